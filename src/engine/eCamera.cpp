@@ -1479,9 +1479,8 @@ void eCamera::SwitchCenter(int d){
     int oldid=centerID;
     if (grid->gameObjectsInteresting.Len()>0){
         if (!InterestingToWatch(grid->gameObjectsInteresting(centerID)))
-            grid->gameObjectsInteresting.Remove
-            (grid->gameObjectsInteresting(centerID),
-             grid->gameObjectsInteresting(centerID)->interestingID);
+            grid->RemoveGameObjectInteresting
+            (grid->gameObjectsInteresting(centerID));
         do{
             timeout--;
             centerID+=d;
@@ -111,24 +111,32 @@ void eDebugLine::Render()
 #endif
 }
 
+// the options only matter if lines are drawn. Leave them alone otherwise,
+// the AI sets them from several threads.
 void eDebugLine::SetColor(REAL r, REAL g, REAL b)
 {
+#ifdef DEBUGLINE
     se_r = r;
     se_g = g;
     se_b = b;
+#endif
 }
 
 void eDebugLine::SetTimeout(REAL time)
 {
+#ifdef DEBUGLINE
     se_timeout = time;
+#endif
 }
 
 void eDebugLine::ResetOptions()
 {
+#ifdef DEBUGLINE
     se_r = 1;
     se_g = 1;
     se_b = 1;
     se_timeout = .1f;
+#endif
 }
 
 void eDebugLine::Draw(const eCoord& start, REAL startH,
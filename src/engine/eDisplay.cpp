@@ -262,7 +262,7 @@ public:
         // adapt zNear and be done
         if( AdaptZNear( zNear_, w, camera_ ) )
         {
-            throw eSensorFinished();
+            finished_ = true;
         }
     }
 private:
@@ -39,8 +39,11 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include "tMath.h"
 #include "nConfig.h"
 #include "eTeam.h"
+#include "tSysTime.h"
 
 #include <map>
+#include <vector>
+#include <algorithm>
 
 uActionPlayer eGameObject::se_turnRight("CYCLE_TURN_RIGHT", -10);
 
@@ -72,6 +75,14 @@ void eGameObject::RemoveFromList(){
 }
 
 void eGameObject::RemoveFromListsAll(){
+    // objects that never entered the lists, like sensors, have nothing to remove;
+    // don't take the sound lock for them, they may live on AI think threads
+    if ( id < 0 && inactiveID < 0 && interestingID < 0 && hashID < 0 )
+    {
+        currentFace = 0;
+        return;
+    }
+
     eSoundLocker locker;
 
     int oldID = id;
@@ -80,7 +91,7 @@ void eGameObject::RemoveFromListsAll(){
 
     grid->gameObjects.Remove(this,id);
     grid->gameObjectsInactive.Remove(this,inactiveID);
-    grid->gameObjectsInteresting.Remove(this,interestingID);
+    grid->RemoveGameObjectInteresting(this);
 
     if ( oldID >= 0 )
         Release();
@@ -124,6 +135,9 @@ eGameObject::eGameObject(eGrid *g,const eCoord &p,const eCoord &d,eFace *current
     id=-1;
     interestingID=-1;
     inactiveID=-1;
+    hashID=-1;
+    hashCell=-1;
+    hashCellID=-1;
     if ( lastTime < 0 )
         lastTime=0;
     team = 0;
@@ -142,25 +156,83 @@ eGameObject::~eGameObject(){
 // makes two gameObjects interact:
 void eGameObject::InteractWith(eGameObject *,REAL,int){}
 
+// by default, objects may interact with anything
+REAL eGameObject::InteractionRange() const
+{
+    return 1E+30;
+}
+
+// calls InteractWith() for all interesting objects in InteractionRange()
+void eGameObject::InteractWithNearby(REAL currentTime)
+{
+    REAL range = InteractionRange();
+    if ( range < 0 )
+        return;
+
+    eGameObjectHash const & hash = grid->gameObjectsInterestingHash;
+    eCoord center = Position();
+    std::vector< eGameObject * > candidates;
+    if ( !hash.Find( center, range, candidates ) )
+    {
+        // the range is too large for the hash to help
+        for(int j=grid->gameObjectsInteresting.Len()-1;j>=0;j--)
+            InteractWith(grid->gameObjectsInteresting(j),currentTime,0);
+        return;
+    }
+
+    int removals = hash.Removals();
+    std::vector< eGameObject * > done;
+    size_t i = 0;
+    while ( i < candidates.size() )
+    {
+        InteractWith( candidates[i++], currentTime, 0 );
+
+        if ( hash.Removals() != removals )
+        {
+            // objects were removed, the remaining candidates may be gone. Look them up again.
+            removals = hash.Removals();
+            done.insert( done.end(), candidates.begin(), candidates.begin() + i );
+
+            std::vector< eGameObject * > found;
+            hash.Find( center, range, found );
+            candidates.clear();
+            for ( size_t j = 0; j < found.size(); ++j )
+                if ( std::find( done.begin(), done.end(), found[j] ) == done.end() )
+                    candidates.push_back( found[j] );
+            i = 0;
+        }
+    }
+}
+
 // what happens if we pass eWall w?
 void eGameObject::PassEdge(const eWall *w,REAL,REAL,int){
     if (w) Kill();
 }
 
-static int se_moveTimeout = 100;
-static tSettingItem<int> se_moveTimeoutC("GAMEOBJECT_MOVE_TIMEOUT", se_moveTimeout);
-
-// data structures for storing temp wall collisions
-struct eTempEdgePassing
+// forwards the walls crossed by a moving object to its PassEdge()
+class eGameObjectRaycastHandler: public eRaycastHandler
 {
-    eWall *wall; //!< the wall the object collides with
-    REAL ratio;  //!< the location of the collision point on the wall
-};
-typedef std::multimap< REAL, eTempEdgePassing > eTempEdgeMap;
+public:
+    eGameObjectRaycastHandler( eGameObject & object ): object_( object ){}
 
+    virtual bool Cross( eWall const * wall, REAL time, REAL wallRatio )
+    {
+        object_.PassEdge( wall, time, wallRatio, 0 );
+        return false;
+    }
+private:
+    eGameObject & object_;
+};
 
 // moves
 void eGameObject::Move( const eCoord &dest, REAL startTime, REAL endTime, bool useTempWalls )
+{
+    eGameObjectRaycastHandler handler( *this );
+    Move( dest, startTime, endTime, handler, useTempWalls );
+}
+
+// moves, stopping at the first wall the handler accepts
+eWall const * eGameObject::Move( const eCoord &dest, REAL startTime, REAL endTime, eRaycastHandler & handler, bool useTempWalls )
 {
 #ifdef DEBUG
     grid->Check();
@@ -168,12 +240,10 @@ void eGameObject::Move( const eCoord &dest, REAL startTime, REAL endTime, bool u
     if (!finite(dest.x) || !finite(dest.y))
     {
         st_Breakpoint();
-        return;
+        return NULL;
     }
 
     tStackObject< ePoint > start(pos),stop(dest);
-    ePoint* pstart = &start;
-    ePoint* pstop = &stop;
 
     // clip movement to rim walls
     REAL clip = eWallRim::Clip(start,stop,-10);
@@ -189,247 +259,17 @@ void eGameObject::Move( const eCoord &dest, REAL startTime, REAL endTime, bool u
         static_cast<eCoord&>(stop) = dest;
         eWallRim::Bound(stop,-10);
 
-        return;
+        return NULL;
     }
 #endif
 
-    //  se_GridRange(dest.Norm_squared());
-    eTempEdgeMap tempCollisions;
-
-    tStackObject< eTempEdge >  te( pstart, pstop );
-    eHalfEdge  &e=*te.Edge(0);
-
-    // check all the currently drawn eWalls:
-    if ( useTempWalls )
-    {
-        for(int i=grid->wallsNotYetInserted.Len()-1;i>=0;i--){
-            const eHalfEdge *other_e=grid->wallsNotYetInserted[i]->Edge();
-            if (//!sg_netPlayerWalls(i)->Preliminary() &&
-                other_e->Point() && other_e->Other() && other_e->Other()->Point()){
-                tJUST_CONTROLLED_PTR< ePoint > new_cross_p=e.IntersectWith(other_e);
-                if (new_cross_p){
-                    REAL e_ratio =e.Ratio(*new_cross_p);
-                    REAL o_ratio =other_e->Ratio(*new_cross_p);
-                    if (0<=e_ratio && 1>=e_ratio &&
-                            0<=o_ratio && 1>=o_ratio)
-                    { // find the fall
-                        eWall *w = other_e->GetWall();
-                        if (!w)
-                        {
-                            w = other_e->Other()->GetWall();
-                            o_ratio = 1-o_ratio;
-                        }
-                        if (w)
-                        {
-                            // insert data into map structure for later processing
-                            eTempEdgePassing passing;
-                            passing.wall = w;
-                            passing.ratio = o_ratio;
-                            tempCollisions.insert( std::pair< REAL, eTempEdgePassing >( e_ratio, passing) );
-                        }
-                    }
-                }
-            }
-        }
-    }
-
     // find a replacement face if required
     FindCurrentFace();
 
-    // the total distance to travel
-    REAL totalDistance = ( stop - pos ).Norm();
-
     if (currentFace){
-        // start iterator for collisions with temporary walls
-        eTempEdgeMap::const_iterator currentTempCollision = tempCollisions.begin();
-
-        int timeout = se_moveTimeout;
-
-        REAL lastDistance = 1E+30; // the distance of pos and stop in the last step
-        eHalfEdge *in    = NULL;   // incoming edge to prevent entdless loop
-
-        while (currentFace && timeout >0 && !currentFace->IsInside(stop)){
-            // the vector to our destination:
-            eCoord vec=stop - pos;
-
-            // count down timeout if we're moving into the wrong direction
-            REAL distance = vec.Norm();
-            if ( distance >= lastDistance )
-            {
-                timeout--;
-            }
-            else
-            {
-                timeout = se_moveTimeout;
-                if ( lastDistance > 1E+29 )
-                    lastDistance = distance * 1.1;
-                lastDistance = .1 * lastDistance + distance * (.9 - EPS);
-
-                // check if the target has been reached within tolerance; it can only make matters
-                // worse then to continue, even if the current face claims we're not part of it.
-                if ( distance <= EPS * totalDistance )
-                {
-                    // st_Breakpoint();
-                    break;
-                }
-            }
-#ifdef DEBUG_X
-rerun:
-#endif
-
-            eHalfEdge *run   = currentFace->Edge(); // runs through all edges of the face
-            eHalfEdge *best  = NULL;                // the best face to leave
-            eHalfEdge *end   = run;
-            REAL bestScore   = -10.0;
-            REAL bestERatio  = .5;
-            REAL bestRRatio  = .5;
-            eCoord bestCross   (0,0);
-
-            // look for the best way out
-            do
-            {
-                run = run->Next();
-
-                if (run == in) // never leave through the edge we entered
-                    continue;
-
-                eCoord runVec = run->Vec();
-
-                REAL score = runVec * vec / ( se_EstimatedRangeOfMult( runVec, vec ) + EPS );
-                static const REAL smallBias = .01;
-
-                // keep a bit of the score, but not too much. We want to
-                // sort out exactly parallel walls here.
-                if ( score > smallBias || ( score > 0 && !run->GetWall() ) )
-                    score = smallBias;
-
-                eCoord cross = e.IntersectWithCareless(run);
-
-                // project crossing to face edge without score penalty
-                REAL run_ratio = run->Ratio(cross);
-                if ( !good( run_ratio ) )
-                {
-                    // score -= 100;
-                    run_ratio = .5;
-                }
-
-                if (run_ratio < 0)
-                {
-                    // score += run_ratio;
-                    run_ratio = 0;
-                }
-                else if (run_ratio > 1)
-                {
-                    // score += (1-run_ratio);
-                    run_ratio = 1;
-                }
-                cross = *run->Point() + run->Vec() * run_ratio;
-
-                // determine how far off the movement edge the modified intersection lies
-                REAL e_side  = vec * ( cross - pos ) / distance;
-                score -= fabs( e_side );
-                // REAL run_side  = runVec * ( cross - *run->Point() ) / runVec.NormSquared();
-
-                REAL e_ratio   = e.Ratio(cross);
-
-                // see whether the intersection is beyond the end points of the movement vector
-                if ( !good( e_ratio ) )
-                {
-                    score -= 100;
-                    e_ratio = .5;
-                }
-
-                if (e_ratio < 0)
-                {
-                    score += e_ratio;
-                    e_ratio = 0;
-                }
-                else if (e_ratio > 1)
-                {
-                    score += (1-e_ratio);
-                    e_ratio = 1;
-                }
-
-                if (score > bestScore)
-                {
-                    best       = run;
-                    bestScore  = score;
-                    bestERatio = e_ratio;
-                    bestRRatio = run_ratio;
-                    bestCross  = cross;
-                }
-
-            }
-            while (run != end);
-
-#ifdef DEBUG_X
-            if ( !good( bestScore ) || bestScore < -50 )
-            {
-                st_Breakpoint();
-                goto rerun;
-            }
-#endif
-
-#define TIME( ratio ) ( startTime+(endTime-startTime)*( ratio ) )
-
-            if (best)
-            {
-                // handle stored temp collisions
-                while ( currentTempCollision != tempCollisions.end() && (*currentTempCollision).first < bestERatio )
-                {
-                    eTempEdgePassing const & passing = (*currentTempCollision).second;
-                    PassEdge( passing.wall, TIME( (*currentTempCollision).first ), passing.ratio, 0 );
-                    ++ currentTempCollision;
-                }
-
-                REAL time=TIME( bestERatio );
-
-                // move to the collision point
-                pos = bestCross;
-
-                // leave this face (through a wall)
-                eWall*     w     = best->GetWall();
-                if (w)
-                    PassEdge(w,time,bestRRatio,0);
-
-                // set next incoming edge
-                tASSERT(best->Other());
-                in          = best->Other();
-
-                // enter the next face (through a wall)
-                if (in)
-                {
-                    bestRRatio = 1-bestRRatio;
-                    w = in->GetWall();
-
-                    if (w)
-                        PassEdge(w,time,bestRRatio,0);
-                }
-
-                // switch to the next face
-                if (in)
-                    currentFace=in->Face();
-                else
-                    currentFace=NULL;
-            }
-            else
-            {
-                timeout = 0;
-            }
-        }
-
-        if (timeout <= 0)
-            grid->requestCleanup = true;
-        else
-            pos=stop;
-
-        // handle stored temp collisions
-        while ( currentTempCollision != tempCollisions.end() )
-        {
-            eTempEdgePassing const & passing = (*currentTempCollision).second;
-            PassEdge( passing.wall, TIME( (*currentTempCollision).first ), passing.ratio, 0 );
-            ++ currentTempCollision;
-        }
+        eWall const * hit = grid->Raycast( pos, currentFace, stop, startTime, endTime, handler, useTempWalls );
+        if ( hit )
+            return hit;
     }
     else // !currentFace
     {
@@ -451,6 +291,8 @@ rerun:
     //    currentFace = NULL;
 
     lastTime = endTime;
+
+    return NULL;
 }
 
 // emulate old bug allowing objects to tunnel through walls
@@ -724,13 +566,14 @@ bool eGameObject::TimestepThis(REAL currentTime,eGameObject *c){
         c->FindCurrentFace();
 
         if (sn_GetNetState()!=nCLIENT)
-            for(int j=c->grid->gameObjectsInteresting.Len()-1;j>=0;j--)
-                c->InteractWith(c->grid->gameObjectsInteresting(j),currentTime,0);
+            c->InteractWithNearby(currentTime);
 
         REAL timeThisStep = lastTime+i*(currentTime-lastTime)/number_of_steps;
         ret = ret || c->Timestep(timeThisStep);
         c->FindCurrentFace();
 
+        c->grid->UpdateGameObjectInteresting( c );
+
         // see if the object refused to get simulated, if yes, give up
         if ( 2 * c->lastTime < timeThisStep + lastTime )
             break;
@@ -833,12 +676,18 @@ void eGameObject::TimestepThisWrapper(eGrid * grid, REAL currentTime, eGameObjec
 }
 
 // does a timestep and all interactions for every eGameObject
+static tPhaseTimer se_timestepTimer( "timestep" );
 void eGameObject::s_Timestep(eGrid *grid, REAL currentTime, REAL minTimestep)
 {
+    tPhaseTimerScope phase( se_timestepTimer );
+
 #ifdef DEBUG
     grid->Check();
 #endif
 
+    // objects may have been moved by other means than simulation
+    grid->gameObjectsInterestingHash.UpdateAll();
+
     // simulate game objects
     for(int i=grid->gameObjects.Len()-1;i>=0;i--)
     {
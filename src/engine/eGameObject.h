@@ -39,6 +39,7 @@ class uActionPlayer;
 class eTeam;
 class eWall;
 class eCamera;
+class eRaycastHandler;
 
 // a generic object for the game (cycles,explosions, particles,
 // maybe AI opponents..)
@@ -47,6 +48,7 @@ class eGameObject{
     friend class eCamera;
     friend class eSensor;
     friend class eGrid;
+    friend class eGameObjectHash;
     friend class ePlayerNetID;
 
     // a list of all active gameobjects
@@ -62,6 +64,9 @@ protected:
     // divided in many small steps
     static bool TimestepThis(REAL currentTime,eGameObject *t);
 
+    // calls InteractWith() for all interesting objects in InteractionRange()
+    void InteractWithNearby(REAL currentTime);
+
     // tells game objects how far they are allowed to exeed the given simulation time
     static REAL MaxSimulateAhead();
 
@@ -69,6 +74,11 @@ protected:
     int interestingID;
     int inactiveID;
 
+    // position in the spatial hash of interesting eGameObjects
+    int hashID;         // index in the list of all hashed objects
+    int hashCell;       // hash bucket
+    int hashCellID;     // index in the bucket
+
     // shall s_Timestep delete a eGameObject requesting destruction
     // completely (autodelete=1) or should it just be removed from the list
     // (autodelete=0) ?
@@ -136,6 +146,9 @@ public:
     // makes two gameObjects interact:
     virtual void InteractWith( eGameObject *target,REAL time,int recursion=1 );
 
+    //! the maximal distance an interesting object can have to be affected by InteractWith(). Negative: there are no interactions.
+    virtual REAL InteractionRange() const;
+
     // what happens if we pass eWall w? (at position e->p[0]*a + e->p[1]*(1-a) )
     virtual void PassEdge( const eWall *w,REAL time,REAL a,int recursion=1 );
 
@@ -145,6 +158,11 @@ public:
     // moves the object from pos to dest during the timeinterval
     // [startTime,endTime] and issues all eWall-crossing tEvents
     void Move( const eCoord &dest, REAL startTime, REAL endTime, bool useTempWalls = true );
+protected:
+    // like Move(), but reports the crossed walls to handler instead of PassEdge().
+    // Stops at the first wall the handler accepts and returns it.
+    eWall const * Move( const eCoord &dest, REAL startTime, REAL endTime, eRaycastHandler & handler, bool useTempWalls = true );
+public:
 
     // finds the eFace we are in
     void FindCurrentFace();
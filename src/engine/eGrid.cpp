@@ -31,6 +31,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 
 #include "eGrid.h"
 #include "eTess2.h"
+#include "ePath.h"
 
 #include "rTexture.h"
 #include "tEventQueue.h"
@@ -43,9 +44,12 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include "nConfig.h" 
 
 #include "tRecorder.h"
+#include "tSysTime.h"
 
 #include <vector>
 #include <set>
+#include <map>
+#include <algorithm>
 
 #define SMALL_FLOAT 1E-30
 const REAL se_maxGridSize = 1E+15;	// this gives us way more space than OpenGL allows us to render
@@ -68,6 +72,103 @@ tDEFINE_REFOBJ( ePoint )
 tDEFINE_REFOBJ( eHalfEdge )
 tDEFINE_REFOBJ( eFace )
 
+// free list allocator for grid topology objects of one size. Memory is kept
+// for reuse and only handed back in bulk, once all objects are gone. Sensors
+// allocate temporary edges from AI think threads, so access is locked.
+class eGridPool
+{
+public:
+    eGridPool( size_t size )
+            : size_( size ), free_( NULL ), alive_( 0 )
+    {
+        // round up so every slot can hold the free list link and stays aligned
+        size_t const align = sizeof( double ) > sizeof( void * ) ? sizeof( double ) : sizeof( void * );
+        slotSize_ = ( ( size > sizeof( void * ) ? size : sizeof( void * ) ) + align - 1 ) / align * align;
+    }
+
+    ~eGridPool()
+    {
+        Trim();
+    }
+
+    void * Alloc( size_t size )
+    {
+        tASSERT( size == size_ );
+
+        mutex_.acquire();
+        if ( !free_ )
+        {
+            // get a new slab and put its slots on the free list
+            char * slab = static_cast< char * >( ::operator new( slotSize_ * slabSlots ) );
+            slabs_.push_back( slab );
+            for ( int i = slabSlots-1; i >= 0; --i )
+            {
+                Slot * slot = reinterpret_cast< Slot * >( slab + i * slotSize_ );
+                slot->next = free_;
+                free_ = slot;
+            }
+        }
+
+        Slot * slot = free_;
+        free_ = slot->next;
+        ++alive_;
+        mutex_.release();
+        return slot;
+    }
+
+    void Free( void * ptr )
+    {
+        if ( !ptr )
+            return;
+
+        Slot * slot = static_cast< Slot * >( ptr );
+        mutex_.acquire();
+        slot->next = free_;
+        free_ = slot;
+        --alive_;
+        mutex_.release();
+    }
+
+    // releases all memory if no object is alive
+    void Trim()
+    {
+        if ( alive_ > 0 )
+            return;
+
+        for ( std::vector< char * >::iterator i = slabs_.begin(); i != slabs_.end(); ++i )
+            ::operator delete( *i );
+        slabs_.clear();
+        free_ = NULL;
+    }
+private:
+    struct Slot{ Slot * next; };
+
+    enum { slabSlots = 256 };     // objects per slab
+
+    size_t size_;                 // the size of the objects
+    size_t slotSize_;             // the size of their slots
+    Slot * free_;                 // the free list
+    int alive_;                   // the number of allocated objects
+    tSpinMutex mutex_;            // protects the free list and the counter
+    std::vector< char * > slabs_; // all slabs
+};
+
+template< class T > static eGridPool & se_GridPool()
+{
+    static eGridPool pool( sizeof( T ) );
+    return pool;
+}
+
+#define eGRID_POOL_DEFINITION( T ) \
+void * T::operator new( size_t size ) { return se_GridPool< T >().Alloc( size ); } \
+void * T::operator new( size_t size, const char *, const char *, int ) { return se_GridPool< T >().Alloc( size ); } \
+void   T::operator delete( void * ptr, size_t ) { se_GridPool< T >().Free( ptr ); } \
+void   T::operator delete( void * ptr, const char *, const char *, int ) { se_GridPool< T >().Free( ptr ); }
+
+eGRID_POOL_DEFINITION( ePoint )
+eGRID_POOL_DEFINITION( eHalfEdge )
+eGRID_POOL_DEFINITION( eFace )
+
 
 REAL se_EstimatedRangeOfMult( const eCoord &a,const eCoord &b )
 {
@@ -96,10 +197,20 @@ void	   eTempEdge::SetWall( eWall* W )    const
 short se_bugRip=false;
 static nSettingItem<short> se_bugRipNet( "BUG_RIP", se_bugRip );
 
+// changes to edges and walls
+static int se_gridRevision = 0;
+
+int eGrid::Revision()
+{
+    return se_gridRevision;
+}
+
 inline void eHalfEdge::SetWall(eWall *w){
     if (!w)
         return;
 
+    se_gridRevision++;
+
     // emulate rip bug
     if ( se_bugRip )
     {
@@ -153,6 +264,7 @@ inline void eHalfEdge::SetWall(eWall *w){
 
 void eHalfEdge::ClearWall( void )
 {
+    se_gridRevision++;
     eWallHolder::SetWall( NULL );
 }
 
@@ -160,7 +272,6 @@ void eHalfEdge::ClearWall( void )
 eHalfEdge::~eHalfEdge()
 {
     Unlink();
-    RemoveFromHeap();
 }
 
 inline void eHalfEdge::Unlink()
@@ -463,20 +574,20 @@ eFace::~eFace()
 }
 
 eFace::eFace (eHalfEdge *e1,eHalfEdge *e2,eHalfEdge *e3 )
-        :replacementStorage( 0 )
+        :seedCell( -1 ), replacementStorage( 0 )
 {
     Create( e1, e2, e3 );
 }
 
 eFace::eFace (eHalfEdge *e1,eHalfEdge *e2,eHalfEdge *e3, tControlledPTR< eFace >& old )
-        :replacementStorage( 0 )
+        :seedCell( -1 ), replacementStorage( 0 )
 {
     Create( e1, e2, e3 );
     se_LinkFaces( old, this );
 }
 
 eFace::eFace (eHalfEdge *e1,eHalfEdge *e2,eHalfEdge *e3, tControlledPTR< eFace >& old1, tControlledPTR< eFace >& old2 )
-        :replacementStorage( 0 )
+        :seedCell( -1 ), replacementStorage( 0 )
 {
     Create( e1, e2, e3 );
     se_LinkFaces( old1, this );
@@ -2038,7 +2149,10 @@ void eGrid::SimplifyNum(int e){
 
 #endif // SIMPLIFY
 
+static tPhaseTimer se_simplifyTimer( "simplify" );
 void eGrid::SimplifyAll(int count){
+    tPhaseTimerScope phase( se_simplifyTimer );
+
     if (requestCleanup)
     {
         requestCleanup = false;
@@ -2109,7 +2223,7 @@ void eGrid::Create(){
 
 
 void eGrid::Clear(){
-    eHalfEdge::ClearPathData();
+    ePathContext::ClearAll();
 
     eGameObject::DeleteAll( this );
 
@@ -2138,6 +2252,11 @@ void eGrid::Clear(){
     a=b=c=NULL;
 
     //	se_faceReplacements.clear();
+
+    // hand the memory of the round's topology back if nothing refers to it any more
+    se_GridPool< ePoint >().Trim();
+    se_GridPool< eHalfEdge >().Trim();
+    se_GridPool< eFace >().Trim();
 }
 
 void eGrid::Grow()
@@ -2200,6 +2319,10 @@ void eGrid::Grow()
 }
 
 void eGrid::Range(REAL NormSquared){
+    // a frozen grid does not grow; moves are clipped to the rim anyway
+    if (frozen_)
+        return;
+
     if (A==NULL)
         Create();
     //    tERR_ERROR_INT("Wanted to insert something into the nonexistant grid!");
@@ -2247,8 +2370,6 @@ eTempEdge::~eTempEdge()
 
 eHalfEdge::eHalfEdge(ePoint *p):ID(-1),next(NULL), prev(NULL), other(NULL)
 {
-    origin_ = PATH_NONE;
-
     point = p;
     face  = 0;
 }
@@ -2259,8 +2380,6 @@ eHalfEdge::eHalfEdge(ePoint *a, ePoint *b, eWall *w)
 {
     tASSERT( a !=  b);
 
-    origin_ = PATH_NONE;
-
     SetPoint(a);
     SetOther(new eHalfEdge(b));
     SetWall(w);
@@ -2367,6 +2486,19 @@ bool eHalfEdge::Check() const{
 
 
 
+// edge length of the cells of the point location index
+static const REAL se_faceSeedCellSize = 16;
+
+// number of hashed cells of the point location index, must be a power of two
+static const int se_faceSeedCells = 4096;
+
+// the center of a face
+static eCoord se_FaceCenter( eFace const * f )
+{
+    eHalfEdge const * e = f->Edge();
+    return ( *e->Point() + *e->Next()->Point() + *e->Next()->Next()->Point() ) * ( 1/3.0 );
+}
+
 void eGrid::AddFace    (eFace     *f)
 {
     if (f->ID >= 0)
@@ -2376,6 +2508,9 @@ void eGrid::AddFace    (eFace     *f)
 
     if (f->CorrectArea())
         requestCleanup = true;
+
+    // new faces are the best start points for searches around them
+    SeedFace( f, FaceSeedCell( se_FaceCenter( f ) ) );
 }
 
 void eGrid::RemoveFace (eFace     *f)
@@ -2383,6 +2518,7 @@ void eGrid::RemoveFace (eFace     *f)
     if (f->ID < 0)
         return;
 
+    UnseedFace(f);
     faces.Remove(f, f->ID);
 }
 
@@ -2391,9 +2527,11 @@ void eGrid::AddEdge    (eHalfEdge *e)
     if (e->ID >= 0)
         return;
 
+    tASSERT( !frozen_ );
     tASSERT(e->Other() && *e->Point() != *e->Other()->Point());
 
     edges.Add(e, e->ID);
+    se_gridRevision++;
 
     int idrec = e->ID;
     tRecorderSync< int >::Archive( "_GRID_ADD_EDGE", 8, idrec );
@@ -2407,10 +2545,13 @@ void eGrid::RemoveEdge (eHalfEdge *e)
     if (e->ID < 0)
         return;
 
+    tASSERT( !frozen_ );
+
     int idrec = e->ID;
     tRecorderSync< int >::Archive( "_GRID_REMOVE_EDGE", 8, idrec );
 
     edges.Remove(e, e->ID);
+    se_gridRevision++;
 }
 
 void eGrid::AddPoint   (ePoint    *p)
@@ -2540,11 +2681,77 @@ ePoint * eGrid::Insert(const eCoord& x, eFace *start){
 const eCoord se_zeroCoord(0,0);
 
 
+// returns the cell of the point location index containing coord
+int eGrid::FaceSeedCell( const eCoord& coord ) const
+{
+    REAL x = floor( coord.x / se_faceSeedCellSize );
+    REAL y = floor( coord.y / se_faceSeedCellSize );
+    if ( !( fabs( x ) < 1E+6 ) || !( fabs( y ) < 1E+6 ) )
+        return 0;
+
+    unsigned int hash = ( static_cast< unsigned int >( int( x ) ) * 73856093U ) ^ ( static_cast< unsigned int >( int( y ) ) * 19349663U );
+    return hash & ( se_faceSeedCells - 1 );
+}
+
+// returns a face close to coord from the point location index, or NULL
+eFace * eGrid::FaceSeed( const eCoord& coord ) const
+{
+    eFace * seed = faceSeeds[ FaceSeedCell( coord ) ];
+    if ( seed )
+        return seed;
+
+    // try the neighboring cells
+    for ( int x = -1; x <= 1; ++x )
+        for ( int y = -1; y <= 1; ++y )
+        {
+            seed = faceSeeds[ FaceSeedCell( coord + eCoord( x, y ) * se_faceSeedCellSize ) ];
+            if ( seed )
+                return seed;
+        }
+
+    return NULL;
+}
+
+// makes f the start face for searches in the given cell
+void eGrid::SeedFace( eFace * f, int cell ) const
+{
+    UnseedFace( f );
+
+    eFace * & seed = faceSeeds[ cell ];
+    if ( seed )
+        seed->seedCell = -1;
+
+    seed = f;
+    f->seedCell = cell;
+}
+
+// removes f from the point location index
+void eGrid::UnseedFace( eFace * f ) const
+{
+    if ( f->seedCell < 0 )
+        return;
+
+    tASSERT( faceSeeds[ f->seedCell ] == f );
+    faceSeeds[ f->seedCell ] = NULL;
+    f->seedCell = -1;
+}
+
 eFace * eGrid::FindSurroundingFace(const eCoord &pos, eFace *currentFace) const{
     if (faces.Len()<1)
         return NULL;
 
-    if (!currentFace || currentFace->ID < 0 || currentFace->ID >= faces.Len() || faces(currentFace->ID) != currentFace)
+    if (currentFace && ( currentFace->ID < 0 || currentFace->ID >= faces.Len() || faces(currentFace->ID) != currentFace ) )
+        currentFace=NULL;
+
+    if (!currentFace || !currentFace->IsInside(pos))
+    {
+        // start the walk from the indexed face if it is closer than the given one
+        eFace * seed = FaceSeed( pos );
+        if ( seed && ( !currentFace || ( se_FaceCenter( seed ) - pos ).NormSquared() < ( se_FaceCenter( currentFace ) - pos ).NormSquared() ) )
+            currentFace = seed;
+    }
+
+    if (!currentFace)
         currentFace=faces(0);
 
     int timeout=faces.Len()+2;
@@ -2614,15 +2821,303 @@ eFace * eGrid::FindSurroundingFace(const eCoord &pos, eFace *currentFace) const{
             }
     }
 
+    // remember the face for future searches if nothing better is known
+    if ( currentFace && currentFace->ID >= 0 && currentFace->seedCell < 0 && !frozen_ )
+    {
+        int cell = FaceSeedCell( pos );
+        if ( !faceSeeds[ cell ] )
+            SeedFace( currentFace, cell );
+    }
+
     return currentFace;
 }
 
+static int se_moveTimeout = 100;
+static tSettingItem<int> se_moveTimeoutC("GAMEOBJECT_MOVE_TIMEOUT", se_moveTimeout);
+
+// data structures for storing temp wall collisions
+struct eTempEdgePassing
+{
+    eWall *wall; //!< the wall the object collides with
+    REAL ratio;  //!< the location of the collision point on the wall
+};
+typedef std::multimap< REAL, eTempEdgePassing > eTempEdgeMap;
+
+
+// *******************************************************************************
+// *
+// *	Raycast
+// *
+// *******************************************************************************
+//!
+//!		@param	pos          the start of the ray; follows the ray and ends at stop or at the accepted wall
+//!		@param	face         the face pos is in; follows the ray like pos
+//!		@param	stop         the end of the ray
+//!		@param	startTime    the time at the start of the ray
+//!		@param	endTime      the time at the end of the ray
+//!		@param	handler      gets all crossed walls in order and decides where the ray stops
+//!		@param	useTempWalls also report walls that are not yet inserted into the grid
+//!		@return	the wall the handler accepted, or NULL if the ray was not stopped
+//!
+// *******************************************************************************
+
+eWall const * eGrid::Raycast( eCoord & pos, tJUST_CONTROLLED_PTR< eFace > & face, eCoord const & stop, REAL startTime, REAL endTime, eRaycastHandler & handler, bool useTempWalls )
+{
+    tStackObject< ePoint > rayStart(pos),rayStop(stop);
+    ePoint* pstart = &rayStart;
+    ePoint* pstop = &rayStop;
+
+    eTempEdgeMap tempCollisions;
+
+    tStackObject< eTempEdge >  te( pstart, pstop );
+    eHalfEdge  &e=*te.Edge(0);
+
+    // check all the currently drawn eWalls:
+    if ( useTempWalls )
+    {
+        for(int i=wallsNotYetInserted.Len()-1;i>=0;i--){
+            const eHalfEdge *other_e=wallsNotYetInserted[i]->Edge();
+            if (//!sg_netPlayerWalls(i)->Preliminary() &&
+                other_e->Point() && other_e->Other() && other_e->Other()->Point()){
+                tJUST_CONTROLLED_PTR< ePoint > new_cross_p=e.IntersectWith(other_e);
+                if (new_cross_p){
+                    REAL e_ratio =e.Ratio(*new_cross_p);
+                    REAL o_ratio =other_e->Ratio(*new_cross_p);
+                    if (0<=e_ratio && 1>=e_ratio &&
+                            0<=o_ratio && 1>=o_ratio)
+                    { // find the fall
+                        eWall *w = other_e->GetWall();
+                        if (!w)
+                        {
+                            w = other_e->Other()->GetWall();
+                            o_ratio = 1-o_ratio;
+                        }
+                        if (w)
+                        {
+                            // insert data into map structure for later processing
+                            eTempEdgePassing passing;
+                            passing.wall = w;
+                            passing.ratio = o_ratio;
+                            tempCollisions.insert( std::pair< REAL, eTempEdgePassing >( e_ratio, passing) );
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    // the total distance to travel
+    REAL totalDistance = ( stop - pos ).Norm();
+
+    // start iterator for collisions with temporary walls
+    eTempEdgeMap::const_iterator currentTempCollision = tempCollisions.begin();
+
+    int timeout = se_moveTimeout;
+
+    REAL lastDistance = 1E+30; // the distance of pos and stop in the last step
+    eHalfEdge *in    = NULL;   // incoming edge to prevent entdless loop
+
+    while (face && timeout >0 && !face->IsInside(stop)){
+        // the vector to our destination:
+        eCoord vec=stop - pos;
+
+        // count down timeout if we're moving into the wrong direction
+        REAL distance = vec.Norm();
+        if ( distance >= lastDistance )
+        {
+            timeout--;
+        }
+        else
+        {
+            timeout = se_moveTimeout;
+            if ( lastDistance > 1E+29 )
+                lastDistance = distance * 1.1;
+            lastDistance = .1 * lastDistance + distance * (.9 - EPS);
+
+            // check if the target has been reached within tolerance; it can only make matters
+            // worse then to continue, even if the current face claims we're not part of it.
+            if ( distance <= EPS * totalDistance )
+            {
+                // st_Breakpoint();
+                break;
+            }
+        }
+#ifdef DEBUG_X
+rerun:
+#endif
+
+        eHalfEdge *run   = face->Edge(); // runs through all edges of the face
+        eHalfEdge *best  = NULL;                // the best face to leave
+        eHalfEdge *end   = run;
+        REAL bestScore   = -10.0;
+        REAL bestERatio  = .5;
+        REAL bestRRatio  = .5;
+        eCoord bestCross   (0,0);
+
+        // look for the best way out
+        do
+        {
+            run = run->Next();
+
+            if (run == in) // never leave through the edge we entered
+                continue;
+
+            eCoord runVec = run->Vec();
+
+            REAL score = runVec * vec / ( se_EstimatedRangeOfMult( runVec, vec ) + EPS );
+            static const REAL smallBias = .01;
+
+            // keep a bit of the score, but not too much. We want to
+            // sort out exactly parallel walls here.
+            if ( score > smallBias || ( score > 0 && !run->GetWall() ) )
+                score = smallBias;
+
+            eCoord cross = e.IntersectWithCareless(run);
+
+            // project crossing to face edge without score penalty
+            REAL run_ratio = run->Ratio(cross);
+            if ( !good( run_ratio ) )
+            {
+                // score -= 100;
+                run_ratio = .5;
+            }
+
+            if (run_ratio < 0)
+            {
+                // score += run_ratio;
+                run_ratio = 0;
+            }
+            else if (run_ratio > 1)
+            {
+                // score += (1-run_ratio);
+                run_ratio = 1;
+            }
+            cross = *run->Point() + run->Vec() * run_ratio;
+
+            // determine how far off the movement edge the modified intersection lies
+            REAL e_side  = vec * ( cross - pos ) / distance;
+            score -= fabs( e_side );
+            // REAL run_side  = runVec * ( cross - *run->Point() ) / runVec.NormSquared();
+
+            REAL e_ratio   = e.Ratio(cross);
+
+            // see whether the intersection is beyond the end points of the movement vector
+            if ( !good( e_ratio ) )
+            {
+                score -= 100;
+                e_ratio = .5;
+            }
+
+            if (e_ratio < 0)
+            {
+                score += e_ratio;
+                e_ratio = 0;
+            }
+            else if (e_ratio > 1)
+            {
+                score += (1-e_ratio);
+                e_ratio = 1;
+            }
+
+            if (score > bestScore)
+            {
+                best       = run;
+                bestScore  = score;
+                bestERatio = e_ratio;
+                bestRRatio = run_ratio;
+                bestCross  = cross;
+            }
+
+        }
+        while (run != end);
+
+#ifdef DEBUG_X
+        if ( !good( bestScore ) || bestScore < -50 )
+        {
+            st_Breakpoint();
+            goto rerun;
+        }
+#endif
+
+#define TIME( ratio ) ( startTime+(endTime-startTime)*( ratio ) )
+
+        if (best)
+        {
+            // handle stored temp collisions
+            while ( currentTempCollision != tempCollisions.end() && (*currentTempCollision).first < bestERatio )
+            {
+                eTempEdgePassing const & passing = (*currentTempCollision).second;
+                if ( handler.Cross( passing.wall, TIME( (*currentTempCollision).first ), passing.ratio ) )
+                    return passing.wall;
+                ++ currentTempCollision;
+            }
+
+            REAL time=TIME( bestERatio );
+
+            // move to the collision point
+            pos = bestCross;
+
+            // leave this face (through a wall)
+            eWall*     w     = best->GetWall();
+            if (w && handler.Cross(w,time,bestRRatio))
+                return w;
+
+            // set next incoming edge
+            tASSERT(best->Other());
+            in          = best->Other();
+
+            // enter the next face (through a wall)
+            if (in)
+            {
+                bestRRatio = 1-bestRRatio;
+                w = in->GetWall();
+
+                if (w && handler.Cross(w,time,bestRRatio))
+                    return w;
+            }
+
+            // switch to the next face
+            if (in)
+                face=in->Face();
+            else
+                face=NULL;
+        }
+        else
+        {
+            timeout = 0;
+        }
+    }
+
+    if (timeout <= 0)
+        requestCleanup = true;
+    else
+        pos=stop;
+
+    // handle stored temp collisions
+    while ( currentTempCollision != tempCollisions.end() )
+    {
+        eTempEdgePassing const & passing = (*currentTempCollision).second;
+        if ( handler.Cross( passing.wall, TIME( (*currentTempCollision).first ), passing.ratio ) )
+            return passing.wall;
+        ++ currentTempCollision;
+    }
+
+    return NULL;
+#undef TIME
+}
+
 void eGrid::AddGameObjectInteresting    (eGameObject *o){
     gameObjectsInteresting.Add(o, o->interestingID);
+    gameObjectsInterestingHash.Add(o);
 }
 
 void eGrid::RemoveGameObjectInteresting (eGameObject *o){
     gameObjectsInteresting.Remove(o, o->interestingID);
+    gameObjectsInterestingHash.Remove(o);
+}
+
+void eGrid::UpdateGameObjectInteresting (eGameObject *o){
+    gameObjectsInterestingHash.Update(o);
 }
 
 void eGrid::AddGameObjectInactive       (eGameObject *o){
@@ -2634,6 +3129,171 @@ void eGrid::RemoveGameObjectInactive    (eGameObject *o){
 }
 
 
+// edge length of the cells of the interaction hash
+static REAL se_interactionCellSize = 32;
+static tSettingItem<REAL> se_interactionCellSizeConf("GAMEOBJECT_INTERACTION_CELL_SIZE", se_interactionCellSize);
+
+// maximal number of cells an interaction query may cover before all objects are checked instead
+static int se_interactionMaxCells = 256;
+static tSettingItem<int> se_interactionMaxCellsConf("GAMEOBJECT_INTERACTION_MAX_CELLS", se_interactionMaxCells);
+
+// number of hash buckets, must be a power of two
+static const int se_interactionBuckets = 1024;
+
+// converts a world coordinate to a cell coordinate
+static int se_InteractionCell( REAL x )
+{
+    REAL cellSize = se_interactionCellSize > 1 ? se_interactionCellSize : 1;
+    REAL cell = floor( x / cellSize );
+
+    // keep far away objects from overflowing the integer
+    if ( cell > 1E+6 )
+        cell = 1E+6;
+    if ( !( cell > -1E+6 ) )
+        cell = -1E+6;
+
+    return int( cell );
+}
+
+eGameObjectHash::eGameObjectHash()
+        : cells_( se_interactionBuckets ),
+        visited_( se_interactionBuckets, 0 ),
+        visit_( 0 ),
+        removals_( 0 )
+{
+}
+
+int eGameObjectHash::Cell( int x, int y ) const
+{
+    unsigned int hash = ( static_cast< unsigned int >( x ) * 73856093U ) ^ ( static_cast< unsigned int >( y ) * 19349663U );
+    return hash & ( se_interactionBuckets - 1 );
+}
+
+int eGameObjectHash::Cell( eCoord const & pos ) const
+{
+    return Cell( se_InteractionCell( pos.x ), se_InteractionCell( pos.y ) );
+}
+
+bool eGameObjectHash::CompareInterest( eGameObject const * a, eGameObject const * b )
+{
+    // same order the list of interesting objects is traversed in
+    return a->interestingID > b->interestingID;
+}
+
+void eGameObjectHash::Add( eGameObject * o )
+{
+    if ( o->hashID >= 0 )
+        return;
+
+    o->hashID = objects_.size();
+    objects_.push_back( o );
+
+    o->hashCell = Cell( o->Position() );
+    std::vector< eGameObject * > & cell = cells_[ o->hashCell ];
+    o->hashCellID = cell.size();
+    cell.push_back( o );
+}
+
+void eGameObjectHash::Remove( eGameObject * o )
+{
+    if ( o->hashID < 0 )
+        return;
+
+    ++removals_;
+
+    // remove from the cell
+    std::vector< eGameObject * > & cell = cells_[ o->hashCell ];
+    eGameObject * last = cell.back();
+    cell[ o->hashCellID ] = last;
+    last->hashCellID = o->hashCellID;
+    cell.pop_back();
+
+    // and from the object list
+    last = objects_.back();
+    objects_[ o->hashID ] = last;
+    last->hashID = o->hashID;
+    objects_.pop_back();
+
+    o->hashID = o->hashCell = o->hashCellID = -1;
+}
+
+void eGameObjectHash::Update( eGameObject * o )
+{
+    if ( o->hashID < 0 )
+        return;
+
+    int newCell = Cell( o->Position() );
+    if ( newCell == o->hashCell )
+        return;
+
+    std::vector< eGameObject * > & oldCell = cells_[ o->hashCell ];
+    eGameObject * last = oldCell.back();
+    oldCell[ o->hashCellID ] = last;
+    last->hashCellID = o->hashCellID;
+    oldCell.pop_back();
+
+    o->hashCell = newCell;
+    std::vector< eGameObject * > & cell = cells_[ newCell ];
+    o->hashCellID = cell.size();
+    cell.push_back( o );
+}
+
+void eGameObjectHash::UpdateAll()
+{
+    for ( int i = objects_.size()-1; i >= 0; --i )
+        Update( objects_[i] );
+}
+
+// *******************************************************************************
+// *
+// *	Find
+// *
+// *******************************************************************************
+//!
+//!		@param	pos     the center of the query
+//!		@param	range   the query radius
+//!		@param	result  the objects found in the cells overlapping the query circle are appended here, ordered like the list of interesting objects
+//!		@return	false if the hash is disabled or the query covers too many cells; the caller should then consider all objects
+//!
+// *******************************************************************************
+
+bool eGameObjectHash::Find( eCoord const & pos, REAL range, std::vector< eGameObject * > & result ) const
+{
+    REAL cellSize = se_interactionCellSize > 1 ? se_interactionCellSize : 1;
+    REAL width = 2 * range / cellSize + 2;
+    if ( se_interactionMaxCells <= 0 || !( width * width <= se_interactionMaxCells ) )
+        return false;
+
+    int xMin = se_InteractionCell( pos.x - range ), xMax = se_InteractionCell( pos.x + range );
+    int yMin = se_InteractionCell( pos.y - range ), yMax = se_InteractionCell( pos.y + range );
+
+    // neighboring cells may share a bucket, scan each bucket only once
+    if ( ++visit_ <= 0 )
+    {
+        std::fill( visited_.begin(), visited_.end(), 0 );
+        visit_ = 1;
+    }
+
+    size_t first = result.size();
+    for ( int x = xMin; x <= xMax; ++x )
+    {
+        for ( int y = yMin; y <= yMax; ++y )
+        {
+            int bucket = Cell( x, y );
+            if ( visited_[ bucket ] == visit_ )
+                continue;
+            visited_[ bucket ] = visit_;
+
+            std::vector< eGameObject * > const & cell = cells_[ bucket ];
+            result.insert( result.end(), cell.begin(), cell.end() );
+        }
+    }
+
+    std::sort( result.begin() + first, result.end(), CompareInterest );
+
+    return true;
+}
+
 /*
 
 
@@ -2680,10 +3340,12 @@ void ePoint::InsertIntoGrid(){
 
 eGrid::eGrid()
         :	 requestCleanup(false),
+        frozen_(false),
         A(NULL), B(NULL), C(NULL),
         a(NULL), b(NULL), c(NULL),
         maxNormSquared(-1),
-        base(100,100)
+        base(100,100),
+        faceSeeds( se_faceSeedCells, NULL )
 {
     currentGrid = this;
 }
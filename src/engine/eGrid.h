@@ -32,6 +32,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include "eCoord.h"
 #include "tList.h"
 #include "eAxis.h"
+#include <vector>
 //#include "eGameObject.h"
 //#include "eWall.h"
 //#include "eCamera.h"
@@ -73,6 +74,47 @@ private:
 };
 
 
+//! receives the walls crossed by eGrid::Raycast()
+class eRaycastHandler
+{
+public:
+    virtual ~eRaycastHandler(){}
+
+    //! called for every wall the ray crosses, in order
+    //! @param wall      the crossed wall
+    //! @param time      the time of the crossing, interpolated along the ray
+    //! @param wallRatio the relative position of the crossing on the wall
+    //! @return true if this is the wall the ray is looking for; the ray stops there
+    virtual bool Cross( eWall const * wall, REAL time, REAL wallRatio ) = 0;
+};
+
+//! spatial hash over game objects; finds the candidates for eGameObject::InteractWith() without checking all pairs
+class eGameObjectHash
+{
+public:
+    eGameObjectHash();
+
+    void Add   ( eGameObject * o );      //!< adds an object
+    void Remove( eGameObject * o );      //!< removes an object
+    void Update( eGameObject * o );      //!< moves an object to the cell of its current position
+    void UpdateAll();                    //!< moves all objects to the cells of their current positions
+
+    bool Find( eCoord const & pos, REAL range, std::vector< eGameObject * > & result ) const; //!< finds all objects that may be within range of pos
+
+    int Removals() const { return removals_; } //!< counts removals so iterators over Find() results can detect them
+private:
+    int Cell( eCoord const & pos ) const;    //!< returns the hash bucket for the given position
+    int Cell( int x, int y ) const;          //!< returns the hash bucket for the given cell coordinates
+
+    static bool CompareInterest( eGameObject const * a, eGameObject const * b ); //!< sort order of Find() results
+
+    std::vector< std::vector< eGameObject * > > cells_; //!< the hash buckets
+    std::vector< eGameObject * > objects_;              //!< all objects
+    mutable std::vector< int > visited_;                //!< stamps marking buckets already scanned by Find()
+    mutable int visit_;                                 //!< the current stamp
+    int removals_;                                      //!< number of removals so far
+};
+
 class eGrid: public tReferencable< eGrid >{
     friend class eCamera;
     friend class eFace;
@@ -131,6 +173,13 @@ public:
     // get the currently active grid (OBSOLETE)
     static eGrid *CurrentGrid();
 
+    //! counts changes to the edges and walls of all grids; data derived from them is stale once it moves
+    static int Revision();
+
+    //! while frozen, the grid may be looked at from several threads at once. Lookups leave the point location index alone, nothing may change the topology.
+    void SetFrozen( bool frozen ){ frozen_ = frozen; }
+    bool IsFrozen() const { return frozen_; } //!< tells whether the grid is frozen
+
     /*
       void ResetVisibles(int viewer);  // reset the visibility information
     */
@@ -139,6 +188,12 @@ public:
 
     eFace *FindSurroundingFace(const eCoord& coord, eFace *start=NULL) const;
 
+    // point location index for FindSurroundingFace()
+    int    FaceSeedCell( const eCoord& coord ) const;     // returns the index cell containing coord
+    eFace *FaceSeed    ( const eCoord& coord ) const;     // returns a face close to coord or NULL
+    void   SeedFace    ( eFace* f, int cell ) const;      // makes f the start face of the given cell
+    void   UnseedFace  ( eFace* f ) const;                // removes f from the index
+
     // adds a new Point end, adds an eEdge from start to end with
     // type wall. Modifies other faces and non-eWall-edges;
     // if change_grid is set to 0, no edges will be flipped.
@@ -168,9 +223,13 @@ public:
 
     void AddGameObjectInteresting    (eGameObject *o);
     void RemoveGameObjectInteresting (eGameObject *o);
+    void UpdateGameObjectInteresting (eGameObject *o); // call when an interesting object moved
     void AddGameObjectInactive       (eGameObject *o);
     void RemoveGameObjectInactive    (eGameObject *o);
 
+    //! walks a ray through the faces and reports the crossed walls until handler accepts one
+    eWall const * Raycast( eCoord & pos, tJUST_CONTROLLED_PTR< eFace > & face, eCoord const & stop, REAL startTime, REAL endTime, eRaycastHandler & handler, bool useTempWalls = true );
+
     typedef void WallProcessor		( eWall* 			w 	);	// function prototype for wall query functions
     void ProcessWallsInRange		( WallProcessor* 	proc,
                                 const eCoord&		pos	,
@@ -206,6 +265,7 @@ protected:
     void AddFaceAll (eFace     *f);
 
     bool       requestCleanup; // triggered when the data structures have gone bonkers
+    bool       frozen_;        // set while the grid is read from several threads
 
     // for the grid growth
     tJUST_CONTROLLED_PTR< ePoint > A,B,C;
@@ -217,11 +277,13 @@ protected:
     tList<eHalfEdge, false, true>   edges;
     tList<ePoint, false, true>      points;
     tList<eFace, false, true>       faces;
+    mutable std::vector< eFace * >  faceSeeds; // for every cell of the point location index, a face close to it (or NULL)
 
     // objects
     tList<eGameObject> gameObjects;
     tList<eGameObject> gameObjectsInactive;
     tList<eGameObject> gameObjectsInteresting;
+    eGameObjectHash    gameObjectsInterestingHash; // the interesting objects, sorted by location
 
     // cameras
     tList<eCamera>     cameras;
@@ -0,0 +1,244 @@
+/*
+
+*************************************************************************
+
+ArmageTron -- Just another Tron Lightcycle Game in 3D.
+Copyright (C) 2000  Manuel Moos (manuel@moosnet.de)
+
+**************************************************************************
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+***************************************************************************
+
+*/
+
+// The interaction benchmark: armagetronad_interactionbench builds a synthetic scene
+// of stationary zones and moving cycles on a private grid and times the zone
+// interaction phase once with the spatial hash and once checking all pairs.
+// Both passes have to find the same hits.
+
+#include "config.h"
+
+#include "eGrid.h"
+#include "eGameObject.h"
+#include "tConfiguration.h"
+#include "tCommandLine.h"
+#include "tLocale.h"
+#include "tRandom.h"
+#include "tSysTime.h"
+#include "tString.h"
+
+#include <stdlib.h>
+#include <vector>
+#include <sstream>
+#include <iostream>
+
+// scene parameters and the limits accepted for them
+static int se_zones = 500, se_targets = 200, se_steps = 100;
+static REAL se_range = 10, se_arenaSize = 1000;
+
+static const int se_maxObjects = 100000;
+static const int se_maxSteps = 100000;
+static const REAL se_maxArenaSize = 100000;
+
+class eInteractionBenchmarkCommandLineAnalyzer: public tCommandLineAnalyzer
+{
+private:
+    virtual bool DoAnalyze( tCommandLineParser & parser )
+    {
+        tString value;
+        if ( parser.GetOption( value, "--zones" ) )
+            se_zones = atoi( value );
+        else if ( parser.GetOption( value, "--cycles" ) )
+            se_targets = atoi( value );
+        else if ( parser.GetOption( value, "--steps" ) )
+            se_steps = atoi( value );
+        else if ( parser.GetOption( value, "--radius" ) )
+            se_range = atof( value );
+        else if ( parser.GetOption( value, "--arena" ) )
+            se_arenaSize = atof( value );
+        else
+            return false;
+
+        return true;
+    }
+
+    virtual void DoHelp( std::ostream & s )
+    {                                      //
+        s << "--zones <count>              : number of zones, default 500\n";
+        s << "--cycles <count>             : number of moving objects, default 200\n";
+        s << "--steps <count>              : number of simulation steps, default 100\n";
+        s << "--radius <size>              : zone radius, default 10\n";
+        s << "--arena <size>               : arena edge length, default 1000\n";
+    }
+};
+
+static eInteractionBenchmarkCommandLineAnalyzer se_analyzer;
+
+// stationary object, plays the role of a zone
+class eInteractionBenchmarkZone: public eGameObject
+{
+public:
+    eInteractionBenchmarkZone( eGrid * grid, eCoord const & pos, REAL range )
+            : eGameObject( grid, pos, eCoord( 1, 0 ), NULL, false ), range_( range ), hits_( 0 )
+    {}
+
+    virtual void AddRef(){}
+    virtual void Release(){}
+
+    virtual REAL InteractionRange() const { return range_; }
+
+    virtual void InteractWith( eGameObject * target, REAL, int )
+    {
+        if ( ( target->Position() - pos ).NormSquared() < range_ * range_ )
+            ++hits_;
+    }
+
+    int Interact()
+    {
+        hits_ = 0;
+        InteractWithNearby( 0 );
+        return hits_;
+    }
+private:
+    REAL range_;
+    int hits_;
+};
+
+// moving object, plays the role of a cycle
+class eInteractionBenchmarkTarget: public eGameObject
+{
+public:
+    eInteractionBenchmarkTarget( eGrid * grid, eCoord const & pos, eCoord const & velocity )
+            : eGameObject( grid, pos, velocity, NULL, false ), start_( pos ), startVelocity_( velocity )
+    {}
+
+    virtual void AddRef(){}
+    virtual void Release(){}
+
+    void Reset(){ pos = start_; dir = startVelocity_; }
+
+    void Move( REAL dt, REAL arenaSize )
+    {
+        pos = pos + dir * dt;
+
+        // bounce off the arena borders
+        if ( pos.x < 0 || pos.x > arenaSize )
+            dir.x = -dir.x;
+        if ( pos.y < 0 || pos.y > arenaSize )
+            dir.y = -dir.y;
+    }
+private:
+    eCoord start_, startVelocity_;
+};
+
+// sets the maximal number of cells a hash query may cover; 0 checks all pairs
+static void se_SetInteractionMaxCells( int cells )
+{
+    std::ostringstream line;
+    line << "GAMEOBJECT_INTERACTION_MAX_CELLS " << cells << "\n";
+    std::istringstream s( line.str() );
+    tCurrentAccessLevel level( tAccessLevel_Owner, true );
+    tConfItemBase::LoadLine( s );
+}
+
+int main( int argc, char ** argv )
+{
+    tString version( "interaction benchmark" );
+    tCommandLineData commandLine;
+    commandLine.programVersion_ = &version;
+    if ( !commandLine.Analyse( argc, argv ) )
+        return 0;
+
+    if ( se_zones < 0 || se_zones > se_maxObjects ||
+         se_targets < 0 || se_targets > se_maxObjects ||
+         se_steps < 1 || se_steps > se_maxSteps ||
+         !( se_arenaSize > 0 && se_arenaSize <= se_maxArenaSize ) ||
+         !( se_range > 0 && se_range <= se_arenaSize ) )
+    {
+        std::cerr << "Parameters out of range: up to " << se_maxObjects << " zones and cycles, 1 to "
+        << se_maxSteps << " steps, an arena size up to " << se_maxArenaSize
+        << " and a zone radius up to the arena size.\n";
+        return 1;
+    }
+
+    tLocale::Load( "languages.txt" );
+    atexit( tLocale::Clear );
+    tConfItemBase::printChange = false;
+
+    tJUST_CONTROLLED_PTR< eGrid > grid = tNEW( eGrid )();
+
+    // a private randomizer; nobody seeds rand() here, so every run builds the same scene
+    tReproducibleRandomizer randomizer;
+    std::vector< eInteractionBenchmarkZone * > zoneObjects;
+    for ( int i = se_zones-1; i >= 0; --i )
+    {
+        eCoord pos( randomizer.Get() * se_arenaSize, randomizer.Get() * se_arenaSize );
+        zoneObjects.push_back( tNEW( eInteractionBenchmarkZone )( grid, pos, se_range ) );
+    }
+    std::vector< eInteractionBenchmarkTarget * > targetObjects;
+    for ( int i = se_targets-1; i >= 0; --i )
+    {
+        eCoord pos( randomizer.Get() * se_arenaSize, randomizer.Get() * se_arenaSize );
+        eCoord velocity( randomizer.Get() * 40 - 20, randomizer.Get() * 40 - 20 );
+        targetObjects.push_back( tNEW( eInteractionBenchmarkTarget )( grid, pos, velocity ) );
+        grid->AddGameObjectInteresting( targetObjects.back() );
+    }
+
+    double time[2];
+    int hits[2];
+    for ( int pass = 0; pass < 2; ++pass )
+    {
+        // first pass with the hash, second pass checking all pairs
+        if ( pass == 1 )
+            se_SetInteractionMaxCells( 0 );
+
+        for ( int i = targetObjects.size()-1; i >= 0; --i )
+            targetObjects[i]->Reset();
+
+        hits[pass] = 0;
+        double start = tRealSysTimeFloat();
+        for ( int step = 0; step < se_steps; ++step )
+        {
+            for ( int i = targetObjects.size()-1; i >= 0; --i )
+            {
+                targetObjects[i]->Move( .1, se_arenaSize );
+                grid->UpdateGameObjectInteresting( targetObjects[i] );
+            }
+            for ( int i = zoneObjects.size()-1; i >= 0; --i )
+                hits[pass] += zoneObjects[i]->Interact();
+        }
+        time[pass] = tRealSysTimeFloat() - start;
+    }
+
+    for ( int i = zoneObjects.size()-1; i >= 0; --i )
+        delete zoneObjects[i];
+    for ( int i = targetObjects.size()-1; i >= 0; --i )
+        delete targetObjects[i];
+    grid = NULL;
+
+    std::cout << "method\ttotal_s\thits\n";
+    std::cout << "hash\t" << time[0] << "\t" << hits[0] << "\n";
+    std::cout << "all_pairs\t" << time[1] << "\t" << hits[1] << "\n";
+
+    if ( hits[0] != hits[1] )
+    {
+        std::cerr << "The spatial hash and the all pairs check found different hits.\n";
+        return 1;
+    }
+
+    return 0;
+}
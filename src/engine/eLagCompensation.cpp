@@ -383,12 +383,13 @@ void nServerLag::Balance()
         return;
 
     // find the minimum used credit
+    std::vector< int > const & users = sn_ActiveUsers();
     REAL minCredit = se_lagCredit;
-    for ( i = MAXCLIENTS; i>0; --i )
+    for ( i = users.size()-1; i>=0; --i )
     {
-        if ( sn_Connections[i].socket )
+        if ( users[i] > 0 )
         {
-            REAL credit = se_serverLag[i].creditUsed_;
+            REAL credit = se_serverLag[users[i]].creditUsed_;
             if ( credit < minCredit )
                 minCredit = credit;
         }
@@ -397,10 +398,11 @@ void nServerLag::Balance()
     // find out how much you can take away
     REAL amnesty = minCredit - se_lagCredit * se_lagCreditSweetSpot;
 
-    // and take it away from everyone
+    // and take it away from everyone; the others get reset on login
     if ( amnesty > 0 )
-        for ( i = MAXCLIENTS; i>0; --i )
-            se_serverLag[i].creditUsed_ -= amnesty;
+        for ( i = users.size()-1; i>=0; --i )
+            if ( users[i] > 0 )
+                se_serverLag[users[i]].creditUsed_ -= amnesty;
 }
 
 // callback resetting the lag credit on login/logout
@@ -33,6 +33,10 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include "eGrid.h"
 #include "eTeam.h"
 #include "eTess2.h"
+#include "tSysTime.h"
+
+#include <vector>
+#include <math.h>
 
 //static nNOInitialisator<eNetGameObject> eNetGameObject_Init("eNetGameObject");
 
@@ -296,6 +300,84 @@ bool eNetGameObject::ClearToTransmit(int user) const{
          player->HasBeenTransmitted(user));
 }
 
+// distance up to which objects are of full interest for syncing
+static REAL se_syncInterestRange = 100;
+static tSettingItem<REAL> se_syncInterestRangeConf( "SYNC_INTEREST_RANGE", se_syncInterestRange );
+
+// positions of the living objects controlled by each user
+static std::vector< eCoord > se_syncViewers[MAXCLIENTS+2];
+
+// collects the positions of all living objects controlled by each user
+static void se_UpdateSyncViewers()
+{
+    static REAL lastUpdate = -1;
+    REAL now = tSysTimeFloat();
+    if ( now == lastUpdate )
+        return;
+    lastUpdate = now;
+
+    // clear the lists filled last time
+    static std::vector< int > filled;
+    for ( std::vector< int >::const_iterator iter = filled.begin(); iter != filled.end(); ++iter )
+        se_syncViewers[*iter].clear();
+    filled.clear();
+
+    for ( int i = se_PlayerNetIDs.Len()-1; i >= 0; --i )
+    {
+        ePlayerNetID * player = se_PlayerNetIDs(i);
+        eNetGameObject * object = player->Object();
+        int owner = player->Owner();
+        if ( object && object->Alive() && owner >= 0 && owner <= MAXCLIENTS+1 )
+        {
+            if ( se_syncViewers[owner].empty() )
+                filled.push_back( owner );
+            se_syncViewers[owner].push_back( object->Position() );
+        }
+    }
+}
+
+// *******************************************************************************
+// *
+// *	se_SyncInterest
+// *
+// *******************************************************************************
+//!
+//!		@param	user	the user that is to receive the sync
+//!		@param	pos 	the center of the object
+//!		@param	radius	the extent of the object around its center
+//!		@return	the interest of the user in the object: 1 if it is near one of the user's own objects, falling off with distance beyond that
+//!
+// *******************************************************************************
+
+REAL se_SyncInterest( int user, eCoord const & pos, REAL radius )
+{
+    se_UpdateSyncViewers();
+
+    // spectators see everything
+    std::vector< eCoord > const & viewers = se_syncViewers[user];
+    if ( viewers.size() == 0 || se_syncInterestRange <= 0 )
+        return 1;
+
+    REAL minDist2 = -1;
+    for ( std::vector< eCoord >::const_iterator i = viewers.begin(); i != viewers.end(); ++i )
+    {
+        REAL dist2 = ( *i - pos ).NormSquared();
+        if ( minDist2 < 0 || dist2 < minDist2 )
+            minDist2 = dist2;
+    }
+
+    REAL dist = sqrt( minDist2 ) - radius;
+    if ( dist <= se_syncInterestRange )
+        return 1;
+
+    return se_syncInterestRange / dist;
+}
+
+REAL eNetGameObject::SyncInterest( int user ) const
+{
+    return se_SyncInterest( user, Position(), 0 );
+}
+
 bool eNetGameObject::Timestep(REAL currentTime){
     // calculate new sr_laggometer
     if (sn_GetNetState() == nSTANDALONE){
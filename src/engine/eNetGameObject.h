@@ -82,6 +82,7 @@ public:
     virtual void ReadSync(nMessage &m);
     //virtual nDescriptor &CreatorDescriptor() const;
     virtual bool ClearToTransmit(int user) const;
+    virtual REAL SyncInterest(int user) const;
     virtual bool SyncIsNew(nMessage &m);
 
     virtual void AddRef();          //!< adds a reference
@@ -104,6 +105,9 @@ public:
     virtual REAL LagThreshold() const;
 };
 
+//! returns the interest a user has in syncs of an object at pos with the given extent
+REAL se_SyncInterest( int user, eCoord const & pos, REAL radius );
+
 nMessage &operator << (nMessage &m, const eCoord &x);
 nMessage &operator >> (nMessage &m, eCoord &x);
 
@@ -33,9 +33,10 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include "eWall.h"
 #include "eSensor.h"
 
-// heap of HalfEdges that are considered to be included in a possible path
-static tHeap<eHalfEdge> open;
-static tHeap<eHalfEdge> closed;
+#include <algorithm>
+
+// all path contexts, so they can release their edges when the grid is cleared
+static tList<ePathContext> se_pathContexts;
 
 
 
@@ -108,22 +109,7 @@ eWall* eHalfEdge::CrossesNewWall(const eGrid *grid) const
     return NULL;
 }
 
-void eHalfEdge::ClearPathData()
-{
-    while (open.Len())
-    {
-        eHalfEdge *e = open.Remove(0);
-        e->origin_ = PATH_NONE;
-    }
-    while (closed.Len())
-    {
-        eHalfEdge *e = closed.Remove(0);
-        e->origin_ = PATH_NONE;
-    }
-}
-
-
-REAL EdgePenalty(const eHalfEdge *e, const eGameObject *g)
+static REAL EdgePenalty(const eHalfEdge *e, const eGameObject *g)
 {
     eCoord probePre = e->Vec().Turn(0, 1);
     eCoord probe    = probePre * (1/sqrt(probePre.NormSquared()));
@@ -137,228 +123,267 @@ REAL EdgePenalty(const eHalfEdge *e, const eGameObject *g)
     return 100 * (1/(s.hit + .1) - (1/1.1));
 }
 
-void eHalfEdge::SetMinPathLength( REAL length, tHeapBase& heap, ePATH_ORIGIN origin )
+// is the edge still part of the grid, with all the neighbours the search looks at?
+static bool Usable(const eHalfEdge *e)
 {
-    tASSERT( Heap() != &closed );
+    return e->Point() && e->Face() && e->Next() && e->Other() && e->Next()->Next();
+}
 
-    origin_ = origin;
-    tHeapElement::SetVal( length, heap );
+ePathContext::ePathContext()
+        : revision_(-1), owner_(NULL),
+        searching_(false), interrupted_(false), examined_(0),
+        listID_(-1)
+{
+    se_pathContexts.Add(this, listID_);
+}
 
-    tASSERT( &heap == Heap() );
+ePathContext::~ePathContext()
+{
+    se_pathContexts.Remove(this, listID_);
 }
 
-// pathfinding interface: find a path for gameobject from origin to target.
-void eHalfEdge::FindPath(const eCoord& startPoint, const eFace* startFace,
-                         const eCoord& stopPoint , const eFace* stopFace,
-                         const eGameObject* gameObject,
-                         ePath& path)
+void ePathContext::Clear()
+{
+    nodes_.clear();
+    open_.clear();
+    index_.clear();
+    penalties_.clear();
+    revision_ = -1;
+    owner_ = NULL;
+    startFace_ = NULL;
+    stopFace_ = NULL;
+    searching_ = false;
+}
+
+void ePathContext::ClearAll()
+{
+    for (int i = se_pathContexts.Len()-1; i>=0; i--)
+        se_pathContexts(i)->Clear();
+}
+
+void ePathContext::Start(const eCoord& startPoint, const eFace* startFace,
+                         const eCoord& stopPoint , const eFace* stopFace)
 {
     tASSERT( startFace );
     tASSERT( stopFace );
-    tASSERT( gameObject );
 
-    // cleanup previous path data (we'll keep it around for debugging)
-    ClearPathData();
-    path.Clear();
+    // forget the previous search, but keep its penalties
+    nodes_.clear();
+    open_.clear();
+    index_.clear();
+
+    startPoint_ = startPoint;
+    stopPoint_  = stopPoint;
+    startFace_  = startFace;
+    stopFace_   = stopFace;
+
+    searching_   = true;
+    interrupted_ = false;
+    examined_    = 0;
 
     // start: add the three vertices around the origin to the open list
+    eHalfEdge *run = startFace->Edge();
+    for (int i=2; i>=0; i--)
     {
-        eHalfEdge *run = startFace->Edge();
-        for (int i=2; i>=0; i--)
-        {
-            run->SetMinPathLength( Distance(run, startPoint) + Distance(run, stopPoint), open, PATH_START );
+        Offer(run, -1, Distance(run, startPoint) + Distance(run, stopPoint));
+        run = run->Next();
+    }
+}
 
-            run = run->Next();
-        }
+REAL ePathContext::Penalty(const eHalfEdge* e, const eGameObject* gameObject)
+{
+    std::map< eHalfEdge const *, REAL >::iterator found = penalties_.find(e);
+    if (found != penalties_.end())
+        return found->second;
+
+    REAL penalty = EdgePenalty(e, gameObject);
+    penalties_[e] = penalty;
+    return penalty;
+}
+
+void ePathContext::Offer(eHalfEdge* e, int parent, REAL length)
+{
+    std::map< eHalfEdge const *, int >::iterator found = index_.find(e);
+    int n;
+    if (found == index_.end())
+    {
+        // completely new entry.
+        n = nodes_.size();
+        index_[e] = n;
+
+        Node node;
+        node.edge   = e;
+        node.closed = false;
+        nodes_.push_back(node);
+    }
+    else
+    {
+        // nothing needs to be done if there is already a shorter path known
+        n = found->second;
+        Node const & node = nodes_[n];
+        if (node.closed || node.length <= length)
+            return;
     }
 
-    // search for a path until one of the edges of the goal face is in the closed list or we have to give up
-    eHalfEdge* stopEdge = NULL;
+    Node & node = nodes_[n];
+    node.length = length;
+    node.parent = parent;
 
-    while (open.Len() > 0 && !stopEdge)
+    // older heap entries of the node are skipped when they come up
+    Open entry;
+    entry.length = length;
+    entry.node   = n;
+    open_.push_back(entry);
+    std::push_heap(open_.begin(), open_.end());
+}
+
+bool ePathContext::Continue(const eGameObject* gameObject, int budget, ePath& path)
+{
+    tASSERT( gameObject );
+
+    if (!searching_)
+        return true;
+
+    // the penalties are only good for the grid and the object they were probed for
+    if (revision_ != eGrid::Revision() || owner_ != gameObject)
+    {
+        // a search that finds nothing after this may have missed the way
+        if (revision_ >= 0 && examined_ > 0)
+            interrupted_ = true;
+
+        penalties_.clear();
+        revision_ = eGrid::Revision();
+        owner_    = gameObject;
+    }
+
+    // search for a path until one of the edges of the goal face is examined or we have to give up
+    int examined = 0;
+    while (open_.size() > 0)
     {
-        // take the most promising HalfEdge out of the open list, put it
-        // into the closed list
+        if (budget > 0 && examined >= budget)
+            return false;
+
+        // take the most promising HalfEdge out of the open list, close it
         // and add all possible ways from there to the open list.
+        std::pop_heap(open_.begin(), open_.end());
+        Open top = open_.back();
+        open_.pop_back();
 
-        eHalfEdge *e = open.Remove(0);
-        tASSERT( e->origin_ < PATH_CLOSED );
+        if (nodes_[top.node].closed || nodes_[top.node].length != top.length)
+            continue;
 
-        int origin = e->origin_;
-        origin |= PATH_CLOSED;
-        e->origin_ = static_cast<ePATH_ORIGIN>(origin);
+        nodes_[top.node].closed = true;
+        eHalfEdge *e = nodes_[top.node].edge;
 
-        closed.Insert(e);
+        // edges removed from the grid since they were reached lead nowhere
+        if (!Usable(e))
+            continue;
+
+        examined++;
+        examined_++;
 
         // check if we are at the goal
-        if (e->Face() == stopFace)
-            stopEdge = e;
+        if (e->Face() == stopFace_)
+        {
+            searching_ = false;
+            return Finish(top.node, path);
+        }
 
-#ifdef DEBUG
-        //      con << "examining " << *e->Point() << ", " << e->Vec() << "\n";
-#endif
+        REAL length  = top.length;
+        REAL penalty = Penalty(e, gameObject);
 
         eHalfEdge *next = e->Next();
-        eHalfEdge *prev = NULL;
+        eHalfEdge *prev = next->Next();
 
         eHalfEdge *other_next = e->Other()->Next();
-        eHalfEdge *prev_other = NULL;
+        eHalfEdge *prev_other = prev->Other();
 
         // try the next HalfEdge in this triangle
+        // check if we cross a new wall on the way
+        if (!e->CrossesNewWall(gameObject->Grid()))
         {
-            if (next)
-            {
-                prev = next->Next();
-
-                // check if we cross a new wall on the way
-                if (!e->CrossesNewWall(gameObject->Grid()))
-                {
-                    // we get this much closer to the target by going this way:
-                    REAL closer  = Distance(e, stopPoint) - Distance(next, stopPoint);
+            // we get this much closer to the target by going this way:
+            REAL closer  = Distance(e, stopPoint_) - Distance(next, stopPoint_);
 
-                    // but have to go this much to get there:
-                    REAL way     = sqrt(e->Vec().NormSquared()) * Modifier(gameObject, e);
+            // but have to go this much to get there:
+            REAL way     = sqrt(e->Vec().NormSquared()) * Modifier(gameObject, e);
 
-                    // tell n that there is a possible path to it
-                    next->PossiblePath(PATH_PREV, e->MinPathLength() + way - closer + EdgePenalty(e, gameObject) );
-                }
-            }
+            // tell n that there is a possible path to it
+            Offer(next, top.node, length + way - closer + penalty);
         }
 
-
         // try the previous HalfEdge in this triangle
-        if (prev)
+        if (!prev->CrossesNewWall(gameObject->Grid()))
         {
-            tASSERT(prev->Next() == e);
-            prev_other = prev->Other();
+            // we get this much closer to the target by going this way:
+            REAL closer  = Distance(e, stopPoint_) - Distance(prev, stopPoint_);
 
-            // check if we cross a new wall on the way
-            if (!prev->CrossesNewWall(gameObject->Grid()))
-            {
-                // we get this much closer to the target by going this way:
-                REAL closer  = Distance(e, stopPoint) - Distance(prev, stopPoint);
+            // but have to go this much to get there:
+            REAL way     = sqrt(prev->Vec().NormSquared()) * Modifier(gameObject, e);
 
-                // but have to go this much to get there:
-                REAL way     = sqrt(prev->Vec().NormSquared()) * Modifier(gameObject, e);
-
-                // tell n that there is a possible path to it
-                prev->PossiblePath(PATH_NEXT, e->MinPathLength() + way - closer  + EdgePenalty(e, gameObject));
-            }
+            Offer(prev, top.node, length + way - closer + penalty);
         }
 
-
         // now the edges that are just around the corner. They do not
         // make the way longer, but require the passed edge to be harmless
         // to the object.
 
         if (other_next && CanPass(gameObject, e))
-            other_next->PossiblePath(PATH_PREV_OTHER, e->MinPathLength() + EdgePenalty(e, gameObject) + .000001f);
+            Offer(other_next, top.node, length + penalty + .000001f);
         if (prev_other && CanPass(gameObject, prev))
-            prev_other->PossiblePath(PATH_OTHER_NEXT, e->MinPathLength() + EdgePenalty(e, gameObject) + .000001f);
+            Offer(prev_other, top.node, length + penalty + .000001f);
     }
 
     // no path found...
-    if (!stopEdge)
-    {
-        ClearPathData();
-        return;
-    }
+    searching_ = false;
+    path.Clear();
+    return true;
+}
 
+bool ePathContext::Finish(int stop, ePath& path)
+{
     // allright! Now we just go back from the goal to the origin,
     // following the crumbs of bread we left behind.
+    path.Clear();
+    path.Add(stopPoint_);
 
-#ifdef DEBUG
-    con << "Found path.\n";
-    //  con << startPoint << "\n";
-#endif
-
-    path.Add(stopPoint);
-
-    eHalfEdge* run = stopEdge;
-    while (run && run->Face() != startFace)
+    for (int run = stop; run >= 0 && nodes_[run].edge->Face() != startFace_; run = nodes_[run].parent)
     {
-        path.Add(run);
-
-#ifdef DEBUG
-        //      con << *run->Point() << ", " << run->Vec() << "\n";
-#endif
+        eHalfEdge *e = nodes_[run].edge;
 
-        tASSERT(run->origin_ >= PATH_CLOSED);
-
-        switch (run->origin_-PATH_CLOSED)
+        // the grid changed under the path
+        if (!Usable(e) || !e->Next()->Point() || !e->Next()->Next()->Point())
         {
-        case (PATH_NEXT):
-                        run = run->Next();
-            break;
-        case (PATH_PREV):
-                        run = run->Next()->Next();
-            break;
-        case (PATH_OTHER_NEXT):
-                        run = run->Other()->Next();
-            break;
-        case (PATH_PREV_OTHER):
-                        run = run->Next()->Next()->Other();
-            break;
-        default:
-            tERR_WARN("Pathfinding error!\n");
-            run = startFace->Edge();
+            interrupted_ = true;
+            path.Clear();
+            return true;
         }
-    }
-
-    //  path.Add(run);
-    //  path.Add(startPoint);
 
-#ifdef DEBUG
-    //  con << stopPoint << "\n";
-#endif
-
-    ClearPathData();
-}
-
-
-void eHalfEdge::PossiblePath( ePATH_ORIGIN newOrigin, REAL minLength ) // tell the pathfinder that there might be a path of total length minLength through this HalfEdge, coming from the given origin type.
-{
-    // nothing needs to be done if there is already a shorter path known
-    if( origin_ == PATH_NONE )
-    {
-        // completely new entry.
-        tASSERT( Heap() == 0 );
-        SetMinPathLength( minLength, open, newOrigin );
-
-#ifdef DEBUG
-        //      con << "adding " << *Point() << ", " << Vec() << ", origin "
-        //	  << origin << " to open list.\n";
-#endif
+        path.Add(e);
     }
-    else if( minLength <  MinPathLength() && origin_ < PATH_CLOSED)
-    {
-        // just update our info; the path got shorter.
-        tASSERT( Heap() != &closed );
-        SetMinPathLength( minLength, open, newOrigin );
 
 #ifdef DEBUG
-        //      con << "updating " << *Point() << ", " << Vec() << ", origin "
-        //	  << origin << " to open list.\n";
+    con << "Found path.\n";
 #endif
 
-    }
+    interrupted_ = false;
+    return true;
 }
 
-
-tHeapBase *eHalfEdge::Heap() const
+// pathfinding interface: find a path for gameobject from origin to target.
+void eHalfEdge::FindPath(const eCoord& startPoint, const eFace* startFace,
+                         const eCoord& stopPoint , const eFace* stopFace,
+                         const eGameObject* gameObject,
+                         ePath& path)
 {
-    if (origin_ >= PATH_NONE)
-        return NULL;
-    if (origin_ >= PATH_CLOSED)
-        return &closed;
-
-    return &open;
+    ePathContext context;
+    context.Start(startPoint, startFace, stopPoint, stopFace);
+    context.Continue(gameObject, 0, path);
 }
 
-
+#ifdef DEBUG
 static ePath* lastPath = NULL;
 
-#ifdef DEBUG
 #include "rRender.h"
 
 void ePath::RenderLast()  // renders the last found path
@@ -421,8 +446,10 @@ ePath::ePath(){
 }
 
 ePath::~ePath(){
+#ifdef DEBUG
     if ( lastPath == this )
         lastPath = NULL;
+#endif
 }
 
 void ePath::Add(eHalfEdge *e)
@@ -455,7 +482,9 @@ void ePath::Add(const eCoord& point)
 
 void ePath::Clear()
 {
+#ifdef DEBUG
     lastPath = this;
+#endif
 
     current=-1;
 
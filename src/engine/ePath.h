@@ -29,9 +29,15 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #define ArmageTron_PATH_H
 
 #include "tArray.h"
+#include "tSafePTR.h"
 #include "eCoord.h"
 
+#include <vector>
+#include <map>
+
 class eHalfEdge;
+class eFace;
+class eGameObject;
 
 class ePath{
 public:
@@ -40,6 +46,7 @@ public:
 #endif
 
     friend class eHalfEdge;
+    friend class ePathContext;
 
     ePath();
     ~ePath();
@@ -61,4 +68,68 @@ protected:
 
 };
 
+//! a search for a path through the grid that can be spread over several calls
+class ePathContext{
+public:
+    ePathContext();
+    ~ePathContext();
+
+    //! starts a new search for a path from startPoint to stopPoint
+    void Start(const eCoord& startPoint, const eFace* startFace,
+               const eCoord& stopPoint , const eFace* stopFace);
+
+    //! continues the search for gameObject, examining at most budget edges (all if budget <= 0).
+    //! Returns true once the search is finished; path then holds the result or is cleared if none was found.
+    bool Continue(const eGameObject* gameObject, int budget, ePath& path);
+
+    bool Searching()   const { return searching_; }   //!< is a search under way?
+    bool Interrupted() const { return interrupted_; } //!< did the grid change under the last search, which then found nothing?
+    int  Examined()    const { return examined_; }    //!< edges examined by the current or last search
+
+    void Clear();           //!< forgets the search and the cached edge penalties
+    static void ClearAll(); //!< clears all contexts; the grid is about to be emptied
+
+private:
+    struct Node
+    {
+        tJUST_CONTROLLED_PTR<eHalfEdge> edge; //!< the edge; the reference keeps it valid across grid changes
+        REAL length;                          //!< minimal length of a path through the edge
+        int  parent;                          //!< the node the path came from, -1 for the start edges
+        bool closed;                          //!< has the edge been examined?
+    };
+
+    struct Open
+    {
+        REAL length; //!< the length the node had when it was offered
+        int  node;   //!< index into nodes_
+
+        bool operator < ( Open const & other ) const { return length > other.length; }
+    };
+
+    REAL Penalty(const eHalfEdge* e, const eGameObject* gameObject); //!< returns the cached penalty for passing e
+    void Offer(eHalfEdge* e, int parent, REAL length);                //!< there might be a path of the given length through e
+    bool Finish(int stop, ePath& path);                               //!< follows the nodes back from stop into path
+
+    std::vector< Node > nodes_;                   //!< all edges reached so far
+    std::vector< Open > open_;                    //!< heap of nodes waiting to be examined
+    std::map< eHalfEdge const *, int > index_;    //!< node of each edge
+    std::map< eHalfEdge const *, REAL > penalties_; //!< cached results of the edge penalty probes
+
+    int                revision_;  //!< grid revision the penalties are valid for
+    eGameObject const* owner_;     //!< object the penalties were probed for; only compared, never used
+
+    eCoord startPoint_, stopPoint_;
+    tJUST_CONTROLLED_PTR< eFace const > startFace_; //!< references keep the faces from being replaced by others at the same address
+    tJUST_CONTROLLED_PTR< eFace const > stopFace_;
+
+    bool searching_;
+    bool interrupted_;
+    int  examined_;
+
+    int listID_; //!< position in the list of all contexts
+
+    ePathContext( ePathContext const & );
+    ePathContext & operator = ( ePathContext const & );
+};
+
 #endif
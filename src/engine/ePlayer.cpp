@@ -47,6 +47,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include "rSysdep.h"
 #include "nAuthentication.h"
 #include "tDirectories.h"
+#include "tLogSink.h"
 #include "eVoter.h"
 #include "tReferenceHolder.h"
 #include "tRandom.h"
@@ -5534,6 +5535,10 @@ static bool se_ladderlogDecorateTS = false;
 static tSettingItem< bool > se_ladderlogDecorateTSConf( "LADDERLOG_DECORATE_TIMESTAMP", se_ladderlogDecorateTS );
 extern bool sn_decorateTS; // from nNetwork.cpp
 
+static tLogSink se_ladderLogSink( "ladderlog.txt" );
+static tLogSink se_chatLogSink( "chatlog.txt" );
+static tLogSink se_scoreLogSink( "scorelog.txt" );
+
 void se_SaveToLadderLog( tOutput const & out )
 {
     if (se_consoleLadderLog)
@@ -5546,12 +5551,12 @@ void se_SaveToLadderLog( tOutput const & out )
     }
     if (sn_GetNetState()!=nCLIENT && !tRecorder::IsPlayingBack())
     {
-        std::ofstream o;
-        if ( tDirectories::Var().Open(o, "ladderlog.txt", std::ios::app) )
-            if(se_ladderlogDecorateTS) {
-                o << st_GetCurrentTime("%Y/%m/%d-%H:%M:%S ");
-            }
-            o << out << std::endl;;
+        tString line;
+        if(se_ladderlogDecorateTS) {
+            line << st_GetCurrentTime("%Y/%m/%d-%H:%M:%S ");
+        }
+        line << out << "\n";
+        se_ladderLogSink.Write( line );
     }
 }
 
@@ -5567,10 +5572,9 @@ void se_SaveToChatLog(tOutput const &out) {
             se_chatWriter.write();
         }
         if(se_chatLog) {
-            std::ofstream o;
-            if ( tDirectories::Var().Open(o, "chatlog.txt", std::ios::app) ) {
-                o << st_GetCurrentTime("[%Y/%m/%d-%H:%M:%S] ") << out << std::endl;
-            }
+            tString line;
+            line << st_GetCurrentTime("[%Y/%m/%d-%H:%M:%S] ") << out << "\n";
+            se_chatLogSink.Write( line );
         }
     }
 }
@@ -5644,9 +5648,7 @@ void se_SaveToScoreFile(const tOutput &o){
     if (sn_GetNetState()==nSERVER && !tRecorder::IsPlayingBack()){
 #endif
 
-        std::ofstream o;
-        if ( tDirectories::Var().Open(o, "scorelog.txt", std::ios::app) )
-            o << tColoredString::RemoveColors(s);
+        se_scoreLogSink.Write( tColoredString::RemoveColors(s) );
     }
 #ifdef DEBUG
 }
@@ -36,7 +36,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 
 eSensor::eSensor(eGameObject *o,const eCoord &start,const eCoord &d)
         :eStackGameObject(o->grid, start,d,o->currentFace)
-        ,hit(1000),ehit(NULL),lr(0), owned(o) , inverseSpeed_(0)
+        ,hit(1000),ehit(NULL),lr(0), owned(o), finished_(false), inverseSpeed_(0)
 {
     if (owned)
     {
@@ -85,9 +85,24 @@ void eSensor::PassEdge(const eWall *w,REAL time,REAL a,int){
     ehit=e;
     before_hit=collPos-dir*.000001;
 
-    throw eSensorFinished();
+    finished_ = true;
 }
 
+// passes the walls crossed by a sensor to its PassEdge() until it is finished
+class eSensorRaycastHandler: public eRaycastHandler
+{
+public:
+    eSensorRaycastHandler( eSensor & sensor ): sensor_( sensor ){}
+
+    virtual bool Cross( eWall const * wall, REAL time, REAL wallRatio )
+    {
+        sensor_.PassEdge( wall, time, wallRatio, 0 );
+        return sensor_.finished_;
+    }
+private:
+    eSensor & sensor_;
+};
+
 //void eSensor::PassEdge(eEdge *e,REAL time,REAL a,int recursion){
 //  PassEdge((const eEdge *)e,time,a,recursion);
 //}
@@ -130,13 +145,9 @@ void eSensor::detect(REAL range){
     }
     */
 
-    try
-    {
-        Move(pos+dir*range,0,range);
-    }
-    catch( eSensorFinished & e )
-    {
-    }
+    finished_ = false;
+    eSensorRaycastHandler handler( *this );
+    Move(pos+dir*range,0,range,handler);
 
 #ifdef DEBUGLINE
     if (hit < range)
@@ -32,11 +32,9 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include "eTess2.h"
 //#include "eGrid.h"
 
-// exception that is thrown when the sensor hit something
-class eSensorFinished{};
-
 // sensor sent out to detect near eWalls
 class eSensor: public eStackGameObject{
+    friend class eSensorRaycastHandler;
 public:
     REAL            hit;            // where is the eWall?
     tCHECKED_PTR_CONST(eHalfEdge) ehit;     // the eWall we sense
@@ -56,6 +54,7 @@ public:
     inline eSensor const & GetInverseSpeed( REAL & inverseSpeed ) const;	//!< Gets the inverse speed of the sensor
 protected:
     tCHECKED_PTR(eGameObject) owned;
+    bool finished_;     //!< set by PassEdge() when the sensor hit what it is looking for; ends detect()
 private:
     REAL inverseSpeed_; //! the inverse speed of the sensor; walls far away will be checked for opacity a bit in the future if this is set.
 };
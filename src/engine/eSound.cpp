@@ -26,6 +26,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 */
 
 #include "eSound.h"
+#include "eSoundMixer.h"
 #include "config.h"
 #include "tMemManager.h"
 #include "tDirectories.h"
@@ -87,6 +88,10 @@ static tList<eSoundPlayer> se_globalPlayers;
 void fill_audio(void *udata, Uint8 *stream, int len)
 {
 #ifndef DEDICATED
+    // sum everything up on a float bus, saturate once at the end
+    static std::vector< float > storage;
+    eSoundMixBus bus( stream, len, storage );
+
     real_sound_sources=0;
     int i;
     if (eGrid::CurrentGrid())
@@ -512,11 +517,6 @@ bool eWavData::Mix(Uint8 *dest,Uint32 playlen,eAudioPos &pos,
         }
     }
 
-    playlen/=4;
-
-    //	Rvol *= 4;
-    //	Lvol *= 4;
-
     const REAL thresh = .25;
 
     if ( Rvol > thresh )
@@ -529,155 +529,20 @@ bool eWavData::Mix(Uint8 *dest,Uint32 playlen,eAudioPos &pos,
         Lvol = thresh;
     }
 
-#define SPEED_FRACTION (1<<20)
-
-#define VOL_SHIFT 16
-#define VOL_FRACTION (1<<VOL_SHIFT)
-
-#define MAX_VAL ((1<<16)-1)
-#define MIN_VAL -(1<<16)
-
-    // first, split the speed into the part before and after the decimal:
-    if (Speed<0) Speed=0;
-
     // adjust for different sample rates:
     Speed*=spec.freq;
     Speed/=audio.freq;
 
-    int speed=int(floor(Speed));
-    int speed_fraction=int(SPEED_FRACTION*(Speed-speed));
-
-    // secondly, make integers out of the volumes:
-    int rvol=int(Rvol*VOL_FRACTION);
-    int lvol=int(Lvol*VOL_FRACTION);
-
-
-    bool goon=true;
-
-    while (goon){
-        if (spec.channels==2){
-            if (spec.format==AUDIO_U8)
-                while (playlen>0 && pos.pos<samples){
-                    // fix endian problems for the Mac port, as well as support for other
-                    // formats than  stereo...
-                    int l=((short *)dest)[0];
-                    int r=((short *)dest)[1];
-                    r += (rvol*(data[(pos.pos<<1)  ]-128)) >> (VOL_SHIFT-8);
-                    l += (lvol*(data[(pos.pos<<1)+1]-128)) >> (VOL_SHIFT-8);
-                    if (r>MAX_VAL) r=MAX_VAL;
-                    if (l>MAX_VAL) l=MAX_VAL;
-                    if (r<MIN_VAL) r=MIN_VAL;
-                    if (l<MIN_VAL) l=MIN_VAL;
-
-                    ((short *)dest)[0]=l;
-                    ((short *)dest)[1]=r;
-
-                    dest+=4;
-
-                    pos.pos+=speed;
-
-                    pos.fraction+=speed_fraction;
-                    while (pos.fraction>=SPEED_FRACTION){
-                        pos.fraction-=SPEED_FRACTION;
-                        pos.pos++;
-                    }
-
-                    playlen--;
-                }
-            else{
-                while (playlen>0 && pos.pos<samples){
-                    int l=((short *)dest)[0];
-                    int r=((short *)dest)[1];
-                    r += (rvol*(((short *)data)[(pos.pos<<1)  ])) >> VOL_SHIFT;
-                    l += (lvol*(((short *)data)[(pos.pos<<1)+1])) >> VOL_SHIFT;
-                    if (r>MAX_VAL) r=MAX_VAL;
-                    if (l>MAX_VAL) l=MAX_VAL;
-                    if (r<MIN_VAL) r=MIN_VAL;
-                    if (l<MIN_VAL) l=MIN_VAL;
-
-                    ((short *)dest)[0]=l;
-                    ((short *)dest)[1]=r;
-
-                    dest+=4;
-
-                    pos.pos+=speed;
-
-                    pos.fraction+=speed_fraction;
-                    while (pos.fraction>=SPEED_FRACTION){
-                        pos.fraction-=SPEED_FRACTION;
-                        pos.pos++;
-                    }
-                    playlen--;
-                }
-            }
-        }
-        else{
-            if (spec.format==AUDIO_U8){
-                while (playlen>0 && pos.pos<samples){
-                    // fix endian problems for the Mac port, as well as support for other
-                    // formats than  stereo...
-                    int l=((short *)dest)[0];
-                    int r=((short *)dest)[1];
-                    int d=data[pos.pos]-128;
-                    l += (lvol*d) >> (VOL_SHIFT-8);
-                    r += (rvol*d) >> (VOL_SHIFT-8);
-                    if (r>MAX_VAL) r=MAX_VAL;
-                    if (l>MAX_VAL) l=MAX_VAL;
-                    if (r<MIN_VAL) r=MIN_VAL;
-                    if (l<MIN_VAL) l=MIN_VAL;
-
-                    ((short *)dest)[0]=l;
-                    ((short *)dest)[1]=r;
-
-                    dest+=4;
-
-                    pos.pos+=speed;
-
-                    pos.fraction+=speed_fraction;
-                    while (pos.fraction>=SPEED_FRACTION){
-                        pos.fraction-=SPEED_FRACTION;
-                        pos.pos++;
-                    }
-
-                    playlen--;
-                }
-            }
-            else
-                while (playlen>0 && pos.pos<samples){
-                    int l=((short *)dest)[0];
-                    int r=((short *)dest)[1];
-                    int d=((short *)data)[pos.pos];
-                    l += (lvol*d) >> VOL_SHIFT;
-                    r += (rvol*d) >> VOL_SHIFT;
-                    if (r>MAX_VAL) r=MAX_VAL;
-                    if (l>MAX_VAL) l=MAX_VAL;
-                    if (r<MIN_VAL) r=MIN_VAL;
-                    if (l<MIN_VAL) l=MIN_VAL;
-
-                    ((short *)dest)[0]=l;
-                    ((short *)dest)[1]=r;
-
-                    dest+=4;
-
-                    pos.pos+=speed;
-
-                    pos.fraction+=speed_fraction;
-                    while (pos.fraction>=SPEED_FRACTION){
-                        pos.fraction-=SPEED_FRACTION;
-                        pos.pos++;
-                    }
-                    playlen--;
-                }
-        }
+    eSampleSource source;
+    source.data     = data;
+    source.samples  = samples;
+    source.channels = spec.channels;
+    source.format   = spec.format == AUDIO_U8 ? eSampleFormat_U8 : eSampleFormat_S16;
 
-        if (loop && pos.pos>=samples)
-            pos.pos-=samples;
-        else
-            goon=false;
-    }
-#endif
+    return se_MixSamples( dest, playlen, source, pos, Lvol, Rvol, Speed, loop );
+#else
     return (playlen>0);
-
+#endif
 }
 
 void eWavData::Loop(){
@@ -0,0 +1,167 @@
+/*
+
+*************************************************************************
+
+ArmageTron -- Just another Tron Lightcycle Game in 3D.
+Copyright (C) 2000  Manuel Moos (manuel@moosnet.de)
+
+**************************************************************************
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+***************************************************************************
+
+*/
+
+// The sound mix benchmark: armagetronad_soundmixbench mixes synthetic sources into
+// a memory buffer, once with the vector and once with the scalar mixing kernels,
+// and reports both times and the maximal deviation between their results.
+// It needs no audio device.
+
+#include "config.h"
+
+#include "eSoundMixer.h"
+#include "tCommandLine.h"
+#include "tRandom.h"
+#include "tSysTime.h"
+#include "tString.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include <iostream>
+
+// mix parameters and the limits accepted for them
+static int se_sources = 32, se_frames = 1024;
+static REAL se_seconds = 10;
+
+static const int se_maxSources = 1024;
+static const int se_maxFrames = 65536;
+static const REAL se_maxSeconds = 3600;
+
+class eSoundMixBenchmarkCommandLineAnalyzer: public tCommandLineAnalyzer
+{
+private:
+    virtual bool DoAnalyze( tCommandLineParser & parser )
+    {
+        tString value;
+        if ( parser.GetOption( value, "--sources" ) )
+            se_sources = atoi( value );
+        else if ( parser.GetOption( value, "--seconds" ) )
+            se_seconds = atof( value );
+        else if ( parser.GetOption( value, "--frames" ) )
+            se_frames = atoi( value );
+        else
+            return false;
+
+        return true;
+    }
+
+    virtual void DoHelp( std::ostream & s )
+    {                                      //
+        s << "--sources <count>            : number of sources mixed at once, default 32\n";
+        s << "--seconds <time>             : length of audio to mix, default 10\n";
+        s << "--frames <count>             : frames per output buffer, default 1024\n";
+    }
+};
+
+static eSoundMixBenchmarkCommandLineAnalyzer se_analyzer;
+
+int main( int argc, char ** argv )
+{
+    tString version( "sound mix benchmark" );
+    tCommandLineData commandLine;
+    commandLine.programVersion_ = &version;
+    if ( !commandLine.Analyse( argc, argv ) )
+        return 0;
+
+    if ( se_sources < 1 || se_sources > se_maxSources ||
+         se_frames < 1 || se_frames > se_maxFrames ||
+         !( se_seconds > 0 && se_seconds <= se_maxSeconds ) )
+    {
+        std::cerr << "Parameters out of range: 1 to " << se_maxSources << " sources, 1 to "
+        << se_maxFrames << " buffer frames and up to " << se_maxSeconds << " seconds.\n";
+        return 1;
+    }
+
+    // one second of noise per source at half the output rate, in the formats the game loads.
+    // A private randomizer; nobody seeds rand() here, so every run mixes the same sources.
+    int const outputRate = 44100, sourceRate = 22050;
+    tReproducibleRandomizer randomizer;
+    std::vector< std::vector< Uint8 > > data( se_sources );
+    std::vector< eSampleSource > sampleSources( se_sources );
+    std::vector< REAL > speeds( se_sources ), volumes( se_sources );
+    for ( int i = 0; i < se_sources; ++i )
+    {
+        eSampleSource & source = sampleSources[i];
+        source.samples  = sourceRate;
+        source.channels = i % 3 == 0 ? 2 : 1;
+        source.format   = i % 3 == 2 ? eSampleFormat_U8 : eSampleFormat_S16;
+
+        int bytes = source.samples * source.channels * ( source.format == eSampleFormat_U8 ? 1 : 2 );
+        data[i].resize( bytes );
+        for ( int j = 0; j < bytes; ++j )
+            data[i][j] = randomizer.Get( 256 );
+        source.data = &data[i][0];
+
+        speeds[i]  = ( .5 + 1.5 * randomizer.Get() ) * sourceRate / outputRate;
+        volumes[i] = .05 + .2 * randomizer.Get();
+    }
+
+    int buffers = int( se_seconds * outputRate / se_frames ) + 1;
+    std::vector< Uint8 > output[2];
+    double time[2];
+    for ( int pass = 0; pass < 2; ++pass )
+    {
+        // first pass with the vector kernels, second pass with the scalar ones
+        se_SetScalarMixing( pass == 1 );
+        output[pass].resize( se_frames * 4 );
+        std::vector< float > storage;
+        std::vector< eAudioPos > positions( se_sources );
+        for ( int i = 0; i < se_sources; ++i )
+            positions[i].pos = positions[i].fraction = 0;
+
+        double start = tRealSysTimeFloat();
+        for ( int buffer = 0; buffer < buffers; ++buffer )
+        {
+            memset( &output[pass][0], 0, se_frames * 4 );
+            eSoundMixBus bus( &output[pass][0], se_frames * 4, storage );
+            for ( int i = 0; i < se_sources; ++i )
+                se_MixSamples( &output[pass][0], se_frames * 4, sampleSources[i], positions[i], volumes[i], volumes[i], speeds[i], true );
+        }
+        time[pass] = tRealSysTimeFloat() - start;
+    }
+    se_SetScalarMixing( false );
+
+    // compare the last buffers of both passes
+    short const * a = reinterpret_cast< short const * >( &output[0][0] );
+    short const * b = reinterpret_cast< short const * >( &output[1][0] );
+    int deviation = 0;
+    for ( int i = se_frames * 2 - 1; i >= 0; --i )
+    {
+        int difference = abs( a[i] - b[i] );
+        if ( difference > deviation )
+            deviation = difference;
+    }
+
+    std::cout << "sources\tseconds\tframes\n";
+    std::cout << se_sources << "\t" << buffers * REAL( se_frames ) / outputRate << "\t" << se_frames << "\n\n";
+    std::cout << "kernels\ttotal_s\n";
+    std::cout << ( se_MixKernels() ? se_MixKernels() : "scalar" ) << "\t" << time[0] << "\n";
+    std::cout << "scalar\t" << time[1] << "\n\n";
+    std::cout << "maximal deviation\t" << deviation << "\n";
+
+    return 0;
+}
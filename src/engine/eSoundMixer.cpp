@@ -0,0 +1,274 @@
+/*
+
+*************************************************************************
+
+ArmageTron -- Just another Tron Lightcycle Game in 3D.
+Copyright (C) 2000  Manuel Moos (manuel@moosnet.de)
+
+**************************************************************************
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+  
+***************************************************************************
+
+*/
+
+#include "eSoundMixer.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define SE_MIX_SSE2
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define SE_MIX_NEON
+#endif
+
+// frames resampled in one go
+#define MIX_BLOCK 256
+
+// use the scalar kernels even if vector ones are compiled in (for the benchmark)
+static bool se_mixScalar = false;
+
+// *******************************************************************************
+// *
+// *	kernels
+// *
+// *******************************************************************************
+
+// adds frames frames of interleaved stereo src, scaled by lvol/rvol, to bus
+static void se_MixBlock( float * bus, float const * src, unsigned int frames, float lvol, float rvol )
+{
+    unsigned int count = frames << 1;
+    unsigned int i = 0;
+
+    if ( !se_mixScalar )
+    {
+#if defined(SE_MIX_SSE2)
+        __m128 vol = _mm_setr_ps( lvol, rvol, lvol, rvol );
+        for ( ; i + 8 <= count; i += 8 )
+        {
+            __m128 a = _mm_add_ps( _mm_loadu_ps( bus + i     ), _mm_mul_ps( _mm_loadu_ps( src + i     ), vol ) );
+            __m128 b = _mm_add_ps( _mm_loadu_ps( bus + i + 4 ), _mm_mul_ps( _mm_loadu_ps( src + i + 4 ), vol ) );
+            _mm_storeu_ps( bus + i    , a );
+            _mm_storeu_ps( bus + i + 4, b );
+        }
+#elif defined(SE_MIX_NEON)
+        float const volumes[4] = { lvol, rvol, lvol, rvol };
+        float32x4_t vol = vld1q_f32( volumes );
+        for ( ; i + 8 <= count; i += 8 )
+        {
+            vst1q_f32( bus + i    , vmlaq_f32( vld1q_f32( bus + i     ), vld1q_f32( src + i     ), vol ) );
+            vst1q_f32( bus + i + 4, vmlaq_f32( vld1q_f32( bus + i + 4 ), vld1q_f32( src + i + 4 ), vol ) );
+        }
+#endif
+    }
+
+    for ( ; i < count; i += 2 )
+    {
+        bus[i  ] += src[i  ] * lvol;
+        bus[i+1] += src[i+1] * rvol;
+    }
+}
+
+// converts count accumulated samples back to 16 bit, saturating
+static void se_Saturate( float const * bus, short * out, unsigned int count )
+{
+    unsigned int i = 0;
+
+    if ( !se_mixScalar )
+    {
+#if defined(SE_MIX_SSE2)
+        // clamp before converting, out of range conversions would wrap
+        __m128 high = _mm_set1_ps( 32767.0f ), low = _mm_set1_ps( -32768.0f );
+        for ( ; i + 8 <= count; i += 8 )
+        {
+            __m128i a = _mm_cvtps_epi32( _mm_max_ps( _mm_min_ps( _mm_loadu_ps( bus + i     ), high ), low ) );
+            __m128i b = _mm_cvtps_epi32( _mm_max_ps( _mm_min_ps( _mm_loadu_ps( bus + i + 4 ), high ), low ) );
+            _mm_storeu_si128( reinterpret_cast< __m128i * >( out + i ), _mm_packs_epi32( a, b ) );
+        }
+#elif defined(SE_MIX_NEON)
+        for ( ; i + 8 <= count; i += 8 )
+        {
+            int16x4_t a = vqmovn_s32( vcvtq_s32_f32( vld1q_f32( bus + i     ) ) );
+            int16x4_t b = vqmovn_s32( vcvtq_s32_f32( vld1q_f32( bus + i + 4 ) ) );
+            vst1q_s16( out + i, vcombine_s16( a, b ) );
+        }
+#endif
+    }
+
+    for ( ; i < count; ++i )
+    {
+        float value = bus[i];
+        if ( value > 32767.0f )
+            value = 32767.0f;
+        else if ( value < -32768.0f )
+            value = -32768.0f;
+        out[i] = short( floor( value + .5f ) );
+    }
+}
+
+// reads one sample, scaled to the 16 bit range
+template< eSampleFormat format > inline float se_Sample( void const * data, Uint32 index );
+
+template<> inline float se_Sample< eSampleFormat_S16 >( void const * data, Uint32 index )
+{
+    return static_cast< short const * >( data )[ index ];
+}
+
+template<> inline float se_Sample< eSampleFormat_U8 >( void const * data, Uint32 index )
+{
+    return ( int( static_cast< Uint8 const * >( data )[ index ] ) - 128 ) << 8;
+}
+
+// resamples up to frames frames of source into interleaved stereo out, advancing pos. Returns the number of frames produced.
+// The source's first channel goes to the right output, as it always has.
+template< int channels, eSampleFormat format >
+static unsigned int se_Resample( eSampleSource const & source, eAudioPos & pos, Uint32 speed, Uint32 speedFraction, float * out, unsigned int frames )
+{
+    void const * data = source.data;
+    Uint32 samples = source.samples;
+    Uint32 position = pos.pos, fraction = pos.fraction;
+
+    unsigned int i;
+    for ( i = 0; i < frames && position < samples; ++i )
+    {
+        Uint32 frame = position * channels;
+        out[2*i  ] = se_Sample< format >( data, frame + channels - 1 );
+        out[2*i+1] = se_Sample< format >( data, frame );
+
+        fraction += speedFraction;
+        position += speed + ( fraction >> SPEED_SHIFT );
+        fraction &= SPEED_FRACTION - 1;
+    }
+
+    pos.pos = position;
+    pos.fraction = fraction;
+    return i;
+}
+
+typedef unsigned int (*eResampler)( eSampleSource const &, eAudioPos &, Uint32, Uint32, float *, unsigned int );
+
+// *******************************************************************************
+// *
+// *	eSoundMixBus
+// *
+// *******************************************************************************
+
+eSoundMixBus * eSoundMixBus::s_active = NULL;
+
+eSoundMixBus::eSoundMixBus( Uint8 * stream, Uint32 len, std::vector< float > & storage )
+        : stream_( stream ), len_( len & ~3 ), previous_( s_active )
+{
+    Uint32 count = len_ >> 1;
+    if ( storage.size() < count + 1 )
+        storage.resize( count + 1 );
+    bus_ = &storage[0];
+
+    short const * samples = reinterpret_cast< short const * >( stream_ );
+    for ( Uint32 i = 0; i < count; ++i )
+        bus_[i] = samples[i];
+
+    s_active = this;
+}
+
+eSoundMixBus::~eSoundMixBus()
+{
+    se_Saturate( bus_, reinterpret_cast< short * >( stream_ ), len_ >> 1 );
+    s_active = previous_;
+}
+
+eSoundMixBus * eSoundMixBus::Covering( Uint8 const * dest, Uint32 len )
+{
+    for ( eSoundMixBus * bus = s_active; bus; bus = bus->previous_ )
+    {
+        if ( dest >= bus->stream_ && dest + len <= bus->stream_ + bus->len_ && ( ( dest - bus->stream_ ) & 3 ) == 0 )
+            return bus;
+    }
+    return NULL;
+}
+
+// *******************************************************************************
+// *
+// *	se_MixSamples
+// *
+// *******************************************************************************
+
+bool se_MixSamples( Uint8 * dest, Uint32 len, eSampleSource const & source, eAudioPos & pos, REAL lvol, REAL rvol, REAL speed, bool loop )
+{
+    eSoundMixBus * bus = eSoundMixBus::Covering( dest, len );
+    if ( !bus )
+    {
+        // nobody is collecting, mix on a bus of our own
+        std::vector< float > storage;
+        eSoundMixBus temporary( dest, len, storage );
+        return se_MixSamples( dest, len, source, pos, lvol, rvol, speed, loop );
+    }
+
+    Uint32 frames = len >> 2;
+    if ( source.samples == 0 )
+        return frames > 0;
+
+    eResampler resample;
+    if ( source.channels == 2 )
+        resample = source.format == eSampleFormat_U8 ? &se_Resample< 2, eSampleFormat_U8 > : &se_Resample< 2, eSampleFormat_S16 >;
+    else
+        resample = source.format == eSampleFormat_U8 ? &se_Resample< 1, eSampleFormat_U8 > : &se_Resample< 1, eSampleFormat_S16 >;
+
+    if ( speed < 0 )
+        speed = 0;
+    Uint32 speedWhole = Uint32( floor( speed ) );
+    Uint32 speedFraction = Uint32( SPEED_FRACTION * ( speed - speedWhole ) );
+
+    float * target = bus->Frames( dest );
+    float block[ 2 * MIX_BLOCK ];
+
+    while ( frames > 0 )
+    {
+        unsigned int wanted = frames < MIX_BLOCK ? frames : MIX_BLOCK;
+        unsigned int done = (*resample)( source, pos, speedWhole, speedFraction, block, wanted );
+        se_MixBlock( target, block, done, lvol, rvol );
+        target += 2 * done;
+        frames -= done;
+
+        if ( pos.pos >= source.samples )
+        {
+            // end of the sample
+            if ( !loop )
+                break;
+            pos.pos -= source.samples;
+        }
+    }
+
+    return frames > 0;
+}
+
+char const * se_MixKernels()
+{
+#if defined(SE_MIX_SSE2)
+    return "SSE2";
+#elif defined(SE_MIX_NEON)
+    return "NEON";
+#else
+    return NULL;
+#endif
+}
+
+void se_SetScalarMixing( bool scalar )
+{
+    se_mixScalar = scalar;
+}
@@ -0,0 +1,86 @@
+/*
+
+*************************************************************************
+
+ArmageTron -- Just another Tron Lightcycle Game in 3D.
+Copyright (C) 2000  Manuel Moos (manuel@moosnet.de)
+
+**************************************************************************
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+  
+***************************************************************************
+
+*/
+
+#ifndef ArmageTron_SOUNDMIXER_H
+#define ArmageTron_SOUNDMIXER_H
+
+#include "eSound.h"
+#include <vector>
+
+// fixed point resolution of eAudioPos::fraction
+#define SPEED_SHIFT 20
+#define SPEED_FRACTION (1<<SPEED_SHIFT)
+
+//! sample layouts the software mixer can read
+enum eSampleFormat
+{
+    eSampleFormat_S16, //!< signed 16 bit, system byte order
+    eSampleFormat_U8   //!< unsigned 8 bit
+};
+
+//! raw sample data as seen by the software mixer
+struct eSampleSource
+{
+    void const *  data;     //!< the interleaved sample data
+    Uint32        samples;  //!< number of frames
+    int           channels; //!< 1 or 2
+    eSampleFormat format;   //!< sample layout
+};
+
+//! float accumulation bus over a buffer of interleaved signed 16 bit stereo samples.
+//! While a bus exists, all mixing into the buffer it covers is summed on the bus;
+//! the sum is saturated back into the buffer once, on destruction.
+class eSoundMixBus
+{
+    eSoundMixBus( eSoundMixBus const & );
+    eSoundMixBus & operator = ( eSoundMixBus const & );
+public:
+    eSoundMixBus( Uint8 * stream, Uint32 len, std::vector< float > & storage ); //!< starts summing on top of the current content of stream
+    ~eSoundMixBus();                                                             //!< writes the saturated sum back
+
+    static eSoundMixBus * Covering( Uint8 const * dest, Uint32 len ); //!< returns the active bus covering the given bytes, or NULL
+
+    float * Frames( Uint8 const * dest ) const { return bus_ + ( ( dest - stream_ ) >> 1 ); } //!< returns the bus slot for a position in the stream
+private:
+    Uint8 *        stream_;   //!< the output buffer
+    Uint32         len_;      //!< its length in bytes
+    float *        bus_;      //!< the accumulated samples, two per frame
+    eSoundMixBus * previous_; //!< the bus that was active before this one
+
+    static eSoundMixBus * s_active; //!< the innermost active bus
+};
+
+//! mixes source into the len bytes of 16 bit stereo at dest, resampling at speed (in source frames per output frame) from pos on. Returns true if the end of the sample was reached.
+bool se_MixSamples( Uint8 * dest, Uint32 len, eSampleSource const & source, eAudioPos & pos, REAL lvol, REAL rvol, REAL speed, bool loop );
+
+//! returns the name of the vector mixing kernels compiled in, or NULL if there are none
+char const * se_MixKernels();
+
+//! makes the mixer use its scalar kernels even if vector kernels are available
+void se_SetScalarMixing( bool scalar );
+
+#endif
@@ -31,12 +31,21 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include "tMemManager.h"
 #include "tList.h"
 #include "eCoord.h"
-#include "tHeap.h"
 #include <iostream>
 #include "eWall.h"
 
 extern int se_debugExt;
 
+// topology objects get their memory from pools in eGrid.cpp; the grid creates and
+// destroys lots of them during play, the pools recycle it without fragmenting the heap.
+// Their reference counts are locked because the AI walks the frozen grid from several threads.
+#define eGRID_POOLED_ALLOCATION \
+public: \
+    static void * operator new( size_t size ); \
+    static void * operator new( size_t size, const char * classn, const char * file, int line ); \
+    static void   operator delete( void * ptr, size_t size ); \
+    static void   operator delete( void * ptr, const char * classn, const char * file, int line );
+
 class ePoint;
 //class eEdge;
 class eFace;
@@ -74,22 +83,18 @@ protected:
     tJUST_CONTROLLED_PTR<eHalfEdge> edge;         // one of the edges that begin at this vertex/is a border of this edge
 };
 
-// information about from where the path came in pathfinding
-typedef enum { PATH_NEXT=0, PATH_PREV=1, PATH_OTHER_NEXT=2, PATH_PREV_OTHER=3,
-               PATH_START=4, PATH_CLOSED=8, PATH_CLOSED_START=12, PATH_NONE=16}
-ePATH_ORIGIN;
-
-class eHalfEdge: public tHeapElement, public eWallHolder, public tReferencable< eHalfEdge > {
+class eHalfEdge: public eWallHolder, public tReferencable< eHalfEdge, tSpinMutex > {
     friend class eDual;
     friend class ePoint;
     friend class eFace;
     friend class eGrid;
     friend class eTempEdge;
     friend class eWall;
-    friend class tReferencable< eHalfEdge >;
+    friend class tReferencable< eHalfEdge, tSpinMutex >;
 
     ~eHalfEdge();                  // destructor unlinking all pointers
     eHalfEdge(ePoint *p = NULL);            // empty constructor
+    eGRID_POOLED_ALLOCATION
 public:
     eHalfEdge(ePoint *a, ePoint *b,eWall *w=NULL);   // full line constructor
 
@@ -198,28 +203,16 @@ public:
     eHalfEdge* Next() const  {return next;}
 
 
-    // pathfinding interface: find a path for gameobject from origin to target.
+    // pathfinding interface: find a path for gameobject from origin to target in one go.
+    // ePathContext spreads the same search over several calls.
     static void FindPath(const eCoord& originPoint, const eFace* originFace,
                          const eCoord& targetPoint, const eFace* targetFace,
                          const eGameObject* gameObject,
                          ePath& path);
 
-    static void ClearPathData();
-
     eWall* CrossesNewWall(const eGrid *grid) const; // check whether this edge
     // crosses any of the brand-new walls on the grid
 protected:
-
-    // pathfinding temporary data:
-    ePATH_ORIGIN origin_; // the origin of the path
-
-    REAL MinPathLength(){ return Val(); }   // the minimum length of a path through this edge
-    void SetMinPathLength( REAL length, tHeapBase& heap, ePATH_ORIGIN origin );
-
-    void PossiblePath( ePATH_ORIGIN origin, REAL minLength ); // tell the pathfinder that there might be a path of total length minLength through this HalfEdge, coming from the given origin type.
-
-    virtual tHeapBase *Heap() const; // pathfinding heap
-
     void Unlink();          // remove us from all lists
     bool Check() const;     // consistency check
 
@@ -242,9 +235,10 @@ protected:
 
 
 
-class ePoint:public eDual, public eCoord, public tReferencable< ePoint >{
-    friend class tReferencable< ePoint >;
+class ePoint:public eDual, public eCoord, public tReferencable< ePoint, tSpinMutex >{
+    friend class tReferencable< ePoint, tSpinMutex >;
 
+    eGRID_POOLED_ALLOCATION
 public:
     ePoint()                         {}
     ePoint(const eCoord &c):eCoord(c){}
@@ -281,10 +275,11 @@ protected:
 
 class eReplacementStorage;
 
-class eFace:public eDual, public tReferencable< eFace >{
-    friend class tReferencable< eFace >;
+class eFace:public eDual, public tReferencable< eFace, tSpinMutex >{
+    friend class tReferencable< eFace, tSpinMutex >;
 
     ~eFace();
+    eGRID_POOLED_ALLOCATION
 public:
     //  eFace(eGrid *Grid): grid(Grid)    {};
     eFace(eHalfEdge *a, eHalfEdge *b, eHalfEdge *c );
@@ -338,6 +333,8 @@ public:
     */
     eFace* nextProcessed;
 
+    int seedCell; // the cell of the grid's point location index this face is the start point for, or -1
+
     // returns the array of stored replacements
     eReplacementStorage& GetReplacementStorage() const;
 protected:
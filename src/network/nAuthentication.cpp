@@ -41,6 +41,8 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include <string>
 #include <string.h>
 #include <deque>
+#include <map>
+#include <time.h>
 
 #ifdef HAVE_LIBZTHREAD
 #include <zthread/Thread.h>
@@ -48,16 +50,15 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 //#include <zthread/ClassLockable.h>
 #include <zthread/FastMutex.h>
 #include <zthread/FastRecursiveMutex.h>
+#include <zthread/Condition.h>
 #include <zthread/Guard.h>
-// #include <zthread/SynchronousExecutor.h>
-#include <zthread/ThreadedExecutor.h>
-typedef ZThread::ThreadedExecutor nExecutor;
-//typedef ZThread::SynchronousExecutor nExecutor;
 typedef ZThread::FastMutex nMutex;
+typedef ZThread::Condition nCondition;
 #define nQueue ZThread::LockedQueue
 #elif defined(HAVE_PTHREAD)
 #include "pthread-binding.h"
 typedef tPThreadMutex nMutex;
+typedef tPThreadCondition nCondition;
 #define nQueue tPThreadQueue
 #else
 typedef tNonMutex nMutex;
@@ -231,19 +232,147 @@ class nLoginPersistence:
     bool userAuthFailedLastTime;
 };
 
-//! template that runs void member functions of reference countable objects
-template< class T > class nMemberFunctionRunnerTemplate
-#ifdef HAVE_LIBZTHREAD
-    : public ZThread::Runnable
-#endif
+//! task for the background threads
+class nBackgroundTask
+{
+public:
+    virtual ~nBackgroundTask(){}
+
+    virtual void run() = 0;
+};
+
+#if defined(HAVE_LIBZTHREAD) || defined(HAVE_PTHREAD)
+
+// number of threads talking to authorities
+static int sn_authWorkers = 4;
+static tSettingItem< int > sn_authWorkersConf( "AUTH_WORKERS", sn_authWorkers );
+
+// number of tasks that may wait for a free thread before new logins are turned away
+static int sn_authQueueMax = 32;
+static tSettingItem< int > sn_authQueueMaxConf( "AUTH_QUEUE_MAX", sn_authQueueMax );
+
+//! fixed set of threads executing queued background tasks
+class nAuthWorkerPool
 {
+public:
+    //! returns the pool. It is never destroyed; the threads wait on it until the process ends.
+    static nAuthWorkerPool & Get()
+    {
+        static nAuthWorkerPool * pool = new nAuthWorkerPool;
+        return *pool;
+    }
+
+    //! takes ownership of the task and queues it. If the queue is full, the task is deleted and false returned.
+    bool Schedule( nBackgroundTask * task )
+    {
+        mutex_.acquire();
+        if ( queue_.size() >= static_cast< size_t >( sn_authQueueMax > 0 ? sn_authQueueMax : 1 ) )
+        {
+            mutex_.release();
+            delete task;
+            return false;
+        }
+
+        queue_.push_back( task );
+
+        // start another thread if all are busy and the limit allows it
+        bool spawn = idle_ < static_cast< int >( queue_.size() ) && ( threads_ < sn_authWorkers || threads_ == 0 );
+        if ( spawn )
+        {
+            ++threads_;
+        }
+        condition_.signal();
+        mutex_.release();
+
+        if ( spawn )
+        {
+            Spawn();
+        }
+
+        return true;
+    }
+
+    //! the loop every worker thread runs
+    void Work()
+    {
+        mutex_.acquire();
+        for(;;)
+        {
+            ++idle_;
+            while ( queue_.empty() )
+            {
+                condition_.wait();
+            }
+            --idle_;
+
+            nBackgroundTask * task = queue_.front();
+            queue_.pop_front();
+            mutex_.release();
+
+            task->run();
+            delete task;
+
+            mutex_.acquire();
+        }
+    }
 private:
-#if defined(HAVE_PTHREAD) && !defined(HAVE_LIBZTHREAD)
-    static void* DoCall( void *o ) {
-        nMemberFunctionRunnerTemplate * functionRunner = (nMemberFunctionRunnerTemplate*) o;
-        ( (functionRunner->object_)->*(functionRunner->function_) )();
+    nAuthWorkerPool()
+    : condition_( mutex_ ), threads_( 0 ), idle_( 0 )
+    {
     }
+
+    //! starts a new worker thread
+    void Spawn();
+
+    nMutex mutex_;                          //!< protects everything below
+    nCondition condition_;                  //!< signalled when a task is queued
+    std::deque< nBackgroundTask * > queue_; //!< tasks waiting for a thread
+    int threads_;                           //!< number of threads started
+    int idle_;                              //!< number of threads waiting for a task
+};
+
+#ifdef HAVE_LIBZTHREAD
+class nAuthWorker: public ZThread::Runnable
+{
+public:
+    void run()
+    {
+        nAuthWorkerPool::Get().Work();
+    }
+};
+
+void nAuthWorkerPool::Spawn()
+{
+    // the thread keeps running when the handle goes away
+    ZThread::Thread thread( ZThread::Task( new nAuthWorker ) );
+}
+#else
+static void * sn_AuthWorker( void * )
+{
+    nAuthWorkerPool::Get().Work();
+    return NULL;
+}
+
+void nAuthWorkerPool::Spawn()
+{
+    pthread_t thread;
+    if ( 0 == pthread_create( &thread, NULL, &sn_AuthWorker, NULL ) )
+    {
+        pthread_detach( thread );
+    }
+    else
+    {
+        mutex_.acquire();
+        --threads_;
+        mutex_.release();
+    }
+}
 #endif
+#endif
+
+//! template that runs void member functions of reference countable objects
+template< class T > class nMemberFunctionRunnerTemplate: public nBackgroundTask
+{
 public:
     nMemberFunctionRunnerTemplate( T & object, void (T::*function)() )
     : object_( &object ), function_( function )
@@ -262,22 +391,14 @@ public:
         pendingForBreak_.push_back( nMemberFunctionRunnerTemplate( object, function ) );
     }
 
-    //! schedule a task for execution in a background thread
-    static void ScheduleBackground( T & object, void (T::*function)()  )
+    //! schedule a task for execution in a background thread. Returns false if too many tasks are waiting already.
+    static bool ScheduleBackground( T & object, void (T::*function)()  )
     {
 #if defined(HAVE_LIBZTHREAD) || defined(HAVE_PTHREAD)
         // schedule the task into a background thread
         if ( !tRecorder::IsRunning() )
         {
-#if !defined(HAVE_LIBZTHREAD)
-            nMemberFunctionRunnerTemplate<T> * runner = new nMemberFunctionRunnerTemplate<T>( object, function );
-
-            pthread_t thread;
-            pthread_create(&thread, NULL, (nMemberFunctionRunnerTemplate::DoCall), (void*) runner);
-#else
-            static nExecutor executor;
-            executor.execute( ZThread::Task( new nMemberFunctionRunnerTemplate( object, function ) ) );
-#endif
+            return nAuthWorkerPool::Get().Schedule( new nMemberFunctionRunnerTemplate( object, function ) );
         }
         else
         {
@@ -289,6 +410,7 @@ public:
         // do it when you can without getting interrupted.
         ScheduleBreak( object, function );
 #endif
+        return true;
     }
 
     //! schedule a task for execution in the next tToDo call
@@ -372,9 +494,9 @@ public:
         nMemberFunctionRunnerTemplate<T>::ScheduleBreak( object, function );
     }
 
-    template< class T > static void ScheduleBackground( T & object, void (T::*function)() )
+    template< class T > static bool ScheduleBackground( T & object, void (T::*function)() )
     {
-        nMemberFunctionRunnerTemplate<T>::ScheduleBackground( object, function );
+        return nMemberFunctionRunnerTemplate<T>::ScheduleBackground( object, function );
     }
 
     template< class T > static void ScheduleForeground( T & object, void (T::*function)() )
@@ -382,12 +504,13 @@ public:
         nMemberFunctionRunnerTemplate<T>::ScheduleForeground( object, function );
     }
 
-    template< class T > static void ScheduleMayBlock( T & object, void (T::*function)(), bool block )
+    //! returns false if the function could not be scheduled because the background threads are overloaded
+    template< class T > static bool ScheduleMayBlock( T & object, void (T::*function)(), bool block )
     {
         if ( block )
         {
 #if defined(HAVE_LIBZTHREAD) || defined(HAVE_PTHREAD)
-            ScheduleBackground( object, function );
+            return ScheduleBackground( object, function );
 #else
             ScheduleBreak( object, function );
 #endif
@@ -396,6 +519,8 @@ public:
         {
             ScheduleForeground( object, function );
         }
+
+        return true;
     }
 };
 
@@ -448,7 +573,10 @@ public:
 
         clientSupportedMethods = sn_Connections[user.Owner()].supportedAuthenticationMethods_;
 
-        nMemberFunctionRunner::ScheduleMayBlock( *this, &nLoginProcess::FetchInfoFromAuthority, authority != "" );
+        if ( !nMemberFunctionRunner::ScheduleMayBlock( *this, &nLoginProcess::FetchInfoFromAuthority, authority != "" ) )
+        {
+            ReportAuthorityError( tOutput( "$login_error_busy" ) );
+        }
     }
 
     // That function triggers fetching of authentication relevant data from the authentication
@@ -581,6 +709,75 @@ void nLoginProcess::FetchInfoFromAuthority()
 
 static tSettingItem< bool > sn_supportRemoteLoginsConf( "GLOBAL_ID", sn_supportRemoteLogins );
 
+// seconds an authority's answer to method queries is reused for further logins
+static int sn_authCacheTime = 600;
+static tSettingItem< int > sn_authCacheTimeConf( "AUTH_CACHE_TIME", sn_authCacheTime );
+
+//! successful answer of an authority
+struct nAuthorityAnswer
+{
+    std::string content; //!< the answer
+    time_t expires;      //!< when it has to be fetched again
+};
+
+// answers to method list and method parameter queries; accessed from the background threads
+static std::map< std::string, nAuthorityAnswer > sn_authorityAnswers;
+static nMutex sn_authorityAnswersMutex;
+
+// fetches a method query from an authority, reusing a recent answer to the same query if possible.
+// Password checks must not go through here.
+static int sn_FetchAuthorityInfo( tString const & fullAuthority, char const * query, std::ostream & target )
+{
+    std::string key( static_cast< char const * >( fullAuthority ) );
+    key += query;
+    time_t now = time( NULL );
+
+    if ( sn_authCacheTime > 0 )
+    {
+        sn_authorityAnswersMutex.acquire();
+        std::map< std::string, nAuthorityAnswer >::const_iterator found = sn_authorityAnswers.find( key );
+        if ( found != sn_authorityAnswers.end() && found->second.expires > now )
+        {
+            std::string content = found->second.content;
+            sn_authorityAnswersMutex.release();
+
+            target << content;
+            return 200;
+        }
+        sn_authorityAnswersMutex.release();
+    }
+
+    std::ostringstream answer;
+    int rc = nKrawall::FetchURL( fullAuthority, query, answer );
+
+    if ( rc == 200 && sn_authCacheTime > 0 )
+    {
+        sn_authorityAnswersMutex.acquire();
+
+        // throw out what is stale so unused authorities don't pile up
+        for ( std::map< std::string, nAuthorityAnswer >::iterator i = sn_authorityAnswers.begin(); i != sn_authorityAnswers.end(); )
+        {
+            if ( i->second.expires <= now )
+            {
+                sn_authorityAnswers.erase( i++ );
+            }
+            else
+            {
+                ++i;
+            }
+        }
+
+        nAuthorityAnswer & stored = sn_authorityAnswers[ key ];
+        stored.content = answer.str();
+        stored.expires = now + sn_authCacheTime;
+
+        sn_authorityAnswersMutex.release();
+    }
+
+    target << answer.str();
+    return rc;
+}
+
 // legal characters in authority hostnames(besides alnum and dots)
 static bool sn_IsLegalSpecialChar( char c )
 {
@@ -774,7 +971,7 @@ bool nLoginProcess::FetchInfoFromAuthorityRemote()
 
         // try yo find a better method, fetch method list
         std::stringstream answer;
-        int rc = nKrawall::FetchURL( fullAuthority, "?query=methods", answer );
+        int rc = sn_FetchAuthorityInfo( fullAuthority, "?query=methods", answer );
 
         if ( rc == -1 )
         {
@@ -819,7 +1016,7 @@ bool nLoginProcess::FetchInfoFromAuthorityRemote()
         query << "?query=params";
         query << "&method=" << nKrawall::EncodeString( method.method );
         std::ostringstream data;
-        int rc = nKrawall::FetchURL( fullAuthority, query.str().c_str(), data );
+        int rc = sn_FetchAuthorityInfo( fullAuthority, query.str().c_str(), data );
         
         if ( rc != 200 )
         {
@@ -946,7 +1143,10 @@ void nLoginProcess::ProcessClientAnswer( nMessage & m )
     sn_GetAdr( m.SenderID(), peerAddress );
   
     // and go on
-    nMemberFunctionRunner::ScheduleMayBlock( *this, &nLoginProcess::Authorize, authority != "" );
+    if ( !nMemberFunctionRunner::ScheduleMayBlock( *this, &nLoginProcess::Authorize, authority != "" ) )
+    {
+        ReportAuthorityError( tOutput( "$login_error_busy" ) );
+    }
 }
 
 static bool sn_trustLAN = false;
@@ -1072,7 +1272,7 @@ void nLoginProcess::Authorize()
 // the finish task can also be triggered any time by this function:
 void nLoginProcess::Abort()
 {
-    nMemberFunctionRunner::ScheduleBackground( *this, &nLoginProcess::Finish );
+    nMemberFunctionRunner::ScheduleForeground( *this, &nLoginProcess::Finish );
 }
 
 // which, when finished, triggers the foreground task of updating the
@@ -30,19 +30,39 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include "tConsole.h"
 #include "tSysTime.h"
 #include <set>
+#include <vector>
 #include <string.h>
 
 nConfItemBase::nConfItemBase()
-        :tConfItemBase(""), lastChangeTime_(-10000), lastChangeMessage_(0), watcher_(0){}
+        :tConfItemBase(""), lastChangeTime_(-10000), lastChangeMessage_(0), watcher_(0), netID_(-1){}
 
 //nConfItemBase::nConfItemBase(const char *title,const char *help)
 //  :tConfItemBase(title, help){}
 
 nConfItemBase::nConfItemBase(const char *title)
-        :tConfItemBase(title), lastChangeTime_(-10000), lastChangeMessage_(0), watcher_(0){}
+        :tConfItemBase(title), lastChangeTime_(-10000), lastChangeMessage_(0), watcher_(0), netID_(-1){}
 
 nConfItemBase::~nConfItemBase(){}
 
+bool nConfItemBase::NetReadValIfNew(nMessage &m){
+    // check if message was new
+    if ( tSysTimeFloat() > lastChangeTime_ + 100 || sn_Update( lastChangeMessage_, m.MessageIDBig() ) )
+    {
+        lastChangeMessage_ = m.MessageIDBig();
+        lastChangeTime_ = tSysTimeFloat();
+        NetReadVal(m);
+        return true;
+    }
+    else
+    {
+        static bool warn = true;
+        if ( warn )
+            con << tOutput( "$nconfig_error_ignoreold", title );
+        warn = false;
+        return false;
+    }
+}
+
 void nConfItemBase::s_GetConfigMessage(nMessage &m){
     if (sn_GetNetState()==nSERVER){
         nReadError(); // never accept config messages from the clients
@@ -61,20 +81,7 @@ void nConfItemBase::s_GetConfigMessage(nMessage &m){
             nConfItemBase *netitem = dynamic_cast<nConfItemBase*> (item);
             if (netitem)
             {
-                // check if message was new
-                if ( tSysTimeFloat() > netitem->lastChangeTime_ + 100 || sn_Update( netitem->lastChangeMessage_, m.MessageIDBig() ) )
-                {
-                    netitem->lastChangeMessage_ = m.MessageIDBig();
-                    netitem->lastChangeTime_ = tSysTimeFloat();
-                    netitem->NetReadVal(m);
-                }
-                else
-                {
-                    static bool warn = true;
-                    if ( warn )
-                        con << tOutput( "$nconfig_error_ignoreold", name );
-                    warn = false;
-                }
+                netitem->NetReadValIfNew(m);
             }
             else
             {
@@ -98,16 +105,279 @@ void nConfItemBase::s_GetConfigMessage(nMessage &m){
 static nDescriptor transferConfig(60,nConfItemBase::s_GetConfigMessage,
                                   "transfer config");
 
+// *******************************************************************************************
+// *
+// *	config snapshots
+// *
+// *******************************************************************************************
+//!
+//!     Clients that understand them get settings packed into config snapshot messages
+//!     instead of one transferConfig message per setting. Every network setting gets a
+//!     compact ID on the server; the first time a setting is sent to a client, its name
+//!     travels along. Once the client acknowledged that message, the ID alone is used.
+//!     Each entry is
+//!         ID ( with bit 15 set if the name follows )
+//!         [name]
+//!         length of the value in words
+//!         value
+//!     so clients can skip settings they don't know.
+//!
+// *******************************************************************************************
+
+static nVersionFeature sn_configSnapshots( 18 );
+
+static nDescriptor transferConfigSnapshot(61,nConfItemBase::s_GetConfigSnapshotMessage,
+                                          "transfer config snapshot");
+
+// maximal length of a config snapshot message in words; a packet holds MAX_MESS_LEN/2 words
+// including the message headers, so this keeps each snapshot message in one packet
+static const int sn_configSnapshotLen = 140;
+
+// the network settings by ID on the server
+static std::vector< nConfItemBase * > sn_configSnapshotItems;
+static unsigned int sn_configSnapshotItemsFrom = 0;
+
+// the IDs each client knows the names of
+static std::vector< bool > sn_configSnapshotKnown[ MAXCLIENTS+2 ];
+
+// the settings by ID as the server announced them, on the client
+static std::vector< nConfItemBase * > sn_configSnapshotReceived;
+
+std::vector< nConfItemBase * > const & nConfItemBase::s_NetItems()
+{
+    // settings only get registered, never removed, so a size change means new ones
+    tConfItemMap & confmap = ConfItemMap();
+    if ( confmap.size() != sn_configSnapshotItemsFrom )
+    {
+        sn_configSnapshotItemsFrom = confmap.size();
+        for(tConfItemMap::iterator iter = confmap.begin(); iter != confmap.end() ; ++iter)
+        {
+            nConfItemBase *netitem = dynamic_cast<nConfItemBase*> ( (*iter).second );
+            if ( netitem && netitem->netID_ < 0 )
+            {
+                netitem->netID_ = sn_configSnapshotItems.size();
+                sn_configSnapshotItems.push_back( netitem );
+            }
+        }
+    }
+
+    return sn_configSnapshotItems;
+}
+
+//! collects settings into config snapshot messages for one client
+class nConfigBatch
+{
+public:
+    explicit nConfigBatch( int peer ): peer_( peer ){}
+    ~nConfigBatch(){ Flush(); }
+
+    //! adds a setting to the batch
+    void Add( nConfItemBase & item )
+    {
+        if ( item.netID_ < 0 )
+            nConfItemBase::s_NetItems();
+        tASSERT( item.netID_ >= 0 && item.netID_ < 0x8000 );
+
+        if ( !message_ )
+        {
+            message_ = tNEW( nMessage )( transferConfigSnapshot );
+        }
+
+        std::vector< bool > & known = sn_configSnapshotKnown[ peer_ ];
+        if ( known.size() <= static_cast< unsigned int >( item.netID_ ) )
+            known.resize( item.netID_ + 1, false );
+
+        unsigned short id = item.netID_;
+        if ( known[ item.netID_ ] )
+        {
+            *message_ << id;
+        }
+        else
+        {
+            *message_ << static_cast< unsigned short >( id | 0x8000 );
+            *message_ << item.GetTitle();
+            named_.push_back( id );
+        }
+
+        // write the value after a placeholder for its length
+        unsigned short lengthPos = message_->DataLen();
+        message_->Write( 0 );
+        item.NetWriteVal( *message_ );
+        message_->data[ lengthPos ] = message_->DataLen() - lengthPos - 1;
+
+        if ( message_->DataLen() >= sn_configSnapshotLen )
+        {
+            Flush();
+        }
+    }
+
+    //! sends the collected settings
+    void Flush();
+private:
+    int peer_;                                //!< the client to send to
+    tCONTROLLED_PTR( nMessage ) message_;     //!< the message collecting the settings
+    std::vector< unsigned short > named_;     //!< IDs whose names are sent in the current message
+};
+
+//! waits for the ack of a config snapshot message, then remembers the client knows the names sent with it
+class nWaitForAckConfigSnapshot: public nWaitForAck
+{
+public:
+    nWaitForAckConfigSnapshot( nMessage * m, int receiver, std::vector< unsigned short > & named )
+            : nWaitForAck( m, receiver )
+    {
+        named_.swap( named );
+    }
+
+    virtual void AckExtraAction()
+    {
+        std::vector< bool > & known = sn_configSnapshotKnown[ receiver ];
+        for ( std::vector< unsigned short >::const_iterator i = named_.begin(); i != named_.end(); ++i )
+        {
+            if ( known.size() <= *i )
+                known.resize( *i + 1, false );
+            known[ *i ] = true;
+        }
+    }
+private:
+    std::vector< unsigned short > named_; //!< IDs whose names were sent
+};
+
+void nConfigBatch::Flush()
+{
+    if ( !message_ )
+        return;
+
+    if ( named_.empty() )
+    {
+        message_->Send( peer_ );
+    }
+    else
+    {
+        // the names are known to the client once it acknowledged the message;
+        // like nNetObject syncs, the message goes out right away with its own ack waiter
+        new nWaitForAckConfigSnapshot( message_, peer_, named_ );
+        unsigned long id = message_->MessageIDBig();
+        message_->SendImmediately( peer_, false );
+        message_->messageIDBig_ = id;
+    }
+
+    message_ = NULL;
+    named_.clear();
+}
+
+void nConfItemBase::s_GetConfigSnapshotMessage(nMessage &m){
+    if (sn_GetNetState()==nSERVER){
+        nReadError(); // never accept config messages from the clients
+        return;
+    }
+
+    while ( !m.End() )
+    {
+        unsigned short id, len;
+        m >> id;
+        nConfItemBase * netitem = NULL;
+        if ( id & 0x8000 )
+        {
+            // learn the ID
+            id &= 0x7fff;
+            tString name;
+            m >> name;
+
+            tConfItemMap & confmap = ConfItemMap();
+            tConfItemMap::iterator iter = confmap.find( name );
+            if ( iter != confmap.end() )
+            {
+                netitem = dynamic_cast<nConfItemBase*> ( (*iter).second );
+            }
+            if ( !netitem )
+            {
+                static bool warn = true;
+                if ( warn )
+                    con << tOutput( "$nconfig_error_unknown", name );
+                warn = false;
+            }
+
+            if ( sn_configSnapshotReceived.size() <= id )
+                sn_configSnapshotReceived.resize( id + 1, NULL );
+            sn_configSnapshotReceived[ id ] = netitem;
+        }
+        else if ( id < sn_configSnapshotReceived.size() )
+        {
+            netitem = sn_configSnapshotReceived[ id ];
+        }
+
+        m >> len;
+        if ( !netitem || !netitem->NetReadValIfNew(m) )
+        {
+            // skip the value
+            unsigned short dummy;
+            for ( int i = len-1; i >= 0; --i )
+                m >> dummy;
+        }
+    }
+}
+
+//! sends a setting to a client in the format the client understands
+static void sn_SendConfig( nConfItemBase & item, nConfigBatch * batch, int peer )
+{
+    if ( batch )
+    {
+        batch->Add( item );
+    }
+    else
+    {
+        nMessage *m=new nMessage(transferConfig);
+        *m << item.GetTitle();
+        item.NetWriteVal(*m);
+        m->Send(peer);
+    }
+}
+
+// returns the next user below previous that config goes to: the given peer, or
+// with peer -1 every connected client. Returns -1 when there are no more.
+static int sn_NextConfigReceiver( int peer, int previous )
+{
+    if ( peer >= 0 )
+        return previous > peer ? peer : -1;
+
+    int next = sn_NextActiveUser( previous );
+    return next > 0 ? next : -1;
+}
+
 void nConfItemBase::s_SendConfig(bool force, int peer){
     if(sn_GetNetState()==nSERVER){
-        tConfItemMap & confmap = ConfItemMap();
-        for(tConfItemMap::iterator iter = confmap.begin(); iter != confmap.end() ; ++iter)
+        std::vector< nConfItemBase * > const & items = s_NetItems();
+
+        // a forced send to a single client happens when it logs in; it knows no IDs yet
+        // and has all settings at their defaults
+        bool login = force && peer >= 0;
+        if ( login )
+            sn_configSnapshotKnown[ peer ].clear();
+
+        for ( int user = sn_NextConfigReceiver( peer, MAXCLIENTS+1 ); user >= 0; user = sn_NextConfigReceiver( peer, user ) )
         {
-            tConfItemBase * item = (*iter).second;
+            if ( !sn_Connections[user].socket )
+                continue;
 
-            nConfItemBase *netitem = dynamic_cast<nConfItemBase*> (item);
-            if (netitem)
-                netitem->SendConfig(force, peer);
+            nConfigBatch userBatch( user );
+            nConfigBatch * batch = sn_configSnapshots.Supported( user ) ? &userBatch : NULL;
+            for ( std::vector< nConfItemBase * >::const_iterator iter = items.begin(); iter != items.end(); ++iter )
+            {
+                nConfItemBase * netitem = *iter;
+                if ( !netitem->changed && !force )
+                    continue;
+                if ( login && batch && netitem->IsDefault() )
+                    continue;
+
+                sn_SendConfig( *netitem, batch, user );
+            }
+        }
+
+        if ( peer == -1 )
+        {
+            for ( std::vector< nConfItemBase * >::const_iterator iter = items.begin(); iter != items.end(); ++iter )
+                (*iter)->changed = false;
         }
     }
 }
@@ -116,16 +386,26 @@ void nConfItemBase::SendConfig(bool force, int peer){
     if ( (changed || force) && sn_GetNetState()==nSERVER)
     {
         //con << "sending conf message for " << tConfItems(i)->title << "\n";
-        nMessage *m=new nMessage(transferConfig);
-        *m << title;
-        NetWriteVal(*m);
+        for ( int user = sn_NextConfigReceiver( peer, MAXCLIENTS+1 ); user >= 0; user = sn_NextConfigReceiver( peer, user ) )
+        {
+            if ( !sn_Connections[user].socket )
+                continue;
+
+            if ( sn_configSnapshots.Supported( user ) )
+            {
+                nConfigBatch batch( user );
+                batch.Add( *this );
+            }
+            else
+            {
+                sn_SendConfig( *this, NULL, user );
+            }
+        }
+
         if (peer==-1)
         {
-            m->BroadCast();
             changed = false;
         }
-        else
-            m->Send(peer);
     }
 }
 
@@ -449,6 +729,8 @@ static char const * sn_versionString[] =
         "0.2.8.3_alpha", // 14
         "0.2.8.3_alpha_auth", // 15
         "0.2.8.3.X", // 16, was: 0.2.8.3_beta2
+        "0.2.8.3.X_deltasync", // 17
+        "0.2.8.3.X_configsnapshot", // 18
        0
     };
 
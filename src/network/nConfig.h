@@ -30,6 +30,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 
 #include "tConfiguration.h"
 #include "nNetwork.h"
+#include <vector>
 
 template<class T> inline bool sn_compare(T&a, T&b)
 {
@@ -69,10 +70,15 @@ private:
 class nConfItemBase:public virtual tConfItemBase
 {
     friend class nIConfItemWatcher;
+    friend class nConfigBatch;
 private:
     double lastChangeTime_;             //!< the time of the last change
     unsigned long lastChangeMessage_;   //!< the ID of the networking message responsible for the change
     nIConfItemWatcher * watcher_;       //!< the watcher that reacts on changes of this item
+    int netID_;                         //!< the compact ID of the item in config snapshots, -1 if none was assigned yet
+
+    bool NetReadValIfNew(nMessage &m);  //!< reads the value from a message unless a newer one was already received
+    static std::vector< nConfItemBase * > const & s_NetItems(); //!< returns the network settings by config snapshot ID
 protected:
     nConfItemBase();
 public:
@@ -84,10 +90,12 @@ public:
     virtual void NetWriteVal(nMessage &m)=0;
 
     static void s_GetConfigMessage(nMessage &m);
+    static void s_GetConfigSnapshotMessage(nMessage &m);
 
     virtual void WasChanged(bool nonDefault);
 
     virtual bool Writable();
+    virtual bool IsDefault() const=0;       //!< returns whether the setting is at its default value
 
     static void s_SendConfig(bool force=true, int peer=-1);
     void          SendConfig(bool force=true, int peer=-1);
@@ -159,6 +167,11 @@ public:
         }
     }
 
+    virtual bool IsDefault() const         //!< returns whether the setting is at its default value
+    {
+        return *this->target == default_;
+    }
+
     virtual void OnRevertToDefaults()      //!< revert this setting to its default
     {
         Set( default_ );
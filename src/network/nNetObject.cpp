@@ -38,6 +38,8 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include "tRecorder.h"
 
 #include <deque>
+#include <vector>
+#include <algorithm>
 #include <set>
 #include <map>
 
@@ -808,7 +810,7 @@ nNetObject::nNetObject(nMessage &m):lastSyncID_(m.MessageIDBig()),refCtr_(0){
     registrar.object = this;
     registrar.sender = m.SenderID();
 
-    knowsAbout[m.SenderID()].knowsAboutExistence=true;
+    knowsAbout.Modify(m.SenderID()).knowsAboutExistence=true;
 #ifdef DEBUG
     // con << "Netobject " << id  << " created (remote order).\n";
 #endif
@@ -823,10 +825,15 @@ void nNetObject::DoBroadcastExistence(){
     {
         int maxUser = (sn_GetNetState() == nSERVER) ? MAXCLIENTS : 0;
         int minUser  = (sn_GetNetState() == nSERVER) ? 1 : 0;
-        for (int user = maxUser; user >= minUser; --user)
+        std::vector< int > const & users = sn_ActiveUsers();
+        for (std::vector< int >::const_iterator iter = users.begin(); iter != users.end(); ++iter)
         {
+            int user = *iter;
+            if ( user < minUser || user > maxUser )
+                continue;
+
             // sync the object only to users that don't know about it yet
-            if ( !knowsAbout[user].knowsAboutExistence && sn_Connections[user].socket ) // && !knowsAbout[user].syncReq )
+            if ( !knowsAbout[user].knowsAboutExistence ) // && !knowsAbout[user].syncReq )
                 RequestSync( user, true );
         }
     }
@@ -979,9 +986,27 @@ void nNetObject::RegisterRegistrar( nNetObjectRegistrar& r )
 
 static nDescriptor net_destroy(22,net_destroy_handler,"net_destroy");
 
-static tJUST_CONTROLLED_PTR< nMessage > destroyers[MAXCLIENTS+2];
-static REAL                             destroyersTime[MAXCLIENTS+2];
-static int                              destroyersCount[MAXCLIENTS+2];
+// what the object synchronisation knows about one connection. The table only grows
+// up to the highest user ID that got synchronised, not to the connection capacity.
+struct nSyncConnection
+{
+    tJUST_CONTROLLED_PTR< nMessage > destroyer;  //!< destruction message being filled
+    REAL destroyerTime;                         //!< time the destruction message was started
+    int destroyersPending;                      //!< destruction messages waiting for their ack
+    bool readyToGetObjects;                     //!< set when the peer is ready to receive objects
+
+    nSyncConnection(): destroyerTime( 0 ), destroyersPending( 0 ), readyToGetObjects( false ){}
+};
+
+static std::vector< nSyncConnection > sn_syncConnections;
+
+static nSyncConnection & sn_SyncConnection( int user )
+{
+    tASSERT( 0 <= user && user <= MAXCLIENTS+1 );
+    if ( user >= static_cast< int >( sn_syncConnections.size() ) )
+        sn_syncConnections.resize( user + 1 );
+    return sn_syncConnections[ user ];
+}
 
 // special ack for destroy messages
 class nWaitForAckDestroy: public nWaitForAck{
@@ -989,22 +1014,22 @@ public:
     nWaitForAckDestroy(nMessage* m,int receiver)
             :nWaitForAck(m,receiver)
     {
-        ++destroyersCount[receiver];
+        ++sn_SyncConnection( receiver ).destroyersPending;
     }
     virtual ~nWaitForAckDestroy()
     {
-        --destroyersCount[receiver];
+        --sn_SyncConnection( receiver ).destroyersPending;
     }
 };
 
 static void sn_SendDestroyer( int client )
 {
-    tASSERT( 0 <= client && client <= MAXCLIENTS+1 );
-    if ( destroyers[ client ] )
+    tJUST_CONTROLLED_PTR< nMessage > destroyer = sn_SyncConnection( client ).destroyer;
+    if ( destroyer )
     {
-        destroyers[ client ]->SendImmediately( client, false );
-        new nWaitForAckDestroy( destroyers[ client ], client );
-        destroyers[ client ] = 0;
+        sn_SyncConnection( client ).destroyer = 0;
+        destroyer->SendImmediately( client, false );
+        new nWaitForAckDestroy( destroyer, client );
     }
 }
 
@@ -1074,17 +1099,20 @@ nNetObject::~nNetObject(){
         tRecorderSync< int >::Archive( "_NETOBJECT_DESTROYED", 3, idsync );
 
         // con << "Destroying object " << id << '\n';
-        for(int user=MAXCLIENTS;user>=0;user--){
-            if( ( user!=sn_myNetID && knowsAbout[user].knowsAboutExistence ) ||
-                    knowsAbout[user].acksPending){
-                if (destroyers[user]==NULL)
+        for(int entry=knowsAbout.Len()-1;entry>=0;entry--){
+            int user = knowsAbout.User(entry);
+            if( user <= MAXCLIENTS &&
+                    ( ( user!=sn_myNetID && knowsAbout[user].knowsAboutExistence ) ||
+                      knowsAbout[user].acksPending ) ){
+                nSyncConnection & connection = sn_SyncConnection( user );
+                if (connection.destroyer==NULL)
                 {
-                    destroyers[user]=new nMessage(net_destroy);
-                    destroyersTime[user]=tSysTimeFloat();
+                    connection.destroyer=new nMessage(net_destroy);
+                    connection.destroyerTime=tSysTimeFloat();
                 }
-                destroyers[user]->Write(id);
+                connection.destroyer->Write(id);
 
-                if (destroyers[user]->DataLen() > ( destroyersCount[user] ? 1000 : 100 ) )
+                if (connection.destroyer->DataLen() > ( connection.destroyersPending ? 1000 : 100 ) )
                 {
                     sn_SendDestroyer( user );
                 }
@@ -1249,6 +1277,49 @@ void nNetObject::PrintName(tString &s) const
     s << "Nameless NetObject nr. " << id;
 }
 
+int nNetObject::nKnowsAboutTable::Find(int user) const{
+    int low = 0, high = entries_.size();
+    while ( low < high )
+    {
+        int middle = ( low + high ) / 2;
+        if ( entries_[middle].user < user )
+            low = middle + 1;
+        else
+            high = middle;
+    }
+    return low;
+}
+
+nNetObject::nKnowsAboutInfo const & nNetObject::nKnowsAboutTable::operator[](int user) const{
+    static nKnowsAboutInfo const defaultInfo;
+
+    int i = Find( user );
+    if ( i < int(entries_.size()) && entries_[i].user == user )
+        return entries_[i].info;
+
+    return defaultInfo;
+}
+
+nNetObject::nKnowsAboutInfo & nNetObject::nKnowsAboutTable::Modify(int user){
+    tASSERT( 0 <= user && user <= MAXCLIENTS+1 );
+
+    int i = Find( user );
+    if ( i == int(entries_.size()) || entries_[i].user != user )
+    {
+        Entry entry;
+        entry.user = user;
+        entries_.insert( entries_.begin() + i, entry );
+    }
+
+    return entries_[i].info;
+}
+
+void nNetObject::nKnowsAboutTable::Remove(int user){
+    int i = Find( user );
+    if ( i < int(entries_.size()) && entries_[i].user == user )
+        entries_.erase( entries_.begin() + i );
+}
+
 bool nNetObject::HasBeenTransmitted(int user) const{
     return (knowsAbout[user].knowsAboutExistence);
 }
@@ -1259,6 +1330,13 @@ bool nNetObject::ClearToTransmit(int user) const{
     return true;
 }
 
+REAL nNetObject::SyncInterest(int user) const{
+    return 1;
+}
+
+void nNetObject::SyncAcked(int user, unsigned short messageID){
+}
+
 
 void nNetObject::WriteSync(nMessage &m){
 #ifdef DEBUG
@@ -1273,7 +1351,7 @@ void nNetObject::ReadSync(nMessage &m){
     if (sn_GetNetState()==nSERVER){
         bool back=knowsAbout[m.SenderID()].syncReq;
         RequestSync(); // tell the others about it
-        knowsAbout[m.SenderID()].syncReq=back;
+        knowsAbout.Modify(m.SenderID()).syncReq=back;
         // but not the sender of the message; he
         // knows already.
     }
@@ -1327,8 +1405,9 @@ void nNetObject::RequestSync(int user,bool ack){ // only for a single user
     this->GetID();
 
     if (sn_GetNetState()==nSERVER || (AcceptClientSync() && owner==::sn_myNetID)){
-        knowsAbout[user].syncReq=true;
-        knowsAbout[user].nextSyncAck |=ack;
+        nKnowsAboutInfo & knows = knowsAbout.Modify(user);
+        knows.syncReq=true;
+        knows.nextSyncAck |=ack;
     }
 #ifdef DEBUG
     else
@@ -1351,9 +1430,12 @@ void nNetObject::RequestSync(bool ack){
         tERR_ERROR("RequestSync should only be called server-side!");
 #endif
 
-    for(int i=MAXCLIENTS;i>=0;i--){
-        knowsAbout[i].syncReq=true;
-        knowsAbout[i].nextSyncAck |=ack;
+    // users without a connection are reset when they connect
+    std::vector< int > const & users = sn_ActiveUsers();
+    for(std::vector< int >::const_iterator iter = users.begin(); iter != users.end(); ++iter){
+        nKnowsAboutInfo & knows = knowsAbout.Modify(*iter);
+        knows.syncReq=true;
+        knows.nextSyncAck |=ack;
     }
 
     if ( syncListID_ < 0 )
@@ -1405,9 +1487,10 @@ class nWaitForAckSync: public nWaitForAck{
 public:
     nWaitForAckSync(nMessage* m,int rec,unsigned short obj)
             :nWaitForAck(m,rec),netobj(obj){
-        if(sn_netObjects(obj)->knowsAbout[rec].acksPending<15)
+        nNetObject::nKnowsAboutInfo & knows = sn_netObjects(obj)->knowsAbout.Modify(rec);
+        if(knows.acksPending<15)
         {
-            sn_netObjects(obj)->knowsAbout[rec].acksPending++;
+            knows.acksPending++;
         }
         else
         {
@@ -1421,9 +1504,10 @@ public:
         nNetObject* obj = sn_netObjects[netobj];
         if ( obj )
         {
-            if( obj->knowsAbout[receiver].acksPending)
+            nNetObject::nKnowsAboutInfo & knows = obj->knowsAbout.Modify(receiver);
+            if( knows.acksPending)
             {
-                obj->knowsAbout[receiver].acksPending--;
+                knows.acksPending--;
             }
             else
             {
@@ -1441,7 +1525,9 @@ public:
             */
 #endif
 
-            obj->knowsAbout[receiver].knowsAboutExistence=true;
+            knows.knowsAboutExistence=true;
+
+            obj->SyncAcked( receiver, message->MessageID() );
         }
         else
         {
@@ -1489,7 +1575,6 @@ bool nNetObject::AcceptClientSync() const{
 
 
 //static int current_sync[MAXCLIENTS+2];
-static bool is_ready_to_get_objects[MAXCLIENTS+2];
 
 // from nNetwork.C
 //extern REAL planned_rate_control[MAXCLIENTS+2];
@@ -1508,7 +1593,57 @@ int nNetObject::SyncedUser()
     return sn_syncedUser;
 }
 
+// time in seconds the syncs of completely uninteresting objects get delayed;
+// 0 disables interest management.
+static REAL sn_syncInterestDelay = 0;
+static tSettingItem< REAL > sn_syncInterestDelayConf( "SYNC_INTEREST_DELAY", sn_syncInterestDelay );
+
+// entry of the sync order
+struct nSyncCandidate
+{
+    int  index;    // index in sn_SyncRequestedObject
+    REAL interest; // interest of the synced user in the object
+
+    bool operator < ( nSyncCandidate const & other ) const
+    {
+        return interest < other.interest;
+    }
+};
+
+// sync requests in the order they should be processed for the current user, most interesting last
+static std::vector< nSyncCandidate > sn_syncOrder;
+
+// sorts the sync requests by the interest the user has in them
+static void sn_SortSyncRequests( int user )
+{
+    sn_syncOrder.resize( sn_SyncRequestedObject.Len() );
+    for ( int i = sn_SyncRequestedObject.Len()-1; i >= 0; --i )
+    {
+        nNetObject * nos = sn_SyncRequestedObject( i );
+        nSyncCandidate & candidate = sn_syncOrder[i];
+        candidate.index = i;
+        candidate.interest = ( nos && sn_syncInterestDelay > 0 ) ? nos->SyncInterest( user ) : 1;
+    }
+
+    // stable, so equally interesting objects keep their usual order
+    if ( sn_syncInterestDelay > 0 )
+        std::stable_sort( sn_syncOrder.begin(), sn_syncOrder.end() );
+}
+
+// determines whether a regular sync of an object should be sent now, given its interest.
+static bool sn_SyncDue( nNetObject::nKnowsAboutInfo const & knows, REAL interest )
+{
+    // syncs that want an ack usually carry important changes; don't hold them back
+    if ( sn_syncInterestDelay <= 0 || knows.nextSyncAck )
+        return true;
+
+    return tSysTimeFloat() >= knows.lastSync + sn_syncInterestDelay * ( 1 - interest );
+}
+
+static tPhaseTimer sn_syncTimer( "sync" );
 void nNetObject::SyncAll(){
+    tPhaseTimerScope phase( sn_syncTimer );
+
 #ifdef DEBUG
     s_DoPrintDebug = false;
 
@@ -1521,20 +1656,24 @@ void nNetObject::SyncAll(){
     }
 #endif
 
-    for(int user=MAXCLIENTS;user>=0;user--)
-        if (is_ready_to_get_objects[user] &&
+    // (sending may disconnect users)
+    for(int user=sn_NextActiveUser(MAXCLIENTS+1);user>=0;user=sn_NextActiveUser(user)){
+        if (sn_SyncConnection( user ).readyToGetObjects &&
                 sn_Connections[user].socket && sn_netObjects.Len()>0 && user!=sn_myNetID){
 
             sn_syncedUser = user;
 
             // con << sn_SyncRequestedObject.Len() << "/" << sn_netObjects.Len() << "\n";
 
-            int currentSync = sn_SyncRequestedObject.Len()-1;
-            while(sn_Connections[user].socket>0 &&
+            sn_SortSyncRequests( user );
+
+            int currentPos = sn_SyncRequestedObject.Len()-1;
+            while(sn_Connections[user].socket &&
                     sn_Connections[user].bandwidthControl_.CanSend() &&
                     sn_Connections[user].ackPending<sn_maxNoAck &&
-                    currentSync >= 0){
-                nNetObject *nos = sn_SyncRequestedObject( currentSync );
+                    currentPos >= 0){
+                nSyncCandidate const & candidate = sn_syncOrder[ currentPos ];
+                nNetObject *nos = candidate.index < sn_SyncRequestedObject.Len() ? sn_SyncRequestedObject( candidate.index ) : NULL;
 
                 if (nos && nos->ClearToTransmit(user) && ( nos == sn_netObjects( nos->id ) )
                         && (sn_GetNetState()!=nCLIENT ||
@@ -1547,11 +1686,12 @@ void nNetObject::SyncAll(){
                     {
                         // look for the object ID in the current destruction message
                         {
-                            if ( destroyers[user] )
+                            nMessage * destroyer = sn_SyncConnection( user ).destroyer;
+                            if ( destroyer )
                             {
-                                for( int i = destroyers[user]->DataLen()-1; i >= 0; --i )
+                                for( int i = destroyer->DataLen()-1; i >= 0; --i )
                                 {
-                                    if ( destroyers[user]->Data(i) == s )
+                                    if ( destroyer->Data(i) == s )
                                     {
                                         // found it. Send the destruction
                                         // message and wait for its ack.
@@ -1562,11 +1702,11 @@ void nNetObject::SyncAll(){
                             }
                         }
 
-                        if ( destroyersCount[user] )
+                        if ( sn_SyncConnection( user ).destroyersPending )
                         {
                             // don't send creation messages while destruction
                             // messages are unacknowledged.
-                            --currentSync;
+                            --currentPos;
                             continue;
                         }
 
@@ -1595,7 +1735,9 @@ void nNetObject::SyncAll(){
                             m->SendImmediately(user, false);
                             m->messageIDBig_ = id;
 
-                            nos->knowsAbout[user].syncReq = false;
+                            nKnowsAboutInfo & knows = nos->knowsAbout.Modify(user);
+                            knows.syncReq = false;
+                            knows.lastSync = tSysTimeFloat();
                         }
 #ifdef DEBUG
                         else if (DoDebugPrint())
@@ -1610,17 +1752,19 @@ void nNetObject::SyncAll(){
                     }
                     else if (nos->knowsAbout[user].syncReq
                              && sn_Connections[user].bandwidthControl_.Control( nBandwidthControl::Usage_Planning ) >50
-                             && nos->knowsAbout[user].acksPending<=1){
+                             && nos->knowsAbout[user].acksPending<=1
+                             && sn_SyncDue( nos->knowsAbout[user], candidate.interest )){
                         // send a sync
                         tJUST_CONTROLLED_PTR< nMessage > m = new nMessage(net_sync);
 
                         m->Write(s);
                         nos->WriteSync(*m);
-                        nos->knowsAbout[user].syncReq=false;
+                        nos->knowsAbout.Modify(user).syncReq=false;
+                        nos->knowsAbout.Modify(user).lastSync = tSysTimeFloat();
 
                         if(nos->knowsAbout[user].nextSyncAck){
                             new nWaitForAckSync(m,user,s);
-                            nos->knowsAbout[user].nextSyncAck=false;
+                            nos->knowsAbout.Modify(user).nextSyncAck=false;
                         }
 #ifndef nSIMULATE_PING	    
                         unsigned long id = m->MessageIDBig();
@@ -1632,16 +1776,17 @@ void nNetObject::SyncAll(){
 
                 }
 
-                currentSync--;
+                currentPos--;
             }
 
             // send the destroy messages
-            if (destroyers[user] && !destroyersCount[user] )
+            nSyncConnection const & connection = sn_SyncConnection( user );
+            if (connection.destroyer && !connection.destroyersPending )
             {
                 // but check whether the opportunity is good (big destroyers message, or a sync packet in the pipe) first
-                if ( destroyers[user]->DataLen() > 75 ||
+                if ( connection.destroyer->DataLen() > 75 ||
                         sn_Connections[user].sendBuffer_.Len() > 0 ||
-                        destroyersTime[user] < tSysTimeFloat()-.5-2*sn_Connections[user].ping.GetPing() )
+                        connection.destroyerTime < tSysTimeFloat()-.5-2*sn_Connections[user].ping.GetPing() )
                 {
                     sn_SendDestroyer( user );
                 }
@@ -1676,6 +1821,7 @@ void nNetObject::SyncAll(){
                 warn++;
 #endif
         }
+    }
 
 
     // clear out objects that no longer need to be in the list because
@@ -1694,10 +1840,11 @@ void nNetObject::SyncAll(){
                 {
                     int start = ( sn_GetNetState() == nSERVER ) ? MAXCLIENTS : 0;
                     int stop  = ( sn_GetNetState() == nSERVER ) ? 1 : 0;
-                    for ( int i = start; i>=stop && canRemove; --i )
+                    for ( int entry = nos->knowsAbout.Len()-1; entry>=0 && canRemove; --entry )
                     {
-                        const nKnowsAboutInfo& knows = nos->knowsAbout[i];
-                        if ( sn_Connections[i].socket && knows.syncReq )
+                        int i = nos->knowsAbout.User(entry);
+                        const nKnowsAboutInfo& knows = nos->knowsAbout.Info(entry);
+                        if ( i <= start && i >= stop && sn_Connections[i].socket && knows.syncReq )
                             canRemove = false;
                     }
                 }
@@ -1711,7 +1858,7 @@ void nNetObject::SyncAll(){
 
 static void ready_handler(nMessage &m)
 {
-    is_ready_to_get_objects[m.SenderID()]=true;
+    sn_SyncConnection( m.SenderID() ).readyToGetObjects=true;
 
     // reset peer's ping, it's probably unreliable
     sn_Connections[m.SenderID()].ping.Timestep(100);
@@ -1739,12 +1886,9 @@ void nNetObject::ClearAllDeleted()
     swap.clear();
 
     // send out object deletion messages
-    for( int i = MAXCLIENTS;i>=0;i--)
+    for( int user = sn_NextActiveUser( MAXCLIENTS+1 ); user >= 0; user = sn_NextActiveUser( user ) )
     {
-        if ( sn_Connections[i].socket )
-        {
-            sn_SendDestroyer(i);
-        }
+        sn_SendDestroyer( user );
     }
 }
 
@@ -1776,11 +1920,14 @@ void nNetObject::ClearAll(){
 
 void nNetObject::ClearKnows(int user, bool clear){
     if (0<=user && user <=MAXCLIENTS){
-        is_ready_to_get_objects[user]=false;
+        sn_SyncConnection( user ).readyToGetObjects=false;
         for(int i=sn_netObjects.Len()-1;i>=0;i--){
             nNetObject *no=sn_netObjects(i);
             if (no){
-                no->knowsAbout[user].Reset();
+                if ( sn_Connections[user].socket )
+                    no->knowsAbout.Modify(user).Reset();
+                else
+                    no->knowsAbout.Remove(user);
 
                 no->DoBroadcastExistence();  // immediately transfer the thing
 
@@ -1858,10 +2005,12 @@ void nNetObject::RelabelOnConnect(){
                 no->id=id;
                 no->owner=::sn_myNetID;
                 sn_netObjectsOwner[id]=::sn_myNetID;
-                for(int j=MAXCLIENTS;j>=0;j--){
-                    no->knowsAbout[j].Reset();
-                    no->DoBroadcastExistence();
+                no->knowsAbout.Clear();
+                std::vector< int > const & users = sn_ActiveUsers();
+                for(std::vector< int >::const_iterator iter = users.begin(); iter != users.end(); ++iter){
+                    no->knowsAbout.Modify(*iter).Reset();
                 }
+                no->DoBroadcastExistence();
 
                 if (sn_netObjects[id])
                     st_Breakpoint();
@@ -1872,7 +2021,7 @@ void nNetObject::RelabelOnConnect(){
         }
     }
     (new nMessage(ready))->Send(0);
-    is_ready_to_get_objects[0]=true;
+    sn_SyncConnection( 0 ).readyToGetObjects=true;
 }
 
 
@@ -1894,7 +2043,7 @@ static void login_callback(){
     // send and delete the  remaining destroyer message
     sn_SendDestroyer(user);
 
-    destroyersCount[user] = 0;
+    sn_SyncConnection( user ).destroyersPending = 0;
 }
 
 static nCallbackLoginLogout nlc(&login_callback);
@@ -1989,10 +2138,9 @@ void sn_Sync(REAL timeout,bool sync_sn_netObjects, bool otherEnd){
             sn_SendPlanned();
 
             goon=false;
-            for(int user=MAXCLIENTS;user>0;user--)
+            for(int user=sn_NextActiveUser(MAXCLIENTS+1);user>0;user=sn_NextActiveUser(user))
             {
-                if(sn_Connections[user].socket &&
-                        (!sync_ack[user] || sn_Connections[user].ackPending>0 || sn_QueueLen(user)))
+                if((!sync_ack[user] || sn_Connections[user].ackPending>0 || sn_QueueLen(user)))
                 {
                     goon=true;
                 }
@@ -32,6 +32,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include "tArray.h"
 #include "tConsole.h"
 #include <string.h>
+#include <vector>
 
 class nObserver;
 
@@ -79,6 +80,7 @@ public:
         // for it's ack?
     bool syncReq:1;              // should a sync message be sent?
     unsigned char acksPending:4;  // how many messages are underway?
+    REAL lastSync;               // time the last sync was sent
 
         nKnowsAboutInfo(){
             memset(this, 0, sizeof(nKnowsAboutInfo) );
@@ -91,11 +93,43 @@ public:
             nextSyncAck=true;
             syncReq=true;
             acksPending=0;
+            lastSync=-1000;
         }
     };
+
+    // what the users know about an object. Only users that had anything
+    // to do with the object get an entry, the others are in the default state.
+    class nKnowsAboutTable{
+    public:
+        // the information about a user, for reading
+        nKnowsAboutInfo const & operator[](int user) const;
+
+        // the information about a user, for writing; creates an entry
+        nKnowsAboutInfo & Modify(int user);
+
+        // puts the user back into the default state
+        void Remove(int user);
+
+        // puts all users back into the default state
+        void Clear(){ entries_.clear(); }
+
+        // iteration over the users with an entry, ordered by user ID
+        int Len() const{ return entries_.size(); }
+        int User(int i) const{ return entries_[i].user; }
+        nKnowsAboutInfo & Info(int i){ return entries_[i].info; }
+    private:
+        struct Entry{
+            unsigned short user;
+            nKnowsAboutInfo info;
+        };
+
+        int Find(int user) const; // index of the first entry with a user not smaller than the given one
+
+        std::vector< Entry > entries_; // sorted by user
+    };
 protected:
 
-    nKnowsAboutInfo knowsAbout[MAXCLIENTS+2];
+    nKnowsAboutTable knowsAbout;
 
     nNetObject *Object(int i);
     // returns a pointer to the nNetObject
@@ -202,6 +236,14 @@ public:
     // to non-transmitted objects. this function is supposed to check that.
     virtual bool ClearToTransmit(int user) const;
 
+    // how interesting is this object for the given user? Returns a value between
+    // 0 (not at all) and 1 (very). Less interesting objects are synced after
+    // the more interesting ones and, if SYNC_INTEREST_DELAY is set, less often.
+    virtual REAL SyncInterest(int user) const;
+
+    // called when the user acknowledged a sync or creation message with the given ID
+    virtual void SyncAcked(int user, unsigned short messageID);
+
     // syncronisation functions:
     virtual void WriteSync(nMessage &m); // store sync message in m
     virtual void ReadSync(nMessage &m); // guess what
@@ -51,6 +51,8 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #endif
 
 #include <deque>
+#include <algorithm>
+#include <functional>
 
 // my IP address. Master server/game server hopefully tell me a correct one.
 static tString sn_myAddress ("*.*.*.*:*");
@@ -208,6 +210,45 @@ static unsigned short lastacks[MAXCLIENTS+2][ACKBACK];
 static unsigned short lastackPos[MAXCLIENTS+2];
 static unsigned short highest_ack[MAXCLIENTS+2];
 
+// the users with an active connection, highest ID first
+static std::vector< int > sn_activeUsers;
+static bool sn_activeUsersDirty = true;
+
+// call whenever a connection in the range 0..MAXCLIENTS gets or loses its socket
+static void sn_ActiveUsersChanged()
+{
+    sn_activeUsersDirty = true;
+}
+
+std::vector< int > const & sn_ActiveUsers()
+{
+    if ( sn_activeUsersDirty )
+    {
+        sn_activeUsersDirty = false;
+        sn_activeUsers.clear();
+        for ( int i = MAXCLIENTS; i >= 0; --i )
+            if ( sn_Connections[i].socket )
+                sn_activeUsers.push_back( i );
+    }
+
+    return sn_activeUsers;
+}
+
+int sn_NextActiveUser( int previous )
+{
+    // search by ID, not by position: the list may get rebuilt between two calls
+    std::vector< int > const & users = sn_ActiveUsers();
+    std::vector< int >::const_iterator next =
+        std::upper_bound( users.begin(), users.end(), previous, std::greater< int >() );
+    return next != users.end() ? *next : -1;
+}
+
+// like sn_NextActiveUser(), but starts with the login slot (pass MAXCLIENTS+2 to begin)
+static int sn_NextSendSlot( int previous )
+{
+    return previous > MAXCLIENTS+1 ? MAXCLIENTS+1 : sn_NextActiveUser( previous );
+}
+
 
 //********************************************************
 // Version control
@@ -469,7 +510,7 @@ static void reset_last_acks(int i){
 
 
 //#ifndef DEBUG
-int sn_maxClients=MAXCLIENTS;
+int sn_maxClients = MAXCLIENTS < 32 ? MAXCLIENTS : 32;
 
 bool restrictMaxClients( int const &newValue )
 {
@@ -504,9 +545,13 @@ unsigned short current_id=1; // current running network number
 
 
 // the classes that are responsible for the queuing of network send tEvents:
+// the heap values are absolute deadlines measured against a common send clock
+// (see sn_sendQueueClock below), so waiting messages become more urgent
+// just by advancing the clock instead of touching every queue entry.
 class planned_send:public tHeapElement{
 protected:
     int peer;
+    REAL enqueued_; // send clock value at the time we got queued
 public:
     planned_send(REAL priority,int peer);
     ~planned_send();
@@ -516,6 +561,12 @@ public:
     // change our priority:
     void add_to_priority(REAL diff);
 
+    // our priority relative to the current time:
+    REAL Priority() const;
+
+    // shift deadline and queue time by the same amount (used for clock rebasing)
+    void Rebase(REAL diff);
+
     // what is to be done if the sceduled tEvent is executed?
     virtual void execute()=0;
 };
@@ -928,12 +979,29 @@ static unsigned long int sn_ExpandMessageID( unsigned short id, unsigned short s
 }
 
 nMessage::nMessage(unsigned short*& buffer,short sender, int lenLeft )
-        :descriptor(ntohs(*(buffer++))),messageIDBig_(sn_ExpandMessageID(ntohs(*(buffer++)),sender)),
-senderID(sender),readOut(0){
+        :view_(0),viewLen_(0){
 #ifdef NET_DEBUG
     nMessages++;
 #endif
 
+    Decode( buffer, sender, lenLeft, false );
+}
+
+void nMessage::View(unsigned short*& buffer,short sender, int lenLeft )
+{
+    data.SetLen(0);
+    Decode( buffer, sender, lenLeft, true );
+}
+
+void nMessage::Decode(unsigned short*& buffer,short sender, int lenLeft, bool view )
+{
+    descriptor=ntohs(*(buffer++));
+    messageIDBig_=sn_ExpandMessageID(ntohs(*(buffer++)),sender);
+    senderID=sender;
+    readOut=0;
+    view_=0;
+    viewLen_=0;
+
     tRecorderSync< unsigned long >::Archive( "_MESSAGE_ID_IN", 3, messageIDBig_ );
     tRecorderSync< unsigned short >::Archive( "_MESSAGE_DECL_IN", 3, descriptor );
 
@@ -946,17 +1014,48 @@ senderID(sender),readOut(0){
         throw nKillHim();
 #endif
     }
-    for(int i=0;i<len;i++)
-        data[i]=ntohs(*(buffer++));
+
+    if ( view )
+    {
+        // just remember where the data is; it gets converted on access
+        view_=buffer;
+        viewLen_=len;
+        buffer+=len;
+    }
+    else
+    {
+        for(int i=0;i<len;i++)
+            data[i]=ntohs(*(buffer++));
+    }
 
 #ifdef DEBUG
     BreakOnMessageID( messageIDBig_ );
 #endif
 }
 
+void nMessage::Materialize()
+{
+    if ( !view_ )
+        return;
+
+    unsigned short const * view = view_;
+    int len = viewLen_;
+    view_=0;
+    viewLen_=0;
+
+    data.SetLen(0);
+    for(int i=0;i<len;i++)
+        data[i]=ntohs(view[i]);
+}
+
+unsigned short nMessage::Data(unsigned short n)
+{
+    return view_ ? ntohs( view_[n] ) : data(n);
+}
+
 nMessage::nMessage(const nDescriptor &d)
         :descriptor(d.id),
-senderID(::sn_myNetID), readOut(0){
+senderID(::sn_myNetID), view_(0), viewLen_(0), readOut(0){
 #ifdef NET_DEBUG
     nMessages++;
 #endif
@@ -1006,9 +1105,8 @@ void nMessage::BroadCast(bool ack){
         Send(0,ack);
 
     if (sn_GetNetState()==nSERVER){
-        for(int i=MAXCLIENTS;i>0;i--){
-            if (sn_Connections[i].socket)
-                Send(i,0,ack);
+        for(int i=sn_NextActiveUser(MAXCLIENTS+1);i>0;i=sn_NextActiveUser(i)){
+            Send(i,0,ack);
         }
     }
 }
@@ -1073,7 +1171,7 @@ nMessage& nMessage::operator << ( const tOutput &o ){
 
 nMessage& nMessage::ReadRaw(tString &s )
 {
-    s.Clear();
+    s.SetLen(0);
     unsigned short w,len;
     Read(len);
     if ( len > 0 )
@@ -1368,6 +1466,8 @@ void nMessage::Read(unsigned short &x){
         // sn_DisconnectUser(senderID, "$network_kill_error");
         nReadError( false );
     }
+    else if ( view_ )
+        x=ntohs(view_[readOut++]);
     else
         x=data(readOut++);
 }
@@ -1779,6 +1879,7 @@ int login_handler( nMessage &m, unsigned short rate ){
                 senderID.SetID( new_id );
 
                 sn_Connections	[ new_id ].socket	= sn_Connections[MAXCLIENTS+1].socket; // the new connection has number MC+1
+                sn_ActiveUsersChanged();
                 peers			[ new_id ]			= peers[MAXCLIENTS+1];
                 timeouts		[ new_id ]			= kickOnDemandTimeout/2;
 
@@ -2147,7 +2248,7 @@ void nMessage::SendImmediately(int peer,bool ack){
     }
 #endif
 
-    if (sn_Connections[peer].sendBuffer_.Len()+data.Len()+3 > MAX_MESS_LEN/2){
+    if (sn_Connections[peer].sendBuffer_.Len()+DataLen()+3 > MAX_MESS_LEN/2){
         SendCollected(peer);
         //con << "Overflow packets sent to " << peer << '\n';
     }
@@ -2230,6 +2331,9 @@ void nMessage::Send(int peer,REAL priority,bool ack){
     // the next line was redundant; the send buffer handles that part of accounting.
     //sn_Connections[peer].bandwidthControl_.Use( nBandwidthControl::Usage_Planning, 2*(data.Len()+3) );
 
+    // the message is kept in the send queue, it can't point into the receive buffer
+    Materialize();
+
     sent_per_messid[descriptor]+=2*(data.Len()+3);
 
     tASSERT(Descriptor()!=s_Acknowledge.ID() || !ack);
@@ -2248,12 +2352,60 @@ public:
 // receive and s_Acknowledge the recently reveived network messages
 
 typedef std::deque< tJUST_CONTROLLED_PTR< nMessage > > nMessageFifo;
+typedef std::vector< tJUST_CONTROLLED_PTR< nMessage > > nMessageArray;
+
+// messages of the current packet; they look directly at the receive buffer
+static nMessageArray sn_viewedMessages;
+
+// messages nobody is interested in any more, ready to view the next packet
+static nMessageArray sn_spareMessages;
+
+// decodes the next message from the receive buffer
+static nMessage * sn_ViewMessage( unsigned short*& buffer, short sender, int lenLeft )
+{
+    if ( sn_spareMessages.empty() )
+    {
+        // no message to reuse, make a new one (it'll be reused later)
+        sn_viewedMessages.push_back( tNEW( nMessage )( buffer, sender, lenLeft ) );
+        return sn_viewedMessages.back();
+    }
+
+    sn_viewedMessages.push_back( sn_spareMessages.back() );
+    sn_spareMessages.pop_back();
+    nMessage * message = sn_viewedMessages.back();
+    message->View( buffer, sender, lenLeft );
+    return message;
+}
+
+// call when the receive buffer is about to be reused. Messages that
+// got stored somewhere get their own copy of the data, the rest are kept for reuse.
+static void sn_ReleaseViewedMessages( bool reuse )
+{
+    for ( nMessageArray::iterator i = sn_viewedMessages.begin(); i != sn_viewedMessages.end(); ++i )
+    {
+        nMessage * message = *i;
+        if ( !reuse || message->GetRefcount() > 1 )
+            message->Materialize();
+        else if ( sn_spareMessages.size() < 100 )
+            sn_spareMessages.push_back( *i );
+    }
+    sn_viewedMessages.clear();
+}
 
 static void rec_peer(unsigned int peer){
     tASSERT( sn_Connections[peer].socket );
 
     nMachine::Expire();
 
+    // are we called from a message handler?
+    static int recursionCount = 0;
+    if ( recursionCount > 0 )
+    {
+        // the messages of the outer call have not all been handled yet, and
+        // we're going to overwrite the buffer they are looking at.
+        sn_ReleaseViewedMessages( false );
+    }
+
     // temporary fifo for received messages
     //static tArray< tJUST_CONTROLLED_PTR< nMessage > > receivedMessages;
     static nMessageFifo receivedMessages;
@@ -2389,7 +2541,7 @@ static void rec_peer(unsigned int peer){
 #endif
                     while( lenleft >= 3 ){
                         tJUST_CONTROLLED_PTR< nMessage > pmess;
-                        pmess = tNEW( nMessage )(b,id,lenleft);
+                        pmess = sn_ViewMessage(b,id,lenleft);
                         nMessage& mess = *pmess;
 
                         lenleft = bend - b;
@@ -2512,7 +2664,6 @@ static void rec_peer(unsigned int peer){
             try
             {
 	#endif
-                static int recursionCount = 0;
                 ++recursionCount;
 
                 // handle messages
@@ -2541,6 +2692,8 @@ static void rec_peer(unsigned int peer){
             }
 	#endif
 
+            // the next packet goes into the same buffer
+            sn_ReleaseViewedMessages( true );
         }
     }
 }
@@ -2669,7 +2822,10 @@ void sn_SetNetState(nNetState x){
             }
 
             if (!sn_Connections[0].socket)
+            {
                 sn_Connections[0].socket=sn_BasicNetworkSystem.Init();
+                sn_ActiveUsersChanged();
+            }
             // bool success = true;
             if (x == nSERVER)
             {
@@ -2716,6 +2872,7 @@ void sn_SetNetState(nNetState x){
             }
 
             sn_Connections[0].socket = 0;
+            sn_ActiveUsersChanged();
 
             // shutdown network system to get new socket
             if ( !sn_noReset )
@@ -2769,7 +2926,10 @@ nConnectError sn_Connect( nAddress const & server, nLoginType loginType, nSocket
 
     // set user requested socket
     if ( socket )
+    {
         sn_Connections[0].socket = socket;
+        sn_ActiveUsersChanged();
+    }
 
     sn_Connections[0].ping.Reset();
 
@@ -3125,10 +3285,49 @@ static tAccessLevelSetter sn_CenterConfLevel( CenterMessage_c, tAccessLevel_Mode
 // the network stuff planned to send:
 tHeap<planned_send> send_queue[MAXCLIENTS+2];
 
+// the global send clock; advances with real time in sn_SendPlanned1().
+static REAL sn_sendQueueClock = 0;
+
+// statistics about the send queue of one peer
+struct nSendQueueStats
+{
+    int  maxDepth;      // maximal number of queued messages
+    int  dequeued;      // number of messages taken out of the queue
+    REAL totalLatency;  // total time dequeued messages spent waiting
+    REAL maxLatency;    // maximal time a message spent waiting
+
+    nSendQueueStats(){ Reset(); }
+
+    void Reset()
+    {
+        maxDepth = dequeued = 0;
+        totalLatency = maxLatency = 0;
+    }
+
+    void Enqueued( int depth )
+    {
+        if ( depth > maxDepth )
+            maxDepth = depth;
+    }
+
+    void Dequeued( REAL latency )
+    {
+        ++dequeued;
+        totalLatency += latency;
+        if ( latency > maxLatency )
+            maxLatency = latency;
+    }
+};
+
+static nSendQueueStats sn_sendQueueStats[MAXCLIENTS+2];
+
 planned_send::planned_send(REAL priority,int Peer){
     peer=Peer;
+    enqueued_=sn_sendQueueClock;
 
-    SetVal( priority, send_queue[peer] );
+    SetVal( priority + sn_sendQueueClock, send_queue[peer] );
+
+    sn_sendQueueStats[peer].Enqueued( send_queue[peer].Len() );
 }
 
 planned_send::~planned_send(){
@@ -3146,6 +3345,17 @@ void planned_send::add_to_priority(REAL diff)
     SetVal( Val() + diff, send_queue[peer] );
 }
 
+REAL planned_send::Priority() const
+{
+    return Val() - sn_sendQueueClock;
+}
+
+void planned_send::Rebase(REAL diff)
+{
+    enqueued_ += diff;
+    SetVal( Val() + diff, send_queue[peer] );
+}
+
 // **********************************************
 
 nMessage_planned_send::nMessage_planned_send
@@ -3158,7 +3368,9 @@ nMessage_planned_send::~nMessage_planned_send(){
 }
 
 void nMessage_planned_send::execute(){
-    if ( Val() < -killTimeout-10){
+    sn_sendQueueStats[peer].Dequeued( sn_sendQueueClock - enqueued_ );
+
+    if ( Priority() < -killTimeout-10){
         tOutput mess;
         mess.SetTemplateParameter(1, peer);
         mess << "$network_error_overflow";
@@ -3195,8 +3407,24 @@ static REAL sn_SendPlanned1(){
 #endif
     REAL dt = time - lastTime;
 
-    //for(int i=MAXCLIENTS+1;i>=0;i--){
-    for(int i=0;i<=MAXCLIENTS+1;i++){
+    // make everything a little more urgent
+    sn_sendQueueClock += dt;
+
+    // keep the clock small so it does not eat up the float precision
+    // of the deadlines. Shifting everything by the same amount keeps
+    // the heaps valid; this happens only every couple of minutes.
+    if ( sn_sendQueueClock > 1000 )
+    {
+        REAL shift = -sn_sendQueueClock;
+        for(int i=MAXCLIENTS+1;i>=0;i--)
+            for(int j=send_queue[i].Len()-1;j>=0;j--)
+                send_queue[i](j)->Rebase( shift );
+        sn_sendQueueClock = 0;
+    }
+
+    // the login slot, then the active users, highest first
+    // (sending may disconnect users; sn_NextSendSlot copes with that)
+    for(int i=sn_NextSendSlot(MAXCLIENTS+2);i>=0;i=sn_NextSendSlot(i)){
         nConnectionInfo & connection = sn_Connections[i];
         if ( !connection.socket )
             continue;
@@ -3209,10 +3437,6 @@ static REAL sn_SendPlanned1(){
             if (send_queue[i].Len())
                 delete send_queue[i](0);
         }
-
-        // make everything a little more urgent:
-        for(int j=send_queue[i].Len()-1;j>=0;j--)
-            send_queue[i](j)->add_to_priority(-dt);
     }
     lastTime=time;
 
@@ -3221,7 +3445,7 @@ static REAL sn_SendPlanned1(){
 
 static void sn_SendPlanned2( REAL dt ){
     // empty the send buffers
-    for(int i=0;i<=MAXCLIENTS+1;i++){
+    for(int i=sn_NextSendSlot(MAXCLIENTS+2);i>=0;i=sn_NextSendSlot(i)){
         nConnectionInfo & connection = sn_Connections[i];
         if ( connection.socket )
         {
@@ -3234,13 +3458,20 @@ static void sn_SendPlanned2( REAL dt ){
     }
 }
 
+static tPhaseTimer sn_sendTimer( "send" );
 void sn_SendPlanned()
 {
+    tPhaseTimerScope phase( sn_sendTimer );
+
+    // collect the packets and hand them to the system in batches
+    nSocketSendBatch batch;
+
     // propagate messages to buffers
     REAL dt = sn_SendPlanned1();
 
     // schedule the acks: send them if it's possible (bandwith limit) or if there already is a packet in the pipe.
-    for(int i=0;i<=MAXCLIENTS+1;i++)
+    for(int i=sn_NextSendSlot(MAXCLIENTS+2);i>=0;i=sn_NextSendSlot(i))
+    {
         if(sn_Connections[i].socket && sn_Connections[i].ackMess && !sn_Connections[i].ackMess->End()
                 //	&& sn_ackAckPending[i] <= 1+sn_Connections[].ackMess[i]->DataLen()
                 && ( sn_Connections[i].bandwidthControl_.CanSend() || sn_Connections[i].sendBuffer_.Len() > 0 )
@@ -3248,6 +3479,7 @@ void sn_SendPlanned()
             sn_Connections[i].ackMess->SendImmediately(i, false);
             sn_Connections[i].ackMess=NULL;
         }
+    }
 
     // schedule lost messages for resending
     nWaitForAck::Resend();
@@ -3256,7 +3488,10 @@ void sn_SendPlanned()
     sn_SendPlanned2( dt );
 }
 
+static tPhaseTimer sn_receiveTimer( "receive" );
 void sn_Receive(){
+    tPhaseTimerScope phase( sn_receiveTimer );
+
     /*
       static bool reentry=false;
       if (reentry)
@@ -3425,10 +3660,12 @@ void sn_DisconnectUserNoWarn(int i, const tOutput& reason, nServerInfoBase * red
     // clear address, socket and send queue
     sn_Connections[i].sendBuffer_.Clear();
     sn_Connections[i].socket=NULL;
+    sn_ActiveUsersChanged();
     peers[i] = nAddress();
     sn_Connections[i].Clear();
     while (send_queue[i].Len())
         delete (send_queue[i](0));
+    sn_sendQueueStats[i].Reset();
 
     reentry=false;
 
@@ -3440,6 +3677,33 @@ int sn_QueueLen(int user){
     return send_queue[user].Len();
 }
 
+// prints send queue statistics of all connected users
+static void sn_SendQueueStats_conf(std::istream &s)
+{
+    for( int i=0; i<=MAXCLIENTS+1; ++i )
+    {
+        nSendQueueStats & stats = sn_sendQueueStats[i];
+        if ( !sn_Connections[i].socket && stats.dequeued == 0 )
+            continue;
+
+        REAL average = stats.dequeued > 0 ? stats.totalLatency/stats.dequeued : 0;
+        tOutput o;
+        o.SetTemplateParameter(1, i);
+        o.SetTemplateParameter(2, send_queue[i].Len());
+        o.SetTemplateParameter(3, stats.maxDepth);
+        o.SetTemplateParameter(4, stats.dequeued);
+        o.SetTemplateParameter(5, average);
+        o.SetTemplateParameter(6, stats.maxLatency);
+        o << "$network_send_queue_stats";
+        con << o;
+
+        // start a new measurement period
+        stats.Reset();
+    }
+}
+
+static tConfItemFunc sn_SendQueueStats_c("SEND_QUEUE_STATS",&sn_SendQueueStats_conf);
+
 
 static tCallback* s_loginoutAnchor=NULL;
 int  nCallbackLoginLogout::user;
@@ -3547,6 +3811,7 @@ nConnectionInfo::~nConnectionInfo(){}
 
 void nConnectionInfo::Clear(){
     socket     = NULL;
+    sn_ActiveUsersChanged();
     ackPending = 0;
     ping.Reset();
     // crypt      = NULL;
@@ -3612,9 +3877,13 @@ unsigned int sn_GetServerPort()
 int sn_NumUsers( bool all )
 {
     int ret = 0;
-    for (int i=MAXCLIENTS; i>0; i--)
-        if (sn_Connections[i].socket && ( all || ( sn_allowSameIPCountSoft > CountSameIP( i ) ) ) )
+    std::vector< int > const & users = sn_ActiveUsers();
+    for ( std::vector< int >::const_iterator iter = users.begin(); iter != users.end(); ++iter )
+    {
+        int i = *iter;
+        if ( i > 0 && ( all || ( sn_allowSameIPCountSoft > CountSameIP( i ) ) ) )
             ret++;
+    }
 
 #ifndef DEDICATED
     ret++;
@@ -37,6 +37,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 //#include "tCrypt.h"
 #include "tException.h"
 #include <memory>
+#include <vector>
 
 class nSocket;
 class nAddress;
@@ -101,9 +102,14 @@ private:
 // call this function on any error occuring while reading a message:
 void nReadError( bool critical = true );
 
+// the capacity of the connection table. The number of clients actually
+// accepted is set at runtime with MAX_CLIENTS. The capacity itself stays a
+// compile time constant: sn_Connections and the other per user tables are
+// indexed by user ID all over the network code, and at a few hundred bytes
+// per slot they are cheap. Loops should visit sn_NextActiveUser(), not every slot.
 #ifndef MAXCLIENTS
 #ifdef DEDICATED
-#define MAXCLIENTS 32
+#define MAXCLIENTS 256
 #else
 #define MAXCLIENTS 16
 #endif
@@ -126,6 +132,12 @@ unsigned int sn_GetPort(int user);
 unsigned int sn_GetServerPort();
 int sn_NumUsers();
 int sn_MaxUsers();
+
+// returns the IDs of all users with an active connection (0..MAXCLIENTS), highest first
+std::vector< int > const & sn_ActiveUsers();
+// returns the highest active user ID below previous, or -1 if there is none.
+// Loops built on it stay valid when users connect or disconnect on the way.
+int sn_NextActiveUser( int previous );
 int sn_MessagesPending(int user);
 
 // information about currently supported versions
@@ -405,6 +417,7 @@ class nMessage: public tReferencable< nMessage >{
     friend class nDescriptor;
     friend class nNetObject;
     friend class nWaitForAck;
+    friend class nConfigBatch;
 
     //	void AddRef();
     //	void Release();
@@ -416,9 +429,15 @@ protected:
     short          senderID;      // sender's identification
     tArray<unsigned short> data;  // assuming ints are 32 bit wide...
 
+    unsigned short const * view_; // if set, the data still sits in network byte order in the receive buffer
+    unsigned short viewLen_;      // the length of the viewed data
+
     unsigned int readOut;
 
     ~nMessage();
+
+    // read message header and data from the network stream
+    void Decode( unsigned short*& buffer, short sender, int lenLeft, bool view );
 public:
     unsigned short Descriptor() const{
         return descriptor;
@@ -437,12 +456,10 @@ public:
     }
 
     unsigned short DataLen() const{
-        return data.Len();
+        return view_ ? viewLen_ : data.Len();
     }
 
-    unsigned short Data(unsigned short n){
-        return data(n);
-    }
+    unsigned short Data(unsigned short n);
 
     void ClearMessageID(){ // clear the message ID so no acks are sent for it
         messageIDBig_ = 0;
@@ -452,6 +469,18 @@ public:
     nMessage(unsigned short*& buffer, short sn_myNetID, int lenLeft );
     // read a message from the network stream
 
+    // reuse this message for the next one in the network stream. The data
+    // is not copied, the message just looks at the buffer, which therefore
+    // has to stay valid until the message is materialized or reused again.
+    void View(unsigned short*& buffer, short sn_myNetID, int lenLeft );
+
+    // copy viewed data into the message so the receive buffer can be reused
+    void Materialize();
+
+    bool IsView() const{
+        return view_;
+    }
+
     // immediately send the message WITHOUT the queue; dangerous!
     void SendImmediately(int peer,bool ack=true);
 
@@ -469,6 +498,8 @@ public:
     void Send(int peer,REAL priority=0,bool ack=true);
 
     void Write(const unsigned short &x){
+        if ( view_ )
+            Materialize();
         data[data.Len()]=x;
     }
 
@@ -504,7 +535,7 @@ public:
             Write((reinterpret_cast<const unsigned short *>(&x))[i]);
     }
 
-bool End(){return readOut>=static_cast<unsigned int>(data.Len());}
+bool End(){return readOut>=static_cast<unsigned int>(DataLen());}
 
     void Reset(){readOut=0;}
 
@@ -33,9 +33,9 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 class nNetObject;
 
 // netobject observer
-class nObserver: public tReferencable< nObserver >
+class nObserver: public tReferencable< nObserver, tSpinMutex >
 {
-    friend class tReferencable< nObserver >;
+    friend class tReferencable< nObserver, tSpinMutex >;
 public:
     const nNetObject* GetNetObject() 	const;  // returns the observed object
 
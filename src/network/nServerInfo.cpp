@@ -45,12 +45,15 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #endif
 
 #include <fstream>
+#include <map>
+#include <vector>
+#include <algorithm>
 
 static nServerInfo*          sn_masterList  = NULL;
 static nServerInfo*          sn_FirstServer = NULL;
 static sn_ServerInfoCreator* sn_Creator     = NULL;
 
-static nServerInfo*          sn_Transmitting[MAXCLIENTS+2];
+static bool                  sn_Transmitting[MAXCLIENTS+2];
 static unsigned int          sn_LastKnown   [MAXCLIENTS+2];
 static bool                  sn_SendAll     [MAXCLIENTS+2];
 static bool                  sn_Requested   [MAXCLIENTS+2];
@@ -61,6 +64,9 @@ static bool                  sn_Auth        [MAXCLIENTS+2];
 #endif
 
 static nServerInfo*          sn_Requesting=NULL;
+static const int             sn_masterBatchSize = 1400; // bytes of server list the master queues per client and step, about one MTU
+static bool                  sn_masterListChanged = false; // the master's server list needs to be saved
+static const REAL            sn_masterSaveDelay = 1;    // seconds the master may wait before saving a changed server list
 static unsigned int          sn_NextTransactionNr = 0;
 
 static bool sn_AcceptingFromBroadcast = false;
@@ -98,13 +104,390 @@ static int sn_MaxTNATotal()
     return sn_IsMaster ? 300 : 50;
 }
 
-static tList<nServerInfo>	sn_Polling;
+static bool sn_queryReport = false;	// report the throughput of each query run
+static tSettingItem< bool > sn_queryReportConf( "BROWSER_QUERY_REPORT", sn_queryReport );
+
+// the queries that are underway, and how many there may be at once. The
+// window grows by one per answer until the first loss, then by about one per
+// round trip. If more than a tenth of the queries to servers that answered
+// before time out within a round trip, it is halved; single servers going
+// down don't count as congestion. Timeouts follow the measured round trip time.
+class nQueryEngine
+{
+public:
+    nQueryEngine();
+
+    void StartRun();                                    //!< forgets all queries and resets the statistics for a run over the whole list
+    void ReportRun();                                   //!< prints the statistics of the finished run
+
+    void Add( nServerInfo * server, int & pollID );     //!< registers a query sent to the server
+    void Remove( int & pollID );                        //!< forgets about the query without drawing conclusions
+    void Answered( int & pollID );                      //!< the server answered the query
+    void Expire( REAL time );                           //!< gives up on queries older than the timeout
+
+    bool CanSend( int simultaneous );                   //!< whether the window allows another query; never more than simultaneous
+    int Len() const { return slots_.size(); }
+    REAL Timeout() const;                               //!< the current query timeout
+private:
+    struct Slot
+    {
+        nServerInfo * server;   //!< the queried server
+        int * pollID;           //!< where the server keeps its slot index
+        REAL sent;              //!< time the query was sent
+        bool answeredBefore;    //!< whether the server answered recently, so losing the query means congestion
+    };
+
+    std::vector< Slot > slots_;
+
+    REAL window_;               //!< number of queries allowed in flight
+    REAL threshold_;            //!< window size where fast growth ends
+    REAL rtt_;                  //!< smoothed round trip time
+    REAL rttVariation_;         //!< smoothed round trip time variation
+
+    REAL periodStart_;          //!< start of the current loss measurement period
+    int periodAnswered_;        //!< queries answered in the period
+    int periodLost_;            //!< queries to servers that answered before that timed out in the period
+
+    REAL runStart_;             //!< statistics of the current run
+    int sent_, answered_, lost_;
+};
+
+static nQueryEngine sn_Polling;
+
+nQueryEngine::nQueryEngine()
+        : window_( 4 ), threshold_( 1E+10 ), rtt_( 0 ), rttVariation_( 0 ),
+        periodStart_( 0 ), periodAnswered_( 0 ), periodLost_( 0 ),
+        runStart_( 0 ), sent_( 0 ), answered_( 0 ), lost_( 0 )
+{
+}
+
+void nQueryEngine::StartRun()
+{
+    while ( slots_.size() > 0 )
+        Remove( *slots_.back().pollID );
+
+    runStart_ = tSysTimeFloat();
+    sent_ = answered_ = lost_ = 0;
+}
+
+void nQueryEngine::ReportRun()
+{
+    REAL duration = tSysTimeFloat() - runStart_;
+
+    tOutput o;
+    o.SetTemplateParameter(1, answered_);
+    o.SetTemplateParameter(2, sent_);
+    o.SetTemplateParameter(3, duration);
+    o.SetTemplateParameter(4, duration > 0 ? answered_ / duration : 0 );
+    o.SetTemplateParameter(5, lost_);
+    o.SetTemplateParameter(6, int( window_ ) );
+    o.SetTemplateParameter(7, int( rtt_ * 1000 ) );
+    o << "$network_browser_query_report";
+    con << o;
+}
+
+void nQueryEngine::Add( nServerInfo * server, int & pollID )
+{
+    if ( pollID >= 0 )
+        return;
+
+    Slot slot;
+    slot.server = server;
+    slot.pollID = &pollID;
+    slot.sent = tSysTimeFloat();
+    // only the first query of a run to a server that answered last time; retries
+    // go to servers that already failed to answer (the query counts towards that only later)
+    slot.answeredBefore = server->TimesNotAnswered() == 0;
+
+    pollID = slots_.size();
+    slots_.push_back( slot );
+    ++sent_;
+}
+
+void nQueryEngine::Remove( int & pollID )
+{
+    if ( pollID < 0 )
+        return;
+
+    // move the last slot into the gap
+    Slot & gap = slots_[ pollID ];
+    gap = slots_.back();
+    *gap.pollID = pollID;
+    slots_.pop_back();
+
+    pollID = -1;
+}
+
+void nQueryEngine::Answered( int & pollID )
+{
+    if ( pollID < 0 )
+        return;
+
+    // update the round trip time estimate
+    REAL rtt = tSysTimeFloat() - slots_[ pollID ].sent;
+    if ( rtt_ <= 0 )
+    {
+        rtt_ = rtt;
+        rttVariation_ = rtt * .5f;
+    }
+    else
+    {
+        rttVariation_ += ( fabs( rtt - rtt_ ) - rttVariation_ ) * .25f;
+        rtt_ += ( rtt - rtt_ ) * .125f;
+    }
+
+    // open the window
+    if ( window_ < threshold_ )
+        window_ += 1;
+    else
+        window_ += 1 / window_;
+
+    ++answered_;
+    ++periodAnswered_;
+    Remove( pollID );
+}
+
+void nQueryEngine::Expire( REAL time )
+{
+    REAL timeout = Timeout();
+    for ( int i = slots_.size()-1; i >= 0; --i )
+    {
+        Slot & slot = slots_[i];
+        if ( slot.sent + timeout >= time )
+            continue;
+
+        // a server that answered before not answering now hints at congestion
+        if ( slot.answeredBefore )
+        {
+            ++lost_;
+            ++periodLost_;
+        }
+
+        Remove( *slot.pollID );
+    }
+
+    // once per round trip, shrink the window if too many queries got lost
+    if ( time > periodStart_ + rtt_ + sn_queryDelayGlobal )
+    {
+        if ( periodLost_ * 10 > periodLost_ + periodAnswered_ )
+        {
+            threshold_ = window_ = window_ > 2 ? window_ * .5f : 1;
+        }
+
+        periodStart_ = time;
+        periodAnswered_ = periodLost_ = 0;
+    }
+}
+
+bool nQueryEngine::CanSend( int simultaneous )
+{
+    if ( window_ > simultaneous )
+        window_ = simultaneous;
+
+    return Len() < int( window_ ) || Len() == 0;
+}
+
+REAL nQueryEngine::Timeout() const
+{
+    // no measurements yet: stick to the configured delay
+    if ( rtt_ <= 0 )
+        return sn_queryDelay;
+
+    // queries are only checked every sn_queryDelayGlobal seconds
+    REAL timeout = rtt_ + 4 * rttVariation_ + sn_queryDelayGlobal;
+    if ( timeout > sn_queryDelay )
+        timeout = sn_queryDelay;
+
+    return timeout;
+}
 
 static tString sn_LastLoaded;  // stores the filename of the last loaded server list
 
+// index over the server list: servers by connection name, by network address
+// and in transaction number order. The master keeps one for its whole list so
+// lookups and "everything newer than X" don't need to walk the list.
+class nServerRegistry
+{
+public:
+    //! position in transaction order: age of the transaction number, then order of registration
+    typedef std::pair< unsigned int, unsigned int > Key;
+
+    nServerRegistry(): active_( false ), base_( 0 ), count_( 0 ){}
+    ~nServerRegistry(){ active_ = false; }
+
+    bool Active() const { return active_; }
+
+    void Build( unsigned int newest );                      //!< indexes the current server list; transaction numbers up to newest are considered in the past
+    void Clear();                                           //!< empties and deactivates the index
+
+    void Update( nServerInfo * server );                    //!< (re)indexes a server whose name, address or transaction number may have changed
+    void Remove( nServerInfo const * server );              //!< removes a server from the index
+
+    nServerInfo * FindByName( nServerInfoBase const & info, int maxSameName ) const; //!< finds a server by connection name and port, or any with the same name if there are more than maxSameName of them
+    nServerInfo * Find( nServerInfoBase const & info ) const;       //!< finds a server by network address
+    nServerInfo * Newest( nServerInfo const * except ) const;       //!< returns the server with the newest transaction number
+
+    Key Position( unsigned int transactionNr ) const;       //!< returns the cursor from which Next() returns the servers newer than the given transaction
+    static Key Start(){ return Key( 0, 0 ); }               //!< returns the cursor from which Next() returns all servers
+    nServerInfo * Next( Key & cursor ) const;               //!< returns the server after the cursor and moves the cursor to it
+private:
+    typedef std::pair< unsigned int, unsigned int > Address;
+    typedef std::multimap< std::string, nServerInfo * > NameMap;
+    typedef std::multimap< Address, nServerInfo * > AddressMap;
+    typedef std::map< Key, nServerInfo * > TransactionMap;
+
+    struct Entry
+    {
+        NameMap::iterator name;
+        AddressMap::iterator address;
+        TransactionMap::iterator position;
+    };
+
+    static std::string NameKey( nServerInfoBase const & info );
+    static Address AddressKey( nServerInfoBase const & info );
+
+    bool active_;
+    unsigned int base_;     //!< transaction numbers are ordered by their distance from this one
+    unsigned int count_;    //!< number of registrations so far
+
+    std::map< nServerInfo const *, Entry > entries_;
+    NameMap byName_;
+    AddressMap byAddress_;
+    TransactionMap byTransaction_;
+};
+
+static nServerRegistry sn_registry;
+
+static nServerRegistry::Key sn_TransmitCursor[MAXCLIENTS+2];
+
+// starts sending the server list to a client of the master
+static void sn_StartTransmission( int user )
+{
+    sn_Transmitting  [user] = true;
+    sn_TransmitCursor[user] = sn_SendAll[user] ? nServerRegistry::Start() : sn_registry.Position( sn_LastKnown[user] );
+}
+
+std::string nServerRegistry::NameKey( nServerInfoBase const & info )
+{
+    return std::string( static_cast< char const * >( info.GetConnectionName() ) );
+}
+
+nServerRegistry::Address nServerRegistry::AddressKey( nServerInfoBase const & info )
+{
+    struct sockaddr_in const * address = reinterpret_cast< struct sockaddr_in const * >( static_cast< struct sockaddr const * >( info.GetAddress() ) );
+    return Address( address->sin_addr.s_addr, ( address->sin_family << 16 ) | address->sin_port );
+}
+
+void nServerRegistry::Build( unsigned int newest )
+{
+    Clear();
+
+    active_ = true;
+    base_ = newest + 0x80000000u + 1;
+
+    for ( nServerInfo * run = nServerInfo::GetFirstServer(); run; run = run->Next() )
+        Update( run );
+}
+
+void nServerRegistry::Clear()
+{
+    entries_.clear();
+    byName_.clear();
+    byAddress_.clear();
+    byTransaction_.clear();
+    active_ = false;
+}
+
+void nServerRegistry::Update( nServerInfo * server )
+{
+    if ( !active_ )
+        return;
+
+    std::string name = NameKey( *server );
+    Address address = AddressKey( *server );
+    unsigned int age = server->TransactionNr() - base_;
+
+    // keep the entry, and with it the place in transaction order, if nothing changed
+    std::map< nServerInfo const *, Entry >::iterator found = entries_.find( server );
+    if ( found != entries_.end() &&
+            found->second.name->first == name &&
+            found->second.address->first == address &&
+            found->second.position->first.first == age )
+        return;
+
+    Remove( server );
+
+    Entry & entry = entries_[ server ];
+    entry.name = byName_.insert( NameMap::value_type( name, server ) );
+    entry.address = byAddress_.insert( AddressMap::value_type( address, server ) );
+    entry.position = byTransaction_.insert( TransactionMap::value_type( Key( age, ++count_ ), server ) ).first;
+}
+
+void nServerRegistry::Remove( nServerInfo const * server )
+{
+    if ( !active_ )
+        return;
+
+    std::map< nServerInfo const *, Entry >::iterator found = entries_.find( server );
+    if ( found == entries_.end() )
+        return;
+
+    byName_.erase( found->second.name );
+    byAddress_.erase( found->second.address );
+    byTransaction_.erase( found->second.position );
+    entries_.erase( found );
+}
+
+nServerInfo * nServerRegistry::FindByName( nServerInfoBase const & info, int maxSameName ) const
+{
+    std::pair< NameMap::const_iterator, NameMap::const_iterator > range = byName_.equal_range( NameKey( info ) );
+
+    int countSameName = 0;
+    for ( NameMap::const_iterator run = range.first; run != range.second; ++run )
+    {
+        if ( countSameName++ > maxSameName || run->second->GetPort() == info.GetPort() )
+            return run->second;
+    }
+
+    return NULL;
+}
+
+nServerInfo * nServerRegistry::Find( nServerInfoBase const & info ) const
+{
+    AddressMap::const_iterator found = byAddress_.find( AddressKey( info ) );
+    if ( found != byAddress_.end() )
+        return found->second;
+
+    return NULL;
+}
+
+nServerInfo * nServerRegistry::Newest( nServerInfo const * except ) const
+{
+    for ( TransactionMap::const_reverse_iterator run = byTransaction_.rbegin(); run != byTransaction_.rend(); ++run )
+        if ( run->second != except )
+            return run->second;
+
+    return NULL;
+}
+
+nServerRegistry::Key nServerRegistry::Position( unsigned int transactionNr ) const
+{
+    return Key( transactionNr - base_, 0xFFFFFFFFu );
+}
+
+nServerInfo * nServerRegistry::Next( Key & cursor ) const
+{
+    TransactionMap::const_iterator next = byTransaction_.upper_bound( cursor );
+    if ( next == byTransaction_.end() )
+        return NULL;
+
+    cursor = next->first;
+    return next->second;
+}
+
 // make sure every new client gets a new server list
 static void login_callback(){
-    sn_Transmitting[nCallbackLoginLogout::User()] = NULL;
+    sn_Transmitting[nCallbackLoginLogout::User()] = false;
     sn_LastKnown   [nCallbackLoginLogout::User()] = 0;
     sn_SendAll     [nCallbackLoginLogout::User()] = true;
     sn_Requested   [nCallbackLoginLogout::User()] = false;
@@ -132,7 +515,7 @@ void ResultCallback(const tString& username,
     if (success)
     {
         sn_Auth[user] = true;
-        sn_Transmitting[user] = nServerInfo::GetFirstServer();
+        sn_StartTransmission( user );
     }
     else
         nAuthentication::RequestLogin(username, user, tOutput("$login_request_failed"), true);
@@ -183,11 +566,9 @@ nServerInfo::nServerInfo()
 
 nServerInfo::~nServerInfo()
 {
-    sn_Polling.Remove(this, pollID);
+    sn_Polling.Remove(pollID);
 
-    for (int i = MAXCLIENTS+1; i>=0; i--)
-        if (sn_Transmitting[i] == this)
-            sn_Transmitting[i] = sn_Transmitting[i]->Next();
+    sn_registry.Remove( this );
 
     if (sn_Requesting == this)
         sn_Requesting = sn_Requesting->Next();
@@ -409,60 +790,53 @@ nServerInfo *nServerInfo::Prev()
 // Sort server list
 void nServerInfo::Sort( PrimaryKey key )
 {
-    // insertion sort
-    nServerInfo *run = GetFirstServer();
-    while (run)
+    // what the comparison needs to know about a server, gathered once per sort
+    struct Entry
     {
-        nServerInfo* ascend = run;
-        run = run->Next();
-
-        while (1)
-        {
-            if ( ascend == GetFirstServer() )
-                break;
+        nServerInfo * server;
+        tString name;
+        bool polling;
+        bool unreachable;
+    };
 
-            nServerInfo *prev = ascend->Prev();
-
-
-            // check if ascend is well in place
-            if (!prev)
-                break;
+    // orders the servers; stable, so servers that compare equal keep their order
+    struct Before
+    {
+        PrimaryKey key;
 
+        bool operator()( Entry const * ascend, Entry const * prev ) const
+        {
             //	  if (prev->queried > ascend->queried)
             //	    break;
             int compare = 0;
-            bool previousPolling = prev->Polling();
-            bool previousUnreachable  = !prev->Reachable() && !previousPolling;
-            bool ascendPolling = ascend->Polling();
-            bool ascendUnreachable  = !ascend->Reachable() && !ascendPolling;
 
             switch ( key )
             {
 
             case KEY_NAME:
                 // Unreachable servers should be displayed at the end of the list
-                if ( !previousUnreachable && !ascendUnreachable ) {
-                    compare = tColoredString::RemoveColors(prev->name).Compare( tColoredString::RemoveColors(ascend->name), true );
+                if ( !prev->unreachable && !ascend->unreachable ) {
+                    compare = prev->name.Compare( ascend->name, true );
                 }
 
                 break;
             case KEY_PING:
-                if ( ascend->ping > prev->ping )
+                if ( ascend->server->ping > prev->server->ping )
                     compare = -1;
-                else if ( ascend->ping < prev->ping )
+                else if ( ascend->server->ping < prev->server->ping )
                     compare = 1;
                 break;
             case KEY_USERS:
-                compare = ascend->users - prev->users;
+                compare = ascend->server->users - prev->server->users;
                 break;
             case KEY_SCORE:
-                if ( previousUnreachable )
+                if ( prev->unreachable )
                     compare ++;
-                if ( ascendUnreachable )
+                if ( ascend->unreachable )
                     compare --;
-                if ( ascend->score > prev->score )
+                if ( ascend->server->score > prev->server->score )
                     compare = 1;
-                else if ( ascend->score < prev->score )
+                else if ( ascend->server->score < prev->server->score )
                     compare = -1;
                 break;
             case KEY_MAX:
@@ -471,19 +845,39 @@ void nServerInfo::Sort( PrimaryKey key )
 
             if (0 == compare)
             {
-                if ( previousPolling )
+                if ( prev->polling )
                     compare++;
-                if ( ascendPolling )
+                if ( ascend->polling )
                     compare--;
             }
 
-            if ( compare <= 0 )
-                break;
-
-            prev->Remove();
-            prev->Insert( ascend->next );
+            return compare > 0;
         }
+    };
+
+    std::vector< Entry > entries;
+    for ( nServerInfo *run = GetFirstServer(); run; run = run->Next() )
+    {
+        Entry entry;
+        entry.server = run;
+        if ( key == KEY_NAME )
+            entry.name = tColoredString::RemoveColors( run->name );
+        entry.polling = run->Polling();
+        entry.unreachable = !run->Reachable() && !entry.polling;
+        entries.push_back( entry );
     }
+
+    std::vector< Entry * > order;
+    for ( std::vector< Entry >::iterator run = entries.begin(); run != entries.end(); ++run )
+        order.push_back( &*run );
+
+    Before before;
+    before.key = key;
+    std::stable_sort( order.begin(), order.end(), before );
+
+    // relink the list in the new order
+    for ( int i = order.size()-1; i >= 0; --i )
+        order[i]->server->Insert( sn_FirstServer );
 }
 
 void nServerInfo::CalcScoreAll()        // calculate the score for all servers
@@ -568,20 +962,13 @@ std::ostream & operator << ( std::ostream & s, nServerInfo const & info )
     return s;
 }
 
-// checks whether server is in list twice, deletes it if that's the case
-static void CheckDuplicate( nServerInfo * server )
+// checks whether server is in list twice, deletes it if that's the case. known indexes the list.
+static void CheckDuplicate( nServerInfo * server, nServerRegistry & known )
 {
     // remove double servers
-    bool IsDouble = 0;
-    nServerInfo *run = nServerInfo::GetFirstServer();
-    while(!IsDouble && run)
-    {
-        if (run != server && *run == *server )
-            IsDouble = true;
-        
-        run = run->Next();
-    }
-    
+    nServerInfo * other = known.Find( *server );
+    bool IsDouble = other && other != server && other->GetPort() == server->GetPort();
+
     if (IsDouble)
     {
 #ifdef DEBUG
@@ -589,12 +976,21 @@ static void CheckDuplicate( nServerInfo * server )
 #endif  
         delete server;
     }
+    else
+    {
+        known.Update( server );
+        sn_registry.Update( server );
+    }
 }
 
 void nServerInfo::Load(const tPath& path, const char *filename)
 {
     sn_LastLoaded = filename;
 
+    // index of the servers already in the list, for duplicate checks
+    nServerRegistry known;
+    known.Build( sn_NextTransactionNr );
+
     // read server info from archive
     static char const * section = "SERVERINFO";
     static char const * sectionEnd = "SERVERINFOEND";
@@ -608,7 +1004,7 @@ void nServerInfo::Load(const tPath& path, const char *filename)
 
             tRecorder::Record( section, *server );
 
-            CheckDuplicate( server );
+            CheckDuplicate( server, known );
 
             server = CreateServerInfo();
         }
@@ -639,7 +1035,7 @@ void nServerInfo::Load(const tPath& path, const char *filename)
             // preemptively resolve DNS
             server->GetAddress();
 
-            CheckDuplicate( server );
+            CheckDuplicate( server, known );
         }
         else
             break;
@@ -819,6 +1215,8 @@ void nServerInfo::Alive()
         transactionNr = sn_NextTransactionNr++;
         if (!sn_NextTransactionNr)
             sn_NextTransactionNr++;
+
+        sn_registry.Update( this );
     }
 }
 
@@ -1037,19 +1435,26 @@ void nServerInfo::GetSmallServerInfo(nMessage &m){
     nServerInfo *n = NULL;
 
     // check if we already have that server lised
-    nServerInfo *run = GetFirstServer();
-    int countSameAdr = 0;
-    while(run && !n)
+    if ( sn_registry.Active() )
     {
-        if ( run->GetConnectionName() == baseInfo.GetConnectionName() )
+        n = sn_registry.FindByName( baseInfo, 32 );
+    }
+    else
+    {
+        nServerInfo *run = GetFirstServer();
+        int countSameAdr = 0;
+        while(run && !n)
         {
-            if (countSameAdr++ > 32)
-                n = run;
+            if ( run->GetConnectionName() == baseInfo.GetConnectionName() )
+            {
+                if (countSameAdr++ > 32)
+                    n = run;
 
-            if ( run->GetPort() == baseInfo.GetPort() )
-                n = run;
+                if ( run->GetPort() == baseInfo.GetPort() )
+                    n = run;
+            }
+            run = run->Next();
         }
-        run = run->Next();
     }
 
     if (m.End())
@@ -1058,12 +1463,19 @@ void nServerInfo::GetSmallServerInfo(nMessage &m){
     // second pass, look harder if no match was found. Use DNS lookup if you have to.
     if(!n)
     {
-        run = GetFirstServer();
-        while(run && !n)
+        if ( sn_registry.Active() )
         {
-            if( run->GetAddress() == baseInfo.GetAddress() )
-                n = run;
-            run = run->Next();
+            n = sn_registry.Find( baseInfo );
+        }
+        else
+        {
+            nServerInfo *run = GetFirstServer();
+            while(run && !n)
+            {
+                if( run->GetAddress() == baseInfo.GetAddress() )
+                    n = run;
+                run = run->Next();
+            }
         }
     }
 
@@ -1122,9 +1534,12 @@ void nServerInfo::GetSmallServerInfo(nMessage &m){
         m >> dummy;
     }
 
+    sn_registry.Update( n );
+
+    // the master saves the list soon, together with other changes
     if (sn_IsMaster)
     {
-        Save();
+        sn_masterListChanged = true;
     }
 }
 
@@ -1134,6 +1549,22 @@ static bool TransIsNewer(unsigned int newTrans, unsigned int oldTrans)
     return (diff > 0);
 }
 
+// finds the server with the latest transaction number, not counting except
+static nServerInfo * sn_Latest( nServerInfo const * except = NULL )
+{
+    if ( sn_registry.Active() )
+        return sn_registry.Newest( except );
+
+    nServerInfo * best = NULL;
+    for ( nServerInfo * run = nServerInfo::GetFirstServer(); run; run = run->Next() )
+    {
+        if ( run != except && ( !best || TransIsNewer( run->TransactionNr(), best->TransactionNr() ) ) )
+            best = run;
+    }
+
+    return best;
+}
+
 void nServerInfo::GiveSmallServerInfo(nMessage &m)
 {
     // start transmitting the server list in master server mode
@@ -1142,6 +1573,19 @@ void nServerInfo::GiveSmallServerInfo(nMessage &m)
         con << "Giving server info to user " << m.SenderID() << "\n";
 
         sn_Requested[m.SenderID()] = true;
+
+        if (m.End())
+            sn_SendAll[m.SenderID()] = true;
+        else
+        {
+            sn_SendAll[m.SenderID()] = false;
+            m >> sn_LastKnown[m.SenderID()];
+        }
+
+        // give out all server info if there is a disagreement
+        // if ( static_cast< unsigned int > ( sn_NextTransactionNr - sn_lastKnown[m.SenderID] ) < 1000 )
+        sn_SendAll[m.SenderID()] = true;
+
 #ifdef KRAWALL_SERVER_LEAGUE
         // one moment! check if we need authentification
         tString adr;
@@ -1154,24 +1598,12 @@ void nServerInfo::GiveSmallServerInfo(nMessage &m)
         }
         else
         {
-            sn_Transmitting[m.SenderID()] = GetFirstServer();
+            sn_StartTransmission( m.SenderID() );
             sn_Auth[m.SenderID()]         = true;
         }
 #else
-        sn_Transmitting[m.SenderID()] = GetFirstServer();
+        sn_StartTransmission( m.SenderID() );
 #endif
-
-        if (m.End())
-            sn_SendAll[m.SenderID()] = true;
-        else
-        {
-            sn_SendAll[m.SenderID()] = false;
-            m >> sn_LastKnown[m.SenderID()];
-        }
-
-        // give out all server info if there is a disagreement
-        // if ( static_cast< unsigned int > ( sn_NextTransactionNr - sn_lastKnown[m.SenderID] ) < 1000 )
-        sn_SendAll[m.SenderID()] = true;
     }
 
     else
@@ -1223,9 +1655,17 @@ nServerInfo* nServerInfo::GetBigServerInfoCommon(nMessage &m)
     baseInfo.NetRead( m );
 
     // find the server
-    nServerInfo *server = GetFirstServer();
-    while( server && *server != baseInfo )
-        server = server->Next();
+    nServerInfo *server = NULL;
+    if ( sn_registry.Active() )
+    {
+        server = sn_registry.Find( baseInfo );
+    }
+    else
+    {
+        server = GetFirstServer();
+        while( server && *server != baseInfo )
+            server = server->Next();
+    }
 
     if ( server )
     {
@@ -1500,18 +1940,8 @@ void nServerInfo::GetFromMaster(nServerInfoBase *masterInfo, char const * fileSu
 
     // find the latest server we know about
     unsigned int latest=0;
-    nServerInfo *run = GetFirstServer();
-    if (run)
-    {
-        latest = run->TransactionNr();
-        run = run->Next();
-        while (run)
-        {
-            if (TransIsNewer(run->TransactionNr(), latest))
-                latest = run->TransactionNr();
-            run = run->Next();
-        }
-    }
+    if ( sn_Latest() )
+        latest = sn_Latest()->TransactionNr();
 
     // connect to the master server
     con << tOutput("$network_master_connecting", masterInfo->GetName() );
@@ -1590,7 +2020,7 @@ void nServerInfo::GetFromMaster(nServerInfoBase *masterInfo, char const * fileSu
     con << o;
 
     // remove servers that are no longer listed on the master
-    run = GetFirstServer();
+    nServerInfo *run = GetFirstServer();
     while (run)
     {
         nServerInfo * next = run->Next();
@@ -1859,38 +2289,19 @@ void nServerInfo::QueryServer()                                  // start to get
         // server was inactive too long. Delete it if possible.
 
         // check if this server is the one with the highest TAN
-        unsigned int latest=0;
-        nServerInfo *run = GetFirstServer();
-        nServerInfo *best = NULL;
-        while (run == this)
-            run = run->Next();
-
-        if (run)
-        {
-            latest  = run->TransactionNr();
-            best    = run;
-            run     = run->Next();
-
-            while (run)
-            {
-                if ((run != this) && TransIsNewer(run->TransactionNr(), latest))
-                {
-                    latest = run->TransactionNr();
-                    best   = run;
-                }
-                run = run->Next();
-            }
-        }
+        nServerInfo *best = sn_Latest( this );
 
-        // now, best points to the latest (except this) server and
-        // latest is its TAN.
+        // now, best points to the latest (except this) server.
 
         // continue if this server is the only one available
         if (best)
         {
             // if THIS server has the latest TAN, simpy transfer it to the second latest.
-            if (TransIsNewer(TransactionNr(), latest))
+            if (TransIsNewer(TransactionNr(), best->TransactionNr()))
+            {
                 best->transactionNr = TransactionNr();
+                sn_registry.Update( best );
+            }
 
             timesNotAnswered = 1000;
             if ( sn_IsMaster )
@@ -1976,8 +2387,7 @@ void nServerInfo::StartQueryAll( QueryType queryType )                         /
     Sort(KEY_SCORE);
     sn_Requesting     = GetFirstServer();
 
-    while (sn_Polling.Len())
-        sn_Polling.Remove(sn_Polling(0), sn_Polling(0)->pollID);
+    sn_Polling.StartRun();
 
     nServerInfo *run = GetFirstServer();
 
@@ -2082,14 +2492,12 @@ bool nServerInfo::DoQueryAll(int simultaneous)         // continue querying the
 
     globalTimeout = time + sn_queryDelayGlobal;
 
-    for (int i=sn_Polling.Len()-1; i>=0; i--)
-    {
-        nServerInfo* poll = sn_Polling(i);
-        if (poll->timeQuerySent + sn_queryDelay < time)
-            sn_Polling.Remove(poll, poll->pollID);
-    }
+    // take in the answers that arrived before giving up on queries
+    sn_Receive();
+    sn_Polling.Expire( time );
 
-    if (sn_Requesting && sn_Polling.Len() < simultaneous)
+    // send as many queries as the window allows
+    while (sn_Requesting && sn_Polling.CanSend( simultaneous ))
     {
         nServerInfo* next = sn_Requesting->Next();
 
@@ -2132,7 +2540,11 @@ bool nServerInfo::DoQueryAll(int simultaneous)         // continue querying the
             Save();
         }
         else
+        {
+            if ( sn_queryReport )
+                sn_Polling.ReportRun();
             Save();
+        }
 
         return ret;
     }
@@ -2190,18 +2602,8 @@ void nServerInfo::RunMaster()
         // find the latest server we know about
     {
         unsigned int latest=0;
-        nServerInfo *run = GetFirstServer();
-        if (run)
-        {
-            latest = run->TransactionNr();
-            run = run->Next();
-            while (run)
-            {
-                if (TransIsNewer(run->TransactionNr(), latest))
-                    latest = run->TransactionNr();
-                run = run->Next();
-            }
-        }
+        if ( sn_Latest() )
+            latest = sn_Latest()->TransactionNr();
 
         latest++;
         if (latest == 0)
@@ -2216,7 +2618,23 @@ void nServerInfo::RunMaster()
         sn_NextTransactionNr = rand();
     }
 
-    for (int i=MAXCLIENTS; i>0; i--)
+    // index the server list
+    if ( !sn_registry.Active() )
+    {
+        sn_registry.Build( sn_NextTransactionNr - 1 );
+    }
+
+    // save changes to the server list, but not more often than every sn_masterSaveDelay seconds
+    static nTimeRolling nextSave = 0;
+    if ( sn_masterListChanged && time >= nextSave )
+    {
+        sn_masterListChanged = false;
+        nextSave = time + sn_masterSaveDelay;
+        Save();
+    }
+
+    // (kicking changes the list)
+    for (int i = sn_NextActiveUser(MAXCLIENTS+1); i > 0; i = sn_NextActiveUser(i))
     {
         if(sn_Connections[i].socket)
         {
@@ -2242,29 +2660,26 @@ void nServerInfo::RunMaster()
 
         if (sn_Transmitting[i] && sn_MessagesPending(i) < 3)
         {
-
-            for (int j = 10-sn_MessagesPending(i); j>=0 && sn_Transmitting[i]; j--)
+            // queue about a packet's worth of servers; the cursor already skips the ones the user knows
+            int size = 0;
+            while ( size < sn_masterBatchSize )
             {
-                // skip known servers
-                if (!sn_SendAll[i])
+                nServerInfo * server = sn_registry.Next( sn_TransmitCursor[i] );
+                if ( !server )
                 {
-                    while (sn_Transmitting[i] && !TransIsNewer(sn_Transmitting[i]->TransactionNr(), sn_LastKnown[i]))
-                        sn_Transmitting[i] = sn_Transmitting[i]->Next();
+                    sn_Transmitting[i] = false;
+                    break;
                 }
 
-                if (!sn_Transmitting[i])
-                    continue;
-
-                if (sn_Transmitting[i]->TimesNotAnswered() < sn_TNALostContact )
+                if (server->TimesNotAnswered() < sn_TNALostContact )
                 {
-                    // tell user i about server sn_Transmitting[i]
+                    // tell user i about the server
                     nMessage *m = tNEW(nMessage)(SmallServerDescriptor);
-                    sn_Transmitting[i]->nServerInfoBase::NetWriteThis( *m );
-                    *m << sn_Transmitting[i]->TransactionNr();
+                    server->nServerInfoBase::NetWriteThis( *m );
+                    *m << server->TransactionNr();
+                    size += 2 * ( m->DataLen() + 3 );
                     m->Send(i);
                 }
-
-                sn_Transmitting[i] = sn_Transmitting[i]->Next();
             }
         }
 
@@ -2333,6 +2748,7 @@ nServerInfo *nServerInfo::GetMasters()
         while ( sn_FirstServer )
         {
             nServerInfo * server = sn_FirstServer;
+            sn_registry.Remove( server );
             server->Remove();
             server->Insert( sn_masterList );
         }
@@ -2932,7 +3348,7 @@ void nServerInfo::NetReadThis( nMessage & m )
     queried = 0;
 
     //  queried = true;
-    sn_Polling.Remove(this, pollID);
+    sn_Polling.Answered(pollID);
 }
 
 // *******************************************************************************************
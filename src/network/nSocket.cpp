@@ -94,6 +94,15 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include <sys/filio.h>
 #endif
 
+// Linux offers epoll for readiness notification and recvmmsg/sendmmsg
+// to transfer many datagrams with one system call
+#if defined(__linux__) && !defined(WIN32)
+#define HAVE_BATCH_IO
+#include <sys/epoll.h>
+#include <sys/uio.h>
+#include <math.h>
+#endif
+
 #ifdef NeXT
 #include <libc.h>
 #endif
@@ -248,9 +257,67 @@ typedef socklen_t NET_SIZE;
 typedef int NET_SIZE;
 #endif
 
+// sorts an error code from the OS into what the caller should do about it
+static nSocketError sn_ClassifyError( int error )
+{
+    nSocketError aError = nSocketError_Ignore;
+
+    switch ( error )
+    {
+    case EADDRINUSE:
+        break;
+    case ENOTSOCK:
+        aError = nSocketError_Reset;
+        break;
+    case ECONNRESET:
+        aError = nSocketError_Reset;
+        break;
+    case ECONNREFUSED:
+        break;
+    case EWOULDBLOCK:
+    case ENETUNREACH:
+        aError = nSocketError_Ignore;
+        break;
+        //		case NOTINITIALISED:
+        //			break;
+    case ENETDOWN:
+        break;
+    case EFAULT:
+        aError = nSocketError_Reset;
+        break;
+    case EINTR:
+        break;
+    case EINVAL:
+        break;
+    case EISCONN:
+        break;
+    case ENETRESET:
+        break;
+    case EOPNOTSUPP:
+    case EAFNOSUPPORT:
+    case EADDRNOTAVAIL:
+        aError = nSocketError_Reset;
+        break;
+    case ESHUTDOWN:
+        break;
+#ifndef WIN32
+    case EMSGSIZE:
+        break;
+#endif
+    case ETIMEDOUT:
+        break;
+    default:
+#ifdef DEBUG
+        con << "Unknown network error " << error << "\n";
+#endif
+        break;
+    }
+
+    return aError;
+}
+
 static nSocketError ANET_Error()
 {
-    int error = 0;
     nSocketError aError = nSocketError_Ignore;
 
     // play back error message
@@ -259,60 +326,10 @@ static nSocketError ANET_Error()
     {
         // get error from OS
 #ifdef WIN32
-        error = WSAGetLastError();
+        aError = sn_ClassifyError( WSAGetLastError() );
 #else
-        error = errno;
+        aError = sn_ClassifyError( errno );
 #endif
-        switch ( error )
-        {
-        case EADDRINUSE:
-            break;
-        case ENOTSOCK:
-            aError = nSocketError_Reset;
-            break;
-        case ECONNRESET:
-            aError = nSocketError_Reset;
-            break;
-        case ECONNREFUSED:
-            break;
-        case EWOULDBLOCK:
-        case ENETUNREACH:
-            aError = nSocketError_Ignore;
-            break;
-            //		case NOTINITIALISED:
-            //			break;
-        case ENETDOWN:
-            break;
-        case EFAULT:
-            aError = nSocketError_Reset;
-            break;
-        case EINTR:
-            break;
-        case EINVAL:
-            break;
-        case EISCONN:
-            break;
-        case ENETRESET:
-            break;
-        case EOPNOTSUPP:
-        case EAFNOSUPPORT:
-        case EADDRNOTAVAIL:
-            aError = nSocketError_Reset;
-            break;
-        case ESHUTDOWN:
-            break;
-    #ifndef WIN32
-        case EMSGSIZE:
-            break;
-    #endif
-        case ETIMEDOUT:
-            break;
-        default:
-    #ifdef DEBUG
-            con << "Unknown network error " << error << "\n";
-    #endif
-            break;
-        }
     }
 
     // record error message
@@ -1470,6 +1487,72 @@ unsigned int nAddress::GetAddressLength( void ) const
 // *******************************************************************************************
 // *******************************************************************************************
 
+#ifdef HAVE_BATCH_IO
+static bool sn_batchIO = true;
+static tSettingItem<bool> sn_batchIOConf( "SOCKET_BATCH_IO", sn_batchIO );
+
+// number of datagrams transferred with one system call
+#define BATCH_SIZE 32
+
+// size of one datagram slot; larger than any buffer we read into
+#define BATCH_SLOT_SIZE 4096
+
+//! buffers for batched reading and writing of one socket
+class nSocketBatch
+{
+public:
+    nSocketBatch()
+            : recvCount( 0 ), recvNext( 0 ), sendCount( 0 )
+    {
+        memset( recvMsg, 0, sizeof( recvMsg ) );
+        memset( sendMsg, 0, sizeof( sendMsg ) );
+
+        for ( int i = BATCH_SIZE-1; i >= 0; --i )
+        {
+            recvIov[i].iov_base = recvData[i];
+            recvIov[i].iov_len  = BATCH_SLOT_SIZE;
+            recvMsg[i].msg_hdr.msg_iov     = &recvIov[i];
+            recvMsg[i].msg_hdr.msg_iovlen  = 1;
+            recvMsg[i].msg_hdr.msg_name    = &recvAddr[i];
+
+            sendIov[i].iov_base = sendData[i];
+            sendMsg[i].msg_hdr.msg_iov     = &sendIov[i];
+            sendMsg[i].msg_hdr.msg_iovlen  = 1;
+            sendMsg[i].msg_hdr.msg_name    = &sendAddr[i];
+        }
+    }
+
+    // received datagrams; recvNext is the next one to hand out
+    int8            recvData[ BATCH_SIZE ][ BATCH_SLOT_SIZE ];
+    nAddressBase    recvAddr[ BATCH_SIZE ];
+    struct iovec    recvIov [ BATCH_SIZE ];
+    struct mmsghdr  recvMsg [ BATCH_SIZE ];
+    int recvCount, recvNext;
+
+    // datagrams waiting to be sent
+    int8            sendData[ BATCH_SIZE ][ BATCH_SLOT_SIZE ];
+    nAddressBase    sendAddr[ BATCH_SIZE ];
+    struct iovec    sendIov [ BATCH_SIZE ];
+    struct mmsghdr  sendMsg [ BATCH_SIZE ];
+    int sendCount;
+};
+
+// returns whether batched IO should be used; not while recording or playing back,
+// the recording needs to see every single read and write.
+static bool sn_UseBatchIO()
+{
+    return sn_batchIO && !tRecorder::IsRunning();
+}
+#else
+class nSocketBatch{};
+#endif
+
+// incremented every time a socket gets created or closed
+static int sn_socketGeneration = 0;
+
+// sockets with data waiting in their send batch
+static std::vector< nSocket const * > sn_pendingBatches;
+
 // *******************************************************************************************
 // *
 // *	nSocket
@@ -1480,7 +1563,7 @@ unsigned int nAddress::GetAddressLength( void ) const
 // *******************************************************************************************
 
 nSocket::nSocket( void )
-        :socket_( -1 ), family_( PF_INET ), socktype_( SOCK_DGRAM ), protocol_( IPPROTO_UDP ), broadcast_( false )
+        :socket_( -1 ), family_( PF_INET ), socktype_( SOCK_DGRAM ), protocol_( IPPROTO_UDP ), broadcast_( false ), batch_( NULL )
 {
 }
 
@@ -1497,6 +1580,8 @@ nSocket::~nSocket( void )
 {
     if ( IsOpen() )
         Close();
+
+    DeleteBatch();
 }
 
 // *******************************************************************************************
@@ -1521,6 +1606,8 @@ int nSocket::Create( void )
     if ( socket_ < 0 )
         return -1;
 
+    ++sn_socketGeneration;
+
     // set TOS to low latency ( see manpages getsockopt(2), ip(7) and socket(7) )
     // maybe this works for Windows, too?
 #ifndef WIN32
@@ -1772,9 +1859,13 @@ int nSocket::Close( void )
         con << "Closing socket bound to " << trueAddress_.ToString() << "\n";
 #endif
 
+    // send what is still waiting and drop what has been received
+    DeleteBatch();
+
     ANET_CloseSocket( socket_ );
     socket_ = -1;
     broadcast_ = false;
+    ++sn_socketGeneration;
 
     return 0;
 }
@@ -1887,6 +1978,12 @@ const nSocket * nSocket::CheckNewConnection( void ) const
     if ( tRecorder::IsRunning() )
         return this;
 
+#ifdef HAVE_BATCH_IO
+    // batched reading handles errors just as well; save the system call
+    if ( sn_UseBatchIO() )
+        return this;
+#endif
+
 
 #ifdef DEBUG
     if ( sn_ResetSocket )
@@ -2003,9 +2100,16 @@ int nSocket::Read( int8 * buf, int len, nAddress & addr ) const
 #endif
 
         // really receive
-        NET_SIZE addrlen = addr.GetAddressLength();
-        ret = recvfrom (socket_, buf, len, 0, addr, &addrlen );
-        tASSERT( addrlen <= static_cast< NET_SIZE >( addr.GetAddressLength() ) );
+#ifdef HAVE_BATCH_IO
+        if ( sn_UseBatchIO() )
+            ret = ReadBatched( buf, len, addr );
+        else
+#endif
+        {
+            NET_SIZE addrlen = addr.GetAddressLength();
+            ret = recvfrom (socket_, buf, len, 0, addr, &addrlen );
+            tASSERT( addrlen <= static_cast< NET_SIZE >( addr.GetAddressLength() ) );
+        }
     }
 
     // write recording
@@ -2086,7 +2190,14 @@ int nSocket::Write( const int8 * buf, int len, const sockaddr * addr, int addrle
         {
             // don't send if a playback is running
             if ( !tRecorder::IsPlayingBack() )
-                ret = sendto (socket_, buf, len, 0, addr, addrlen );
+            {
+#ifdef HAVE_BATCH_IO
+                if ( nSocketSendBatch::Active() )
+                    ret = WriteBatched( buf, len, addr, addrlen );
+                else
+#endif
+                    ret = sendto (socket_, buf, len, 0, addr, addrlen );
+            }
         }
     }
 
@@ -2136,6 +2247,274 @@ int nSocket::Write( const int8 * buf, int len, const nAddress & addr ) const
     return Write( buf, len, addr, addr.GetAddressLength() );
 }
 
+#ifdef HAVE_BATCH_IO
+
+// *******************************************************************************************
+// *
+// *	ReadBatched
+// *
+// *******************************************************************************************
+//!
+//!		@param	buf	    buffer to read to
+//!		@param	len	    maximum number of bytes to read
+//!		@param	addr	the address where the data came from is stored here
+//!		@return		    number of bytes truly read or something negative on failure
+//!
+// *******************************************************************************************
+
+int nSocket::ReadBatched( int8 * buf, int len, nAddress & addr ) const
+{
+    if ( !batch_ )
+        batch_ = tNEW( nSocketBatch );
+    nSocketBatch & batch = *batch_;
+
+    // fetch the next batch of datagrams from the system
+    if ( batch.recvNext >= batch.recvCount )
+    {
+        batch.recvNext = batch.recvCount = 0;
+
+        for ( int i = BATCH_SIZE-1; i >= 0; --i )
+        {
+            batch.recvMsg[i].msg_hdr.msg_namelen = sizeof( nAddressBase );
+            batch.recvMsg[i].msg_hdr.msg_flags   = 0;
+        }
+
+        int received = recvmmsg( socket_, batch.recvMsg, BATCH_SIZE, MSG_DONTWAIT, NULL );
+        if ( received <= 0 )
+        {
+            // errno is left for ANET_Error() to inspect
+            return -1;
+        }
+
+        batch.recvCount = received;
+    }
+
+    // hand out the next one
+    int slot = batch.recvNext++;
+    struct msghdr const & message = batch.recvMsg[slot].msg_hdr;
+
+    // like recvfrom, truncate to the buffer size. Datagrams that did not fit into
+    // the slot are reported as filling the buffer completely.
+    int ret = batch.recvMsg[slot].msg_len;
+    if ( message.msg_flags & MSG_TRUNC )
+        ret = BATCH_SLOT_SIZE;
+    if ( ret > len )
+        ret = len;
+    memcpy( buf, batch.recvData[slot], ret );
+
+    unsigned int addrlen = message.msg_namelen;
+    if ( addrlen > addr.GetAddressLength() )
+        addrlen = addr.GetAddressLength();
+    memcpy( static_cast< struct sockaddr * >( addr ), &batch.recvAddr[slot], addrlen );
+
+    return ret;
+}
+
+// *******************************************************************************************
+// *
+// *	WriteBatched
+// *
+// *******************************************************************************************
+//!
+//!		@param	buf	    pointer to data to send
+//!		@param	len	    length of data to send
+//!		@param	addr	address to send data to
+//!		@param	addrlen	length of address data structure
+//!		@return		    the number of bytes queued or sent or something negative on error
+//!
+// *******************************************************************************************
+
+int nSocket::WriteBatched( const int8 * buf, int len, const sockaddr * addr, int addrlen ) const
+{
+    // oversized data does not fit into a slot; send it directly.
+    if ( len > BATCH_SLOT_SIZE || addrlen > static_cast< int >( sizeof( nAddressBase ) ) )
+        return sendto (socket_, buf, len, 0, addr, addrlen );
+
+    if ( !batch_ )
+        batch_ = tNEW( nSocketBatch );
+    nSocketBatch & batch = *batch_;
+
+    if ( batch.sendCount >= BATCH_SIZE )
+        FlushBatch();
+
+    if ( batch.sendCount == 0 )
+        sn_pendingBatches.push_back( this );
+
+    // copy data and address into the next free slot
+    int slot = batch.sendCount++;
+    memcpy( batch.sendData[slot], buf, len );
+    memcpy( &batch.sendAddr[slot], addr, addrlen );
+    batch.sendIov[slot].iov_len = len;
+    batch.sendMsg[slot].msg_hdr.msg_namelen = addrlen;
+
+    return len;
+}
+
+#endif
+
+// *******************************************************************************************
+// *
+// *	FlushBatch
+// *
+// *******************************************************************************************
+//!
+//!		@return		the number of queued datagrams that could not be sent
+//!
+// *******************************************************************************************
+
+int nSocket::FlushBatch( void ) const
+{
+    int dropped = 0;
+
+#ifdef HAVE_BATCH_IO
+    if ( !batch_ || batch_->sendCount == 0 )
+        return 0;
+
+    nSocketBatch & batch = *batch_;
+    int count = batch.sendCount;
+    batch.sendCount = 0;
+
+    for ( std::vector< nSocket const * >::iterator iter = sn_pendingBatches.begin(); iter != sn_pendingBatches.end(); ++iter )
+    {
+        if ( *iter == this )
+        {
+            sn_pendingBatches.erase( iter );
+            break;
+        }
+    }
+
+    int sent = 0;
+    int error = 0;
+    bool reset = false;
+    while ( sent < count && !reset )
+    {
+        int ret = sendmmsg( socket_, batch.sendMsg + sent, count - sent, MSG_DONTWAIT );
+        if ( ret <= 0 )
+        {
+            // the first remaining datagram could not be sent; drop it like a
+            // failed single write would. The writer was already told the data
+            // went out, so the error can't go back to it, and it must not go to
+            // the recorder either: playbacks never queue writes.
+            int thisError = errno;
+            reset = ( sn_ClassifyError( thisError ) == nSocketError_Reset );
+            ret = reset ? count - sent : 1;
+            dropped += ret;
+
+            // a full send buffer drops single writes silently, too
+            if ( thisError != EWOULDBLOCK && thisError != EAGAIN )
+                error = thisError;
+        }
+        sent += ret;
+    }
+
+    // an unreachable peer fails every flush; report it once a second at most
+    static double lastReport = -1;
+    if ( error && ( lastReport < 0 || tRealSysTimeFloat() > lastReport + 1 ) )
+    {
+        lastReport = tRealSysTimeFloat();
+        con << "Could not send " << dropped << " of " << count << " queued datagrams from "
+            << trueAddress_.ToString() << ": " << strerror( error ) << "\n";
+    }
+
+    // resetting closes the socket and deletes the batch
+    if ( reset )
+        Reset();
+#endif
+
+    return dropped;
+}
+
+// *******************************************************************************************
+// *
+// *	DeleteBatch
+// *
+// *******************************************************************************************
+//!
+//!
+// *******************************************************************************************
+
+void nSocket::DeleteBatch( void )
+{
+    if ( batch_ )
+    {
+        if ( IsOpen() )
+            FlushBatch();
+
+        delete batch_;
+        batch_ = NULL;
+    }
+}
+
+// *******************************************************************************************
+// *******************************************************************************************
+// *******************************************************************************************
+
+int nSocketSendBatch::depth_ = 0;
+
+// *******************************************************************************************
+// *
+// *	nSocketSendBatch
+// *
+// *******************************************************************************************
+//!
+//!
+// *******************************************************************************************
+
+nSocketSendBatch::nSocketSendBatch( void )
+{
+    ++depth_;
+}
+
+// *******************************************************************************************
+// *
+// *	~nSocketSendBatch
+// *
+// *******************************************************************************************
+//!
+//!
+// *******************************************************************************************
+
+nSocketSendBatch::~nSocketSendBatch( void )
+{
+    if ( --depth_ == 0 )
+        Flush();
+}
+
+// *******************************************************************************************
+// *
+// *	Flush
+// *
+// *******************************************************************************************
+//!
+//!
+// *******************************************************************************************
+
+void nSocketSendBatch::Flush( void )
+{
+    // flushing removes the socket from the list
+    while ( !sn_pendingBatches.empty() )
+        sn_pendingBatches.back()->FlushBatch();
+}
+
+// *******************************************************************************************
+// *
+// *	Active
+// *
+// *******************************************************************************************
+//!
+//!		@return		true if writes should be collected
+//!
+// *******************************************************************************************
+
+bool nSocketSendBatch::Active( void )
+{
+#ifdef HAVE_BATCH_IO
+    return depth_ > 0 && sn_UseBatchIO();
+#else
+    return false;
+#endif
+}
+
 // *******************************************************************************************
 // *
 // *	Broadcast
@@ -2245,6 +2624,10 @@ void nSocket::MoveFrom( const nSocket & other )
     // close this socket
     if ( IsOpen() )
         Close();
+    DeleteBatch();
+
+    // the batch buffers stay behind, it's simpler to let the other socket send its data now
+    const_cast< nSocket & >( other ).DeleteBatch();
 
 
     // copy uncritical data
@@ -2273,6 +2656,7 @@ void nSocket::MoveFrom( const nSocket & other )
 nSocket::nSocket( const nSocket & other )
 {
     socket_ = -1;
+    batch_ = NULL;
     MoveFrom( other );
 }
 
@@ -2509,8 +2893,8 @@ nSocketListener & nSocketListener::SetIpList( tString const & ipList )
 // *******************************************************************************************
 
 nBasicNetworkSystem::nBasicNetworkSystem( void )
+        : epoll_( -1 ), epollGeneration_( -1 )
 {
-    // nothing to do
 }
 
 // *******************************************************************************************
@@ -2631,6 +3015,47 @@ bool nBasicNetworkSystem::Select( REAL dt )
             return false;
         }
 
+#ifdef HAVE_BATCH_IO
+        if ( sn_UseBatchIO() )
+        {
+            // set up the epoll instance again if sockets were opened or closed
+            if ( epoll_ < 0 || epollGeneration_ != sn_socketGeneration )
+            {
+                if ( epoll_ >= 0 )
+                    close( epoll_ );
+
+                epoll_ = epoll_create( 16 );
+                epollGeneration_ = sn_socketGeneration;
+
+                struct epoll_event event;
+                memset( &event, 0, sizeof( event ) );
+                event.events = EPOLLIN;
+
+                event.data.fd = controlSocket_.GetSocket();
+                if ( epoll_ >= 0 )
+                    epoll_ctl( epoll_, EPOLL_CTL_ADD, event.data.fd, &event );
+
+                for( nSocketListener::SocketArray::const_iterator iter = listener_.GetSockets().begin(); epoll_ >= 0 && iter != listener_.GetSockets().end(); ++iter )
+                {
+                    event.data.fd = (*iter).GetSocket();
+                    if ( event.data.fd >= 0 )
+                        epoll_ctl( epoll_, EPOLL_CTL_ADD, event.data.fd, &event );
+                }
+            }
+
+            if ( epoll_ >= 0 )
+            {
+                // we only care whether something arrived, not where
+                struct epoll_event events[16];
+                int timeout = dt > 0 ? static_cast< int >( ceil( dt * 1000 ) ) : 0;
+                retval = epoll_wait( epoll_, events, 16, timeout );
+
+                tRecorder::Record( section, retval );
+                return ( retval > 0 );
+            }
+        }
+#endif
+
         fd_set rfds; // set of sockets to wathc
         struct timeval tv; // time value to pass to select()
 
@@ -2682,6 +3107,14 @@ void nBasicNetworkSystem::Shutdown()
 
     // close the control socket
     controlSocket_.Close();
+
+#ifdef HAVE_BATCH_IO
+    if ( epoll_ >= 0 )
+    {
+        close( epoll_ );
+        epoll_ = -1;
+    }
+#endif
 }
 
 
@@ -40,6 +40,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include <vector>
 
 class nScoket;
+class nSocketBatch;
 struct nHostInfo;
 // struct addrinfo;
 struct hostentry;
@@ -170,6 +171,11 @@ private:
 
     int Write       ( const int8 *buf, int len, const sockaddr * addr, int addrlen ) const; //!< writes data to the socket
 
+    int  ReadBatched ( int8 *buf, int len, nAddress & addr )                       const; //!< reads data from the receive batch, refilling it if required
+    int  WriteBatched( const int8 *buf, int len, const sockaddr * addr, int addrlen ) const; //!< queues data in the send batch
+    int  FlushBatch  ()                                                             const; //!< sends all queued data, returns the number of datagrams dropped
+    void DeleteBatch ();                                                                   //!< flushes and deletes the batch buffers
+
     nSocket & SetAddress( nAddress const & address );  //!< Sets the address the socket is bound to
     inline nSocket & SetSocket( int socket );	       //!< Sets the raw socket
 
@@ -178,6 +184,27 @@ private:
     nAddress trueAddress_;  //!< the address the socket is really bound to
     int family_, socktype_, protocol_;    //!< more low level data determining the socket type
     mutable bool broadcast_;              //!< flag indicating whether this socket has been prepared for broadcasts
+    mutable nSocketBatch * batch_;        //!< buffers for batched sending and receiving, allocated on demand
+
+    friend class nSocketSendBatch;
+};
+
+//! while an object of this class exists, data written to sockets is collected
+//! and sent in batches (on systems that support it) when the last one goes out of scope.
+class nSocketSendBatch
+{
+public:
+    nSocketSendBatch();     //!< constructor
+    ~nSocketSendBatch();    //!< destructor, flushes all collected data
+
+    static void Flush();    //!< sends all collected data now
+    static bool Active();   //!< returns whether writes should currently be collected
+private:
+    static int depth_;      //!< number of existing batch objects
+
+    // forbid copying
+    nSocketSendBatch( const nSocketSendBatch & );
+    nSocketSendBatch & operator=( const nSocketSendBatch & );
 };
 
 //! collection of listening server sockets
@@ -242,6 +269,9 @@ private:
     nSocketListener listener_;          //!< listening sockets
     nSocket         controlSocket_;     //!< network control socket
 
+    int             epoll_;             //!< epoll instance watching all sockets, or -1
+    int             epollGeneration_;   //!< socket generation the epoll instance was set up for
+
     // forbid copying
     nBasicNetworkSystem( const nBasicNetworkSystem & );
     nBasicNetworkSystem & operator=( const nBasicNetworkSystem & );
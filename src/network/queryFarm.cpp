@@ -0,0 +1,350 @@
+/*
+
+*************************************************************************
+
+ArmageTron -- Just another Tron Lightcycle Game in 3D.
+Copyright (C) 2000  Manuel Moos (manuel@moosnet.de)
+
+**************************************************************************
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+***************************************************************************
+
+*/
+
+// The query farm: armagetronad_queryfarm opens a fake server farm on loopback
+// ports and lets the server browser query it, the way it queries the list it
+// gets from the master server. The farm answers big server info requests after
+// a delay, loses some of them, has servers that never answer and only sends so
+// many answers per second. Each round reports how long the browser took and how
+// many of the live servers it reached.
+
+#include "config.h"
+
+#ifdef WIN32
+#error "The query farm uses poll() and only builds on POSIX systems."
+#endif
+
+#include "tConfiguration.h"
+#include "nNetwork.h"
+#include "nServerInfo.h"
+#include "tSysTime.h"
+#include "tLocale.h"
+#include "tCommandLine.h"
+#include "tRandom.h"
+#include "nSocket.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <poll.h>
+#include <netinet/in.h>
+#include <vector>
+#include <queue>
+#include <sstream>
+#include <iostream>
+
+// farm parameters and the limits accepted for them
+static int sn_servers = 1000, sn_firstPort = 30000, sn_rounds = 2, sn_simultaneous = 20;
+static REAL sn_delay = .02, sn_loss = .01, sn_dead = .05, sn_rate = 3000;
+
+static const int sn_maxServers = 10000;
+static const int sn_maxRounds = 100;
+static const int sn_maxSimultaneous = 1000;
+static const REAL sn_maxDelay = 5;
+static const REAL sn_maxRate = 1000000;
+
+class nQueryFarmCommandLineAnalyzer: public tCommandLineAnalyzer
+{
+private:
+    virtual bool DoAnalyze( tCommandLineParser & parser )
+    {
+        tString value;
+        if ( parser.GetOption( value, "--servers" ) )
+            sn_servers = atoi( value );
+        else if ( parser.GetOption( value, "--port" ) )
+            sn_firstPort = atoi( value );
+        else if ( parser.GetOption( value, "--rounds" ) )
+            sn_rounds = atoi( value );
+        else if ( parser.GetOption( value, "--simultaneous" ) )
+            sn_simultaneous = atoi( value );
+        else if ( parser.GetOption( value, "--delay" ) )
+            sn_delay = atof( value );
+        else if ( parser.GetOption( value, "--loss" ) )
+            sn_loss = atof( value );
+        else if ( parser.GetOption( value, "--dead" ) )
+            sn_dead = atof( value );
+        else if ( parser.GetOption( value, "--rate" ) )
+            sn_rate = atof( value );
+        else
+            return false;
+
+        return true;
+    }
+
+    virtual void DoHelp( std::ostream & s )
+    {                                      //
+        s << "--servers <count>            : number of fake servers, default 1000\n";
+        s << "--port <port>                : port of the first fake server, default 30000\n";
+        s << "--rounds <count>             : number of query runs over the farm, default 2\n";
+        s << "--simultaneous <count>       : queries the browser may have underway, default 20\n";
+        s << "--delay <time>               : answer delay in seconds, default 0.02\n";
+        s << "--loss <fraction>            : fraction of queries lost, default 0.01\n";
+        s << "--dead <fraction>            : fraction of servers that never answer, default 0.05\n";
+        s << "--rate <count>               : answers the farm sends per second at most, default 3000\n";
+    }
+};
+
+static nQueryFarmCommandLineAnalyzer sn_analyzer;
+
+// the fake servers, all in one process
+class nQueryFarm
+{
+public:
+    nQueryFarm( int servers, int firstPort, tReproducibleRandomizer & randomizer )
+            : randomizer_( randomizer ), alive_( 0 )
+    {
+        nAddress address;
+        address.SetAddress( "127.0.0.1" );
+        for ( int i = 0; i < servers; ++i )
+        {
+            address.SetPort( firstPort + i );
+
+            Server server;
+            server.socket = tNEW( nSocket );
+            server.dead = randomizer_.Get() < sn_dead;
+            if ( !server.dead )
+                ++alive_;
+            if ( server.socket->Open( address ) != 0 )
+                tERR_ERROR( "Could not open fake server port " << firstPort + i << "." );
+            server.answer = Answer( firstPort + i );
+            servers_.push_back( server );
+
+            pollfd fd;
+            fd.fd = server.socket->GetSocket();
+            fd.events = POLLIN;
+            fd.revents = 0;
+            fds_.push_back( fd );
+        }
+
+        tokens_ = sn_rate * .05;
+        lastRefill_ = tRealSysTimeFloat();
+    }
+
+    ~nQueryFarm()
+    {
+        for ( int i = servers_.size()-1; i >= 0; --i )
+            delete servers_[i].socket;
+    }
+
+    // waits at most the given time for queries and sends the answers that are due
+    void Serve( REAL timeout )
+    {
+        double now = tRealSysTimeFloat();
+        if ( !pending_.empty() && pending_.top().due - now < timeout )
+            timeout = pending_.top().due - now;
+        if ( timeout < 0 )
+            timeout = 0;
+
+        if ( poll( &fds_[0], fds_.size(), int( timeout * 1000 ) ) > 0 )
+        {
+            now = tRealSysTimeFloat();
+
+            // the farm's uplink: a burst of 50 ms worth of answers, then the rate
+            tokens_ += ( now - lastRefill_ ) * sn_rate;
+            if ( tokens_ > sn_rate * .05 )
+                tokens_ = sn_rate * .05;
+            lastRefill_ = now;
+
+            for ( int i = fds_.size()-1; i >= 0; --i )
+            {
+                if ( !( fds_[i].revents & POLLIN ) )
+                    continue;
+
+                int8 buffer[2048];
+                Pending query;
+                while ( servers_[i].socket->Read( buffer, sizeof( buffer ), query.sender ) > 0 )
+                {
+                    // dead servers and lost queries go unanswered, and so do
+                    // queries arriving while the uplink is congested
+                    if ( servers_[i].dead || randomizer_.Get() < sn_loss || tokens_ < 1 )
+                        continue;
+                    tokens_ -= 1;
+
+                    query.due = now + sn_delay * ( .8 + .4 * randomizer_.Get() );
+                    query.server = i;
+                    pending_.push( query );
+                }
+            }
+        }
+
+        now = tRealSysTimeFloat();
+        while ( !pending_.empty() && pending_.top().due <= now )
+        {
+            Server const & server = servers_[ pending_.top().server ];
+            server.socket->Write( &server.answer[0], server.answer.size(), pending_.top().sender );
+            pending_.pop();
+        }
+    }
+
+    int Alive() const { return alive_; }
+private:
+    // the big server info packet a server with the given port sends, as
+    // nServerInfo::NetWriteThis would write it
+    static std::vector< int8 > Answer( int port )
+    {
+        std::ostringstream name;
+        name << "farm " << port;
+
+        std::vector< unsigned short > data;
+        data.push_back( port & 0xFFFF );
+        data.push_back( port >> 16 );
+        PutString( data, "127.0.0.1" );
+        PutString( data, name.str().c_str() );
+        data.push_back( 3 ); // users
+        data.push_back( 0 );
+
+        // descriptor, message ID, length, data, sender ID
+        std::vector< unsigned short > packet;
+        packet.push_back( 51 );
+        packet.push_back( 0 );
+        packet.push_back( data.size() );
+        packet.insert( packet.end(), data.begin(), data.end() );
+        packet.push_back( 0 );
+
+        std::vector< int8 > answer( packet.size() * 2 );
+        for ( int i = packet.size()-1; i >= 0; --i )
+        {
+            unsigned short word = htons( packet[i] );
+            memcpy( &answer[i*2], &word, 2 );
+        }
+        return answer;
+    }
+
+    // strings go as their length including the trailing zero, then two characters per word
+    static void PutString( std::vector< unsigned short > & data, char const * string )
+    {
+        int len = strlen( string ) + 1;
+        data.push_back( len );
+        for ( int i = 0; i < len; i += 2 )
+        {
+            unsigned short word = static_cast< unsigned char >( string[i] );
+            if ( i + 1 < len )
+                word |= static_cast< unsigned char >( string[i+1] ) << 8;
+            data.push_back( word );
+        }
+    }
+
+    struct Server
+    {
+        nSocket * socket;
+        bool dead;
+        std::vector< int8 > answer;
+    };
+
+    struct Pending
+    {
+        double due;
+        int server;
+        nAddress sender;
+
+        // the answer due first comes out of the queue first
+        bool operator < ( Pending const & other ) const
+        {
+            return due > other.due;
+        }
+    };
+
+    tReproducibleRandomizer & randomizer_;
+    std::vector< Server > servers_;
+    std::vector< pollfd > fds_;
+    std::priority_queue< Pending > pending_;
+    double tokens_, lastRefill_;
+    int alive_;
+};
+
+int main( int argc, char ** argv )
+{
+    tCommandLineData commandLine;
+    commandLine.programVersion_ = &sn_programVersion;
+    if ( !commandLine.Analyse( argc, argv ) )
+        return 0;
+
+    if ( sn_servers < 1 || sn_servers > sn_maxServers ||
+         sn_firstPort < 1024 || sn_firstPort + sn_servers > 65536 ||
+         sn_rounds < 1 || sn_rounds > sn_maxRounds ||
+         sn_simultaneous < 1 || sn_simultaneous > sn_maxSimultaneous ||
+         !( sn_delay >= 0 && sn_delay <= sn_maxDelay ) ||
+         !( sn_loss >= 0 && sn_loss < 1 ) ||
+         !( sn_dead >= 0 && sn_dead <= 1 ) ||
+         !( sn_rate >= 20 && sn_rate <= sn_maxRate ) )
+    {
+        std::cerr << "Parameters out of range: 1 to " << sn_maxServers << " servers on ports from 1024 to 65535, 1 to "
+        << sn_maxRounds << " rounds, 1 to " << sn_maxSimultaneous << " simultaneous queries, a delay up to "
+        << sn_maxDelay << " seconds, loss and dead fractions from 0 to 1 and a rate from 20 to " << sn_maxRate << ".\n";
+        return 1;
+    }
+
+    tLocale::Load( "languages.txt" );
+    atexit( tLocale::Clear );
+    tConfItemBase::printChange = false;
+
+    {
+        std::istringstream s( "BROWSER_QUERY_REPORT 1\n" );
+        tCurrentAccessLevel level( tAccessLevel_Owner, true );
+        tConfItemBase::LoadAll( s );
+    }
+
+    // a private randomizer; nobody seeds rand() here, so every run kills the same servers
+    tReproducibleRandomizer randomizer;
+    nQueryFarm farm( sn_servers, sn_firstPort, randomizer );
+
+    // the server list, as the master server would send it
+    for ( int i = 0; i < sn_servers; ++i )
+    {
+        std::ostringstream entry;
+        entry << "connection\t127.0.0.1\nport\t" << sn_firstPort + i << "\nname\tfarm " << sn_firstPort + i << "\nServerEnd\n";
+        std::istringstream s( entry.str() );
+        nServerInfo * server = tNEW( nServerInfo )();
+        server->Load( s );
+    }
+
+    std::cout << "round\ttotal_s\tservers\talive\treachable\n";
+    for ( int round = 0; round < sn_rounds; ++round )
+    {
+        double start = tRealSysTimeFloat();
+        nServerInfo::StartQueryAll();
+        while ( nServerInfo::DoQueryAll( sn_simultaneous ) )
+        {
+            farm.Serve( .001 );
+            sn_BasicNetworkSystem.Select( .001 );
+            tAdvanceFrame();
+        }
+
+        int reachable = 0;
+        for ( nServerInfo * run = nServerInfo::GetFirstServer(); run; run = run->Next() )
+        {
+            if ( run->Reachable() )
+                ++reachable;
+        }
+
+        std::cout << round << "\t" << tRealSysTimeFloat() - start << "\t" << sn_servers << "\t"
+        << farm.Alive() << "\t" << reachable << "\n";
+    }
+
+    nServerInfo::DeleteAll( false );
+
+    return 0;
+}
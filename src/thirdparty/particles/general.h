@@ -23,16 +23,32 @@ struct Particle
     float age;
 };
 
+struct ParticleArrays;
+
 // A group of particles - Info and an array of Particles
 struct ParticleGroup
 {
     int p_count;		// Number of particles currently existing.
     int max_particles;	// Max particles allowed in group.
     int particles_allocated; // Actual allocated size.
+    ParticleArrays *arrays;	// Component arrays for compiled action lists, or NULL.
+    bool in_arrays;		// True while arrays, not list, holds the particles.
     Particle list[1];	// Actually, num_particles in size
 
+    // Everything that touches list directly must call this first.
+    inline void ToList()
+    {
+        if(in_arrays)
+            UnpackArrays();
+    }
+
+    void PackArrays();	// Move the particles from list to arrays.
+    void UnpackArrays();	// Move them back.
+    void FreeArrays();
+
     inline void Remove(int i)
     {
+        ToList();
         list[i] = list[--p_count];
     }
 
@@ -41,6 +57,9 @@ struct ParticleGroup
                     const float alpha = 1.0f,
                     const float age = 0.0f)
     {
+        // pVertex() adds in immediate mode, possibly right after a fused pass.
+        ToList();
+
         if(p_count >= max_particles)
             return false;
         else
@@ -132,10 +151,13 @@ struct ParticleAction
 // Data types derived from Action.
 
 
+struct PCompiledList;
+
 struct PAHeader : public ParticleAction
 {
     int actions_allocated;
     int count;			// Total actions in the list.
+    PCompiledList *compiled;	// Stages built from the list on first call, or NULL.
     float padding[96];	// This must be the largest action.
 
     ExecMethod
@@ -37,6 +37,8 @@ PARTICLEDLL_API void pDrawGroupp(int primitive, bool const_size, bool const_colo
     if(pg->p_count < 1)
         return;
 
+    pg->ToList();
+
     if(primitive == GL_POINTS)
     {
         glPushClientAttrib(GL_CLIENT_VERTEX_ARRAY_BIT);
@@ -103,6 +105,8 @@ PARTICLEDLL_API void pDrawGroupl(int dlist, bool const_size, bool const_color, b
     if(pg->p_count < 1)
         return;
 
+    pg->ToList();
+
     //if(const_color)
     //	glColor4fv((GLfloat *)&pg->list[0].color);
 
@@ -0,0 +1,419 @@
+// soa.cpp
+//
+// This file implements the structure of arrays particle storage and
+// the fused passes of compiled action lists.
+//
+// A fused pass walks the group in blocks of P_BLOCK particles. Each
+// action runs over the whole block as a plain loop over the component
+// arrays, which the compiler can vectorize, while the block is still in
+// the cache. Actions that kill particles only clear their flag in keep;
+// the block is compacted once at the end, without branching per
+// particle. Unlike Remove(), compaction keeps the order of the
+// survivors.
+
+#include "soa.h"
+
+#include <memory.h>
+
+extern void _pCallActionList(ParticleAction *pa, int num_actions,
+                             ParticleGroup *pg);
+
+////////////////////////////////////////////////////////
+// ParticleArrays
+
+ParticleArrays::ParticleArrays(int count)
+{
+    // Round up so each array starts 16 byte aligned.
+    allocated = (count + 3) & ~3;
+    data = new float[P_COMPONENTS * allocated + 3];
+
+    float *base = data;
+    while(((size_t)base) & 15)
+        base++;
+
+    for(int c = 0; c < P_COMPONENTS; c++)
+        comp[c] = base + c * allocated;
+}
+
+ParticleArrays::~ParticleArrays()
+{
+    delete [] data;
+}
+
+void ParticleArrays::Load(const Particle *list, int count)
+{
+    const float *src = (const float *)list;
+
+    for(int c = 0; c < P_COMPONENTS; c++)
+    {
+        float *dst = comp[c];
+        for(int i = 0; i < count; i++)
+            dst[i] = src[i * P_COMPONENTS + c];
+    }
+}
+
+void ParticleArrays::Store(Particle *list, int count) const
+{
+    float *dst = (float *)list;
+
+    for(int c = 0; c < P_COMPONENTS; c++)
+    {
+        const float *src = comp[c];
+        for(int i = 0; i < count; i++)
+            dst[i * P_COMPONENTS + c] = src[i];
+    }
+}
+
+int ParticleArrays::Compact(int first, int count, int dest, const unsigned char *keep)
+{
+    int kept = 0;
+    for(int i = 0; i < count; i++)
+        kept += keep[i];
+
+    // Nothing died and nothing died before: nothing to move.
+    if(kept == count && dest == first)
+        return dest + count;
+
+    for(int c = 0; c < P_COMPONENTS; c++)
+    {
+        // Always write, then only advance past survivors.
+        const float *src = comp[c] + first;
+        float *dst = comp[c] + dest;
+        int j = 0;
+        for(int i = 0; i < count; i++)
+        {
+            dst[j] = src[i];
+            j += keep[i];
+        }
+    }
+
+    return dest + kept;
+}
+
+////////////////////////////////////////////////////////
+// ParticleGroup
+
+void ParticleGroup::PackArrays()
+{
+    if(in_arrays)
+        return;
+
+    if(arrays && arrays->allocated < p_count)
+        FreeArrays();
+
+    if(arrays == NULL)
+        arrays = new ParticleArrays(max_particles > p_count ? max_particles : p_count);
+
+    arrays->Load(list, p_count);
+    in_arrays = true;
+}
+
+void ParticleGroup::UnpackArrays()
+{
+    arrays->Store(list, p_count);
+    in_arrays = false;
+}
+
+void ParticleGroup::FreeArrays()
+{
+    ToList();
+    delete arrays;
+    arrays = NULL;
+}
+
+////////////////////////////////////////////////////////
+// Kernels. Each one does what the Execute() method of its action does,
+// for the n particles starting at s.
+
+static void _pCopyVertexB(const PACopyVertexB *pa, ParticleArrays &a, int s, int n)
+{
+    for(int c = 0; c < 3; c++)
+    {
+        if(pa->copy_pos)
+            memcpy(a.comp[P_POSB + c] + s, a.comp[P_POS + c] + s, n * sizeof(float));
+        if(pa->copy_vel)
+            memcpy(a.comp[P_VELB + c] + s, a.comp[P_VEL + c] + s, n * sizeof(float));
+    }
+}
+
+static void _pDamping(const PADamping *pa, ParticleArrays &a, int s, int n)
+{
+    pVector one(1,1,1);
+    pVector scale(one - ((one - pa->damping) * ParticleAction::dt));
+    float vlowSqr = pa->vlowSqr, vhighSqr = pa->vhighSqr;
+
+    float *vx = a.comp[P_VEL] + s, *vy = a.comp[P_VEL + 1] + s, *vz = a.comp[P_VEL + 2] + s;
+    for(int i = 0; i < n; i++)
+    {
+        float vSqr = vx[i]*vx[i]+vy[i]*vy[i]+vz[i]*vz[i];
+        bool damp = vSqr >= vlowSqr && vSqr <= vhighSqr;
+
+        vx[i] *= damp ? scale.x : 1.0f;
+        vy[i] *= damp ? scale.y : 1.0f;
+        vz[i] *= damp ? scale.z : 1.0f;
+    }
+}
+
+static void _pGravity(const PAGravity *pa, ParticleArrays &a, int s, int n)
+{
+    pVector ddir(pa->direction * ParticleAction::dt);
+    float d[3] = { ddir.x, ddir.y, ddir.z };
+
+    for(int c = 0; c < 3; c++)
+    {
+        float *v = a.comp[P_VEL + c] + s;
+        for(int i = 0; i < n; i++)
+            v[i] += d[c];
+    }
+}
+
+static void _pKillOld(const PAKillOld *pa, ParticleArrays &a, int s, int n, unsigned char *keep)
+{
+    float age_limit = pa->age_limit;
+    bool kill_less_than = pa->kill_less_than;
+
+    const float *age = a.comp[P_AGE] + s;
+    for(int i = 0; i < n; i++)
+        keep[i] &= (age[i] < age_limit) ^ kill_less_than;
+}
+
+static void _pMove(ParticleArrays &a, int s, int n)
+{
+    float dt = ParticleAction::dt;
+
+    float *age = a.comp[P_AGE] + s;
+    for(int i = 0; i < n; i++)
+        age[i] += dt;
+
+    for(int c = 0; c < 3; c++)
+    {
+        float *p = a.comp[P_POS + c] + s;
+        const float *v = a.comp[P_VEL + c] + s;
+        for(int i = 0; i < n; i++)
+            p[i] += v[i] * dt;
+    }
+}
+
+static void _pSink(const pDomain &domain, bool kill_inside, const float *const *v, int s, int n, unsigned char *keep)
+{
+    const float *x = v[0] + s, *y = v[1] + s, *z = v[2] + s;
+    for(int i = 0; i < n; i++)
+        keep[i] &= domain.Within(pVector(x[i], y[i], z[i])) ^ kill_inside;
+}
+
+static void _pSpeedLimit(const PASpeedLimit *pa, ParticleArrays &a, int s, int n)
+{
+    float min_speed = pa->min_speed, max_speed = pa->max_speed;
+    float min_sqr = min_speed*min_speed;
+    float max_sqr = max_speed*max_speed;
+
+    float *vx = a.comp[P_VEL] + s, *vy = a.comp[P_VEL + 1] + s, *vz = a.comp[P_VEL + 2] + s;
+    for(int i = 0; i < n; i++)
+    {
+        float sSqr = vx[i]*vx[i]+vy[i]*vy[i]+vz[i]*vz[i];
+        float sp = sqrtf(sSqr);
+        float f = (sSqr<min_sqr && sSqr) ? min_speed/sp : (sSqr>max_sqr ? max_speed/sp : 1.0f);
+
+        vx[i] *= f;
+        vy[i] *= f;
+        vz[i] *= f;
+    }
+}
+
+static void _pTargetColor(const PATargetColor *pa, ParticleArrays &a, int s, int n)
+{
+    float scaleFac = pa->scale * ParticleAction::dt;
+    float target[4] = { pa->color.x, pa->color.y, pa->color.z, pa->alpha };
+
+    // Color and alpha are adjacent.
+    for(int c = 0; c < 4; c++)
+    {
+        float *col = a.comp[P_COLOR + c] + s;
+        for(int i = 0; i < n; i++)
+            col[i] += (target[c] - col[i]) * scaleFac;
+    }
+}
+
+static void _pTargetSize(const PATargetSize *pa, ParticleArrays &a, int s, int n)
+{
+    float dt = ParticleAction::dt;
+    float target[3] = { pa->size.x, pa->size.y, pa->size.z };
+    float scaleFac[3] = { pa->scale.x * dt, pa->scale.y * dt, pa->scale.z * dt };
+
+    for(int c = 0; c < 3; c++)
+    {
+        float *size = a.comp[P_SIZE + c] + s;
+        for(int i = 0; i < n; i++)
+            size[i] += (target[c] - size[i]) * scaleFac[c];
+    }
+}
+
+static void _pTargetVelocity(const PATargetVelocity *pa, ParticleArrays &a, int s, int n)
+{
+    float scaleFac = pa->scale * ParticleAction::dt;
+    float target[3] = { pa->velocity.x, pa->velocity.y, pa->velocity.z };
+
+    for(int c = 0; c < 3; c++)
+    {
+        float *v = a.comp[P_VEL + c] + s;
+        for(int i = 0; i < n; i++)
+            v[i] += (target[c] - v[i]) * scaleFac;
+    }
+}
+
+bool _pFusible(PActionEnum type)
+{
+    switch(type)
+    {
+    case PACopyVertexBID:
+    case PADampingID:
+    case PAGravityID:
+    case PAKillOldID:
+    case PAMoveID:
+    case PASinkID:
+    case PASinkVelocityID:
+    case PASpeedLimitID:
+    case PATargetColorID:
+    case PATargetSizeID:
+    case PATargetVelocityID:
+        return true;
+    default:
+        return false;
+    }
+}
+
+// Run a stage of fusible actions over the whole group.
+static void _pExecuteFused(PAHeader *pa, int num_actions, ParticleGroup *pg)
+{
+    pg->PackArrays();
+    ParticleArrays &a = *pg->arrays;
+
+    unsigned char keep[P_BLOCK];
+    int alive = 0;
+
+    for(int s = 0; s < pg->p_count; s += P_BLOCK)
+    {
+        int n = pg->p_count - s;
+        if(n > P_BLOCK)
+            n = P_BLOCK;
+
+        memset(keep, 1, n);
+
+        for(int action = 0; action < num_actions; action++)
+        {
+            ParticleAction *act = pa + action;
+            switch(act->type)
+            {
+            case PACopyVertexBID:
+                _pCopyVertexB((PACopyVertexB *)act, a, s, n);
+                break;
+            case PADampingID:
+                _pDamping((PADamping *)act, a, s, n);
+                break;
+            case PAGravityID:
+                _pGravity((PAGravity *)act, a, s, n);
+                break;
+            case PAKillOldID:
+                _pKillOld((PAKillOld *)act, a, s, n, keep);
+                break;
+            case PAMoveID:
+                _pMove(a, s, n);
+                break;
+            case PASinkID:
+                _pSink(((PASink *)act)->position, ((PASink *)act)->kill_inside, a.comp + P_POS, s, n, keep);
+                break;
+            case PASinkVelocityID:
+                _pSink(((PASinkVelocity *)act)->velocity, ((PASinkVelocity *)act)->kill_inside, a.comp + P_VEL, s, n, keep);
+                break;
+            case PASpeedLimitID:
+                _pSpeedLimit((PASpeedLimit *)act, a, s, n);
+                break;
+            case PATargetColorID:
+                _pTargetColor((PATargetColor *)act, a, s, n);
+                break;
+            case PATargetSizeID:
+                _pTargetSize((PATargetSize *)act, a, s, n);
+                break;
+            case PATargetVelocityID:
+                _pTargetVelocity((PATargetVelocity *)act, a, s, n);
+                break;
+            default:
+                break;
+            }
+        }
+
+        alive = a.Compact(s, n, alive, keep);
+    }
+
+    pg->p_count = alive;
+}
+
+////////////////////////////////////////////////////////
+// PCompiledList
+
+PCompiledList::PCompiledList(const PAHeader *alist)
+{
+    const PAHeader *pa = alist + 1;
+    int num_actions = alist->count - 1;
+
+    // Fusing a lone action between others is not worth moving the
+    // particles into the arrays and back, unless nothing else runs.
+    bool all_fusible = true;
+    int i;
+    for(i = 0; i < num_actions; i++)
+        all_fusible = all_fusible && _pFusible(pa[i].type);
+
+    stages = new PCompiledStage[num_actions > 0 ? num_actions : 1];
+    stage_count = 0;
+
+    for(i = 0; i < num_actions; )
+    {
+        int run = 0;
+        while(i + run < num_actions && _pFusible(pa[i + run].type))
+            run++;
+
+        PCompiledStage &stage = stages[stage_count++];
+        stage.first = i;
+
+        if(run > 1 || (run == 1 && all_fusible))
+        {
+            stage.count = run;
+            stage.fused = true;
+        }
+        else
+        {
+            // Plain actions, including a lone fusible one, run as before.
+            if(run == 0)
+                run = 1;
+            while(i + run < num_actions && !_pFusible(pa[i + run].type))
+                run++;
+
+            stage.count = run;
+            stage.fused = false;
+        }
+
+        i += run;
+    }
+}
+
+PCompiledList::~PCompiledList()
+{
+    delete [] stages;
+}
+
+void PCompiledList::Execute(PAHeader *actions, ParticleGroup *pg) const
+{
+    // All these require a particle group, so check for it.
+    if(pg == NULL)
+        return;
+
+    for(int i = 0; i < stage_count; i++)
+    {
+        const PCompiledStage &stage = stages[i];
+
+        if(stage.fused)
+            _pExecuteFused(actions + stage.first, stage.count, pg);
+        else
+            _pCallActionList(actions + stage.first, stage.count, pg);
+    }
+}
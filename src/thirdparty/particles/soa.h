@@ -0,0 +1,74 @@
+// soa.h
+//
+// This file declares the structure of arrays particle storage and the
+// action list compiler that runs consecutive simple actions over it in
+// one fused pass.
+
+#ifndef soa_h
+#define soa_h
+
+#include "general.h"
+
+// Offsets of the particle components, in floats. They follow the layout
+// of struct Particle.
+enum PComponentEnum
+{
+    P_POS = 0,
+    P_POSB = 3,
+    P_SIZE = 6,
+    P_VEL = 9,
+    P_VELB = 12,
+    P_COLOR = 15,
+    P_ALPHA = 18,
+    P_AGE = 19,
+    P_COMPONENTS = 20
+};
+
+// Particles processed per block of a fused pass.
+#define P_BLOCK 256
+
+// The particles of a group with one array per component.
+struct ParticleArrays
+{
+    int allocated;		// Particles that fit in each array.
+    float *comp[P_COMPONENTS];	// The arrays, 16 byte aligned.
+
+    ParticleArrays(int count);
+    ~ParticleArrays();
+
+    void Load(const Particle *list, int count);
+    void Store(Particle *list, int count) const;
+
+    // Move the particles first..first+count-1 with keep set down to dest,
+    // which must not be above first. Returns the next free slot.
+    int Compact(int first, int count, int dest, const unsigned char *keep);
+
+private:
+    float *data;
+};
+
+// One step of a compiled action list.
+struct PCompiledStage
+{
+    int first;			// First action, counted from the one after the header.
+    int count;			// Number of actions.
+    bool fused;			// True to run them together over the arrays.
+};
+
+// An action list cut into stages. Runs of actions that only look at one
+// particle at a time are fused; everything else runs as before.
+struct PCompiledList
+{
+    int stage_count;
+    PCompiledStage *stages;
+
+    PCompiledList(const PAHeader *alist);
+    ~PCompiledList();
+
+    void Execute(PAHeader *actions, ParticleGroup *pg) const;
+};
+
+// True if the action can be part of a fused pass.
+bool _pFusible(PActionEnum type);
+
+#endif
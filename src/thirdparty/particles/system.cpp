@@ -5,6 +5,7 @@
 // This file implements the API calls that are not particle actions.
 
 #include "general.h"
+#include "soa.h"
 
 #include <memory.h>
 
@@ -291,6 +292,9 @@ void _pCallActionList(ParticleAction *apa, int num_actions,
     // Step through all the actions in the action list.
     for(int action = 0; action < num_actions; action++, pa++)
     {
+        // A nested list may have left the particles in the arrays.
+        pg->ToList();
+
         switch(pa->type)
         {
         case PAAvoidID:
@@ -530,6 +534,7 @@ PARTICLEDLL_API int pGenActionLists(int action_list_count)
         _ps.alist_list[i]->actions_allocated = 8;
         _ps.alist_list[i]->type = PAHeaderID;
         _ps.alist_list[i]->count = 1;
+        _ps.alist_list[i]->compiled = NULL;
     }
 
     _PUnLock();
@@ -554,6 +559,8 @@ PARTICLEDLL_API void pNewActionList(int action_list_num)
 
     // Remove whatever used to be in the list.
     _ps.pact->count = 1;
+    delete _ps.pact->compiled;
+    _ps.pact->compiled = NULL;
 }
 
 PARTICLEDLL_API void pEndActionList()
@@ -588,6 +595,7 @@ PARTICLEDLL_API void pDeleteActionLists(int action_list_num, int action_list_cou
     {
         if(_ps.alist_list[i])
         {
+            delete _ps.alist_list[i]->compiled;
             delete [] _ps.alist_list[i];
             _ps.alist_list[i] = NULL;
         }
@@ -628,7 +636,11 @@ PARTICLEDLL_API void pCallActionList(int action_list_num)
 
         _ps.in_call_list = true;
 
-        _pCallActionList(pa+1, pa->count-1, _ps.pgrp);
+        // Compile on first use; the list can't change until pNewActionList.
+        if(pa->compiled == NULL)
+            pa->compiled = new PCompiledList(pa);
+
+        pa->compiled->Execute(pa+1, _ps.pgrp);
 
         _ps.in_call_list = false;
     }
@@ -657,6 +669,8 @@ PARTICLEDLL_API int pGenParticleGroups(int p_group_count, int max_particles)
         _ps.group_list[i]->max_particles = max_particles;
         _ps.group_list[i]->particles_allocated = max_particles;
         _ps.group_list[i]->p_count = 0;
+        _ps.group_list[i]->arrays = NULL;
+        _ps.group_list[i]->in_arrays = false;
     }
 
     _PUnLock();
@@ -680,6 +694,7 @@ PARTICLEDLL_API void pDeleteParticleGroups(int p_group_num, int p_group_count)
     {
         if(_ps.group_list[i])
         {
+            _ps.group_list[i]->FreeArrays();
             delete [] _ps.group_list[i];
             _ps.group_list[i] = NULL;
         }
@@ -723,6 +738,8 @@ PARTICLEDLL_API int pSetMaxParticles(int max_count)
     if(max_count < 0)
         return 0; // ERROR
 
+    pg->ToList();
+
     // Reducing max.
     if(pg->particles_allocated >= max_count)
     {
@@ -779,6 +796,9 @@ PARTICLEDLL_API void pCopyGroup(int p_src_group_num, int index, int copy_count)
     if(destgrp == NULL)
         return; // ERROR
 
+    srcgrp->ToList();
+    destgrp->ToList();
+
     // Find out exactly how many to copy.
     int ccount = copy_count;
     if(ccount > srcgrp->p_count - index)
@@ -820,6 +840,8 @@ PARTICLEDLL_API int pGetParticles(int index, int count, float *verts,
     if(index < 0 || count < 0)
         return -3; // ERROR
 
+    pg->ToList();
+
     if(index + count > pg->p_count)
     {
         count = pg->p_count - index;
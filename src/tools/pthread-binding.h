@@ -0,0 +1,145 @@
+/*
+
+*************************************************************************
+
+ArmageTron -- Just another Tron Lightcycle Game in 3D.
+Copyright (C) 2005  Manuel Moos (manuel@moosnet.de)
+
+**************************************************************************
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+***************************************************************************
+
+*/
+
+#ifndef ArmageTron_PTHREAD_BINDING_H
+#define ArmageTron_PTHREAD_BINDING_H
+
+// thin wrappers around POSIX threads, mimicking the parts of the ZThread
+// interface the rest of the code uses when ZThread is not available
+
+#include <pthread.h>
+#include <deque>
+
+//! plain mutex
+class tPThreadMutex
+{
+public:
+    tPThreadMutex(){ pthread_mutex_init( &mutex_, NULL ); }
+    ~tPThreadMutex(){ pthread_mutex_destroy( &mutex_ ); }
+
+    void acquire(){ pthread_mutex_lock( &mutex_ ); }
+    void release(){ pthread_mutex_unlock( &mutex_ ); }
+
+    pthread_mutex_t & Native(){ return mutex_; }
+private:
+    tPThreadMutex( tPThreadMutex const & );
+    tPThreadMutex & operator = ( tPThreadMutex const & );
+
+    pthread_mutex_t mutex_;
+};
+
+//! mutex that may be acquired several times by the same thread
+class tPThreadRecursiveMutex
+{
+public:
+    tPThreadRecursiveMutex()
+    {
+        pthread_mutexattr_t attributes;
+        pthread_mutexattr_init( &attributes );
+        pthread_mutexattr_settype( &attributes, PTHREAD_MUTEX_RECURSIVE );
+        pthread_mutex_init( &mutex_, &attributes );
+        pthread_mutexattr_destroy( &attributes );
+    }
+    ~tPThreadRecursiveMutex(){ pthread_mutex_destroy( &mutex_ ); }
+
+    void acquire(){ pthread_mutex_lock( &mutex_ ); }
+    void release(){ pthread_mutex_unlock( &mutex_ ); }
+private:
+    tPThreadRecursiveMutex( tPThreadRecursiveMutex const & );
+    tPThreadRecursiveMutex & operator = ( tPThreadRecursiveMutex const & );
+
+    pthread_mutex_t mutex_;
+};
+
+//! condition variable bound to a mutex, like ZThread::Condition. wait() needs the mutex held.
+class tPThreadCondition
+{
+public:
+    explicit tPThreadCondition( tPThreadMutex & mutex ): mutex_( mutex ){ pthread_cond_init( &condition_, NULL ); }
+    ~tPThreadCondition(){ pthread_cond_destroy( &condition_ ); }
+
+    void wait(){ pthread_cond_wait( &condition_, &mutex_.Native() ); }
+    void signal(){ pthread_cond_signal( &condition_ ); }
+    void broadcast(){ pthread_cond_broadcast( &condition_ ); }
+private:
+    tPThreadCondition( tPThreadCondition const & );
+    tPThreadCondition & operator = ( tPThreadCondition const & );
+
+    tPThreadMutex & mutex_;
+    pthread_cond_t condition_;
+};
+
+//! pointer with a separate value for every thread, like ZThread::ThreadLocal. Starts out NULL.
+template< class T > class tPThreadLocal
+{
+public:
+    tPThreadLocal(){ pthread_key_create( &key_, NULL ); }
+    ~tPThreadLocal(){ pthread_key_delete( key_ ); }
+
+    T * get() const { return static_cast< T * >( pthread_getspecific( key_ ) ); }
+    void set( T * value ) const { pthread_setspecific( key_, value ); }
+private:
+    tPThreadLocal( tPThreadLocal const & );
+    tPThreadLocal & operator = ( tPThreadLocal const & );
+
+    pthread_key_t key_;
+};
+
+//! queue safe for concurrent access, like ZThread::LockedQueue
+template< class T, class MUTEX > class tPThreadQueue
+{
+public:
+    void add( T const & item )
+    {
+        mutex_.acquire();
+        queue_.push_back( item );
+        mutex_.release();
+    }
+
+    //! removes and returns the first item; the queue must not be empty
+    T next()
+    {
+        mutex_.acquire();
+        T ret = queue_.front();
+        queue_.pop_front();
+        mutex_.release();
+        return ret;
+    }
+
+    size_t size()
+    {
+        mutex_.acquire();
+        size_t ret = queue_.size();
+        mutex_.release();
+        return ret;
+    }
+private:
+    MUTEX mutex_;
+    std::deque< T > queue_;
+};
+
+#endif
@@ -39,7 +39,7 @@ void GrowingArrayBase::Swap( GrowingArrayBase & other )
 {
     ::Swap( len, other.len );
     ::Swap( size, other.size );
-    ::Swap( base, other.base );
+    ::Swap( storage, other.storage );
 }
 
 void GrowingArrayBase::ComplainIfFull(){
@@ -47,53 +47,76 @@ void GrowingArrayBase::ComplainIfFull(){
         tERR_ERROR("Array should be empty.");
 }
 
-GrowingArrayBase::GrowingArrayBase(int firstsize,int size_of_T, bool useMalloc)
+GrowingArrayBase::GrowingArrayBase(int firstsize,int size_of_T, bool useMalloc, bool clear)
 {
     // dump(low,dump,"con:size " << firstsize << ",element size " << size_of_T);
     len=firstsize;
-    if (firstsize) size=firstsize;
-    else             size=1;
+
+    // small arrays, most notably short strings, need no memory of their own
+    if ( firstsize * size_of_T <= tARRAY_LOCAL_SIZE )
+    {
+        size = tARRAY_LOCAL_SIZE / size_of_T;
+        if ( clear )
+            memset( storage.local, 0, sizeof( storage.local ) );
+        return;
+    }
+
+    size=firstsize;
 
     if ( useMalloc )
-        base=malloc(size * size_of_T);
+        storage.base=malloc(size * size_of_T);
     else
-        base=tNEW( char[size * size_of_T] );
+        storage.base=tNEW( char[size * size_of_T] );
 
-    if(NULL==base) {
+    if(NULL==storage.base) {
         tERR_ERROR("Error Allocating " << size_of_T*(size) << " bytes." );
     }
-    for(int i=size*size_of_T-1;i>=0;i--)
-        (reinterpret_cast<char *>(base))[i]=0;
-
+    if ( clear )
+        memset( storage.base, 0, size * size_of_T );
 }
 
 GrowingArrayBase::~GrowingArrayBase(){
-    tASSERT( base == NULL );
+    tASSERT( storage.base == NULL );
     // dump(very_low,flow,"des");
 }
 
-void GrowingArrayBase::Delete( bool useMalloc ){
+void GrowingArrayBase::Delete( bool useMalloc, int size_of_T ){
     // dump(very_low,flow,"des");
-    if ( useMalloc )
-    {
-        free(base);
-    }
-    else
+    if ( !IsLocal( size_of_T ) )
     {
-        delete[] (char*)base;
+        if ( useMalloc )
+        {
+            free(storage.base);
+        }
+        else
+        {
+            delete[] (char*)storage.base;
+        }
     }
 
-    base = NULL;
+    storage.base = NULL;
     size = len = 0;
 }
 
-void GrowingArrayBase::ResizeBase(int i,int size_of_T, bool useMalloc){
+void GrowingArrayBase::ResizeBase(int i,int size_of_T, bool useMalloc, bool clear){
 
     i++;
 
     // dump(very_low,flow,"Array-base resize");
 
     unsigned int oldsize=size;
+    void *oldbase=Base(size_of_T);
+    bool wasLocal=IsLocal(size_of_T);
+
+    // still fits inside? Then all of the local space is used.
+    if ( i * size_of_T <= tARRAY_LOCAL_SIZE )
+    {
+        tASSERT( wasLocal );
+        size = tARRAY_LOCAL_SIZE / size_of_T;
+        if ( clear )
+            memset( storage.local + oldsize*size_of_T, 0, (size-oldsize)*size_of_T );
+        return;
+    }
 
     int size_a=i+(1<<12);
     int size_b=i+(i>>2);
@@ -120,34 +143,28 @@ void GrowingArrayBase::ResizeBase(int i,int size_of_T, bool useMalloc){
         tERR_ERROR("Error reallocating " << size_of_T*(new_size) << " bytes.");
     }
     else{
-        memcpy(newbase,base,size_of_T*(oldsize));
-        if ( useMalloc )
+        memcpy(newbase,oldbase,size_of_T*(oldsize));
+        if ( !wasLocal )
         {
-            free(base);
-        }
-        else
-        {
-            delete[] (char*)base;
+            if ( useMalloc )
+            {
+                free(oldbase);
+            }
+            else
+            {
+                delete[] (char*)oldbase;
+            }
         }
     }
     //
     size = new_size;
 
     // clear the newly allocated memory
-    char *start=(reinterpret_cast<char *>(newbase)) + oldsize*size_of_T;
-    for(int j=(size-oldsize)*size_of_T-1;j>=0;j--)
-        start[j]=0;
+    if ( clear )
+    {
+        char *start=(reinterpret_cast<char *>(newbase)) + oldsize*size_of_T;
+        memset( start, 0, (size-oldsize)*size_of_T );
+    }
 
-    base=newbase;
+    storage.base=newbase;
 }
-
-
-
-
-
-
-
-
-
-
-
@@ -30,27 +30,71 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 
 #include "defs.h"
 #include <new>
+#include <string.h>
 #include "tError.h"
 #include "tSafePTR.h"
 
 
+//! tells whether T is plain old data: tArray then leaves spare capacity
+//! uninitialized and copies elements bytewise.
+template< class T > struct tArrayPOD { enum { value = false }; };
+template< class T > struct tArrayPOD< T * > { enum { value = true }; };
+#define tARRAY_POD( T ) template<> struct tArrayPOD< T > { enum { value = true }; }
+tARRAY_POD( bool );
+tARRAY_POD( char );
+tARRAY_POD( signed char );
+tARRAY_POD( unsigned char );
+tARRAY_POD( short );
+tARRAY_POD( unsigned short );
+tARRAY_POD( int );
+tARRAY_POD( unsigned int );
+tARRAY_POD( long );
+tARRAY_POD( unsigned long );
+tARRAY_POD( float );
+tARRAY_POD( double );
+#undef tARRAY_POD
+
+//! bytewise element operations; they only do something (and the compiler only
+//! sees memset/memcpy on T) for plain old data
+template< bool POD > struct tArrayBytes
+{
+    template< class T > static void Zero( T *, int ){}
+    template< class T > static void Copy( T *, T const *, int ){}
+};
+template<> struct tArrayBytes< true >
+{
+    template< class T > static void Zero( T * target, int count ){ memset( target, 0, count * sizeof(T) ); }
+    template< class T > static void Copy( T * target, T const * source, int count ){ memcpy( target, source, count * sizeof(T) ); }
+};
+
+//! number of bytes of elements an array keeps inside itself before it allocates memory
+#define tARRAY_LOCAL_SIZE 24
+
 class GrowingArrayBase {
     int len;    // current logical size
     int size;   // current size in memory
-    void *base; // start of memory block
+    union Storage
+    {
+        void *base;                     // start of memory block
+        char local[tARRAY_LOCAL_SIZE];  // the elements themselves, if they fit
+    } storage;
 
     const GrowingArrayBase & operator=(const GrowingArrayBase &);
     GrowingArrayBase(GrowingArrayBase &);
 
 protected:
-    void ResizeBase(int i,int size_of_T, bool useMalloc);
-    void *Base() const {return base;}
+    void ResizeBase(int i,int size_of_T, bool useMalloc, bool clear=true);
+
+    //! returns whether the elements are stored inside the array object.
+    //! Holds exactly when all of the current size fits there; local elements move with the array.
+    bool IsLocal(int size_of_T) const {return size * size_of_T <= tARRAY_LOCAL_SIZE;}
+    void *Base(int size_of_T) const {return IsLocal(size_of_T) ? const_cast< char * >( storage.local ) : storage.base;}
 
     //! fast data swap with other array
     void Swap( GrowingArrayBase & other );
 
-    GrowingArrayBase(int firstsize,int size_of_T, bool useMalloc);
-    void Delete( bool useMalloc );
+    GrowingArrayBase(int firstsize,int size_of_T, bool useMalloc, bool clear=true);
+    void Delete( bool useMalloc, int size_of_T );
     ~GrowingArrayBase();
 
     /*
@@ -71,18 +115,24 @@ public:
 
 template<class T, bool MALLOC=false> class tArray: public GrowingArrayBase {
 protected:
+    T * Base() const {return reinterpret_cast<T *>(GrowingArrayBase::Base(sizeof(T)));}
+
     void Init(){
         int i;
-        for(i=Size()-1;i>=0;i--)
-            new(reinterpret_cast<T *>(Base())+i) T();
+        if ( tArrayPOD<T>::value )
+            tArrayBytes< tArrayPOD<T>::value != 0 >::Zero( Base(), Len() );
+        else
+            for(i=Size()-1;i>=0;i--)
+                new(Base()+i) T();
     }
 
     void resize(int i){
         int oldsize=Size();
-        ResizeBase(i,sizeof(T),MALLOC);
+        ResizeBase(i,sizeof(T),MALLOC,!tArrayPOD<T>::value);
         // dump(low,flow,"Array resize from " << oldsize << " to " << Size());
-        for(i=Size()-1;i>=oldsize;i--)
-            new(reinterpret_cast<T *>(Base())+i) T();
+        if ( !tArrayPOD<T>::value )
+            for(i=Size()-1;i>=oldsize;i--)
+                new(Base()+i) T();
     }
 
     //! fast data swap with other array
@@ -93,44 +143,55 @@ protected:
 
     void Clear(){
         int i;
-        for(i=Size()-1;i>=0;i--){
-            // dump(low,flow,"i=" << i);
-            ((reinterpret_cast<T *>(Base()))+i)->~T();
-        }
-        Delete(MALLOC);
+        if ( !tArrayPOD<T>::value )
+            for(i=Size()-1;i>=0;i--){
+                // dump(low,flow,"i=" << i);
+                (Base()+i)->~T();
+            }
+        Delete(MALLOC,sizeof(T));
     }
 
 
     void CopyFrom(const tArray &A){
         int i;
+        if ( tArrayPOD<T>::value )
+        {
+            tArrayBytes< tArrayPOD<T>::value != 0 >::Copy( Base(), A.Base(), Len() );
+            return;
+        }
         for(i=Len()-1;i>=0;i--)
-            new(reinterpret_cast<T *>(Base())+i) T(A(i));
+            new(Base()+i) T(A(i));
         for(i=Len();i<Size();i++)
-            new(reinterpret_cast<T *>(Base())+i) T();
+            new(Base()+i) T();
     }
 
 public:
     void SetLen(int i){
+        int oldlen=Len();
         GrowingArrayBase::SetLen(i);
         if (i>Size()) resize(i);
+
+        // plain data is not initialized with the capacity, but when it gets used
+        if ( tArrayPOD<T>::value && i>oldlen )
+            tArrayBytes< tArrayPOD<T>::value != 0 >::Zero( Base()+oldlen, i-oldlen );
     }
 
     ~tArray(){
         tERR_FLOW_LOW();
         Clear();
-        Delete(MALLOC);
+        Delete(MALLOC,sizeof(T));
     }
 
 
     tArray(int firstsize=0)
-            :GrowingArrayBase(firstsize,sizeof(T),MALLOC) {
+            :GrowingArrayBase(firstsize,sizeof(T),MALLOC,!tArrayPOD<T>::value) {
         // dump(low,flow,"con:size " << firstsize);
         Init();
     }
 
 
     tArray(const tArray &A)
-            :GrowingArrayBase(A.Len(),sizeof(T),MALLOC){
+            :GrowingArrayBase(A.Len(),sizeof(T),MALLOC,!tArrayPOD<T>::value){
         CopyFrom(A);
     }
 
@@ -148,14 +209,14 @@ public:
 
         //    dump(low,flow,"[" << i << "]" << "=" << ((T *)Base())[i] << '\n');
 
-        return((reinterpret_cast<T *>(Base()))[i]);
+        return(Base()[i]);
     }
 
 
     T& operator()(int i) const{
         tASSERT( i >= 0 && i < Len() );
 
-        return((reinterpret_cast<T *>(Base()))[i]);
+        return(Base()[i]);
     }
 
     T* operator+(int i) const{
@@ -166,7 +227,7 @@ public:
                             << i <<" of maximal " <<Len())}
     #endif
 
-        return(reinterpret_cast<T *>(Base())+i);
+        return(Base()+i);
     }
 
     const tArray<T> &operator=(const tArray<T> &A){
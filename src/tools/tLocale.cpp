@@ -34,10 +34,32 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include <fstream>
 #include <string>
 #include <map>
+#include <string.h>
 
 class tLocaleSubItem; // identifies a single string in a single language
 
-static tArray<tString> st_TemplateParameters;
+static tString st_TemplateParameters[10];
+
+// bumped whenever translations or the language choice change; invalidates
+// the languages the locale items have resolved to
+static int st_localeStamp = 0;
+
+// appends len characters at s to target
+static void st_Append( tString & target, char const * s, int len )
+{
+    if ( len <= 0 )
+        return;
+
+    int end = target.Len() > 0 ? target.Len() - 1 : 0;
+    target.SetLen( end + len + 1 );
+    memcpy( &target[end], s, len );
+    target[end + len] = '\0';
+}
+
+static void st_Append( tString & target, char const * s )
+{
+    st_Append( target, s, strlen( s ) );
+}
 
 static tString s_gameName("Armagetron"); // the official name of this game
 
@@ -49,12 +71,17 @@ class tLocaleItem: public tReferencable< tLocaleItem >    // idendifies a string
     tLocaleSubItem *items;  // the versions of various languages
     bool istemplate;        // does it contain \i-directives?
 
+    mutable tLocaleSubItem const * resolved; //!< the version to use, valid while resolvedStamp is current
+    mutable int resolvedStamp;                //!< st_localeStamp at the time resolved was determined
+
+    tLocaleSubItem const * Resolve() const;   //!< returns the version in the favorite language, NULL if there is none
 public:
     // static void Check();    // display warnings for all strings not defined in
     // the favorite language
 
     //  operator tString() const; // return the version of this string in the favorite language
     operator const char *() const;
+    void Print( tString & target ) const; //!< appends the version in the favorite language to target
 
     tLocaleItem(const char *identifier); // constructor taking the string identifier
     ~tLocaleItem();
@@ -79,16 +106,76 @@ typedef std::map< std::string, tJUST_CONTROLLED_PTR< tLocaleItem > > tLocaleItem
 static tLanguage *currentLanguage = NULL;
 
 
+//! a piece of a translation, split up for template replacement
+struct tLocaleSegment
+{
+    enum Type
+    {
+        Literal,   //!< text from the translation
+        Parameter, //!< a template parameter
+        GameName,  //!< the name of the game
+        Newline    //!< a line break
+    };
+
+    Type type;          //!< what this is
+    int start, length;  //!< literals: the position in the translation
+    int parameter;      //!< parameters: the parameter number
+
+    tLocaleSegment( Type t, int s = 0, int l = 0, int p = 0 )
+            : type( t ), start( s ), length( l ), parameter( p )
+    {}
+};
+
 class tLocaleSubItem: public tListItem<tLocaleSubItem>
 {
 public:
     const tLanguage *language;  // the language this string is in
     tString translation;        // the string itself
+    int length;                 // the length of the translation as a C string
+    std::vector< tLocaleSegment > segments; // the translation split up at the \i-directives
 
     tLocaleSubItem(tLocaleItem *item) // adds this SubItem to item
             : tListItem<tLocaleSubItem>(item->items){}
+
+    void Split(); //!< fills segments from translation
 };
 
+void tLocaleSubItem::Split()
+{
+    segments.clear();
+
+    // the translation may carry more than one terminator
+    int len = length = strlen( translation );
+    int literal = 0;
+    for(int i = 0; i < len; i++)
+    {
+        if (translation(i) != '\\')
+            continue;
+
+        if ( i > literal )
+            segments.push_back( tLocaleSegment( tLocaleSegment::Literal, literal, i - literal ) );
+
+        // the directive and the character after it are consumed, unknown ones vanish
+        char c = translation(i+1);
+        if (c == 'g')
+            segments.push_back( tLocaleSegment( tLocaleSegment::GameName ) );
+        else
+        {
+            int index = c-'0';
+            if (index > 0 && index < 10)
+                segments.push_back( tLocaleSegment( tLocaleSegment::Parameter, 0, 0, index ) );
+            else if (c == '\\')
+                segments.push_back( tLocaleSegment( tLocaleSegment::Newline ) );
+        }
+
+        i++;
+        literal = i + 1;
+    }
+
+    if ( len > literal )
+        segments.push_back( tLocaleSegment( tLocaleSegment::Literal, literal, len - literal ) );
+}
+
 
 
 tLanguage::tLanguage(const tString& n)
@@ -106,12 +193,14 @@ tLanguage* tLanguage::FirstLanguage()
 void tLanguage::SetFirstLanguage()  const
 {
     st_firstLanguage = this;
+    st_localeStamp++;
     Load();
 }
 
 void tLanguage::SetSecondLanguage() const
 {
     st_secondLanguage = this;
+    st_localeStamp++;
     Load();
 }
 
@@ -190,26 +279,29 @@ void tLocaleItem::Check()
 }
 */
 
-tLocaleItem::operator const char *() const// return the version of this string in the favorite language
+tLocaleSubItem const * tLocaleItem::Resolve() const
 {
+    if ( resolvedStamp == st_localeStamp )
+        return resolved;
+
     static tLanguage * english = tLanguage::FindStrict( tString("British English") );
 
-    tString *first = NULL, *second = NULL, *third = NULL, *fourth = NULL;
-    const tString *ret = NULL;
+    tLocaleSubItem const *first = NULL, *second = NULL, *third = NULL, *fourth = NULL;
+    tLocaleSubItem const *ret = NULL;
 
     tLocaleSubItem *run = items;
     while (run)
     {
         if (st_firstLanguage && run->language == st_firstLanguage)
-            first = &run->translation;
+            first = run;
 
         if (st_secondLanguage && run->language == st_secondLanguage)
-            second = &run->translation;
+            second = run;
 
         if (run->language == english)
-            third = &run->translation;
+            third = run;
 
-        fourth = &run->translation;
+        fourth = run;
         run = run->Next();
     }
 
@@ -229,53 +321,78 @@ tLocaleItem::operator const char *() const// return the version of this string i
             {
                 loadEnglish = false;
                 english->Load();
-                return *this;
+                return Resolve();
             }
         }
 
-        if (!ret && fourth)
-            ret = fourth;
         if (!ret)
-            ret = &identifier;
+            ret = fourth;
+    }
+
+    resolved = ret;
+    resolvedStamp = st_localeStamp;
+    return ret;
+}
+
+void tLocaleItem::Print( tString & target ) const
+{
+    tLocaleSubItem const * ret = Resolve();
+    if (!ret)
+    {
+        st_Append( target, identifier );
+        return;
     }
 
+    const tString& temp = ret->translation;
     if (!istemplate)
-        return *ret;   // no template replacements need to be made
-    else
     {
-        const tString& temp = *ret;
-        static tString        replaced;
-        replaced.Clear();
-        for(int i = 0; i < temp.Len(); i++)
+        // no template replacements need to be made
+        st_Append( target, temp, ret->length );
+        return;
+    }
+
+    for ( std::vector< tLocaleSegment >::const_iterator i = ret->segments.begin(); i != ret->segments.end(); ++i )
+    {
+        switch ( i->type )
         {
-            char c = temp(i);
-            if (c != '\\')
-                replaced += c;
-            else if (i < temp.Len() - 1)
+        case tLocaleSegment::Literal:
+            st_Append( target, &temp( i->start ), i->length );
+            break;
+        case tLocaleSegment::Parameter:
             {
-                c = temp(i+1);
-                if (c == 'g')
-                    replaced << s_gameName;
-                else
-                {
-                    int index = c-'0';
-                    if (index > 0 && index < 10)
-                        replaced << st_TemplateParameters[index];
-                    else if (temp(i+1) == '\\')
-                        replaced << '\n';
-                }
-                i++;
+                st_Append( target, st_TemplateParameters[ i->parameter ] );
             }
+            break;
+        case tLocaleSegment::GameName:
+            st_Append( target, s_gameName );
+            break;
+        case tLocaleSegment::Newline:
+            target << '\n';
+            break;
         }
-
-        return replaced;
     }
 }
 
+tLocaleItem::operator const char *() const// return the version of this string in the favorite language
+{
+    tLocaleSubItem const * ret = Resolve();
+    if (!ret)
+        return identifier;
+
+    if (!istemplate)
+        return ret->translation;   // no template replacements need to be made
+
+    static tString replaced;
+    replaced.SetLen(0);
+    Print( replaced );
+
+    return replaced;
+}
+
 
 tLocaleItem::tLocaleItem(const char *id) // constructor taking the string identifier
 //:tListItem<tLocaleItem>(st_localeAnchor),
-        :identifier(id), items(NULL), istemplate(false)
+        :identifier(id), items(NULL), istemplate(false), resolved(NULL), resolvedStamp(-1)
 {
 }
 
@@ -328,6 +445,8 @@ static const tString INCLUDE("include");
 
 void tLocaleItem::Load(const char *file, bool complete)  // load the language definitions from a file
 {
+    st_localeStamp++;
+
     // bool check = false;
     {
         tString f;
@@ -455,6 +574,7 @@ void tLocaleItem::Load(const char *file, bool complete)  // load the language de
                 }
 
                 r->language = currentLanguage;
+                r->Split();
                 //	r->translation.ReadLine(s);
 
 
@@ -468,84 +588,48 @@ void tLocaleItem::Load(const char *file, bool complete)  // load the language de
     */
 }
 
-class tOutputItemLocale: public tOutputItemBase
-{
-    const tLocaleItem *element;
-public:
-    tOutputItemLocale(tOutput& o, const tLocaleItem& e);
-    virtual void Print(tString& target) const;
-    virtual void Clone(tOutput& o)      const;
-};
-
-class tOutputItemSpace: public tOutputItemBase
-{
-public:
-    tOutputItemSpace(tOutput& o);
-    virtual void Print(tString& target) const;
-    virtual void Clone(tOutput& o)      const;
-};
-
-
-class tOutputItemTemplate: public tOutputItemBase
-{
-    int       num;
-    tString   parameter;
-public:
-    tOutputItemTemplate(tOutput& o, int n, const char *p);
-    virtual void Print(tString& target) const;
-    virtual void Clone(tOutput& o)      const;
-};
-
-
-tOutput::tOutput(): anchor(0){}
-tOutput::~tOutput()
-{
-    while (anchor)
-        delete anchor;
-}
+tOutput::tOutput(){}
+tOutput::~tOutput(){}
 
 void tOutput::Clear()
 {
-    while (anchor)
-        delete anchor;
+    items_.clear();
+    text_.SetLen(0);
 }
 
-
-static void getstring(tString &target, tOutputItemBase *item)
+void tOutput::AddText( Item::Type type, int num, int start )
 {
-    if (!item)
-        return;
-    getstring(target, item->Next());
-    item->Print(target);
+    items_.push_back( Item( type, NULL, num, start, TextLength() - start ) );
 }
 
-/*
-tOutput::operator tString() const
+void tOutput::Print( tString & target ) const
 {
-#ifdef DEBUG
-#ifndef WIN32
-	static bool recursion = false;
-	if (recursion)
+    for ( std::vector< Item >::const_iterator i = items_.begin(); i != items_.end(); ++i )
     {
-		tERR_ERROR_INT("Locale Recursion!");
+        switch ( i->type )
+        {
+        case Item::Literal:
+            if ( i->length > 0 )
+                st_Append( target, &text_( i->start ), i->length );
+            break;
+        case Item::Locale:
+            i->locale->Print( target );
+            break;
+        case Item::Space:
+            target << ' ';
+            break;
+        case Item::Parameter:
+            if ( i->num >= 0 && i->num < 10 )
+            {
+                tString & parameter = st_TemplateParameters[ i->num ];
+                parameter.SetLen(0);
+                if ( i->length > 0 )
+                    st_Append( parameter, &text_( i->start ), i->length );
+            }
+            break;
+        }
     }
-	recursion = true;
-#endif
-#endif
-
-	static tString x;
-	x.Clear();
-	getstring(x, anchor);
-
-#ifdef DEBUG
-#ifndef WIN32
-	recursion = false;
-#endif
-#endif
-
-	return x;
 }
-*/
 
 tOutput::operator const char *() const
 {
@@ -560,15 +644,15 @@ tOutput::operator const char *() const
 #endif
 #endif
 
-    // get a relatively safe buffer to write to
+    // get a relatively safe buffer to write to; the buffers keep their memory
     static const int maxstrings = 5;
     static int current = 0;
     static tString buffers[maxstrings];
     tString & x = buffers[current];
     current = ( current + 1 ) % maxstrings;
 
-    x.Clear();
-    getstring(x, anchor);
+    x.SetLen(0);
+    Print(x);
 
 #ifdef DEBUG
 #ifndef WIN32
@@ -582,145 +666,97 @@ tOutput::operator const char *() const
 
 void tOutput::AddLiteral(const char *x)
 {
-    tNEW(tOutputItem<tString>)(*this, tString(x));
+    int start = TextLength();
+    text_ += x;
+    AddText( Item::Literal, 0, start );
 }
 
 void tOutput::AddSpace()
 {
-    tNEW(tOutputItemSpace)(*this);
+    items_.push_back( Item( Item::Space ) );
 }
 
 void tOutput::AddLocale(const char *x)
 {
-    tNEW(tOutputItemLocale)(*this, tLocale::Find(x));
+    items_.push_back( Item( Item::Locale, &tLocale::Find(x) ) );
 }
 
 
 tOutput & tOutput::SetTemplateParameter(int num, const char *parameter)
 {
-    tNEW(tOutputItemTemplate)(*this, num, parameter);
+    int start = TextLength();
+    text_ += parameter;
+    AddText( Item::Parameter, num, start );
     return *this;
 }
 
 tOutput &  tOutput::SetTemplateParameter(int num, int parameter)
 {
-    tString p;
-    p << parameter;
-    tNEW(tOutputItemTemplate)(*this, num, p);
+    int start = TextLength();
+    text_ << parameter;
+    AddText( Item::Parameter, num, start );
 
     return *this;
 }
 
 tOutput & tOutput::SetTemplateParameter(int num, float parameter)
 {
-    tString p;
-    p << parameter;
-    tNEW(tOutputItemTemplate)(*this, num, p);
+    int start = TextLength();
+    text_ << parameter;
+    AddText( Item::Parameter, num, start );
 
     return *this;
 }
 
 
 tOutput::tOutput(const tString& x)
-        :anchor(NULL)
 {
-    tNEW(tOutputItem<tString>)(*this, x);
+    AddLiteral( x );
 }
 
 tOutput::tOutput(const char * x)
-        :anchor(NULL)
 {
     *this << x;
 }
 
 
 tOutput::tOutput(const tLocaleItem &locale)
-        :anchor(NULL)
 {
-    tNEW(tOutputItemLocale)(*this, locale);
-}
-
-
-static void copyrec(tOutput &targ, tOutputItemBase *it)
-{
-    if (!it)
-        return;
-
-    copyrec(targ, it->Next());
-    it->Clone(targ);
+    items_.push_back( Item( Item::Locale, &locale ) );
 }
 
 tOutput::tOutput(const tOutput &o)
-        :anchor(NULL)
+        :items_( o.items_ ), text_( o.text_ )
 {
-    copyrec(*this, o.anchor);
 }
 
 tOutput& tOutput::operator=(const tOutput &o)
 {
-    Clear();
-
-    copyrec(*this, o.anchor);
+    if ( &o != this )
+    {
+        items_ = o.items_;
+        text_ = o.text_;
+    }
 
     return *this;
 }
 
 void tOutput::Append(const tOutput &o)
 {
-    copyrec(*this, o.anchor);
-}
-
-
-tOutputItemBase::tOutputItemBase(tOutput& o): tListItem<tOutputItemBase>(o.anchor){}
-
-tOutputItemBase::~tOutputItemBase(){}
-
-
-
-tOutputItemLocale::tOutputItemLocale(tOutput& o, const tLocaleItem& e)
-        :tOutputItemBase(o),
-        element(&e)
-{
-}
-
-void tOutputItemLocale::Print(tString& target) const
-{
-    target << *element;
-}
-
-void tOutputItemLocale::Clone(tOutput& o)      const
-{
-    tNEW(tOutputItemLocale)(o, *element);
-}
-
-
-tOutputItemSpace::tOutputItemSpace(tOutput& o)
-        :tOutputItemBase(o)
-{}
-
-void tOutputItemSpace::Print(tString& target) const
-{
-    target << ' ';
-}
-
-void tOutputItemSpace::Clone(tOutput& o)      const
-{
-    tNEW(tOutputItemSpace)(o);
-}
-
-
-tOutputItemTemplate::tOutputItemTemplate(tOutput& o, int n, const char *p)
-        :tOutputItemBase(o), num(n), parameter(p)
-{}
-
-void tOutputItemTemplate::Print(tString& target) const
-{
-    st_TemplateParameters[num] = parameter;
-}
+    if ( &o == this )
+    {
+        tOutput copy( o );
+        Append( copy );
+        return;
+    }
 
-void tOutputItemTemplate::Clone(tOutput& o)      const
-{
-    tNEW(tOutputItemTemplate)(o, num, parameter);
+    int offset = TextLength();
+    st_Append( text_, o.text_, o.TextLength() );
+    for ( std::vector< Item >::const_iterator i = o.items_.begin(); i != o.items_.end(); ++i )
+    {
+        items_.push_back( *i );
+        items_.back().start += offset;
+    }
 }
 
 
@@ -735,11 +771,11 @@ tOutput& operator << (tOutput &o, const char *locale){
     if (len == 0)
         return o;
     if (len == 1 && locale[0] == ' ')
-        tNEW(tOutputItemSpace)(o);
+        o.AddSpace();
     else if (locale[0] == '$')
-        tNEW(tOutputItemLocale)(o, tLocale::Find(locale+1));
+        o.AddLocale(locale+1);
     else
-        tNEW(tOutputItem<tString>)(o, tString(locale));
+        o.AddLiteral(locale);
 
     return o;
 }
@@ -747,7 +783,7 @@ tOutput& operator << (tOutput &o, const char *locale){
 // output operators
 std::ostream& operator<< (std::ostream& s, const tOutput& o)
 {
-    return s << tString(o);
+    return s << static_cast< const char * >( o );
 }
 
 /*
@@ -760,7 +796,7 @@ std::stringstream& operator<< (std::stringstream& s, const tOutput& o)
 
 tString& operator<< (tString& s, const tOutput& o)
 {
-    s << tString(o);
+    o.Print(s);
     return s;
 }
 
@@ -801,6 +837,6 @@ std::ostream& operator<<(std::ostream& s, const tLocaleItem &t)
 
 tString& operator<< (tString& s, const tLocaleItem& o)
 {
-    s << static_cast<const char *>(o);
+    o.Print(s);
     return s;
 }
@@ -31,9 +31,10 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include "tString.h"
 #include "tLinkedList.h"
 
+#include <vector>
+
 
 class tLocaleItem;
-class tOutputItemBase;
 
 class tLanguage: public tListItem<tLanguage>      // identifies a language
 {
@@ -77,21 +78,53 @@ public:
 */
 
 class tOutput{
-    friend class tOutputItemBase;
-
-    tOutputItemBase *anchor;
+    //! one element of the output
+    struct Item
+    {
+        enum Type
+        {
+            Literal,   //!< language independent text
+            Locale,    //!< a language dependant string
+            Space,     //!< a simple space
+            Parameter  //!< sets a template parameter for the locales that follow
+        };
+
+        Type type;                  //!< what this is
+        int num;                    //!< the template parameter number
+        int start, length;          //!< literals and parameters: the position of the text in text_
+        tLocaleItem const * locale; //!< locales: the item to print
+
+        Item( Type t, tLocaleItem const * l = NULL, int n = 0, int s = 0, int len = 0 )
+                : type( t ), num( n ), start( s ), length( len ), locale( l )
+        {}
+    };
+
+    std::vector< Item > items_; //!< the elements in order
+    tString text_;              //!< the text of all literals and parameters, back to back
 
     tOutput& operator << (const tOutput &o);
+
+    int TextLength() const { return text_.Len() > 0 ? text_.Len() - 1 : 0; } //!< the length of text_ without terminator
+    void AddText( Item::Type type, int num, int start ); //!< adds an item for the text appended to text_ since start
 public:
     tOutput();
     ~tOutput();
 
     operator const char *() const;    // creates the output string
     //  operator tString() const;    // creates the output string
+    void Print( tString & target ) const; //!< appends the output string to target
     void AddLiteral(const char *);       // adds a language independent string
     void AddLocale(const char *);        // adds a language dependant string
     void AddSpace();                     // adds a simple space
 
+    //! adds a language independent string made from anything that can be written to a tString
+    template< class T > void AddLiteralItem( T const & element )
+    {
+        int start = TextLength();
+        text_ << element;
+        AddText( Item::Literal, 0, start );
+    }
+
     // set a template parameter at this position of the output string
     tOutput & SetTemplateParameter(int num, const char *parameter);
     tOutput & SetTemplateParameter(int num, int         parameter);
@@ -107,30 +140,27 @@ public:
     // convenience template constructors: fill in template parameters with passed value
     template< class T1>
     tOutput( char const * identifier, T1 const & template1 )
-            :anchor(NULL)
     {
         tASSERT( identifier && identifier[0] == '$' );
 
         SetTemplateParameter(1, template1);
 
-        *this << identifier;
+        AddLocale( identifier + 1 );
     }
 
     template< class T1, class T2 >
     tOutput( char const * identifier, T1 const & template1, T2 const & template2 )
-            :anchor(NULL)
     {
         tASSERT( identifier && identifier[0] == '$' );
 
         SetTemplateParameter(1, template1);
         SetTemplateParameter(2, template2);
 
-        *this << identifier;
+        AddLocale( identifier + 1 );
     }
 
     template< class T1, class T2, class T3 >
     tOutput( char const * identifier, T1 const & template1, T2 const & template2, T3 const & template3 )
-            :anchor(NULL)
     {
         tASSERT( identifier && identifier[0] == '$' );
 
@@ -138,12 +168,11 @@ public:
         SetTemplateParameter(2, template2);
         SetTemplateParameter(3, template3);
 
-        *this << identifier;
+        AddLocale( identifier + 1 );
     }
 
     template< class T1, class T2, class T3, class T4 >
     tOutput( char const * identifier, T1 const & template1, T2 const & template2, T3 const & template3, T4 const & template4 )
-            :anchor(NULL)
     {
         tASSERT( identifier && identifier[0] == '$' );
 
@@ -152,7 +181,7 @@ public:
         SetTemplateParameter(3, template3);
         SetTemplateParameter(4, template4);
 
-        *this << identifier;
+        AddLocale( identifier + 1 );
     }
 
     tOutput(const tOutput &o); // copy constructor
@@ -161,39 +190,14 @@ public:
     void Append(const tOutput &o);
 
     bool IsEmpty()const {
-        return !anchor;
+        return items_.empty();
     }
 };
 
-class tOutputItemBase: public tListItem<tOutputItemBase>
-{
-public:
-    tOutputItemBase(tOutput& o);
-    virtual ~tOutputItemBase();
-    virtual void Print(tString& target) const = 0;
-    virtual void Clone(tOutput& o)      const = 0;
-};
-
-
-template <class T>class tOutputItem: public tOutputItemBase
-{
-    T element;
-    public:
-tOutputItem(tOutput& o, const T& e): tOutputItemBase(o), element(e){}
-virtual void Print(tString& target) const {
-    target << element;
-}
-virtual void Clone(tOutput& o)      const {
-    tNEW(tOutputItem<T>)(o, element);
-}
-};
-
-
-
 // now the print template:
 template<class T> tOutput&  operator<< (tOutput& o, const T& e)
 {
-    tNEW(tOutputItem<T>)(o, e);
+    o.AddLiteralItem( e );
     return o;
 }
 
@@ -0,0 +1,443 @@
+/*
+
+*************************************************************************
+
+ArmageTron -- Just another Tron Lightcycle Game in 3D.
+Copyright (C) 2005  Manuel Moos (manuel@moosnet.de)
+
+**************************************************************************
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+***************************************************************************
+
+*/
+
+#include "tLogSink.h"
+#include "tDirectories.h"
+#include "tConfiguration.h"
+#include "tLocale.h"
+#include "tConsole.h"
+#include "tToDo.h"
+
+#include <string>
+#include <vector>
+
+#ifdef HAVE_LIBZTHREAD
+#include <zthread/Thread.h>
+#include <zthread/FastMutex.h>
+#include <zthread/Condition.h>
+#define tLOG_THREADED
+#elif defined(HAVE_PTHREAD)
+#include "pthread-binding.h"
+#define tLOG_THREADED
+#endif
+
+// maximal number of bytes waiting to be written; further lines are dropped
+static int st_logQueueSize = 1 << 20;
+static tSettingItem< int > st_logQueueSizeConf( "LOG_QUEUE_SIZE", st_logQueueSize );
+
+#ifdef HAVE_LIBZTHREAD
+typedef ZThread::FastMutex tLogMutex;
+typedef ZThread::Condition tLogCondition;
+#elif defined(HAVE_PTHREAD)
+typedef tPThreadMutex tLogMutex;
+typedef tPThreadCondition tLogCondition;
+#else
+class tLogMutex
+{
+public:
+    void acquire(){}
+    void release(){}
+};
+#endif
+
+//! a line waiting to be written
+struct tLogLine
+{
+    tLogSink * sink;
+    std::string text;
+};
+
+//! owns the queue shared by all sinks and the thread emptying it
+class tLogWriter
+{
+public:
+    tLogWriter();
+    ~tLogWriter();                           //!< stops the thread and writes out the rest
+
+    void Queue( tLogSink & sink, tString const & text ); //!< queues a line, called from the game thread only
+    void Flush();                            //!< writes everything and closes all files
+    void CommitQueue( bool close );          //!< synchronously writes everything queued
+
+    void PrintStats();                       //!< prints the counters to the console
+
+#ifdef tLOG_THREADED
+    void Run();                              //!< the writer thread's loop
+#endif
+private:
+    void Commit( bool close );               //!< writes batch_ to the files
+
+    tLogMutex mutex_;                        //!< protects the queue and the counters
+
+    std::vector< tLogLine > queue_;          //!< lines waiting to be written
+    std::vector< tLogLine > batch_;          //!< lines currently being written, writer only
+    std::vector< tLogSink * > open_;         //!< sinks with open files, writer only
+    size_t queuedBytes_;                     //!< bytes in queue_
+
+    unsigned long queued_, written_, dropped_, commits_; //!< statistics
+    bool dropping_;                          //!< set while lines are dropped, so the warning is printed once
+    bool commitScheduled_;                   //!< set when a synchronous commit is scheduled via st_ToDo
+
+#ifdef tLOG_THREADED
+    void Start();                            //!< starts the thread
+
+    tLogCondition changed_;                  //!< signalled when the queue or the writer state changed
+    bool running_, stop_, writing_, closeRequested_;
+#ifdef HAVE_LIBZTHREAD
+    ZThread::Thread * thread_;
+#else
+    pthread_t thread_;
+#endif
+#endif
+};
+
+#ifdef tLOG_THREADED
+#ifdef HAVE_LIBZTHREAD
+//! forwards ZThread's run() to the writer without letting the task own it
+class tLogWriterTask: public ZThread::Runnable
+{
+public:
+    explicit tLogWriterTask( tLogWriter & writer ): writer_( writer ){}
+    virtual void run(){ writer_.Run(); }
+private:
+    tLogWriter & writer_;
+};
+#else
+static void * st_RunLogWriter( void * writer )
+{
+    static_cast< tLogWriter * >( writer )->Run();
+    return NULL;
+}
+#endif
+#endif
+
+// the writer; created with the first sink and destroyed with the last
+static tLogWriter * st_logWriter = NULL;
+static int st_logSinkCount = 0;
+
+tLogWriter::tLogWriter()
+    : queuedBytes_( 0 )
+    , queued_( 0 ), written_( 0 ), dropped_( 0 ), commits_( 0 )
+    , dropping_( false ), commitScheduled_( false )
+#ifdef tLOG_THREADED
+    , changed_( mutex_ )
+    , running_( false ), stop_( false ), writing_( false ), closeRequested_( false )
+#endif
+{
+}
+
+tLogWriter::~tLogWriter()
+{
+#ifdef tLOG_THREADED
+    if ( running_ )
+    {
+        mutex_.acquire();
+        stop_ = true;
+        changed_.broadcast();
+        mutex_.release();
+
+#ifdef HAVE_LIBZTHREAD
+        thread_->wait();
+        delete thread_;
+#else
+        pthread_join( thread_, NULL );
+#endif
+        running_ = false;
+    }
+#endif
+    CommitQueue( true );
+}
+
+#ifdef tLOG_THREADED
+void tLogWriter::Start()
+{
+    running_ = true;
+#ifdef HAVE_LIBZTHREAD
+    thread_ = new ZThread::Thread( ZThread::Task( new tLogWriterTask( *this ) ) );
+#else
+    if ( 0 != pthread_create( &thread_, NULL, &st_RunLogWriter, this ) )
+    {
+        running_ = false;
+    }
+#endif
+}
+
+void tLogWriter::Run()
+{
+    mutex_.acquire();
+    for(;;)
+    {
+        while ( queue_.empty() && !closeRequested_ && !stop_ )
+        {
+            changed_.wait();
+        }
+        if ( queue_.empty() && !closeRequested_ )
+        {
+            break;
+        }
+
+        // take everything queued so far and write it as one batch
+        batch_.swap( queue_ );
+        queuedBytes_ = 0;
+        dropping_ = false;
+        bool close = closeRequested_;
+        closeRequested_ = false;
+        writing_ = true;
+        mutex_.release();
+
+        Commit( close );
+
+        mutex_.acquire();
+        writing_ = false;
+        changed_.broadcast();
+    }
+    mutex_.release();
+}
+#endif
+
+// scheduled via st_ToDo when there is no writer thread
+static void st_CommitLogQueue()
+{
+    if ( st_logWriter )
+    {
+        st_logWriter->CommitQueue( false );
+    }
+}
+
+void tLogWriter::Queue( tLogSink & sink, tString const & text )
+{
+    std::string line( static_cast< char const * >( text ) );
+
+    mutex_.acquire();
+    if ( st_logQueueSize > 0 && queuedBytes_ + line.size() > static_cast< size_t >( st_logQueueSize ) )
+    {
+        ++dropped_;
+        bool warn = !dropping_;
+        dropping_ = true;
+        mutex_.release();
+
+        if ( warn )
+        {
+            con << tOutput( "$log_queue_dropping", sink.fileName_ );
+        }
+        return;
+    }
+
+    queue_.push_back( tLogLine() );
+    queue_.back().sink = &sink;
+    queue_.back().text.swap( line );
+    queuedBytes_ += queue_.back().text.size();
+    ++queued_;
+
+#ifdef tLOG_THREADED
+    if ( !running_ )
+    {
+        Start();
+    }
+    if ( running_ )
+    {
+        changed_.broadcast();
+        mutex_.release();
+        return;
+    }
+#endif
+    bool schedule = !commitScheduled_;
+    commitScheduled_ = true;
+    mutex_.release();
+
+    // no thread: write everything queued during this frame in one go
+    if ( schedule )
+    {
+        st_ToDo( &st_CommitLogQueue );
+    }
+}
+
+void tLogWriter::Flush()
+{
+#ifdef tLOG_THREADED
+    mutex_.acquire();
+    if ( running_ )
+    {
+        closeRequested_ = true;
+        changed_.broadcast();
+        while ( closeRequested_ || writing_ || !queue_.empty() )
+        {
+            changed_.wait();
+        }
+        mutex_.release();
+        return;
+    }
+    mutex_.release();
+#endif
+    CommitQueue( true );
+}
+
+void tLogWriter::CommitQueue( bool close )
+{
+    mutex_.acquire();
+    batch_.swap( queue_ );
+    queuedBytes_ = 0;
+    dropping_ = false;
+    commitScheduled_ = false;
+    mutex_.release();
+
+    Commit( close );
+}
+
+void tLogWriter::Commit( bool close )
+{
+    if ( !batch_.empty() )
+    {
+        std::vector< tLogSink * > touched;
+        for ( std::vector< tLogLine >::const_iterator i = batch_.begin(); i != batch_.end(); ++i )
+        {
+            tLogSink & sink = *i->sink;
+            if ( !sink.file_.is_open() && sink.Open() )
+            {
+                open_.push_back( &sink );
+            }
+            if ( sink.file_.is_open() )
+            {
+                sink.file_ << i->text;
+                if ( touched.empty() || touched.back() != &sink )
+                {
+                    touched.push_back( &sink );
+                }
+            }
+        }
+
+        // one flush per file and batch, not per line
+        for ( std::vector< tLogSink * >::const_iterator i = touched.begin(); i != touched.end(); ++i )
+        {
+            (*i)->file_.flush();
+        }
+
+        mutex_.acquire();
+        written_ += batch_.size();
+        ++commits_;
+        mutex_.release();
+
+        batch_.clear();
+    }
+
+    if ( close )
+    {
+        for ( std::vector< tLogSink * >::const_iterator i = open_.begin(); i != open_.end(); ++i )
+        {
+            (*i)->file_.close();
+        }
+        open_.clear();
+    }
+}
+
+void tLogWriter::PrintStats()
+{
+    mutex_.acquire();
+    tOutput o;
+    o.SetTemplateParameter( 1, static_cast< int >( queued_ ) );
+    o.SetTemplateParameter( 2, static_cast< int >( written_ ) );
+    o.SetTemplateParameter( 3, static_cast< int >( dropped_ ) );
+    o.SetTemplateParameter( 4, static_cast< int >( commits_ ) );
+    o.SetTemplateParameter( 5, static_cast< int >( queue_.size() ) );
+    o.SetTemplateParameter( 6, static_cast< int >( queuedBytes_ ) );
+    o << "$log_queue_stats";
+    mutex_.release();
+
+    con << o;
+}
+
+static void st_LogQueueStats( std::istream & )
+{
+    if ( st_logWriter )
+    {
+        st_logWriter->PrintStats();
+    }
+}
+
+static tConfItemFunc st_logQueueStatsConf( "LOG_QUEUE_STATS", &st_LogQueueStats );
+
+tLogSink::tLogSink( char const * fileName )
+    : fileName_( fileName )
+{
+    if ( !st_logWriter )
+    {
+        st_logWriter = new tLogWriter;
+    }
+    ++st_logSinkCount;
+}
+
+tLogSink::~tLogSink()
+{
+    st_logWriter->Flush();
+    if ( --st_logSinkCount == 0 )
+    {
+        delete st_logWriter;
+        st_logWriter = NULL;
+    }
+}
+
+void tLogSink::Write( tString const & text )
+{
+    if ( st_logWriter )
+    {
+        st_logWriter->Queue( *this, text );
+    }
+    else
+    {
+        // shutting down, write directly
+        if ( file_.is_open() || Open() )
+        {
+            file_ << text;
+            file_.close();
+        }
+    }
+}
+
+bool tLogSink::Open()
+{
+    // resolve the path only once; the var directory may be gone by the time
+    // the last lines get written on shutdown
+    if ( path_.Len() <= 1 )
+    {
+        path_ = tDirectories::Var().GetWritePath( fileName_ );
+        if ( path_.Len() <= 1 )
+        {
+            return false;
+        }
+    }
+
+    file_.clear();
+    file_.open( path_, std::ios::app );
+    return file_.is_open();
+}
+
+void tLogSink::FlushAll()
+{
+    if ( st_logWriter )
+    {
+        st_logWriter->Flush();
+    }
+}
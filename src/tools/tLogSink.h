@@ -0,0 +1,63 @@
+/*
+
+*************************************************************************
+
+ArmageTron -- Just another Tron Lightcycle Game in 3D.
+Copyright (C) 2005  Manuel Moos (manuel@moosnet.de)
+
+**************************************************************************
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+***************************************************************************
+
+*/
+
+#ifndef ArmageTron_LOGSINK_H
+#define ArmageTron_LOGSINK_H
+
+#include "tString.h"
+
+#include <fstream>
+
+class tLogWriter;
+
+//! append-only log file in the var directory (ladderlog.txt and friends).
+//! Lines are queued without touching the disk; a writer thread (or, in builds
+//! without thread support, the next st_DoToDo()) appends everything queued
+//! so far in one go and flushes each file once per batch.
+class tLogSink
+{
+    friend class tLogWriter;
+public:
+    explicit tLogSink( char const * fileName ); //!< creates a sink for a file relative to the var directory
+    ~tLogSink();                                //!< writes out everything queued for this sink
+
+    void Write( tString const & text );         //!< queues text to be appended to the file
+
+    static void FlushAll();                     //!< writes everything queued to disk and closes the files so they get reopened (and may be rotated) on the next write
+
+private:
+    tLogSink( tLogSink const & );
+    tLogSink & operator = ( tLogSink const & );
+
+    bool Open();                                //!< opens the file for appending
+
+    tString fileName_;                          //!< name of the file, relative to the var directory
+    tString path_;                              //!< full path of the file, resolved on first use
+    std::ofstream file_;                        //!< the open file; only touched by the writer
+};
+
+#endif
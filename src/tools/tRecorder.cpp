@@ -34,6 +34,8 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include    "tDirectories.h"
 #include    "tRecorderInternal.h"
 
+#include    <string.h>
+
 #undef 	INLINE_DEF
 #define INLINE_DEF
 
@@ -240,6 +242,184 @@ std::istream & operator >> ( std::istream & s, tLineString & line )
     return s;
 }
 
+// *****************************************************************************************
+// *
+// *	WriteUnsigned
+// *
+// *****************************************************************************************
+//!
+//!		@param	stream	the stream to write to
+//!		@param	data	the number to write, seven bits per byte, lowest first
+//!
+// *****************************************************************************************
+
+void tRecorderBinary::WriteUnsigned( std::ostream & stream, unsigned long data )
+{
+    while ( data >= 0x80 )
+    {
+        stream.put( static_cast< char >( ( data & 0x7f ) | 0x80 ) );
+        data >>= 7;
+    }
+    stream.put( static_cast< char >( data ) );
+}
+
+// *****************************************************************************************
+// *
+// *	WriteSigned
+// *
+// *****************************************************************************************
+//!
+//!		@param	stream	the stream to write to
+//!		@param	data	the number to write; the sign goes to the lowest bit so small negative numbers stay short
+//!
+// *****************************************************************************************
+
+void tRecorderBinary::WriteSigned( std::ostream & stream, long data )
+{
+    unsigned long bits = static_cast< unsigned long >( data );
+    WriteUnsigned( stream, data < 0 ? ( ~bits << 1 ) | 1 : bits << 1 );
+}
+
+// *****************************************************************************************
+// *
+// *	WriteString
+// *
+// *****************************************************************************************
+//!
+//!		@param	stream	the stream to write to
+//!		@param	data	the string to write
+//!
+// *****************************************************************************************
+
+void tRecorderBinary::WriteString( std::ostream & stream, std::string const & data )
+{
+    WriteUnsigned( stream, data.size() );
+    stream.write( data.c_str(), data.size() );
+}
+
+// *****************************************************************************************
+// *
+// *	ReadUnsigned
+// *
+// *****************************************************************************************
+//!
+//!		@param	stream	the stream to read from
+//!		@return		    the number read
+//!
+// *****************************************************************************************
+
+unsigned long tRecorderBinary::ReadUnsigned( std::istream & stream )
+{
+    unsigned long data = 0;
+    int shift = 0;
+    int c;
+    do
+    {
+        c = stream.get();
+        if ( c == EOF )
+            break;
+        data |= static_cast< unsigned long >( c & 0x7f ) << shift;
+        shift += 7;
+    }
+    while ( ( c & 0x80 ) && shift < int( sizeof( unsigned long ) * 8 ) );
+
+    return data;
+}
+
+// *****************************************************************************************
+// *
+// *	ReadSigned
+// *
+// *****************************************************************************************
+//!
+//!		@param	stream	the stream to read from
+//!		@return		    the number read
+//!
+// *****************************************************************************************
+
+long tRecorderBinary::ReadSigned( std::istream & stream )
+{
+    unsigned long bits = ReadUnsigned( stream );
+    return static_cast< long >( ( bits & 1 ) ? ~( bits >> 1 ) : bits >> 1 );
+}
+
+// *****************************************************************************************
+// *
+// *	ReadString
+// *
+// *****************************************************************************************
+//!
+//!		@param	stream	the stream to read from
+//!		@return		    the string read
+//!
+// *****************************************************************************************
+
+std::string tRecorderBinary::ReadString( std::istream & stream )
+{
+    unsigned long len = ReadUnsigned( stream );
+    std::string data;
+    for ( unsigned long i = 0; i < len && stream.good(); ++i )
+        data += static_cast< char >( stream.get() );
+
+    return data;
+}
+
+// floats and doubles are stored byte by byte, little endian
+static bool st_LittleEndian()
+{
+    int one = 1;
+    return *reinterpret_cast< char * >( &one ) == 1;
+}
+
+template< class FLOAT > static void st_WriteFloat( std::ostream & stream, FLOAT data )
+{
+    static bool littleEndian = st_LittleEndian();
+    char bytes[ sizeof( FLOAT ) ];
+    memcpy( bytes, &data, sizeof( FLOAT ) );
+    for ( unsigned int i = 0; i < sizeof( FLOAT ); ++i )
+        stream.put( bytes[ littleEndian ? i : sizeof( FLOAT ) - 1 - i ] );
+}
+
+template< class FLOAT > static void st_ReadFloat( std::istream & stream, FLOAT & data )
+{
+    static bool littleEndian = st_LittleEndian();
+    char bytes[ sizeof( FLOAT ) ];
+    for ( unsigned int i = 0; i < sizeof( FLOAT ); ++i )
+        bytes[ littleEndian ? i : sizeof( FLOAT ) - 1 - i ] = static_cast< char >( stream.get() );
+    memcpy( &data, bytes, sizeof( FLOAT ) );
+}
+
+void tRecorderBinary::Write( std::ostream & stream, float data )
+{
+    st_WriteFloat( stream, data );
+}
+
+void tRecorderBinary::Write( std::ostream & stream, double data )
+{
+    st_WriteFloat( stream, data );
+}
+
+void tRecorderBinary::Read( std::istream & stream, float & data )
+{
+    st_ReadFloat( stream, data );
+}
+
+void tRecorderBinary::Read( std::istream & stream, double & data )
+{
+    st_ReadFloat( stream, data );
+}
+
+// line strings are stored without the escaping needed for the text format
+void tRecorderBinary::Write( std::ostream & stream, tLineString const & data )
+{
+    WriteString( stream, static_cast< char const * >( data ) );
+}
+
+void tRecorderBinary::Read( std::istream & stream, tLineString & data )
+{
+    data = tLineString( tString( ReadString( stream ).c_str() ) );
+}
+
 // *****************************************************************************************
 // *****************************************************************************************
 // *****************************************************************************************
@@ -265,6 +445,7 @@ bool tRecordingBlockBase::Initialize( char const * section, tRecording * recordi
         return false;
 
     // start section
+    binary_ = recording_->binary_;
     recording_->BeginSection( section );
 
     // return success
@@ -299,7 +480,8 @@ bool tRecordingBlockBase::Initialize( char const * section )
 
 void tRecordingBlockBase::Separator( void )
 {
-    GetRecordingStream() << "\n";
+    if ( !binary_ )
+        GetRecordingStream() << "\n";
     separate_ = false;
 }
 
@@ -328,7 +510,7 @@ tRecording * tRecordingBlockBase::GetArchive( void )
 // *****************************************************************************************
 
 tRecordingBlockBase::tRecordingBlockBase( void )
-        : separate_( true ), recording_( NULL )
+        : separate_( true ), binary_( false ), recording_( NULL )
 {
 }
 
@@ -423,6 +605,7 @@ bool tPlaybackBlockBase::Initialize( char const * section, tPlayback * playback
         playback_ = NULL;
         return false;
     }
+    binary_ = playback_->binary_;
 
     // return success
     return true;
@@ -481,7 +664,7 @@ tPlayback * tPlaybackBlockBase::GetArchive( void )
 // *****************************************************************************************
 
 tPlaybackBlockBase::tPlaybackBlockBase( void )
-        : playback_( 0 )
+        : binary_( false ), playback_( 0 )
 {
 }
 
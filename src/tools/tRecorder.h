@@ -41,6 +41,8 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 
 #include    "tString.h"
 
+#include    <sstream>
+
 // #include    "tRecorderInternal.h"
 
 // *****************************************************************************
@@ -245,6 +247,71 @@ public:
 
     static void Read  ( std::istream & stream, DATA & data, int nodummyrequired );        //!< reads a piece of data using a dummy
     static void Read  ( std::istream & stream, DATA & data, int * dummyrequired );        //!< reads a piece of data using a dummy
+
+    static void WriteBinary ( std::ostream & stream, DATA const & data, int nodummyrequired );  //!< writes a piece of data in binary
+    static void WriteBinary ( std::ostream & stream, DATA const & data, int * dummyrequired );  //!< writes a piece of data in binary using a dummy
+
+    static void ReadBinary  ( std::istream & stream, DATA & data, int nodummyrequired );  //!< reads a piece of binary data
+    static void ReadBinary  ( std::istream & stream, DATA & data, int * dummyrequired );  //!< reads a piece of binary data using a dummy
+};
+
+// *****************************************************************************
+// encoding of the data in binary recordings
+// *****************************************************************************
+
+//! reads and writes data of binary recordings. Integers are stored as variable length
+//! numbers, floating point numbers as little endian IEEE numbers and strings with their
+//! length in front. Other types are stored as text with the length in front.
+class tRecorderBinary
+{
+public:
+    static void WriteUnsigned( std::ostream & stream, unsigned long data ); //!< writes an unsigned variable length number
+    static void WriteSigned  ( std::ostream & stream, long data );          //!< writes a signed variable length number
+    static void WriteString  ( std::ostream & stream, std::string const & data ); //!< writes a string
+
+    static unsigned long ReadUnsigned( std::istream & stream );             //!< reads an unsigned variable length number
+    static long          ReadSigned  ( std::istream & stream );             //!< reads a signed variable length number
+    static std::string   ReadString  ( std::istream & stream );             //!< reads a string
+
+    static void Write( std::ostream & stream, bool data ){ stream.put( data ? 1 : 0 ); }
+    static void Write( std::ostream & stream, signed char data ){ WriteSigned( stream, data ); }
+    static void Write( std::ostream & stream, short data ){ WriteSigned( stream, data ); }
+    static void Write( std::ostream & stream, unsigned short data ){ WriteUnsigned( stream, data ); }
+    static void Write( std::ostream & stream, int data ){ WriteSigned( stream, data ); }
+    static void Write( std::ostream & stream, unsigned int data ){ WriteUnsigned( stream, data ); }
+    static void Write( std::ostream & stream, long data ){ WriteSigned( stream, data ); }
+    static void Write( std::ostream & stream, unsigned long data ){ WriteUnsigned( stream, data ); }
+    static void Write( std::ostream & stream, float data );
+    static void Write( std::ostream & stream, double data );
+    static void Write( std::ostream & stream, tLineString const & data );
+
+    static void Read( std::istream & stream, bool & data ){ data = ( stream.get() != 0 ); }
+    static void Read( std::istream & stream, signed char & data ){ data = ReadSigned( stream ); }
+    static void Read( std::istream & stream, short & data ){ data = ReadSigned( stream ); }
+    static void Read( std::istream & stream, unsigned short & data ){ data = ReadUnsigned( stream ); }
+    static void Read( std::istream & stream, int & data ){ data = ReadSigned( stream ); }
+    static void Read( std::istream & stream, unsigned int & data ){ data = ReadUnsigned( stream ); }
+    static void Read( std::istream & stream, long & data ){ data = ReadSigned( stream ); }
+    static void Read( std::istream & stream, unsigned long & data ){ data = ReadUnsigned( stream ); }
+    static void Read( std::istream & stream, float & data );
+    static void Read( std::istream & stream, double & data );
+    static void Read( std::istream & stream, tLineString & data );
+
+    //! writes anything else in text form
+    template< class T > static void Write( std::ostream & stream, T const & data )
+    {
+        std::ostringstream text;
+        text.precision( 10 );
+        text << data;
+        WriteString( stream, text.str() );
+    }
+
+    //! reads anything else from text form
+    template< class T > static void Read( std::istream & stream, T & data )
+    {
+        std::istringstream text( ReadString( stream ) );
+        text >> data;
+    }
 };
 
 // *****************************************************************************
@@ -269,6 +336,7 @@ protected:
     std::ostream & GetRecordingStream() const;                        //!< returns the stream to record to
 
     bool separate_;                                                   //!< flag indicating whether a separation is needed before the next data element
+    bool binary_;                                                     //!< flag indicating that the data is to be written in binary
 private:
     tRecording * recording_;                                          //!< the recording to record to
 };
@@ -291,6 +359,14 @@ public:
     {
         // get stream
         std::ostream & stream = GetRecordingStream();
+        typename tTypeToStream< T >::DUMMYREQUIRED dummyRequired = 0;
+
+        // binary data needs no separators
+        if ( binary_ )
+        {
+            tRecorderBlockHelper< T >::WriteBinary( stream, data, dummyRequired );
+            return *this;
+        }
 
         // add separator
         if ( separate_ )
@@ -298,7 +374,6 @@ public:
         separate_ = true;
 
         // delegate to dummy using or dummyless function
-        typename tTypeToStream< T >::DUMMYREQUIRED dummyRequired = 0;
         tRecorderBlockHelper< T >::Write( stream, data, dummyRequired );
 
         return *this;
@@ -324,6 +399,7 @@ protected:
 
     std::istream & GetPlaybackStream() const;                         //!< returns the stream to playback from
 
+    bool binary_;                                                     //!< flag indicating that the data is stored in binary
 private:
     tPlayback * playback_;                                             //!< the playback to read from
 };
@@ -346,7 +422,10 @@ public:
     {
         // delegate to dummy using or dummyless function
         typename tTypeToStream< T >::DUMMYREQUIRED dummyrequired = 0;
-        tRecorderBlockHelper< T >::Read( GetPlaybackStream(), data, dummyrequired );
+        if ( binary_ )
+            tRecorderBlockHelper< T >::ReadBinary( GetPlaybackStream(), data, dummyrequired );
+        else
+            tRecorderBlockHelper< T >::Read( GetPlaybackStream(), data, dummyrequired );
 
         return *this;
     }
@@ -1154,4 +1233,89 @@ void tRecorderBlockHelper< DATA >::Read( std::istream & stream, DATA & data, int
     data = static_cast< DATA >( dummy );
 }
 
+// ******************************************************************************************
+// *
+// *	WriteBinary
+// *
+// ******************************************************************************************
+//!
+//!		@param	stream	        the stream to write to
+//!     @param  data            the data to archive
+//!     @param  nodummyrequired dummy parameter indicating by type that no conversion is required
+//!
+// ******************************************************************************************
+
+template< class DATA >
+void tRecorderBlockHelper< DATA >::WriteBinary( std::ostream & stream, DATA const & data, int nodummyrequired )
+{
+    // write
+    tRecorderBinary::Write( stream, data );
+}
+
+// ******************************************************************************************
+// *
+// *	WriteBinary
+// *
+// ******************************************************************************************
+//!
+//!		@param	stream	        the stream to write to
+//!     @param  data            the data to archive
+//!     @param  dummyrequired   dummy parameter indicating by type that conversion is required
+//!
+// ******************************************************************************************
+
+template< class DATA >
+void tRecorderBlockHelper< DATA >::WriteBinary( std::ostream & stream, DATA const & data, int * dummyrequired )
+{
+    // write ( converted )
+    typedef typename tTypeToStream< DATA >::TOSTREAM TOSTREAM;
+    TOSTREAM dummy = static_cast< TOSTREAM >( data );
+    tRecorderBinary::Write( stream, dummy );
+}
+
+// ******************************************************************************************
+// *
+// *	ReadBinary
+// *
+// ******************************************************************************************
+//!
+//!		@param	stream	        the stream to read from
+//!     @param  data            the data to archive
+//!     @param  nodummyrequired dummy parameter indicating by type that no conversion is required
+//!
+// ******************************************************************************************
+
+template< class DATA >
+void tRecorderBlockHelper< DATA >::ReadBinary( std::istream & stream, DATA & data, int nodummyrequired )
+{
+    tASSERT( stream.good() );
+
+    // read
+    tRecorderBinary::Read( stream, data );
+}
+
+// ******************************************************************************************
+// *
+// *	ReadBinary
+// *
+// ******************************************************************************************
+//!
+//!		@param	stream	        the stream to read from
+//!     @param  data            the data to archive
+//!     @param  dummyrequired   dummy parameter indicating by type that conversion is required
+//!
+// ******************************************************************************************
+
+template< class DATA >
+void tRecorderBlockHelper< DATA >::ReadBinary( std::istream & stream, DATA & data, int * dummyrequired )
+{
+    tASSERT( stream.good() );
+
+    // read ( with conversion )
+    typedef typename tTypeToStream< DATA >::TOSTREAM TOSTREAM;
+    TOSTREAM dummy ;
+    tRecorderBinary::Read( stream, dummy );
+    data = static_cast< DATA >( dummy );
+}
+
 #endif // TRECORDING_H_INCLUDED
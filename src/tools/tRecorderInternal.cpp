@@ -40,6 +40,10 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 
 #include    "tCommandLine.h"
 #include    "tConsole.h"
+#include    "tRecorder.h"
+#include    "tSysTime.h"
+
+#include    <string.h>
 
 #undef  INLINE_DEF
 #define INLINE_DEF
@@ -70,10 +74,12 @@ tRecording::~tRecording()
 // *
 // ******************************************************************************************
 //!
+//!     @param  binary  true if values are to be written in binary
 //!
 // ******************************************************************************************
 
-tRecording::tRecording()
+tRecording::tRecording( bool binary )
+        : binary_( binary )
 {
     tASSERT( !currentRecording_ );
 
@@ -127,6 +133,21 @@ tRecording & tRecording::operator= ( tRecording const & other )
 // ******************************************************************************************
 
 void tRecording::BeginSection( char const * name )
+{
+    DoBeginSection( name );
+}
+
+// ******************************************************************************************
+// *
+// *    DoBeginSection
+// *
+// ******************************************************************************************
+//!
+//!     @param  name    the name of the new section
+//!
+// ******************************************************************************************
+
+void tRecording::DoBeginSection( char const * name )
 {
     DoGetStream() << "\n" << name;
 }
@@ -171,10 +192,12 @@ tPlayback::~tPlayback()
 // *
 // ******************************************************************************************
 //!
+//!     @param  binary  true if values are stored in binary
 //!
 // ******************************************************************************************
 
-tPlayback::tPlayback()
+tPlayback::tPlayback( bool binary )
+        : binary_( binary )
 {
     tASSERT( !currentPlayback_ );
 
@@ -255,18 +278,14 @@ void EatWhite( std::istream & stream )
 
 void tPlayback::AdvanceSection( void )
 {
-    std::istream& stream = DoGetStream();
-
-    std::ws( stream );
-    stream >> nextSection_;
-    std::ws( stream );
+    bool good = DoReadSection( nextSection_ );
 
     // memorize if end marking was seen
     static bool end = false;
     if ( nextSection_ == "END" )
         end = true;
 
-    if ( !stream.good() )
+    if ( !good )
     {
         if ( !end )
             con << "Recording ends abruptly here, prepare for a crash!\n";
@@ -277,6 +296,606 @@ void tPlayback::AdvanceSection( void )
     }
 }
 
+// ******************************************************************************************
+// *
+// *    DoReadSection
+// *
+// ******************************************************************************************
+//!
+//!     @param  name    the name of the next section to fill in
+//!     @return         false if the recording ended
+//!
+// ******************************************************************************************
+
+bool tPlayback::DoReadSection( std::string & name )
+{
+    std::istream& stream = DoGetStream();
+
+    std::ws( stream );
+    stream >> name;
+    std::ws( stream );
+
+    return stream.good();
+}
+
+// ******************************************************************************************
+// binary recordings
+// ******************************************************************************************
+
+// file layout: the header magic, then the blocks, each with
+//     'B', compression method, raw size, stored size, system time, data
+// then the index
+//     'I', number of blocks, ( offset, system time ) for each block
+// and at the very end the offset of the index and the index magic.
+static char const st_binaryMagic[] = "AATRBIN1";
+static char const st_indexMagic[]  = "AATRIDX1";
+static int const st_magicLength = 8;
+
+// size of the uncompressed blocks
+static int const st_blockSize = 1 << 16;
+
+// compression methods
+enum
+{
+    st_storeRaw = 0,
+    st_storeLZ = 1
+};
+
+// fixed size little endian numbers for the frame headers
+static void st_WriteFixed( std::ostream & stream, unsigned long value, int bytes )
+{
+    for ( int i = 0; i < bytes; ++i )
+    {
+        stream.put( static_cast< char >( value & 0xff ) );
+        value >>= 8;
+    }
+}
+
+static unsigned long st_ReadFixed( std::istream & stream, int bytes )
+{
+    unsigned long value = 0;
+    for ( int i = 0; i < bytes; ++i )
+    {
+        unsigned long c = stream.get() & 0xff;
+        if ( i < int( sizeof( value ) ) )
+            value |= c << ( i * 8 );
+    }
+    return value;
+}
+
+// The block compressor, a plain LZ77 variant: a control byte below 32 is followed by that
+// many plus one literal bytes; otherwise its upper three bits hold the length of a back
+// reference ( 7 meaning another length byte follows ) and its lower five bits, together
+// with the next byte, the distance.
+static int const st_hashBits = 14;
+static int const st_maxDistance = 1 << 13;
+static int const st_maxLiteral = 32;
+static int const st_maxMatch = 7 + 255 + 2;
+
+static inline int st_Hash( unsigned char const * p )
+{
+    unsigned int v = ( p[0] << 16 ) | ( p[1] << 8 ) | p[2];
+    return ( v * 2654435761U ) >> ( 32 - st_hashBits );
+}
+
+// compresses in into out, which needs room for len + len / 32 + 1 bytes. Returns the compressed size.
+static int st_Compress( unsigned char const * in, int len, unsigned char * out, std::vector< int > & hash )
+{
+    hash.assign( 1 << st_hashBits, -1 );
+
+    int ip = 0, op = 1, literals = 0;
+    while ( ip + 2 < len )
+    {
+        int h = st_Hash( in + ip );
+        int ref = hash[ h ];
+        hash[ h ] = ip;
+
+        int distance = ip - ref - 1;
+        if ( ref >= 0 && distance < st_maxDistance &&
+                in[ ref ] == in[ ip ] && in[ ref + 1 ] == in[ ip + 1 ] && in[ ref + 2 ] == in[ ip + 2 ] )
+        {
+            // extend the match
+            int maxMatch = len - ip < st_maxMatch ? len - ip : st_maxMatch;
+            int match = 3;
+            while ( match < maxMatch && in[ ref + match ] == in[ ip + match ] )
+                ++match;
+
+            // end the literal run
+            if ( literals )
+                out[ op - literals - 1 ] = literals - 1;
+            else
+                --op;
+            literals = 0;
+
+            // write the reference
+            int code = match - 2;
+            if ( code < 7 )
+                out[ op++ ] = ( code << 5 ) | ( distance >> 8 );
+            else
+            {
+                out[ op++ ] = ( 7 << 5 ) | ( distance >> 8 );
+                out[ op++ ] = code - 7;
+            }
+            out[ op++ ] = distance & 0xff;
+
+            // remember the skipped positions, too
+            int end = ip + match;
+            for ( ++ip; ip < end && ip + 2 < len; ++ip )
+                hash[ st_Hash( in + ip ) ] = ip;
+            ip = end;
+
+            // start the next literal run
+            ++op;
+        }
+        else
+        {
+            out[ op++ ] = in[ ip++ ];
+            if ( ++literals == st_maxLiteral )
+            {
+                out[ op - literals - 1 ] = literals - 1;
+                literals = 0;
+                ++op;
+            }
+        }
+    }
+
+    // the last bytes are literals
+    while ( ip < len )
+    {
+        out[ op++ ] = in[ ip++ ];
+        if ( ++literals == st_maxLiteral )
+        {
+            out[ op - literals - 1 ] = literals - 1;
+            literals = 0;
+            ++op;
+        }
+    }
+
+    if ( literals )
+        out[ op - literals - 1 ] = literals - 1;
+    else
+        --op;
+
+    return op;
+}
+
+// uncompresses in into out, which has room for exactly outLen bytes. Returns false on corrupt data.
+static bool st_Uncompress( unsigned char const * in, int len, unsigned char * out, int outLen )
+{
+    int ip = 0, op = 0;
+    while ( ip < len )
+    {
+        int control = in[ ip++ ];
+        if ( control < st_maxLiteral )
+        {
+            int literals = control + 1;
+            if ( ip + literals > len || op + literals > outLen )
+                return false;
+            memcpy( out + op, in + ip, literals );
+            ip += literals;
+            op += literals;
+        }
+        else
+        {
+            int match = control >> 5;
+            if ( match == 7 )
+            {
+                if ( ip >= len )
+                    return false;
+                match += in[ ip++ ];
+            }
+            match += 2;
+
+            if ( ip >= len )
+                return false;
+            int ref = op - ( ( control & 0x1f ) << 8 ) - in[ ip++ ] - 1;
+            if ( ref < 0 || op + match > outLen )
+                return false;
+
+            // byte by byte, the match may overlap what it writes
+            for ( int i = 0; i < match; ++i )
+                out[ op++ ] = out[ ref++ ];
+        }
+    }
+
+    return op == outLen;
+}
+
+// ******************************************************************************************
+// *
+// *    tBinaryRecording
+// *
+// ******************************************************************************************
+//!
+//!     @param  filename    the file to record to
+//!
+// ******************************************************************************************
+
+tBinaryRecording::tBinaryRecording( char const * filename )
+        : tRecording( true ), file_( filename, std::ios::out | std::ios::binary ), blockTime_( 0 )
+{
+    file_.write( st_binaryMagic, st_magicLength );
+}
+
+// ******************************************************************************************
+// *
+// *    ~tBinaryRecording
+// *
+// ******************************************************************************************
+//!
+//!
+// ******************************************************************************************
+
+tBinaryRecording::~tBinaryRecording()
+{
+    FinishBlock();
+
+    // write the index
+    unsigned long indexOffset = file_.tellp();
+    file_.put( 'I' );
+    st_WriteFixed( file_, index_.size(), 4 );
+    for ( std::vector< tRecordingIndexEntry >::const_iterator i = index_.begin(); i != index_.end(); ++i )
+    {
+        st_WriteFixed( file_, (*i).offset, 8 );
+        tRecorderBinary::Write( file_, (*i).time );
+    }
+
+    st_WriteFixed( file_, indexOffset, 8 );
+    file_.write( st_indexMagic, st_magicLength );
+}
+
+// ******************************************************************************************
+// *
+// *    DoBeginSection
+// *
+// ******************************************************************************************
+//!
+//!     @param  name    the name of the new section
+//!
+// ******************************************************************************************
+
+void tBinaryRecording::DoBeginSection( char const * name )
+{
+    // blocks are only ever cut between sections
+    std::streamoff size = block_.tellp();
+    if ( size >= st_blockSize )
+    {
+        FinishBlock();
+        size = 0;
+    }
+    if ( size == 0 )
+        blockTime_ = tSysTimeFloat();
+
+    // section names are almost always literals, so try the pointer first
+    std::map< char const *, int >::const_iterator last = lastIds_.find( name );
+    if ( last != lastIds_.end() && names_[ (*last).second - 1 ] == name )
+    {
+        tRecorderBinary::WriteUnsigned( block_, (*last).second );
+        return;
+    }
+
+    std::map< std::string, int >::const_iterator found = ids_.find( name );
+    if ( found != ids_.end() )
+    {
+        lastIds_[ name ] = (*found).second;
+        tRecorderBinary::WriteUnsigned( block_, (*found).second );
+        return;
+    }
+
+    // new name: ID 0 introduces it, it gets the next free ID
+    names_.push_back( name );
+    int id = names_.size();
+    ids_[ name ] = id;
+    lastIds_[ name ] = id;
+    tRecorderBinary::WriteUnsigned( block_, 0 );
+    tRecorderBinary::WriteString( block_, name );
+}
+
+// ******************************************************************************************
+// *
+// *    DoGetStream
+// *
+// ******************************************************************************************
+//!
+//!     @return     the stream to write to
+//!
+// ******************************************************************************************
+
+std::ostream & tBinaryRecording::DoGetStream()
+{
+    return block_;
+}
+
+// ******************************************************************************************
+// *
+// *    FinishBlock
+// *
+// ******************************************************************************************
+//!
+//!
+// ******************************************************************************************
+
+void tBinaryRecording::FinishBlock()
+{
+    std::string raw = block_.str();
+    if ( raw.empty() )
+        return;
+
+    int rawSize = raw.size();
+    compressed_.resize( rawSize + rawSize / 32 + 1 );
+    int storedSize = st_Compress( reinterpret_cast< unsigned char const * >( raw.c_str() ), rawSize,
+                                  reinterpret_cast< unsigned char * >( &compressed_[0] ), hash_ );
+    int method = st_storeLZ;
+    char const * stored = &compressed_[0];
+    if ( storedSize >= rawSize )
+    {
+        method = st_storeRaw;
+        storedSize = rawSize;
+        stored = raw.c_str();
+    }
+
+    tRecordingIndexEntry entry;
+    entry.offset = file_.tellp();
+    entry.time = blockTime_;
+    index_.push_back( entry );
+
+    file_.put( 'B' );
+    file_.put( static_cast< char >( method ) );
+    st_WriteFixed( file_, rawSize, 4 );
+    st_WriteFixed( file_, storedSize, 4 );
+    tRecorderBinary::Write( file_, blockTime_ );
+    file_.write( stored, storedSize );
+
+    // a finished block should survive a crash
+    file_.flush();
+
+    block_.str( "" );
+}
+
+// ******************************************************************************************
+// *
+// *    tBinaryPlayback
+// *
+// ******************************************************************************************
+//!
+//!     @param  filename    the file to play back
+//!
+// ******************************************************************************************
+
+tBinaryPlayback::tBinaryPlayback( char const * filename )
+        : tPlayback( true ), file_( filename, std::ios::in | std::ios::binary ), nextBlock_( 0 )
+{
+    if ( !ReadIndex() )
+    {
+        ScanIndex();
+        std::cout << "Recording index missing, the recording was cut off.\n";
+    }
+
+    if ( index_.size() > 0 )
+    {
+        std::cout << "Playing back " << index_.size() << " blocks, recorded from system time "
+        << index_.front().time << " on, the last one starting at " << index_.back().time << ".\n";
+    }
+}
+
+// ******************************************************************************************
+// *
+// *    ~tBinaryPlayback
+// *
+// ******************************************************************************************
+//!
+//!
+// ******************************************************************************************
+
+tBinaryPlayback::~tBinaryPlayback()
+{
+}
+
+// ******************************************************************************************
+// *
+// *    IsBinary
+// *
+// ******************************************************************************************
+//!
+//!     @param  filename    the file to check
+//!     @return             true if the file starts like a binary recording
+//!
+// ******************************************************************************************
+
+bool tBinaryPlayback::IsBinary( char const * filename )
+{
+    std::ifstream file( filename, std::ios::in | std::ios::binary );
+    char magic[ st_magicLength ];
+    file.read( magic, st_magicLength );
+    return file.good() && 0 == memcmp( magic, st_binaryMagic, st_magicLength );
+}
+
+// ******************************************************************************************
+// *
+// *    ReadIndex
+// *
+// ******************************************************************************************
+//!
+//!     @return     true if a complete index was found at the end of the file
+//!
+// ******************************************************************************************
+
+bool tBinaryPlayback::ReadIndex()
+{
+    // find the footer
+    file_.seekg( 0, std::ios::end );
+    std::streamoff size = file_.tellg();
+    if ( !file_.good() || size < 2 * st_magicLength + 8 )
+        return false;
+
+    file_.seekg( size - st_magicLength - 8 );
+    unsigned long indexOffset = st_ReadFixed( file_, 8 );
+    char magic[ st_magicLength ];
+    file_.read( magic, st_magicLength );
+    if ( !file_.good() || 0 != memcmp( magic, st_indexMagic, st_magicLength ) || std::streamoff( indexOffset ) >= size )
+        return false;
+
+    // read the index
+    file_.seekg( indexOffset );
+    if ( file_.get() != 'I' )
+        return false;
+    int count = st_ReadFixed( file_, 4 );
+    index_.clear();
+    for ( int i = 0; i < count && file_.good(); ++i )
+    {
+        tRecordingIndexEntry entry;
+        entry.offset = st_ReadFixed( file_, 8 );
+        tRecorderBinary::Read( file_, entry.time );
+        index_.push_back( entry );
+    }
+
+    return file_.good();
+}
+
+// ******************************************************************************************
+// *
+// *    ScanIndex
+// *
+// ******************************************************************************************
+//!
+//!
+// ******************************************************************************************
+
+void tBinaryPlayback::ScanIndex()
+{
+    file_.clear();
+    file_.seekg( 0, std::ios::end );
+    std::streamoff size = file_.tellg();
+
+    index_.clear();
+    std::streamoff offset = st_magicLength;
+    while ( true )
+    {
+        file_.seekg( offset );
+        if ( file_.get() != 'B' )
+            break;
+
+        tRecordingIndexEntry entry;
+        entry.offset = offset;
+        file_.get();
+        st_ReadFixed( file_, 4 );
+        unsigned long storedSize = st_ReadFixed( file_, 4 );
+        tRecorderBinary::Read( file_, entry.time );
+
+        // only take complete blocks
+        offset = file_.tellg() + std::streamoff( storedSize );
+        if ( !file_.good() || offset > size )
+            break;
+
+        index_.push_back( entry );
+    }
+
+    file_.clear();
+}
+
+// ******************************************************************************************
+// *
+// *    ReadBlock
+// *
+// ******************************************************************************************
+//!
+//!     @return     true if a block could be read
+//!
+// ******************************************************************************************
+
+bool tBinaryPlayback::ReadBlock()
+{
+    if ( nextBlock_ >= int( index_.size() ) )
+        return false;
+
+    file_.clear();
+    file_.seekg( index_[ nextBlock_++ ].offset );
+    if ( file_.get() != 'B' )
+        return false;
+
+    int method = file_.get();
+    int rawSize = st_ReadFixed( file_, 4 );
+    int storedSize = st_ReadFixed( file_, 4 );
+    double time;
+    tRecorderBinary::Read( file_, time );
+    if ( !file_.good() || rawSize < 0 || storedSize < 0 || storedSize > rawSize + rawSize / 32 + 1 )
+        return false;
+
+    std::vector< char > stored( storedSize + 1 );
+    file_.read( &stored[0], storedSize );
+    if ( !file_.good() )
+        return false;
+
+    std::string raw;
+    if ( method == st_storeRaw && storedSize == rawSize )
+    {
+        raw.assign( &stored[0], storedSize );
+    }
+    else if ( method == st_storeLZ )
+    {
+        std::vector< char > buffer( rawSize + 1 );
+        if ( !st_Uncompress( reinterpret_cast< unsigned char const * >( &stored[0] ), storedSize,
+                             reinterpret_cast< unsigned char * >( &buffer[0] ), rawSize ) )
+            return false;
+        raw.assign( &buffer[0], rawSize );
+    }
+    else
+        return false;
+
+    block_.clear();
+    block_.str( raw );
+    return true;
+}
+
+// ******************************************************************************************
+// *
+// *    DoReadSection
+// *
+// ******************************************************************************************
+//!
+//!     @param  name    the name of the next section to fill in
+//!     @return         false if the recording ended
+//!
+// ******************************************************************************************
+
+bool tBinaryPlayback::DoReadSection( std::string & name )
+{
+    // go to the next block if this one is used up
+    while ( block_.peek() == EOF )
+    {
+        if ( !ReadBlock() )
+            return false;
+    }
+
+    unsigned long id = tRecorderBinary::ReadUnsigned( block_ );
+    if ( id == 0 )
+    {
+        names_.push_back( tRecorderBinary::ReadString( block_ ) );
+        id = names_.size();
+    }
+
+    if ( id > names_.size() || !block_.good() )
+        return false;
+
+    name = names_[ id - 1 ];
+    return true;
+}
+
+// ******************************************************************************************
+// *
+// *    DoGetStream
+// *
+// ******************************************************************************************
+//!
+//!     @return     the stream to read from
+//!
+// ******************************************************************************************
+
+std::istream & tBinaryPlayback::DoGetStream()
+{
+    return block_;
+}
+
 class tRecordingCommandLineAnalyzer: public tCommandLineAnalyzer
 {
 private:
@@ -290,9 +909,23 @@ private:
             return true;
         }
 
+        if ( parser.GetOption( filename, "--recordbinary" ) )
+        {
+            // start a binary recorder
+            static tBinaryRecording recorder( static_cast< char const * >( filename ) );
+            return true;
+        }
+
         if ( parser.GetOption( filename, "--playback" ) )
         {
-            // start a playback
+            // start a playback of the right kind
+            if ( tBinaryPlayback::IsBinary( filename ) )
+            {
+                static tBinaryPlayback recorder( static_cast< char const * >( filename ) );
+                recorder.InitPlayback();
+                return true;
+            }
+
             static tRecorderImp< tPlayback, std::ifstream > recorder( static_cast< char const * >( filename ) );
             recorder.InitPlayback();
             return true;
@@ -304,7 +937,8 @@ private:
     virtual void DoHelp( std::ostream & s )
     {                                      //
         s << "--record <filename>          : creates a DEBUG recording while running\n";
-        s << "--playback <filename>        : plays back a DEBUG recording\n";
+        s << "--recordbinary <filename>    : creates a compressed, indexed DEBUG recording while running\n";
+        s << "--playback <filename>        : plays back a DEBUG recording of either kind\n";
     }
 };
 
@@ -36,7 +36,11 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include    "tString.h"
 
 #include    <iostream>
+#include    <fstream>
+#include    <sstream>
 #include    <string>
+#include    <vector>
+#include    <map>
 
 //! recording class
 class tRecording
@@ -44,7 +48,7 @@ class tRecording
     friend class tRecordingBlockBase;
 
 public:
-    tRecording              ()        ;   //!< default constructor
+    tRecording              ( bool binary = false );   //!< default constructor
 
     typedef std::ostream STREAM       ;   //!< stream typedef
 protected:
@@ -55,8 +59,10 @@ private:
     tRecording&     operator =      ( tRecording const &            other       ) ;   //!< copy operator
 
     void BeginSection( char const * name )      ; //!< begins a new section
+    virtual void DoBeginSection( char const * name ); //!< begins a new section, text version
     virtual std::ostream& DoGetStream ()     =0 ; //!< returns the stream to write to
 
+    bool binary_;                                 //!< flag indicating that values are to be written in binary
     static tRecording * currentRecording_;        //!< the currently running recording
 };
 
@@ -66,7 +72,7 @@ class tPlayback
     friend class tPlaybackBlockBase;
 
 public:
-    tPlayback              ()        ;   //!< default constructor
+    tPlayback              ( bool binary = false );   //!< default constructor
 
     typedef std::istream STREAM      ;   //!< stream typedef
 protected:
@@ -79,9 +85,11 @@ private:
     tPlayback&     operator =      ( tPlayback const &            other       ) ;   //!< copy operator
 
     std::string const & GetNextSection()    const       ; //!< name of the next section
+    virtual bool DoReadSection( std::string & name )    ; //!< reads the name of the next section, text version
     virtual std::istream& DoGetStream ()           = 0  ; //!< returns the stream to read from
 
     std::string         nextSection_;           //!< the name of the next section
+    bool                binary_;                //!< flag indicating that values are stored in binary
     static tPlayback *  currentPlayback_;       //!< the currently running playback
 };
 
@@ -109,4 +117,67 @@ private:
     STREAM_IMP stream_;
 };
 
+//! entry of the index of a binary recording
+struct tRecordingIndexEntry
+{
+    unsigned long offset;           //!< file position of the block
+    double time;                    //!< system time at the beginning of the block
+};
+
+//! binary recording: sections are named by interned IDs, the data is collected in blocks
+//! that get compressed and framed. An index of the blocks is appended at the end.
+class tBinaryRecording: public tRecording
+{
+public:
+    tBinaryRecording( char const * filename );  //!< opens the file to record to
+    ~tBinaryRecording();                        //!< writes the last block and the index
+private:
+    virtual void DoBeginSection( char const * name ); //!< begins a new section
+    virtual std::ostream& DoGetStream ();       //!< returns the stream to write to
+
+    void FinishBlock();                         //!< compresses and writes the current block
+
+    std::ofstream file_;                        //!< the file to write to
+    std::ostringstream block_;                  //!< the block currently being filled
+    double blockTime_;                          //!< system time when the current block was started
+
+    std::map< std::string, int > ids_;          //!< IDs of the section names seen so far
+    std::map< char const *, int > lastIds_;     //!< IDs by name pointer, checked against names_
+    std::vector< std::string > names_;          //!< section names by ID
+
+    std::vector< tRecordingIndexEntry > index_; //!< index of the blocks written so far
+    std::vector< int > hash_;                   //!< compressor hash table
+    std::vector< char > compressed_;            //!< compressor output buffer
+};
+
+//! playback of a binary recording
+class tBinaryPlayback: public tPlayback
+{
+public:
+    tBinaryPlayback( char const * filename );   //!< opens the file to play back
+    ~tBinaryPlayback();                         //!< destructor
+
+    static bool IsBinary( char const * filename ); //!< checks whether a file holds a binary recording
+
+    //! init function for playback
+    void InitPlayback()
+    {
+        AdvanceSection();
+    }
+private:
+    virtual bool DoReadSection( std::string & name ); //!< reads the name of the next section
+    virtual std::istream& DoGetStream ();       //!< returns the stream to read from
+
+    bool ReadIndex();                           //!< reads the index from the end of the file
+    void ScanIndex();                           //!< rebuilds the index from the block headers
+    bool ReadBlock();                           //!< reads and uncompresses the next block
+
+    std::ifstream file_;                        //!< the file to read from
+    std::istringstream block_;                  //!< the current block
+    int nextBlock_;                             //!< index of the next block to read
+
+    std::vector< std::string > names_;          //!< section names by ID
+    std::vector< tRecordingIndexEntry > index_; //!< index of the blocks in the file
+};
+
 #endif // TRECORDING_H_INCLUDED
@@ -428,6 +428,29 @@ struct tNonMutex
     void release(){}
 };
 
+// spin lock for short critical sections, like reference counts of objects
+// several threads may look at concurrently. Falls back to tNonMutex where
+// no atomic operations are known; tSPIN_MUTEX_SAFE tells whether it is real.
+#ifdef __GNUC__
+#define tSPIN_MUTEX_SAFE
+class tSpinMutex
+{
+public:
+    tSpinMutex(): lock_(0){}
+
+    void acquire()
+    {
+        while ( __sync_lock_test_and_set( &lock_, 1 ) ){}
+    }
+
+    void release(){ __sync_lock_release( &lock_ ); }
+private:
+    char lock_;
+};
+#else
+typedef tNonMutex tSpinMutex;
+#endif
+
 template< class T, class MUTEX = tNonMutex > class tReferencable
 {
     friend class tStackObject< T >;
@@ -44,14 +44,18 @@ tString::tString(const char *x){
 }
 
 tString::tString(const tString &x)
-        :tArray< char >()
+        :tArray< char >( x )
 {
-    operator[](0)='\0';
-    operator=(x);
-
     tASSERT( (*this) == x );
 }
 
+#if __cplusplus >= 201103L
+tString::tString(tString &&x){
+    operator[](0)='\0';
+    Swap( x );
+}
+#endif
+
 tString::tString(const tOutput &x){
     operator[](0)='\0';
     operator=(x);
@@ -167,30 +171,46 @@ tString & tString::operator<<(const char *c){
     return operator+=(c);
 }
 
+// checks whether c points into the string s
+static bool st_PointsInto( tString const & s, const char * c )
+{
+    return s.Len() > 0 && c >= &s(0) && c < &s(0) + s.Len();
+}
+
 tString & tString::operator+=(const char *c){
-    if (c){
-        if ( Len() == 0 )
-            operator[](0)='\0';
+    if ( st_PointsInto( *this, c ) )
+    {
+        // resizing would pull the rug out from under c
+        tString copy( c );
+        return operator+=( copy );
+    }
 
+    if (c){
         int i=Len()-1;
         if (i<0) i=0;
-        while (*c!='\0'){
-            operator[](i)=*c;
-            i++;
-            c++;
-        }
-        operator[](i)='\0';
+
+        // make room for all of c and its terminator at once
+        int len = strlen(c);
+        SetLen( i+len+1 );
+        memcpy( &operator()(i), c, len+1 );
     }
     return *this;
 }
 
 tString & tString::operator=(const char *c){
-    Clear();
+    if ( st_PointsInto( *this, c ) )
+    {
+        tString copy( c );
+        return operator=( copy );
+    }
+
+    // keep the memory, we're likely to need it again
+    SetLen(0);
     return operator+=(c);
 }
 
 tString & tString::operator=(const tOutput& o){
-    Clear();
+    SetLen(0);
     return operator <<(o);
 }
 
@@ -650,23 +670,41 @@ tString & tString::operator=(const tString &s)
     if ( &s == this )
         return *this;
 
-    Clear();
-    for (int i = s.Len()-1; i>=0; i--)
-        operator[](i) = s(i);
+    SetLen( s.Len() );
+    if ( s.Len() > 0 )
+        memcpy( &operator()(0), &s(0), s.Len() );
 
     tASSERT( (*this) == s );
 
     return *this;
 }
 
+#if __cplusplus >= 201103L
+tString & tString::operator=(tString &&s)
+{
+    Swap( s );
+    return *this;
+}
+#endif
+
 
 tString & tString::operator+=(const tString &s)
 {
+    if ( &s == this )
+    {
+        // resizing would grow s along with us
+        tString copy( s );
+        return operator+=( copy );
+    }
+
     if (Len() > 0 && operator()(Len()-1) == 0)
         SetLen(Len()-1);
 
-    for (int i = 0; i< s.Len(); i++)
-        operator[](Len()) = s(i);
+    int start = Len();
+    int len = s.Len();
+    SetLen( start + len );
+    if ( len > 0 )
+        memmove( &operator()(start), &s(0), len );
 
     if (Len() > 0 && operator()(Len()-1) != 0)
         operator[](Len()) = 0;
@@ -47,6 +47,9 @@ public:
     tString(const tString &);
     explicit tString(const char *);
     explicit tString(const tOutput &);
+#if __cplusplus >= 201103L
+    tString(tString &&);                        //!< takes over the contents of the other string, leaving it empty
+#endif
 
     void ReadLine(std::istream &s, bool enableEscapeSequences=false);
 
@@ -74,6 +77,15 @@ public:
     tString & operator =(const tString &s);
     tString & operator =(const tOutput &s);
     tString & operator+=(const tString &s);
+#if __cplusplus >= 201103L
+    tString & operator =(tString &&s);          //!< takes over the contents of the other string
+#endif
+
+    //! fast contents swap with other string
+    void Swap( tString & other )
+    {
+        tArray<char>::Swap( other );
+    }
 
     // Z-Man: stupid, stupid disambiguation for Visual C++.
     // not harmful to GCC, but not required.
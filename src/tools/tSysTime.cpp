@@ -400,6 +400,55 @@ double tSysTimeFloat ()
 static struct tTime timeRealStart;    // the real time at the start of the program
 static struct tTime timeRealRelative; // the time since the system start
 
+tPhaseTimer * tPhaseTimer::anchor_ = 0;
+bool tPhaseTimer::enabled_ = false;
+double tPhaseTimer::start_ = 0;
+long tPhaseTimer::allocations_ = 0;
+
+tPhaseTimer::tPhaseTimer( char const * name )
+        : name_( name ), calls_( 0 ), depth_( 0 ), total_( 0 ), max_( 0 ), allocs_( 0 ), next_( anchor_ )
+{
+    anchor_ = this;
+}
+
+void tPhaseTimer::Enable()
+{
+    enabled_ = true;
+    start_ = Now();
+    allocations_ = 0;
+}
+
+double tPhaseTimer::Now()
+{
+    // differences to the first call keep the precision up
+    static tTime first;
+    static bool firstSet = false;
+    tTime time;
+    GetTime( time );
+    if ( !firstSet )
+    {
+        first = time;
+        firstSet = true;
+    }
+
+    tTime relative = time - first;
+    return relative.seconds + relative.microseconds * 1E-6;
+}
+
+void tPhaseTimer::Report( std::ostream & s )
+{
+    double run = Now() - start_;
+
+    s << "phase\tcalls\ttotal_s\tmean_us\tmax_us\tallocs\tallocs_per_call\n";
+    s << "run\t1\t" << run << "\t" << run * 1E6 << "\t" << run * 1E6 << "\t" << allocations_ << "\t" << allocations_ << "\n";
+    for ( tPhaseTimer * timer = anchor_; timer; timer = timer->next_ )
+    {
+        s << timer->name_ << "\t" << timer->calls_ << "\t" << timer->total_ << "\t"
+        << ( timer->calls_ > 0 ? timer->total_ * 1E6 / timer->calls_ : 0 ) << "\t" << timer->max_ * 1E6 << "\t"
+        << timer->allocs_ << "\t" << ( timer->calls_ > 0 ? double( timer->allocs_ ) / timer->calls_ : 0 ) << "\n";
+    }
+}
+
 double tRealSysTimeFloat ()
 {
     // get real time from real OS
@@ -28,6 +28,8 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #ifndef ArmageTron_SysTime_H
 #define ArmageTron_SysTime_H
 
+#include <iosfwd>
+
 bool tTimerIsAccurate();                      //! returns true if a timer with more than millisecond accuracy is available
 double tSysTimeFloat();                       //! returns the current frame's time ( from the playback )
 double tRealSysTimeFloat();                   //! returns the current frame's time ( from the real system )
@@ -35,4 +37,73 @@ void tAdvanceFrame( int usecdelay = 0);       //! andvances one frame: updates t
 void tDelay( int usecdelay );                 //! delays for the specified number of microseconds
 void tDelayForce( int usecdelay );            //! delays for the specified number of microseconds, even when playing back
 
+//! accumulates the real time spent in one phase of the main loop. Nothing is measured
+//! unless the phase timers are enabled, which the replay benchmark does.
+class tPhaseTimer
+{
+    friend class tPhaseTimerScope;
+public:
+    explicit tPhaseTimer( char const * name );  //!< registers a phase under the given name
+
+    static void Enable();                       //!< starts measuring
+    static bool IsEnabled(){ return enabled_; } //!< returns whether the phases are measured
+    static void Report( std::ostream & s );     //!< writes the measurements as a tab separated table
+    //! notes a memory allocation, charged to the running phases. Worker threads allocate too, so the count is atomic.
+    static void CountAllocation()
+    {
+#ifdef __GNUC__
+        __sync_fetch_and_add( &allocations_, 1 );
+#else
+        ++allocations_;
+#endif
+    }
+private:
+    static double Now();                        //!< returns the real time in seconds, for taking differences
+
+    char const * name_;                         //!< name of the phase
+    int calls_;                                 //!< number of times the phase was run
+    int depth_;                                 //!< nesting depth of the phase right now
+    double total_;                              //!< total time spent in the phase
+    double max_;                                //!< longest single run of the phase
+    long allocs_;                               //!< number of memory allocations made during the phase
+    tPhaseTimer * next_;                        //!< next phase in the list of all phases
+
+    static tPhaseTimer * anchor_;               //!< first phase in the list of all phases
+    static bool enabled_;                       //!< flag indicating whether the phases are measured
+    static double start_;                       //!< time measuring was started at
+    static long allocations_;                   //!< number of memory allocations counted so far
+};
+
+//! adds the real time spent in its scope to a phase timer. Nested scopes of the same phase count once.
+class tPhaseTimerScope
+{
+public:
+    explicit tPhaseTimerScope( tPhaseTimer & timer )
+            : timer_( tPhaseTimer::enabled_ ? &timer : 0 ), start_( -1 ), allocs_( 0 )
+    {
+        if ( timer_ && timer_->depth_++ == 0 )
+        {
+            start_ = tPhaseTimer::Now();
+            allocs_ = tPhaseTimer::allocations_;
+        }
+    }
+
+    ~tPhaseTimerScope()
+    {
+        if ( timer_ && --timer_->depth_ == 0 && start_ >= 0 )
+        {
+            double time = tPhaseTimer::Now() - start_;
+            timer_->calls_++;
+            timer_->total_ += time;
+            if ( time > timer_->max_ )
+                timer_->max_ = time;
+            timer_->allocs_ += tPhaseTimer::allocations_ - allocs_;
+        }
+    }
+private:
+    tPhaseTimer * timer_;                       //!< the phase to measure, NULL if nothing is measured
+    double start_;                              //!< time the phase was entered at
+    long allocs_;                               //!< allocation count the phase was entered at
+};
+
 #endif
@@ -38,13 +38,37 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include "rScreen.h"
 #include "eFloor.h"
 #include "eDebugLine.h"
+#include "tSysTime.h"
 #include "gAICharacter.h"
 #include "tReferenceHolder.h"
 #include "tRandom.h"
 #include "tRecorder.h"
+#include "tConfiguration.h"
 #include <stdlib.h>
 #include <cstdlib>
 #include <memory>
+#include <vector>
+
+// the think phase can run on several threads. Debug builds draw lines and
+// print diagnostics while thinking, they always think on the main thread.
+#if ( defined(HAVE_LIBZTHREAD) || defined(HAVE_PTHREAD) ) && defined(tSPIN_MUTEX_SAFE) && !defined(DEBUG)
+#define gAI_THREADED
+#endif
+
+#ifdef gAI_THREADED
+#ifdef HAVE_LIBZTHREAD
+#include <zthread/Thread.h>
+#include <zthread/FastMutex.h>
+#include <zthread/Condition.h>
+#include <zthread/ThreadLocal.h>
+typedef ZThread::FastMutex gAIMutex;
+typedef ZThread::Condition gAICondition;
+#else
+#include "pthread-binding.h"
+typedef tPThreadMutex gAIMutex;
+typedef tPThreadCondition gAICondition;
+#endif
+#endif
 
 #define AI_REACTION          0 
 #define AI_EMERGENCY         1 
@@ -89,29 +113,62 @@ static void ClearAITeam()
 class gRandomController
 {
 public:
-    static gRandomController * random_;
     gRandomController * lastRandom_;
     tRandomizer & randomizer_;
 
     gRandomController( tRandomizer & randomizer = tRandomizer::GetInstance() )
-            : lastRandom_( random_ ), randomizer_( randomizer )
+            : lastRandom_( Current() ), randomizer_( randomizer )
     {
-        random_ = this;
+        SetCurrent( this );
     }
 
     ~gRandomController()
     {
-        random_ = lastRandom_;
+        SetCurrent( lastRandom_ );
     }
+
+    static gRandomController * Current();                     //!< returns the innermost controller of this thread
+private:
+    static void SetCurrent( gRandomController * controller ); //!< sets the innermost controller of this thread
 };
 
-gRandomController * gRandomController::random_ = 0;
+#ifdef gAI_THREADED
+// every thinking thread has its own controllers
+#ifdef HAVE_LIBZTHREAD
+static ZThread::ThreadLocal< gRandomController * > sg_randomController;
+#else
+static tPThreadLocal< gRandomController > sg_randomController;
+#endif
+
+gRandomController * gRandomController::Current()
+{
+    return sg_randomController.get();
+}
+
+void gRandomController::SetCurrent( gRandomController * controller )
+{
+    sg_randomController.set( controller );
+}
+#else
+static gRandomController * sg_randomController = 0;
+
+gRandomController * gRandomController::Current()
+{
+    return sg_randomController;
+}
+
+void gRandomController::SetCurrent( gRandomController * controller )
+{
+    sg_randomController = controller;
+}
+#endif
 
 REAL Random()
 {
-    if ( gRandomController::random_ )
+    gRandomController * controller = gRandomController::Current();
+    if ( controller )
     {
-        tRandomizer & randomizer = gRandomController::random_->randomizer_;
+        tRandomizer & randomizer = controller->randomizer_;
         return randomizer.Get();
     }
     else
@@ -1344,6 +1401,13 @@ void gAIPlayer::SetTraceSide(int side)
 // off if the PC can't handle it. Doesn't doo much good, anyway.
 static bool sg_pathEnabled = true;
 
+// number of edges a path search may examine each time a bot thinks; the rest waits for the next thought
+static int sg_pathBudget = 300;
+static tSettingItem<int> sg_pathBudgetConf( "AI_PATH_BUDGET", sg_pathBudget );
+
+// set while the AI players think on several threads; the grid is frozen then
+static bool sg_thinkingInParallel = false;
+
 // state change:
 void gAIPlayer::SwitchToState(gAI_STATE nextState, REAL minTime)
 {
@@ -1623,7 +1687,7 @@ void gAIPlayer::ThinkPath( ThinkData & data )
 
 
     // find a new path if the one we got is outdated:
-    if (lastPath < se_GameTime() - 10)
+    if (lastPath < se_GameTime() - 10 && !pathSearch.Searching())
         if (target->CurrentFace())
         {
             if( !sg_pathEnabled )
@@ -1634,12 +1698,27 @@ void gAIPlayer::ThinkPath( ThinkData & data )
                 return;
             }
 
-            Object()->FindCurrentFace();
+            // in the parallel phase, the face was found before the threads started
+            if ( !sg_thinkingInParallel )
+                Object()->FindCurrentFace();
+            pathSearch.Start(Object()->Position(), Object()->CurrentFace(),
+                             target->Position(), target->CurrentFace());
+            lastPath = se_GameTime();
+        }
+
+    // continue the search; the old path stays in use until it is done
+    bool searching = pathSearch.Searching();
+    if (searching)
+    {
+        if (sg_thinkingInParallel)
+        {
+            // the timer is not to be read from several threads; the budget keeps the search short
+            searching = !pathSearch.Continue(Object(), sg_pathBudget, path);
+        }
+        else
+        {
             REAL before = tRealSysTimeFloat();
-            eHalfEdge::FindPath(Object()->Position(), Object()->CurrentFace(),
-                                target->Position(), target->CurrentFace(),
-                                Object(),
-                                path);
+            searching = !pathSearch.Continue(Object(), sg_pathBudget, path);
 
             // calculate (and archive) time used for pathfinding
             REAL used = tRealSysTimeFloat() - before;
@@ -1658,12 +1737,16 @@ void gAIPlayer::ThinkPath( ThinkData & data )
 #endif
                 sg_pathEnabled = false;
             }
-            lastPath = se_GameTime();
         }
 
+        // the grid changed under the search and it found nothing; try again soon
+        if ( !searching && pathSearch.Interrupted() )
+            lastPath -= 10;
+    }
+
     if (!path.Valid())
     {
-        data.thinkAgain = 1;
+        data.thinkAgain = searching ? .1 : 1;
         return;
     }
 
@@ -1745,6 +1828,10 @@ void gAIPlayer::ThinkPath( ThinkData & data )
     data.thinkAgain = mindist / Object()->Speed();
     if (data.thinkAgain > .4)
         data.thinkAgain *= .7;
+
+    // come back soon to continue the search
+    if (searching && data.thinkAgain > .1)
+        data.thinkAgain = .1;
 }
 
 
@@ -2666,6 +2753,7 @@ void gAIPlayer::NewObject()         // called when we control a new object
     lastChangeAttempt = 0;
     lazySideChange = 0;
     path.Clear();
+    pathSearch.Clear();
 
     if (character)
     {
@@ -2733,6 +2821,16 @@ static gAISensor * sg_GetSensor( int currentDirectionNumber, gCycle const & obje
 }
 
 REAL gAIPlayer::Think(){
+    Thought thought;
+    thought.player = this;
+    Ponder( thought );
+    return Act( thought );
+}
+
+void gAIPlayer::Ponder( Thought & thought ){
+    thought.act = false;
+    thought.limit = 100;
+
     // get the delay between two turns
     REAL delay = Delay();
 
@@ -2747,7 +2845,7 @@ REAL gAIPlayer::Think(){
 #endif
 
     if (!Object()->Alive())
-        return 100;
+        return;
 
     emergency = false;
     //  return 1;
@@ -2832,8 +2930,9 @@ REAL gAIPlayer::Think(){
             ThinkCloseCombat(data);
             break;
         }
-        ActOnData( data );
-        ret = data.thinkAgain;
+        thought.data = data;
+        thought.act = true;
+        ret = 1E+30;
     }
 
 #ifdef DEBUG_X
@@ -2867,6 +2966,21 @@ REAL gAIPlayer::Think(){
     if (ret > mindist)
         ret = mindist;
 
+    thought.limit = ret;
+}
+
+REAL gAIPlayer::Act( Thought & thought ){
+    REAL ret = thought.limit;
+
+    if ( thought.act )
+    {
+        ActOnData( thought.data );
+        CheckThinkAgain( thought.data );
+
+        if ( ret > thought.data.thinkAgain )
+            ret = thought.data.thinkAgain;
+    }
+
     return ret;
 }
 
@@ -2891,7 +3005,11 @@ void gAIPlayer::ActOnData( ThinkData & data )
     // delegate
     ThinkDataBase & base = data;
     ActOnData( base );
+    CheckThinkAgain( base );
+}
 
+void gAIPlayer::CheckThinkAgain( ThinkDataBase & data )
+{
     // sanitize next think time so it will be before we hit the next wall
     if ( Object()->Speed() > 0 && data.thinkAgain > 0 )
     {
@@ -2939,15 +3057,23 @@ void gAIPlayer::ActOnData( ThinkDataBase & data )
 const REAL relax=25;
 
 void gAIPlayer::Timestep(REAL time){
+    if (BeginTimestep(time)){
+        gRandomController random( randomizer_ );
+
+        EndTimestep(Think());
+    }
+}
+
+bool gAIPlayer::BeginTimestep(REAL time){
     if (!character)
     {
         st_Breakpoint();
-        return;
+        return false;
     }
 
     // don't think if the object is not up to date
     if ( Object() && Object()->LastTime() < time - EPS )
-        return;
+        return false;
 
     REAL ts=time-lastTime;
     lastTime=time;
@@ -2958,20 +3084,240 @@ void gAIPlayer::Timestep(REAL time){
     concentration += 4*(character->properties[AI_REACTION]+1) * ts/relax;
     concentration=concentration/(1+ts/relax);
 
-    if (bool(Object()) && Object()->Alive() && nextTime<time){
-        gRandomController random( randomizer_ );
+    return bool(Object()) && Object()->Alive() && nextTime<time;
+}
+
+void gAIPlayer::EndTimestep(REAL nextthought){
+    //    if (nextthought>.9) nextthought=REAL(.9);
+
+    if (nextthought<REAL(.6-concentration)) nextthought=REAL(.6-concentration);
+
+    nextTime=nextTime+nextthought;
+
+    //con << concentration << "\t" << nextthought << '\n';
+
+    if(.1+4*nextthought<1)
+        concentration*=REAL(.1+4*nextthought);
+}
+
+// number of threads that help the main thread think for the AI players; 0 thinks serially
+static int sg_aiThreads = 0;
+static tSettingItem<int> sg_aiThreadsConf( "AI_THREADS", sg_aiThreads );
+
+#ifdef gAI_THREADED
+//! lets several threads ponder for the AI players
+class gAIThinkPool
+{
+public:
+    //! returns the pool. It is never destroyed; the threads wait on it until the process ends.
+    static gAIThinkPool & Get()
+    {
+        static gAIThinkPool * pool = new gAIThinkPool;
+        return *pool;
+    }
 
-        REAL nextthought=Think();
-        //    if (nextthought>.9) nextthought=REAL(.9);
+    //! ponders for all thoughts on the calling thread and up to workers pool threads. Returns when all are done.
+    void Run( std::vector< gAIPlayer::Thought > & thoughts, int workers )
+    {
+        while ( threads_ < workers && Spawn() )
+        {
+            ++threads_;
+        }
 
-        if (nextthought<REAL(.6-concentration)) nextthought=REAL(.6-concentration);
+        mutex_.acquire();
+        thoughts_ = &thoughts[0];
+        count_ = static_cast< int >( thoughts.size() );
+        next_ = 0;
+        pending_ = count_;
+        workers_ = workers;
+        ++generation_;
+        wake_.broadcast();
+
+        PonderAll();
+        while ( pending_ > 0 )
+        {
+            done_.wait();
+        }
 
-        nextTime=nextTime+nextthought;
+        thoughts_ = NULL;
+        count_ = 0;
+        mutex_.release();
+    }
 
-        //con << concentration << "\t" << nextthought << '\t' << ts << '\n';
+    //! the loop every pool thread runs
+    void Work()
+    {
+        mutex_.acquire();
+        int index = started_++;
+        int generation = generation_;
+        for(;;)
+        {
+            while ( generation == generation_ )
+            {
+                wake_.wait();
+            }
+            generation = generation_;
 
-        if(.1+4*nextthought<1)
-            concentration*=REAL(.1+4*nextthought);
+            if ( index < workers_ )
+            {
+                PonderAll();
+            }
+        }
+    }
+private:
+    gAIThinkPool()
+    : wake_( mutex_ ), done_( mutex_ )
+    , thoughts_( NULL ), count_( 0 ), next_( 0 ), pending_( 0 )
+    , workers_( 0 ), generation_( 0 ), started_( 0 ), threads_( 0 )
+    {
+    }
+
+    //! ponders for thoughts until none are left. Call with the mutex acquired.
+    void PonderAll()
+    {
+        while ( next_ < count_ )
+        {
+            gAIPlayer::Thought & thought = thoughts_[ next_++ ];
+            mutex_.release();
+
+            {
+                gRandomController random( thought.player->randomizer_ );
+                thought.player->Ponder( thought );
+            }
+
+            mutex_.acquire();
+            if ( --pending_ == 0 )
+            {
+                done_.broadcast();
+            }
+        }
+    }
+
+    //! starts a new pool thread, returns false on failure
+    bool Spawn();
+
+    gAIMutex mutex_;                      //!< protects everything below
+    gAICondition wake_;                   //!< broadcast when new thoughts are ready
+    gAICondition done_;                   //!< broadcast when the last thought is done
+    gAIPlayer::Thought * thoughts_;       //!< the thoughts of the current phase
+    int count_;                           //!< their number
+    int next_;                            //!< the next one nobody ponders for yet
+    int pending_;                         //!< number of thoughts not done yet
+    int workers_;                         //!< number of pool threads that may help in this phase
+    int generation_;                      //!< counts the phases
+    int started_;                         //!< number of threads that entered Work()
+    int threads_;                         //!< number of threads started, main thread only
+};
+
+#ifdef HAVE_LIBZTHREAD
+class gAIThinkWorker: public ZThread::Runnable
+{
+public:
+    void run()
+    {
+        gAIThinkPool::Get().Work();
+    }
+};
+
+bool gAIThinkPool::Spawn()
+{
+    // the thread keeps running when the handle goes away
+    ZThread::Thread thread( ZThread::Task( new gAIThinkWorker ) );
+    return true;
+}
+#else
+static void * sg_AIThinkWorker( void * )
+{
+    gAIThinkPool::Get().Work();
+    return NULL;
+}
+
+bool gAIThinkPool::Spawn()
+{
+    pthread_t thread;
+    if ( 0 != pthread_create( &thread, NULL, &sg_AIThinkWorker, NULL ) )
+    {
+        return false;
+    }
+
+    pthread_detach( thread );
+    return true;
+}
+#endif
+#endif
+
+static tPhaseTimer sg_aiTimer( "ai" );
+void gAIPlayer::TimestepAll(REAL time){
+    tPhaseTimerScope phase( sg_aiTimer );
+
+#ifdef gAI_THREADED
+    // recordings need the decisions made in the usual order, and so does playback
+    if ( sg_aiThreads > 0 && !tRecorder::IsRunning() )
+    {
+        std::vector< Thought > thoughts;
+        eGrid * grid = NULL;
+        for(int i=se_PlayerNetIDs.Len()-1;i>=0;i--)
+        {
+            gAIPlayer *ai = dynamic_cast<gAIPlayer*>(se_PlayerNetIDs(i));
+            if (ai && ai->BeginTimestep(time))
+            {
+                Thought thought;
+                thought.player = ai;
+                thoughts.push_back( thought );
+                grid = ai->Object()->Grid();
+            }
+        }
+
+        if ( thoughts.size() > 1 )
+        {
+            // the sensors and path searches start from the faces of the cycles; find
+            // replacements for the ones that left the grid while it may still change
+            const tList<eGameObject>& gameObjects = grid->GameObjects();
+            for (int i=gameObjects.Len()-1;i>=0;i--)
+            {
+                eGameObject * object = gameObjects(i);
+                if ( object->CurrentFace() && !object->CurrentFace()->IsInGrid() )
+                    object->FindCurrentFace();
+
+                // the thoughts pick targets by observer; make sure they exist
+                gCycle * cycle = dynamic_cast<gCycle *>(object);
+                if ( cycle )
+                    cycle->GetObserver();
+            }
+            for (size_t i = 0; i < thoughts.size(); ++i)
+                if ( thoughts[i].player->state == AI_PATH )
+                    thoughts[i].player->Object()->FindCurrentFace();
+
+            // look at the frozen world from all threads
+            grid->SetFrozen(true);
+            sg_thinkingInParallel = true;
+            gAIThinkPool::Get().Run( thoughts, sg_aiThreads );
+            sg_thinkingInParallel = false;
+            grid->SetFrozen(false);
+        }
+        else if ( thoughts.size() == 1 )
+        {
+            gRandomController random( thoughts[0].player->randomizer_ );
+            thoughts[0].player->Ponder( thoughts[0] );
+        }
+
+        // act in the usual order
+        for (size_t i = 0; i < thoughts.size(); ++i)
+        {
+            gAIPlayer * ai = thoughts[i].player;
+            gRandomController random( ai->randomizer_ );
+            ai->EndTimestep( ai->Act( thoughts[i] ) );
+        }
+
+        return;
+    }
+#endif
+
+    for(int i=se_PlayerNetIDs.Len()-1;i>=0;i--)
+    {
+        gAIPlayer *ai = dynamic_cast<gAIPlayer*>(se_PlayerNetIDs(i));
+        if (ai)
+            ai->Timestep(time);
     }
 }
 
@@ -55,6 +55,7 @@ gAI_STATE;
 
 class gAIPlayer: public ePlayerNetID{
     friend class gAITeam;
+    friend class gAIThinkPool;
 
     tReproducibleRandomizer randomizer_;
 protected:
@@ -65,6 +66,7 @@ protected:
 
     // for pathfinding mode:
     ePath                   path;    // last found path to the victim
+    ePathContext            pathSearch; // the search for the next path, spread over several thoughts
     REAL lastPath;                   // when was the last time we did a pathsearch?
 
     // for trace mode:
@@ -111,6 +113,15 @@ public:
         }
     };
 
+    // what Ponder() came up with
+    struct Thought
+    {
+        gAIPlayer * player;                         // the thinker
+        ThinkDataBase data;                         // the decision
+        bool act;                                   // whether to act on data
+        REAL limit;                                 // upper bound for the time to think again
+    };
+
 protected:
 struct ThinkData : public ThinkDataBase
     {
@@ -139,6 +150,7 @@ struct ThinkData : public ThinkDataBase
     // acting on gathered data
     virtual void ActOnData( ThinkData & data );
     virtual void ActOnData( ThinkDataBase & data );
+    void CheckThinkAgain( ThinkDataBase & data ); // makes sure we think again before hitting a wall
 public:
     gAICharacter* Character() const {return character;}
 
@@ -173,6 +185,12 @@ public:
     // do some thinking. Return value: time to think again
     virtual REAL Think();
 
+    // the two halves of Think(). Ponder() only looks at the world, so it may run
+    // for several AIs at once; Act() carries out the decision and returns the
+    // time to think again.
+    void Ponder( Thought & thought );
+    REAL Act( Thought & thought );
+
     bool Alive(){
         return bool(Object()) && Object()->Alive();
     }
@@ -194,6 +212,11 @@ public:
     }
 
     void Timestep(REAL time);
+    static void TimestepAll(REAL time); // lets all AI players think, on several threads if AI_THREADS allows it
+private:
+    bool BeginTimestep(REAL time);      // updates the concentration, returns whether it is time to think
+    void EndTimestep(REAL nextthought); // schedules the next thought
+public:
 
     virtual void NewObject();                     // called when we control a new object
     virtual void RightBeforeDeath(int triesLeft); // is called right before the vehicle gets destroyed.
@@ -54,6 +54,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include <stdlib.h>
 #include <fstream>
 #include <memory>
+#include <map>
 
 #ifndef DEDICATED
 #define DONTDOIT
@@ -364,14 +365,11 @@ class Sensor: public gSensor
 
         virtual void PassEdge(const eWall *ww,REAL time,REAL a,int r)
         {
-            try{
-                gSensor::PassEdge(ww,time,a,r);
-            }
-            catch( eSensorFinished & e )
-            {
-                if ( DoExtraDetectionStuff() )
-                    throw;
-            }
+            gSensor::PassEdge(ww,time,a,r);
+
+            // ignore the hit if it turns out to be uninteresting
+            if ( finished_ && !DoExtraDetectionStuff() )
+                finished_ = false;
         }
 
         bool DoExtraDetectionStuff()
@@ -1268,9 +1266,7 @@ public:
     // write compressed float to message
     void Write( nMessage& m, REAL value ) const
     {
-        clamp( value, min_, max_ );
-        unsigned short compressed = static_cast< unsigned short > ( maxShort_ * ( value - min_ )/( max_ - min_ ) );
-        m.Write( compressed );
+        m.Write( Compress( value ) );
     }
 
     REAL Read( nMessage& m ) const
@@ -1278,6 +1274,19 @@ public:
         unsigned short compressed;
         m.Read( compressed );
 
+        return Decompress( compressed );
+    }
+
+    // compress float to a short
+    unsigned short Compress( REAL value ) const
+    {
+        clamp( value, min_, max_ );
+        return static_cast< unsigned short > ( maxShort_ * ( value - min_ )/( max_ - min_ ) );
+    }
+
+    // expand compressed short again
+    REAL Decompress( unsigned short compressed ) const
+    {
         return  min_ + compressed * ( max_ - min_ )/maxShort_;
     }
 private:
@@ -2410,7 +2419,8 @@ gCycle::gCycle(eGrid *grid, const eCoord &pos,const eCoord &d,ePlayerNetID *p)
         skew(0),skewDot(0),
         rotationFrontWheel(1,0),rotationRearWheel(1,0),heightFrontWheel(0),heightRearWheel(0),
         currentWall(NULL),
-        lastWall(NULL)
+        lastWall(NULL),
+        deltaSync_(NULL)
 {
     windingNumberWrapped_ = windingNumber_ = Grid()->DirectionWinding(dirDrive);
     dirDrive = Grid()->GetDirection(windingNumberWrapped_);
@@ -2428,6 +2438,9 @@ gCycle::gCycle(eGrid *grid, const eCoord &pos,const eCoord &d,ePlayerNetID *p)
     sg_ArchiveReal( this->verletSpeed_, 1 );
 }
 
+// the delta sync baselines are defined further down, with the code using them
+static void sg_DeleteDeltaSync( gCycleDeltaSync * deltaSync );
+
 gCycle::~gCycle(){
 #ifdef DEBUG
     //  con << "deleting cylce...\n";
@@ -2437,6 +2450,8 @@ gCycle::~gCycle(){
     tDESTROY(engine);
     tDESTROY(turning);
     tDESTROY(spark);
+    sg_DeleteDeltaSync( deltaSync_ );
+    deltaSync_ = NULL;
 
     this->RemoveFromGame();
 
@@ -3166,6 +3181,12 @@ bool gCycle::TimestepCore(REAL currentTime, bool calculateAcceleration ){
 }
 
 
+// cycles don't interact with anything (see below)
+REAL gCycle::InteractionRange() const
+{
+    return -1;
+}
+
 void gCycle::InteractWith(eGameObject *target,REAL,int){
     /*
       if (alive && target->type()==ArmageTron_CYCLE){
@@ -4900,7 +4921,8 @@ gCycle::gCycle(nMessage &m)
         skew(0),skewDot(0),
         rotationFrontWheel(1,0),rotationRearWheel(1,0),heightFrontWheel(0),heightRearWheel(0),
         currentWall(NULL),
-        lastWall(NULL)
+        lastWall(NULL),
+        deltaSync_(NULL)
 {
     deathTime=0;
     lastNetWall=lastWall=currentWall=NULL;
@@ -4942,6 +4964,324 @@ void gCycle::WriteCreate(nMessage &m){
 
 static nVersionFeature sg_verletIntegration( 7 );
 
+// cycle syncs are sent as deltas against a state the receiver acknowledged
+static nVersionFeature sg_deltaSync( 17 );
+
+// *******************************************************************************
+// *
+// *	delta compressed syncs
+// *
+// *******************************************************************************
+//
+// A delta sync starts with its sequence number and the sequence number of the
+// baseline it is relative to (equal to its own for syncs without baseline).
+// Then follow two bits per field telling whether the field is unchanged,
+// sent as a quantized delta to the baseline or sent in full. Then the data
+// of the fields that are not unchanged follows.
+//
+// The sender only uses baselines the receiver acknowledged, and the receiver
+// keeps the last sgDeltaSyncWindow states it received, so the baseline is
+// always available on the other end.
+
+// state of a cycle as it is transmitted in delta syncs
+struct gCycleSyncState
+{
+    enum Field
+    {
+        // REAL fields
+        Time, DirX, DirY, PosX, PosY, Speed, Distance, LastTurnX, LastTurnY,
+        // short fields
+        Alive, Wall, Turns, Braking, Rubber, RubberMalus, MessageID, BrakingReservoir,
+        FieldCount,
+        RealCount = Alive
+    };
+
+    REAL            reals[ RealCount ];
+    unsigned short  shorts[ FieldCount - RealCount ];
+
+    unsigned short  seq;    // sequence number of the sync
+    bool            valid;  // flag indicating whether the state is in use
+
+    gCycleSyncState(): seq( 0 ), valid( false ){}
+
+    unsigned short & Short( Field field ){ return shorts[ field - RealCount ]; }
+    unsigned short Short( Field field ) const { return shorts[ field - RealCount ]; }
+};
+
+// how a field of a delta sync is encoded
+enum gDeltaSyncMode
+{
+    gDeltaSyncUnchanged = 0,  // same as in the baseline, not sent
+    gDeltaSyncDelta = 1,      // quantized difference to the baseline, one short
+    gDeltaSyncFull = 2        // full value, two shorts for REALs, one for shorts
+};
+
+// quantization steps of the REAL fields. Fields with step 0 are never sent as deltas,
+// they change rarely and need to be exact when they do.
+static REAL const sg_deltaSyncSteps[ gCycleSyncState::RealCount ] =
+    {
+        1/4096.0,                 // time
+        0, 0,                     // direction
+        1/1024.0, 1/1024.0,       // position
+        1/1024.0,                 // speed
+        1/1024.0,                 // distance
+        0, 0                      // last turn
+    };
+
+// number of syncs a baseline stays usable; the receiver keeps twice as many states.
+static const int sgDeltaSyncWindow = 8;
+
+// the value the receiver of a quantized delta gets; the sender uses the same function
+// so both ends agree on the baseline exactly
+static REAL sg_ApplySyncDelta( REAL base, short delta, REAL step )
+{
+    return base + delta * step;
+}
+
+static void sg_WriteFullReal( nMessage & m, REAL value )
+{
+    float f = value;
+    unsigned int bits;
+    memcpy( &bits, &f, sizeof( bits ) );
+    m.Write( static_cast< unsigned short >( bits >> 16 ) );
+    m.Write( static_cast< unsigned short >( bits & 0xFFFF ) );
+}
+
+static REAL sg_ReadFullReal( nMessage & m )
+{
+    unsigned short high, low;
+    m.Read( high );
+    m.Read( low );
+    unsigned int bits = ( static_cast< unsigned int >( high ) << 16 ) | low;
+    float f;
+    memcpy( &f, &bits, sizeof( f ) );
+    return f;
+}
+
+// *******************************************************************************
+// *
+// *	sg_WriteDeltaSync
+// *
+// *******************************************************************************
+//!
+//!		@param	m	    the message to write to
+//!		@param	state	the state to write. Is modified to the state the receiver will read.
+//!		@param	base	the baseline the receiver has, or NULL
+//!
+// *******************************************************************************
+
+static void sg_WriteDeltaSync( nMessage & m, gCycleSyncState & state, gCycleSyncState const * base )
+{
+    int modes[ gCycleSyncState::FieldCount ];
+    short deltas[ gCycleSyncState::RealCount ];
+
+    // determine the encoding of every field
+    for ( int i = 0; i < gCycleSyncState::RealCount; ++i )
+    {
+        REAL & value = state.reals[i];
+        REAL step = sg_deltaSyncSteps[i];
+        modes[i] = gDeltaSyncFull;
+
+        if ( !base )
+        {
+        }
+        else if ( base->reals[i] == value )
+        {
+            modes[i] = gDeltaSyncUnchanged;
+        }
+        else if ( step > 0 && fabs( value - base->reals[i] ) < 32000 * step )
+        {
+            short delta = static_cast< short >( floor( ( value - base->reals[i] )/step + .5 ) );
+            if ( delta == 0 )
+            {
+                modes[i] = gDeltaSyncUnchanged;
+                value = base->reals[i];
+            }
+            else
+            {
+                modes[i] = gDeltaSyncDelta;
+                deltas[i] = delta;
+                value = sg_ApplySyncDelta( base->reals[i], delta, step );
+            }
+        }
+
+        if ( modes[i] == gDeltaSyncFull )
+        {
+            // the receiver gets single precision
+            value = static_cast< float >( value );
+        }
+    }
+    for ( int i = gCycleSyncState::RealCount; i < gCycleSyncState::FieldCount; ++i )
+    {
+        gCycleSyncState::Field field = gCycleSyncState::Field( i );
+        modes[i] = ( base && base->Short( field ) == state.Short( field ) ) ? gDeltaSyncUnchanged : gDeltaSyncFull;
+    }
+
+    // write the modes, eight fields per short
+    for ( int start = 0; start < gCycleSyncState::FieldCount; start += 8 )
+    {
+        unsigned short packed = 0;
+        for ( int i = start; i < start + 8 && i < gCycleSyncState::FieldCount; ++i )
+        {
+            packed |= modes[i] << ( 2 * ( i - start ) );
+        }
+        m.Write( packed );
+    }
+
+    // write the data
+    for ( int i = 0; i < gCycleSyncState::RealCount; ++i )
+    {
+        if ( modes[i] == gDeltaSyncDelta )
+            m.Write( static_cast< unsigned short >( deltas[i] ) );
+        else if ( modes[i] == gDeltaSyncFull )
+            sg_WriteFullReal( m, state.reals[i] );
+    }
+    for ( int i = gCycleSyncState::RealCount; i < gCycleSyncState::FieldCount; ++i )
+    {
+        if ( modes[i] == gDeltaSyncFull )
+            m.Write( state.Short( gCycleSyncState::Field( i ) ) );
+    }
+}
+
+// *******************************************************************************
+// *
+// *	sg_ReadDeltaSync
+// *
+// *******************************************************************************
+//!
+//!		@param	m	    the message to read from
+//!		@param	state	the state to fill
+//!		@param	base	the baseline the sender used, or NULL if it is not available
+//!		@return	true if the state could be read completely
+//!
+// *******************************************************************************
+
+static bool sg_ReadDeltaSync( nMessage & m, gCycleSyncState & state, gCycleSyncState const * base )
+{
+    int modes[ gCycleSyncState::FieldCount ];
+    for ( int start = 0; start < gCycleSyncState::FieldCount; start += 8 )
+    {
+        unsigned short packed;
+        m.Read( packed );
+        for ( int i = start; i < start + 8 && i < gCycleSyncState::FieldCount; ++i )
+        {
+            modes[i] = ( packed >> ( 2 * ( i - start ) ) ) & 3;
+            if ( modes[i] != gDeltaSyncFull && !base )
+                return false;
+        }
+    }
+
+    for ( int i = 0; i < gCycleSyncState::RealCount; ++i )
+    {
+        switch ( modes[i] )
+        {
+        case gDeltaSyncUnchanged:
+            state.reals[i] = base->reals[i];
+            break;
+        case gDeltaSyncDelta:
+            {
+                unsigned short delta;
+                m.Read( delta );
+                state.reals[i] = sg_ApplySyncDelta( base->reals[i], static_cast< short >( delta ), sg_deltaSyncSteps[i] );
+            }
+            break;
+        case gDeltaSyncFull:
+            state.reals[i] = sg_ReadFullReal( m );
+            break;
+        default:
+            return false;
+        }
+    }
+    for ( int i = gCycleSyncState::RealCount; i < gCycleSyncState::FieldCount; ++i )
+    {
+        gCycleSyncState::Field field = gCycleSyncState::Field( i );
+        if ( modes[i] == gDeltaSyncFull )
+            m.Read( state.Short( field ) );
+        else if ( modes[i] == gDeltaSyncUnchanged )
+            state.Short( field ) = base->Short( field );
+        else
+            return false;
+    }
+
+    return true;
+}
+
+// the delta sync bookkeeping of a cycle
+class gCycleDeltaSync
+{
+public:
+    //! what the server knows about the sync state of one client
+    struct Peer
+    {
+        gCycleSyncState acked;          //!< the last state the client acknowledged, the baseline for the next syncs
+        gCycleSyncState pending;        //!< the state sent in the sync we're waiting for an ack for
+        unsigned short pendingMessage;  //!< the ID of the message containing pending
+        unsigned short nextSeq;         //!< sequence number of the next sync
+
+        Peer(): pendingMessage( 0 ), nextSeq( 0 ){}
+    };
+
+    std::map< int, Peer > peers;                       //!< the baselines of every client that got syncs (server side)
+    gCycleSyncState received[ 2 * sgDeltaSyncWindow ]; //!< the last states received (client side)
+
+    //! returns the received state with the given sequence number, or NULL if it is not known
+    gCycleSyncState const * Received( unsigned short seq ) const
+    {
+        gCycleSyncState const & state = received[ seq % ( 2 * sgDeltaSyncWindow ) ];
+        return ( state.valid && state.seq == seq ) ? &state : NULL;
+    }
+
+    //! stores a received state
+    void Store( gCycleSyncState const & state )
+    {
+        gCycleSyncState & slot = received[ state.seq % ( 2 * sgDeltaSyncWindow ) ];
+        // don't let late messages overwrite newer states
+        if ( !slot.valid || static_cast< short >( state.seq - slot.seq ) > 0 )
+            slot = state;
+    }
+};
+
+static void sg_DeleteDeltaSync( gCycleDeltaSync * deltaSync )
+{
+    delete deltaSync;
+}
+
+gCycleDeltaSync & gCycle::DeltaSync()
+{
+    if ( !deltaSync_ )
+        deltaSync_ = tNEW( gCycleDeltaSync );
+    return *deltaSync_;
+}
+
+// *******************************************************************************
+// *
+// *	SyncAcked
+// *
+// *******************************************************************************
+//!
+//!		@param	user	    the user that acknowledged a sync
+//!		@param	messageID	the ID of the acknowledged message
+//!
+// *******************************************************************************
+
+void gCycle::SyncAcked( int user, unsigned short messageID )
+{
+    if ( !deltaSync_ )
+        return;
+
+    std::map< int, gCycleDeltaSync::Peer >::iterator found = deltaSync_->peers.find( user );
+    if ( found == deltaSync_->peers.end() )
+        return;
+
+    // the pending state is the new baseline
+    gCycleDeltaSync::Peer & peer = found->second;
+    if ( peer.pending.valid && peer.pendingMessage == messageID )
+    {
+        peer.acked = peer.pending;
+        peer.pending.valid = false;
+    }
+}
+
 void gCycle::WriteSync(nMessage &m){
     //	eNetGameObject::WriteSync(m);
 
@@ -4950,6 +5290,59 @@ void gCycle::WriteSync(nMessage &m){
         lastSyncOwnerGameTime_ = lastTime;
     }
 
+    int user = SyncedUser();
+    if ( user >= 0 && sg_deltaSync.Supported( user ) )
+    {
+        gCycleSyncState state;
+        state.reals[ gCycleSyncState::Time ] = Alive() ? lastTime : deathTime;
+        state.reals[ gCycleSyncState::DirX ] = Direction().x;
+        state.reals[ gCycleSyncState::DirY ] = Direction().y;
+        state.reals[ gCycleSyncState::PosX ] = Position().x;
+        state.reals[ gCycleSyncState::PosY ] = Position().y;
+        state.reals[ gCycleSyncState::Speed ] = sg_verletIntegration.Supported( user ) ? Speed() : verletSpeed_;
+        state.reals[ gCycleSyncState::Distance ] = distance;
+        state.reals[ gCycleSyncState::LastTurnX ] = GetLastTurnPos().x;
+        state.reals[ gCycleSyncState::LastTurnY ] = GetLastTurnPos().y;
+        state.Short( gCycleSyncState::Alive ) = Alive() ? 1 : 0;
+        state.Short( gCycleSyncState::Wall ) = ( !currentWall || currentWall->preliminary ) ? 0 : currentWall->ID();
+        state.Short( gCycleSyncState::Turns ) = turns;
+        state.Short( gCycleSyncState::Braking ) = braking;
+        state.Short( gCycleSyncState::Rubber ) = compressZeroOne.Compress( rubber/( sg_rubberCycle + .1 ) );
+        state.Short( gCycleSyncState::RubberMalus ) = compressZeroOne.Compress( 1/( 1 + rubberMalus ) );
+        state.Short( gCycleSyncState::MessageID ) = lastDestination ? lastDestination->messageID : 0;
+        state.Short( gCycleSyncState::BrakingReservoir ) = compressZeroOne.Compress( brakingReservoir );
+
+        gCycleDeltaSync::Peer & peer = DeltaSync().peers[ user ];
+
+        // forget everything about users that don't know about us yet, they may be new
+        if ( !knowsAbout[ user ].knowsAboutExistence )
+        {
+            peer.acked.valid = peer.pending.valid = false;
+        }
+
+        state.seq = peer.nextSeq++;
+        state.valid = true;
+
+        // use the acknowledged state as baseline if the client still has it
+        gCycleSyncState const * base = NULL;
+        if ( peer.acked.valid && static_cast< unsigned short >( state.seq - peer.acked.seq ) < sgDeltaSyncWindow )
+            base = &peer.acked;
+
+        m.Write( state.seq );
+        m.Write( base ? base->seq : state.seq );
+        sg_WriteDeltaSync( m, state, base );
+
+        // request an ack for this sync so it can become the next baseline
+        if ( !peer.pending.valid || static_cast< unsigned short >( state.seq - peer.pending.seq ) >= sgDeltaSyncWindow )
+        {
+            peer.pending = state;
+            peer.pendingMessage = m.MessageID();
+            knowsAbout.Modify( user ).nextSyncAck = true;
+        }
+
+        return;
+    }
+
     if ( Alive() )
     {
         m << lastTime;
@@ -5007,6 +5400,14 @@ void gCycle::WriteSync(nMessage &m){
 }
 
 bool gCycle::SyncIsNew(nMessage &m){
+    if ( sg_deltaSync.Supported( m.SenderID() ) )
+    {
+        // every delta sync needs to be read, it may become the baseline for later
+        // syncs; ReadSync() ignores outdated information.
+        nNetObject::SyncIsNew(m);
+        return true;
+    }
+
     bool ret=eNetGameObject::SyncIsNew(m);
 
 
@@ -5302,80 +5703,128 @@ void gCycle::ReadSync( nMessage &m )
 
     // eCoord new_pos = pos;	// the extrapolated position
 
-    // warning: depends on the implementation of eNetGameObject::WriteSync
-    // since we don't call eNetGameObject::ReadSync.
-    m >> sync.time;
-
-    // reset values not sent with old protocol messages
-    sync.rubber = rubber;
-    sync.turns = turns;
-    sync.braking = braking;
-    sync.messageID = 1;
-
-    m >> sync.dir;
-    m >> sync.pos;
-
-    //eDebugLine::SetTimeout( 1.0 );
-    //eDebugLine::SetColor( 1,1,1 );
-    //eDebugLine::Draw( lastSyncMessage_.pos, 0, lastSyncMessage_.pos, 20 );
-
-    m >> sync.speed;
-    m >> sync_alive;
-    m >> sync.distance;
-    m.Read(sync_wall);
-    if (!m.End())
-        m.Read(sync.turns);
-    if (!m.End())
-        m.Read(sync.braking);
-
-    if ( !m.End() )
-    {
-        m >> sync.lastTurn;
-    }
-    else if ( currentWall )
-    {
-        sync.lastTurn = currentWall->beg;
-    }
-
     bool canUseExtrapolatorMethod = false;
-
     bool rubberSent = false;
-    if ( !m.End() )
+
+    if ( sg_deltaSync.Supported( m.SenderID() ) )
     {
-        rubberSent = true;
+        gCycleSyncState state;
+        unsigned short baseSeq;
+        m.Read( state.seq );
+        m.Read( baseSeq );
 
-        // read rubber
-        REAL preRubber, preRubberMalus;
-        preRubber = compressZeroOne.Read( m );
-        preRubberMalus = compressZeroOne.Read( m );
+        gCycleDeltaSync & deltaSync = DeltaSync();
+        gCycleSyncState const * base = NULL;
+        if ( baseSeq != state.seq )
+        {
+            base = deltaSync.Received( baseSeq );
+            if ( !base )
+            {
+                // baseline lost; wait for the next sync
+                return;
+            }
+        }
 
-        // read last message ID
-        m.Read(sync.messageID);
+        if ( !sg_ReadDeltaSync( m, state, base ) )
+            return;
 
-        // read braking reservoir
-        sync.brakingReservoir = compressZeroOne.Read( m );
-        // std::cout << "sync: " << sync.brakingReservoir << ":" << sync.braking << "\n";
+        state.valid = true;
+        deltaSync.Store( state );
+
+        sync.time = state.reals[ gCycleSyncState::Time ];
+        sync.dir = eCoord( state.reals[ gCycleSyncState::DirX ], state.reals[ gCycleSyncState::DirY ] );
+        sync.pos = eCoord( state.reals[ gCycleSyncState::PosX ], state.reals[ gCycleSyncState::PosY ] );
+        sync.speed = state.reals[ gCycleSyncState::Speed ];
+        sync.distance = state.reals[ gCycleSyncState::Distance ];
+        sync.lastTurn = eCoord( state.reals[ gCycleSyncState::LastTurnX ], state.reals[ gCycleSyncState::LastTurnY ] );
+        sync_alive = state.Short( gCycleSyncState::Alive );
+        sync_wall = state.Short( gCycleSyncState::Wall );
+        sync.turns = state.Short( gCycleSyncState::Turns );
+        sync.braking = state.Short( gCycleSyncState::Braking );
+        sync.messageID = state.Short( gCycleSyncState::MessageID );
+        sync.brakingReservoir = compressZeroOne.Decompress( state.Short( gCycleSyncState::BrakingReservoir ) );
 
         // undo skewing
-        sync.rubber = preRubber * ( sg_rubberCycle + .1 );
-        sync.rubberMalus = 1/preRubberMalus - 1;
+        sync.rubber = compressZeroOne.Decompress( state.Short( gCycleSyncState::Rubber ) ) * ( sg_rubberCycle + .1 );
+        sync.rubberMalus = 1/compressZeroOne.Decompress( state.Short( gCycleSyncState::RubberMalus ) ) - 1;
 
-        // extrapolation is probably safe
+        rubberSent = true;
         canUseExtrapolatorMethod = sg_useExtrapolatorSync && lastTime > 0;
     }
     else
     {
-        // try to extrapolate brake status backwards in time
-        sync.brakingReservoir = brakingReservoir;
-        if ( brakingReservoir > 0 && sync.braking )
-            sync.brakingReservoir += ( lastTime - sync.time ) * sg_cycleBrakeDeplete;
-        else if ( brakingReservoir < 1 && !sync.braking )
-            sync.brakingReservoir -= ( lastTime - sync.time ) * sg_cycleBrakeRefill;
-
-        if ( sync.brakingReservoir < 0 )
-            sync.brakingReservoir = 0;
-        else if ( sync.brakingReservoir > 1 )
-            sync.brakingReservoir = 1;
+        // warning: depends on the implementation of eNetGameObject::WriteSync
+        // since we don't call eNetGameObject::ReadSync.
+        m >> sync.time;
+
+        // reset values not sent with old protocol messages
+        sync.rubber = rubber;
+        sync.turns = turns;
+        sync.braking = braking;
+        sync.messageID = 1;
+
+        m >> sync.dir;
+        m >> sync.pos;
+
+        //eDebugLine::SetTimeout( 1.0 );
+        //eDebugLine::SetColor( 1,1,1 );
+        //eDebugLine::Draw( lastSyncMessage_.pos, 0, lastSyncMessage_.pos, 20 );
+
+        m >> sync.speed;
+        m >> sync_alive;
+        m >> sync.distance;
+        m.Read(sync_wall);
+        if (!m.End())
+            m.Read(sync.turns);
+        if (!m.End())
+            m.Read(sync.braking);
+
+        if ( !m.End() )
+        {
+            m >> sync.lastTurn;
+        }
+        else if ( currentWall )
+        {
+            sync.lastTurn = currentWall->beg;
+        }
+
+        if ( !m.End() )
+        {
+            rubberSent = true;
+
+            // read rubber
+            REAL preRubber, preRubberMalus;
+            preRubber = compressZeroOne.Read( m );
+            preRubberMalus = compressZeroOne.Read( m );
+
+            // read last message ID
+            m.Read(sync.messageID);
+
+            // read braking reservoir
+            sync.brakingReservoir = compressZeroOne.Read( m );
+            // std::cout << "sync: " << sync.brakingReservoir << ":" << sync.braking << "\n";
+
+            // undo skewing
+            sync.rubber = preRubber * ( sg_rubberCycle + .1 );
+            sync.rubberMalus = 1/preRubberMalus - 1;
+
+            // extrapolation is probably safe
+            canUseExtrapolatorMethod = sg_useExtrapolatorSync && lastTime > 0;
+        }
+        else
+        {
+            // try to extrapolate brake status backwards in time
+            sync.brakingReservoir = brakingReservoir;
+            if ( brakingReservoir > 0 && sync.braking )
+                sync.brakingReservoir += ( lastTime - sync.time ) * sg_cycleBrakeDeplete;
+            else if ( brakingReservoir < 1 && !sync.braking )
+                sync.brakingReservoir -= ( lastTime - sync.time ) * sg_cycleBrakeRefill;
+
+            if ( sync.brakingReservoir < 0 )
+                sync.brakingReservoir = 0;
+            else if ( sync.brakingReservoir > 1 )
+                sync.brakingReservoir = 1;
+        }
     }
 
     // abort if sync is not new
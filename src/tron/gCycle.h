@@ -115,6 +115,7 @@ private:
 };
 
 class gCycleChatBot;
+class gCycleDeltaSync;
 
 #ifndef DEDICATED
 class gCycleWallsDisplayListManager
@@ -227,6 +228,9 @@ private:
     nTimeRolling nextSync, nextSyncOwner;
     REAL lastSyncOwnerGameTime_;    //!< time of the last sync to the owner in game time
 
+    gCycleDeltaSync * deltaSync_;                //!< baselines for delta compressed syncs, owned
+    gCycleDeltaSync & DeltaSync();               //!< returns the delta sync baselines, creating them if required
+
     void MyInitAfterCreation();
 
     void SetCurrentWall(gNetPlayerWall *w);
@@ -284,12 +288,14 @@ public:
 
     virtual nDescriptor &CreatorDescriptor() const;
     virtual bool SyncIsNew(nMessage &m);
+    virtual void SyncAcked(int user, unsigned short messageID);
     //virtual bool ClearToTransmit(int user) const;
 
     virtual bool Timestep(REAL currentTime);
     virtual bool TimestepCore(REAL currentTime,bool calculateAcceleration = true);
 
     virtual void InteractWith(eGameObject *target,REAL time,int recursion=1);
+    virtual REAL InteractionRange() const;
 
     virtual bool EdgeIsDangerous(const eWall *w, REAL time, REAL a) const;
 
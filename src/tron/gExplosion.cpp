@@ -272,6 +272,11 @@ bool gExplosion::Timestep(REAL currentTime){
 
 void gExplosion::InteractWith(eGameObject *,REAL ,int){}
 
+REAL gExplosion::InteractionRange() const
+{
+    return -1;
+}
+
 void gExplosion::PassEdge(const eWall *,REAL ,REAL ,int){}
 
 void gExplosion::Kill(){
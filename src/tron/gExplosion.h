@@ -44,6 +44,7 @@ public:
     virtual bool Timestep(REAL currentTime);
 
     virtual void InteractWith(eGameObject *target,REAL time,int recursion=1);
+    virtual REAL InteractionRange() const;
 
     virtual void PassEdge(const eWall *w,REAL time,REAL a,int recursion=1);
 
@@ -64,12 +64,14 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include "nServerInfo.h"
 #include "gAICharacter.h"
 #include "tDirectories.h"
+#include "tLogSink.h"
 #include "gTeam.h"
 #include "gWinZone.h"
 #include "eVoter.h"
 #include "tRecorder.h"
 
 #include "gParser.h"
+#include "gHighscores.h"
 #include "tResourceManager.h"
 #include "nAuthentication.h"
 
@@ -77,6 +79,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include <stdlib.h>
 #include <string>
 #include <fstream>
+#include <stdio.h>
 #include <ctype.h>
 #include <time.h>
 
@@ -629,134 +632,242 @@ bool sg_TalkToMaster = true;
 static tSettingItem<bool> sg_ttm("TALK_TO_MASTER",
                                  sg_TalkToMaster);
 
+// lines of journal per table entry that trigger a rewrite of the whole table
+static REAL sg_highscoreJournalRatio = 1;
+static tSettingItem<REAL> sg_highscoreJournalRatioConf("HIGHSCORE_JOURNAL_RATIO",
+        sg_highscoreJournalRatio);
+
 class gHighscoresBase{
     int id;
     static tList<gHighscoresBase> highscoreList;
 protected:
-    tArray<tString> highName;
+    gHighscoreStore store;
 
     char const * highscore_file;
     tOutput desc;
     int     maxSize;
 
-    // find the player at position i
-    ePlayerNetID *online(int p){
+    tLogSink * journal;   // changes since the file was last written completely
+    int journalLines;     // number of lines in the journal
+    bool compact;         // set if the next save needs to rewrite the file
+
+    // find the human player belonging to an entry
+    ePlayerNetID *online(gHighscoreEntry const * entry){
         for (int i=se_PlayerNetIDs.Len()-1;i>=0;i--)
-            if (se_PlayerNetIDs(i)->IsHuman() && !strcmp(se_PlayerNetIDs(i)->GetUserName(),highName[p]))
+            if (se_PlayerNetIDs(i)->IsHuman() && !strcmp(se_PlayerNetIDs(i)->GetUserName(),entry->Name()))
                 return se_PlayerNetIDs(i);
 
         return NULL;
     }
 
-    // i is the active player, j the passive one
-    virtual void swap_entries(int i,int j){
-        Swap(highName[i],highName[j]);
-
-        // swap: i is now the passive player
+    // the moving entry passed the one of player p, who now is at position pos
+    void passed(ePlayerNetID *p,gHighscoreEntry const * moving,int pos,bool rose){
+        tColoredString name;
+        name << *p << tColoredString::ColorString(1,.5,.5);
 
-        // send the poor guy who just dropped a message
-        ePlayerNetID *p=online(i);
-        if (p){
-            tColoredString name;
-            name << *p << tColoredString::ColorString(1,.5,.5);
+        tOutput message;
+        message.SetTemplateParameter(1, static_cast<const char *>(name));
+        message.SetTemplateParameter(2, static_cast<const char *>(moving->Name()));
+        message.SetTemplateParameter(3, pos+1);
+        message.SetTemplateParameter(4, desc);
 
-            tOutput message;
-            message.SetTemplateParameter(1, static_cast<const char *>(name));
-            message.SetTemplateParameter(2, static_cast<const char *>(highName[j]));
-            message.SetTemplateParameter(3, i+1);
-            message.SetTemplateParameter(4, desc);
+        if (rose)
+            message <<  "$league_message_rose" ;
+        else
+            message <<  "$league_message_dropped" ;
 
-            if (i<j)
-                message <<  "$league_message_rose" ;
-            else
-                message <<  "$league_message_dropped" ;
+        message << "\n";
 
-            message << "\n";
+        tString s;
+        s << message;
+        sn_ConsoleOut(s,p->Owner());
+    }
 
-            tString s;
-            s << message;
-            sn_ConsoleOut(s,p->Owner());
-            // con << message;
-        }
+    virtual double readScore(std::istream &s)=0;
+    virtual void writeScore(tString &s,double score)=0;
 
+    // formats an entry the way it appears in the file
+    void writeEntry(tString &line,gHighscoreEntry const * entry){
+        writeScore(line,entry->Score());
+        line.SetPos(10, false );
+        line << entry->Name() << '\n';
     }
 
-    void load_Name(std::istream &s,int i){
-        std::ws( s );
+    // reads a table or journal file, later lines override earlier ones.
+    // Returns the number of lines read.
+    int readFile(char const * filename){
+        tTextFileRecorder stream( tDirectories::Var(), filename );
+        int lines=0;
+        while ( !stream.EndOfFile() )
+        {
+            std::stringstream s( stream.GetLine() );
+            double score=readScore(s);
+
+            std::ws( s );
+            tString name;
+            name.ReadLine( s );
+            lines++;
+
+            if (name.Len()<=1)
+                continue;
+
+            gHighscoreEntry * entry=store.Find(name);
+            if (entry)
+                store.SetScore(entry,score);
+            else
+                store.Add(name,score);
+        }
 
-        // read name
-        highName[i].ReadLine( s );
+        return lines;
     }
 
-    void save_Name(std::ostream &s,int i){
-        s << highName[i];
+    tString fileName(){
+        tString filename(highscore_file);
+        if ( tRecorder::IsPlayingBack() )
+        {
+            filename += ".playback";
+        }
+        return filename;
     }
 
+    // rewrites the whole table and empties the journal
+    void writeTable(){
+        tString filename=fileName();
+        tString journalName=filename+".journal";
 
-public:
+        // pending journal lines have to hit the disk before it gets emptied
+        tLogSink::FlushAll();
 
-    virtual void Save()=0;
-    virtual void Load()=0;
+        tString path=tDirectories::Var().GetWritePath(filename);
+        if (path.Len()<=1)
+            return;
+        tString temp=path+".tmp";
 
-    // returns if i should stay above j
-    virtual bool inorder(int i,int j)=0;
+        {
+            std::ofstream s( temp );
+            if (!s.good())
+                return;
+
+            std::vector< gHighscoreEntry * > entries;
+            store.GetRanked(entries,maxSize);
+            for (std::vector< gHighscoreEntry * >::const_iterator i=entries.begin();i!=entries.end();++i){
+                tString line;
+                writeEntry(line,*i);
+                s << line;
+            }
+        }
 
-    void sort(){
-        // since single score items travel up the
-        // score ladder, this is the most efficient sort algorithm:
+        // replace the old table in one step so it is never seen half written
+#ifdef WIN32
+        remove( path );
+#endif
+        rename( temp, path );
 
-        for(int i=1;i<highName.Len();i++)
-            for(int j=i;j>=1 && !inorder(j-1,j);j--)
-                swap_entries(j,j-1);
-    }
+        std::ofstream truncate;
+        tDirectories::Var().Open( truncate, journalName );
 
+        journalLines=0;
+        compact=false;
+        store.ClearDirty();
+    }
 
-    int checkPos(int found){
-        // move him up
-        int newpos=found;
-        while(newpos>0 && !inorder(newpos-1,newpos)){
-            swap_entries(newpos,newpos-1);
-            newpos--;
+    // appends the changes since the last save to the journal
+    void writeJournal(){
+        if (!journal){
+            tString journalName=fileName()+".journal";
+            journal=tNEW(tLogSink)(journalName);
         }
 
-        // move him down
-        while(newpos<highName.Len()-1 && !inorder(newpos,newpos+1)){
-            swap_entries(newpos,newpos+1);
-            newpos++;
+        std::vector< gHighscoreEntry * > const & dirty=store.Dirty();
+        for (std::vector< gHighscoreEntry * >::const_iterator i=dirty.begin();i!=dirty.end();++i){
+            tString line;
+            writeEntry(line,*i);
+            journal->Write(line);
+            journalLines++;
         }
 
-        //Save();
+        store.ClearDirty();
+    }
+
+public:
+
+    virtual void Save(bool final=false){
+        if (compact || final || journalLines + static_cast<int>(store.Dirty().size()) > sg_highscoreJournalRatio * store.Len())
+            writeTable();
+        else
+            writeJournal();
+    }
+
+    virtual void Load(){
+        readFile(highscore_file);
+        journalLines=readFile(tString(highscore_file)+".journal");
+
+        // the table file only holds the best ones; the journal may know more
+        if (maxSize){
+            while (store.Len()>maxSize){
+                store.Remove(store.AtRank(store.Len()-1));
+                compact=true;
+            }
+        }
 
-        return newpos;
+        store.ClearDirty();
     }
 
-    int Find(const char *name,bool force=false){
-        int found=highName.Len();
-        for(int i=found-1;i>=0 ;i--)
-            if(highName[i].Len()<=1 || !strcmp(highName[i],name)){
-                found=i;
+    // moves an entry to its new score, informing the players it passes.
+    // Returns the new position.
+    int checkPos(gHighscoreEntry * entry,double score){
+        // remember where the players online are
+        tArray<ePlayerNetID*> players;
+        tArray<gHighscoreEntry*> entries;
+        tArray<int> positions;
+        for (int i=se_PlayerNetIDs.Len()-1;i>=0;i--){
+            ePlayerNetID *p=se_PlayerNetIDs(i);
+            gHighscoreEntry * other=p->IsHuman() ? store.Find(p->GetUserName()) : NULL;
+            if (other && other!=entry){
+                int j=players.Len();
+                players[j]=p;
+                entries[j]=other;
+                positions[j]=store.Rank(other);
             }
+        }
+
+        store.SetScore(entry,score);
+
+        // everyone whose position changed was passed
+        for (int i=0;i<players.Len();i++){
+            int pos=store.Rank(entries(i));
+            if (pos!=positions(i))
+                passed(players(i),entry,pos,pos<positions(i));
+        }
+
+        return store.Rank(entry);
+    }
+
+    gHighscoreEntry * Find(const char *name,bool force=false){
+        gHighscoreEntry * found=store.Find(name);
 
-        if (force && highName[found].Len()<=1)
-            highName[found]=name;
+        if (force && !found)
+            found=store.Add(tString(name),0);
 
         return found;
     }
 
     gHighscoresBase(char const * name,char const * sd,int max=0)
-            :id(-1),highscore_file(name),desc(sd),maxSize(max){
+            :id(-1),highscore_file(name),desc(sd),maxSize(max),journal(NULL),journalLines(0),compact(false){
         highscoreList.Add(this,id);
     }
 
     virtual ~gHighscoresBase(){
         highscoreList.Remove(this,id);
+        delete journal;
     }
 
     virtual void greet_this(ePlayerNetID *p,tOutput &o){
         //    tOutput o;
 
-        int f=Find(p->GetUserName())+1;
-        int l=highName.Len();
+        gHighscoreEntry * found=Find(p->GetUserName());
+        int l=store.Len();
+        int f=found ? store.Rank(found)+1 : l+1;
 
         o.SetTemplateParameter(1, f);
         o.SetTemplateParameter(2, l);
@@ -782,9 +893,9 @@ public:
         o << ".\n";
     }
 
-    static void SaveAll(){
+    static void SaveAll(bool final=false){
         for(int i=highscoreList.Len()-1;i>=0;i--)
-            highscoreList(i)->Save();
+            highscoreList(i)->Save(final);
     }
 
     static void LoadAll(){
@@ -809,94 +920,39 @@ tList<gHighscoresBase> gHighscoresBase::highscoreList;
 
 template<class T>class highscores: public gHighscoresBase{
     protected:
-    tArray<T>    high_score;
-
-    virtual void swap_entries(int i,int j){
-        Swap(high_score[i],high_score[j]);
-        gHighscoresBase::swap_entries(i,j);
+    virtual double readScore(std::istream &s){
+        T score=T();
+        s >> score;
+        return score;
     }
 
-    public:
-    virtual void Load(){
-        tTextFileRecorder stream( tDirectories::Var(), highscore_file );
-        int i=0;
-        while ( !stream.EndOfFile() )
-        {
-            std::stringstream s( stream.GetLine() );
-            s >> high_score[i];
-            load_Name(s,i);
-            // con << highName[i] << " " << high_score[i] << '\n';
-            i++;
-        }
-    }
-
-    // returns if i should stay above j
-    virtual bool inorder(int i,int j)
-    {
-        return (highName[j].Len()<=1 || high_score[i]>=high_score[j]);
-    }
-
-
-    virtual void Save(){
-        std::ofstream s;
-
-        sort();
-
-        tString filename(highscore_file);
-        if ( tRecorder::IsPlayingBack() )
-        {
-            filename += ".playback";
-        }
-
-        if ( tDirectories::Var().Open ( s, filename ) )
-        {
-            int i=0;
-            int max=high_score.Len();
-            if (maxSize && max>maxSize)
-                max=maxSize;
-            while (i<max && highName[i].Len()>1){
-                tString mess;
-                mess << high_score[i];
-                mess.SetPos(10, false );
-                s << mess;
-                save_Name(s,i);
-                s << '\n';
-                i++;
-                //std::cout << mess;
-                //save_Name(std::cout,i);
-                //std::cout << '\n';
-            }
-        }
+    virtual void writeScore(tString &s,double score){
+        s << static_cast<T>(score);
     }
 
-    void checkPos(int found,const tString &name,T score){
+    public:
+    void checkPos(gHighscoreEntry * found,const tString &name,T score){
         tOutput message;
-        // find the name in the list
-        bool isnew=false;
 
         message.SetTemplateParameter(1, name);
         message.SetTemplateParameter(2, desc);
         message.SetTemplateParameter(3, score);
 
-        if (highName[found].Len()<=1){
-            highName[found]=name;
-            message << "$highscore_message_entered";
-            high_score[found]=score;
-            isnew=true;
-        }
-        else if (score>high_score[found]){
+        // Find() already added newcomers with a score of zero, so they count as improving
+        if (score>static_cast<T>(found->Score())){
             message << "$highscore_message_improved";
-            high_score[found]=score;
         }
         else
             return;
 
+        int oldpos=store.Rank(found);
+
         // move him up
-        int newpos=gHighscoresBase::checkPos(found);
+        int newpos=gHighscoresBase::checkPos(found,score);
 
         message.SetTemplateParameter(4, newpos + 1);
 
-        if (newpos!=found || isnew)
+        if (newpos!=oldpos)
             if (newpos==0)
                 message << "$highscore_message_move_top";
             else
@@ -909,19 +965,18 @@ template<class T>class highscores: public gHighscoresBase{
 
         message << "\n";
 
-        ePlayerNetID *p=online(newpos);
+        ePlayerNetID *p=online(found);
         //con << message;
         if (p)
             sn_ConsoleOut(tString(message),p->Owner());
-        //Save();
     }
 
     void Add( ePlayerNetID* player,T AddScore)
     {
         tASSERT( player );
         tString const & name = player->GetUserName();
-        int f=Find(name,true);
-        checkPos(f,name,AddScore+high_score[f]);
+        gHighscoreEntry * f=Find(name,true);
+        checkPos(f,name,AddScore+static_cast<T>(f->Score()));
     }
 
     void Add( eTeam* team,T AddScore)
@@ -944,7 +999,7 @@ template<class T>class highscores: public gHighscoresBase{
         tString name = player->GetUserName();
 
         // find the name in the list
-        int found=Find(name,true);
+        gHighscoreEntry * found=Find(name,true);
         checkPos(found,name,score);
     }
 
@@ -994,61 +1049,55 @@ public:
     virtual void Load(){
         highscores<REAL>::Load();
 
-        sort();
+        std::vector< gHighscoreEntry * > entries;
+        store.GetRanked(entries);
 
-        int end=highName.Len();
-
-        for(int i=highName.Len()-1;i>=0;i--){
+        for(int i=entries.size()-1;i>=0;i--){
 
             // make them lose some points
 
-            REAL loss=ladder_lose_perc_on_load*high_score[i]*.01;
+            REAL score=entries[i]->Score();
+            REAL loss=ladder_lose_perc_on_load*score*.01;
             if (loss<ladder_lose_min_on_load)
                 loss=ladder_lose_min_on_load;
-            high_score[i]-=loss;
+            score-=loss;
 
-            if (high_score[i]<0)
-                end=i;
+            // remove the bugggers with less than 0 points
+            if (score<0)
+                store.Remove(entries[i]);
+            else
+                store.SetScore(entries[i],score);
         }
 
-        // remove the bugggers with less than 0 points
-        highName.SetLen(end);
-        high_score.SetLen(end);
+        // everyone changed, write everything on the next save
+        store.ClearDirty();
+        compact=true;
     }
 
-    void checkPos(int found,const tString &name,REAL score){
+    void checkPos(gHighscoreEntry * found,const tString &name,REAL score){
         tOutput message;
 
         message.SetTemplateParameter(1, name);
         message.SetTemplateParameter(2, desc);
         message.SetTemplateParameter(3, score);
 
-        // find the name in the list
-        bool isnew=false;
-        if (highName[found].Len()<=1){
-            highName[found]=name;
-            message << "$ladder_message_entered";
-            high_score[found]=score;
-            isnew=true;
-        }
-        else{
-            REAL diff=score-high_score[found];
-            message.SetTemplateParameter(5, static_cast<float>(fabs(diff)));
+        // Find() already added newcomers with a score of zero, so they gain or lose like everyone else
+        REAL diff=score-found->Score();
+        message.SetTemplateParameter(5, static_cast<float>(fabs(diff)));
 
-            if (diff>0)
-                message << "$ladder_message_gained";
-            else
-                message << "$ladder_message_lost";
+        if (diff>0)
+            message << "$ladder_message_gained";
+        else
+            message << "$ladder_message_lost";
 
-            high_score[found]=score;
-        }
+        int oldpos=store.Rank(found);
 
         // move him up
-        int newpos=gHighscoresBase::checkPos(found);
+        int newpos=gHighscoresBase::checkPos(found,score);
 
         message.SetTemplateParameter(4, newpos + 1);
 
-        if (newpos!=found || isnew)
+        if (newpos!=oldpos)
             if (newpos==0)
                 message << "$ladder_message_move_top";
             else
@@ -1061,18 +1110,16 @@ public:
 
         message << "\n";
 
-        ePlayerNetID *p=online(newpos);
+        ePlayerNetID *p=online(found);
         // con << message;
         if (p){
             sn_ConsoleOut(tString(message),p->Owner());
         }
-
-        // Save();
     }
 
     void Add(const tString &name,REAL AddScore){
-        int found=Find(name,true);
-        checkPos(found,name,AddScore+high_score[found]);
+        gHighscoreEntry * found=Find(name,true);
+        checkPos(found,name,AddScore+found->Score());
     }
 
     // ladder mechanics: what happens if someone wins?
@@ -1110,19 +1157,18 @@ public:
         }
 
         // collect the bets
-        tArray<int> nums;
         tArray<REAL> bet;
 
         REAL pot=0;
 
         for(i=active.Len()-1;i>=0;i--){
 
-            nums[i]=Find(active(i)->GetUserName(),true);
+            gHighscoreEntry * entry=Find(active(i)->GetUserName(),true);
 
-            if (high_score[nums[i]]<0)
-                high_score[nums[i]]=0;
+            if (entry->Score()<0)
+                store.SetScore(entry,0);
 
-            bet[i]=high_score[nums[i]]*ladder_perc_bet*.01;
+            bet[i]=entry->Score()*ladder_perc_bet*.01;
             if (bet[i]<ladder_min_bet)
                 bet[i]=ladder_min_bet;
             pot+=bet[i];
@@ -2981,6 +3027,10 @@ void gGame::NetSync(){
         uMenu::quickexit=uMenu::QuickExit_Total;
     }
 
+    // the replay benchmark is done when its recording is
+    if ( tPhaseTimer::IsEnabled() && !tRecorder::IsPlayingBack() )
+        uMenu::quickexit=uMenu::QuickExit_Total;
+
 #ifdef DEDICATED
     if (!sr_glOut && ePlayer::PlayerConfig(0)->cam)
         tERR_ERROR_INT("Someone messed with the camera!");
@@ -3031,15 +3081,14 @@ void gGame::SyncState(unsigned short state){
             NetSyncIdle();
 
             goon=false;
-            for(int i=MAXCLIENTS;i>0;i--)
-                if ( sn_Connections[i].socket )
+            for(int i=sn_NextActiveUser(MAXCLIENTS+1);i>0;i=sn_NextActiveUser(i))
+            {
+                int clientState = client_gamestate[i];
+                if ( sg_AbeforeB( clientState, state ) )
                 {
-                    int clientState = client_gamestate[i];
-                    if ( sg_AbeforeB( clientState, state ) )
-                    {
-                        goon=true;
-                    }
+                    goon=true;
                 }
+            }
             if (goon && firsttime){
                 firsttime=false;
 #ifdef DEBUG
@@ -3138,6 +3187,9 @@ void gGame::StateUpdate(){
             exit_game_objects(grid);
             nNetObject::ClearAllDeleted();
 
+            // the round is over; get the logs onto the disk
+            tLogSink::FlushAll();
+
             if (goon)
                 SetState(GS_TRANSFER_SETTINGS,GS_CREATE_GRID);
             else
@@ -3276,13 +3328,12 @@ void gGame::StateUpdate(){
                 while(goon && tSysTimeFloat()<timeout){
                     NetSyncIdle();
                     goon=false;
-                    for(int i=MAXCLIENTS;i>0;i--)
-                        if (sn_Connections[i].socket)
-                            for(int j=sn_netObjects.Len()-1;j>=0;j--)
-                                if (sn_netObjects(j) &&
-                                        !sn_netObjects(j)->HasBeenTransmitted(i) &&
-                                        sn_netObjects(j)->syncRequested(i))
-                                    goon=true;
+                    for(int i=sn_NextActiveUser(MAXCLIENTS+1);i>0;i=sn_NextActiveUser(i))
+                        for(int j=sn_netObjects.Len()-1;j>=0;j--)
+                            if (sn_netObjects(j) &&
+                                    !sn_netObjects(j)->HasBeenTransmitted(i) &&
+                                    sn_netObjects(j)->syncRequested(i))
+                                goon=true;
                 }
                 if (tSysTimeFloat()<timeout)
                     con << tOutput("$gamestate_done");
@@ -3379,6 +3430,7 @@ void gGame::StateUpdate(){
                 if ( sg_waitForExternalScript )
                 {
                     sg_waitForExternalScriptWriter.write();
+                    tLogSink::FlushAll();
                     // REAL waitingSince = tSysTimeFloat();
                 }
                 while ( sg_waitForExternalScript && timeout > tSysTimeFloat())
@@ -4144,7 +4196,10 @@ static uActionGlobalFunc ingamemenu_action(&ingamemenu,&ingamemenu_func, true );
 
 static eLadderLogWriter sg_gameTimeWriter("GAME_TIME", true);
 
+static tPhaseTimer sg_frameTimer( "frame" );
 bool gGame::GameLoop(bool input){
+    tPhaseTimerScope phase( sg_frameTimer );
+
     nNetState netstate = sn_GetNetState();
 
 #ifdef DEBUG
@@ -4339,12 +4394,8 @@ bool gGame::GameLoop(bool input){
         if (sn_GetNetState()!=nCLIENT)
         {
             // simulate IAs
-            for(int i=se_PlayerNetIDs.Len()-1;i>=0;i--)
-            {
-                gAIPlayer *ai = dynamic_cast<gAIPlayer*>(se_PlayerNetIDs(i));
-                if (ai && think)
-                    ai->Timestep(gtime);
-            }
+            if (think)
+                gAIPlayer::TimestepAll(gtime);
 
             Analysis(gtime);
 
@@ -4558,7 +4609,7 @@ void sg_EnterGameCore( nNetState enter_state ){
 
 void sg_EnterGameCleanup()
 {
-    gHighscoresBase::SaveAll();
+    gHighscoresBase::SaveAll(true);
 
     sn_SetNetState( nSTANDALONE );
 
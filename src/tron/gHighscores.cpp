@@ -0,0 +1,412 @@
+/*
+
+*************************************************************************
+
+ArmageTron -- Just another Tron Lightcycle Game in 3D.
+Copyright (C) 2005  Manuel Moos (manuel@moosnet.de)
+
+**************************************************************************
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+  
+***************************************************************************
+
+*/
+
+#include "gHighscores.h"
+#include "tMemManager.h"
+#include "tError.h"
+
+#include <string.h>
+
+// *******************************************************************************
+// *
+// *	gHighscoreEntry
+// *
+// *******************************************************************************
+
+gHighscoreEntry::gHighscoreEntry( tString const & name, double score )
+    : name_( name ), score_( score ), order_( 0 ), dirty_( false )
+    , priority_( 0 ), size_( 1 ), left_( NULL ), right_( NULL ), nextInBucket_( NULL )
+{
+}
+
+// *******************************************************************************
+// *
+// *	gHighscoreStore
+// *
+// *******************************************************************************
+
+gHighscoreStore::gHighscoreStore()
+    : root_( NULL ), count_( 0 ), firstOrder_( 0 ), lastOrder_( 0 ), random_( 0x9e3779b9 )
+{
+    buckets_.resize( 64, NULL );
+}
+
+gHighscoreStore::~gHighscoreStore()
+{
+    Delete( root_ );
+}
+
+void gHighscoreStore::Delete( gHighscoreEntry * root )
+{
+    if ( root )
+    {
+        Delete( root->left_ );
+        Delete( root->right_ );
+        delete root;
+    }
+}
+
+// FNV-1a over the name
+size_t gHighscoreStore::Bucket( char const * name ) const
+{
+    unsigned int hash = 2166136261u;
+    for ( unsigned char const * c = reinterpret_cast< unsigned char const * >( name ); *c; ++c )
+    {
+        hash = ( hash ^ *c ) * 16777619u;
+    }
+
+    // the bucket count is a power of two
+    return hash & ( buckets_.size() - 1 );
+}
+
+void gHighscoreStore::Rehash( size_t buckets )
+{
+    std::vector< gHighscoreEntry * > old;
+    old.swap( buckets_ );
+    buckets_.resize( buckets, NULL );
+
+    for ( std::vector< gHighscoreEntry * >::iterator i = old.begin(); i != old.end(); ++i )
+    {
+        gHighscoreEntry * entry = *i;
+        while ( entry )
+        {
+            gHighscoreEntry * next = entry->nextInBucket_;
+            gHighscoreEntry * & bucket = buckets_[ Bucket( entry->name_ ) ];
+            entry->nextInBucket_ = bucket;
+            bucket = entry;
+            entry = next;
+        }
+    }
+}
+
+gHighscoreEntry * gHighscoreStore::Find( char const * name ) const
+{
+    for ( gHighscoreEntry * entry = buckets_[ Bucket( name ) ]; entry; entry = entry->nextInBucket_ )
+    {
+        if ( !strcmp( entry->name_, name ) )
+        {
+            return entry;
+        }
+    }
+
+    return NULL;
+}
+
+// entries with higher scores go first; of equal scores, the one with the lower tie breaker
+bool gHighscoreStore::Before( gHighscoreEntry const * a, gHighscoreEntry const * b )
+{
+    if ( a->score_ != b->score_ )
+    {
+        return a->score_ > b->score_;
+    }
+    return a->order_ < b->order_;
+}
+
+int gHighscoreStore::Size( gHighscoreEntry const * root )
+{
+    return root ? root->size_ : 0;
+}
+
+void gHighscoreStore::Update( gHighscoreEntry * root )
+{
+    root->size_ = 1 + Size( root->left_ ) + Size( root->right_ );
+}
+
+gHighscoreEntry * gHighscoreStore::RotateLeft( gHighscoreEntry * root )
+{
+    gHighscoreEntry * top = root->right_;
+    root->right_ = top->left_;
+    top->left_ = root;
+    Update( root );
+    Update( top );
+    return top;
+}
+
+gHighscoreEntry * gHighscoreStore::RotateRight( gHighscoreEntry * root )
+{
+    gHighscoreEntry * top = root->left_;
+    root->left_ = top->right_;
+    top->right_ = root;
+    Update( root );
+    Update( top );
+    return top;
+}
+
+gHighscoreEntry * gHighscoreStore::Insert( gHighscoreEntry * root, gHighscoreEntry * entry )
+{
+    if ( !root )
+    {
+        return entry;
+    }
+
+    if ( Before( entry, root ) )
+    {
+        root->left_ = Insert( root->left_, entry );
+        if ( root->left_->priority_ > root->priority_ )
+        {
+            return RotateRight( root );
+        }
+    }
+    else
+    {
+        root->right_ = Insert( root->right_, entry );
+        if ( root->right_->priority_ > root->priority_ )
+        {
+            return RotateLeft( root );
+        }
+    }
+
+    Update( root );
+    return root;
+}
+
+gHighscoreEntry * gHighscoreStore::Merge( gHighscoreEntry * left, gHighscoreEntry * right )
+{
+    if ( !left )
+    {
+        return right;
+    }
+    if ( !right )
+    {
+        return left;
+    }
+
+    if ( left->priority_ > right->priority_ )
+    {
+        left->right_ = Merge( left->right_, right );
+        Update( left );
+        return left;
+    }
+    else
+    {
+        right->left_ = Merge( left, right->left_ );
+        Update( right );
+        return right;
+    }
+}
+
+gHighscoreEntry * gHighscoreStore::Erase( gHighscoreEntry * root, gHighscoreEntry * entry )
+{
+    tASSERT( root );
+
+    if ( root == entry )
+    {
+        gHighscoreEntry * ret = Merge( root->left_, root->right_ );
+        entry->left_ = entry->right_ = NULL;
+        entry->size_ = 1;
+        return ret;
+    }
+
+    if ( Before( entry, root ) )
+    {
+        root->left_ = Erase( root->left_, entry );
+    }
+    else
+    {
+        root->right_ = Erase( root->right_, entry );
+    }
+
+    Update( root );
+    return root;
+}
+
+void gHighscoreStore::MarkDirty( gHighscoreEntry * entry )
+{
+    if ( !entry->dirty_ )
+    {
+        entry->dirty_ = true;
+        dirty_.push_back( entry );
+    }
+}
+
+void gHighscoreStore::ClearDirty()
+{
+    for ( std::vector< gHighscoreEntry * >::iterator i = dirty_.begin(); i != dirty_.end(); ++i )
+    {
+        (*i)->dirty_ = false;
+    }
+    dirty_.clear();
+}
+
+gHighscoreEntry * gHighscoreStore::Add( tString const & name, double score )
+{
+    tASSERT( !Find( name ) );
+
+    gHighscoreEntry * entry = tNEW( gHighscoreEntry )( name, score );
+
+    // new entries go below others with the same score
+    entry->order_ = ++lastOrder_;
+
+    // xorshift priorities keep the treap balanced
+    random_ ^= random_ << 13;
+    random_ ^= random_ >> 17;
+    random_ ^= random_ << 5;
+    entry->priority_ = random_;
+
+    root_ = Insert( root_, entry );
+
+    if ( ++count_ > static_cast< int >( buckets_.size() ) )
+    {
+        Rehash( buckets_.size() * 2 );
+    }
+    gHighscoreEntry * & bucket = buckets_[ Bucket( name ) ];
+    entry->nextInBucket_ = bucket;
+    bucket = entry;
+
+    MarkDirty( entry );
+
+    return entry;
+}
+
+void gHighscoreStore::SetScore( gHighscoreEntry * entry, double score )
+{
+    if ( score == entry->score_ )
+    {
+        return;
+    }
+
+    root_ = Erase( root_, entry );
+
+    // an entry that rises stays below those it only draws level with,
+    // one that falls stays above them.
+    entry->order_ = score > entry->score_ ? ++lastOrder_ : --firstOrder_;
+    entry->score_ = score;
+
+    root_ = Insert( root_, entry );
+
+    MarkDirty( entry );
+}
+
+void gHighscoreStore::Remove( gHighscoreEntry * entry )
+{
+    root_ = Erase( root_, entry );
+    --count_;
+
+    gHighscoreEntry * * link = &buckets_[ Bucket( entry->name_ ) ];
+    while ( *link != entry )
+    {
+        link = &(*link)->nextInBucket_;
+    }
+    *link = entry->nextInBucket_;
+
+    if ( entry->dirty_ )
+    {
+        for ( std::vector< gHighscoreEntry * >::iterator i = dirty_.begin(); i != dirty_.end(); ++i )
+        {
+            if ( *i == entry )
+            {
+                dirty_.erase( i );
+                break;
+            }
+        }
+    }
+
+    delete entry;
+}
+
+int gHighscoreStore::Len() const
+{
+    return count_;
+}
+
+int gHighscoreStore::Rank( gHighscoreEntry const * entry ) const
+{
+    int rank = 0;
+    gHighscoreEntry const * node = root_;
+    while ( node )
+    {
+        if ( node == entry )
+        {
+            return rank + Size( node->left_ );
+        }
+        if ( Before( entry, node ) )
+        {
+            node = node->left_;
+        }
+        else
+        {
+            rank += Size( node->left_ ) + 1;
+            node = node->right_;
+        }
+    }
+
+    tASSERT( 0 );
+    return -1;
+}
+
+gHighscoreEntry * gHighscoreStore::AtRank( int rank ) const
+{
+    gHighscoreEntry * node = root_;
+    while ( node )
+    {
+        int left = Size( node->left_ );
+        if ( rank < left )
+        {
+            node = node->left_;
+        }
+        else if ( rank == left )
+        {
+            return node;
+        }
+        else
+        {
+            rank -= left + 1;
+            node = node->right_;
+        }
+    }
+
+    return NULL;
+}
+
+void gHighscoreStore::GetRanked( std::vector< gHighscoreEntry * > & entries, int max ) const
+{
+    if ( max <= 0 || max > count_ )
+    {
+        max = count_;
+    }
+    entries.clear();
+    entries.reserve( max );
+
+    // in order walk with an explicit stack
+    std::vector< gHighscoreEntry * > stack;
+    gHighscoreEntry * node = root_;
+    while ( static_cast< int >( entries.size() ) < max && ( node || !stack.empty() ) )
+    {
+        if ( node )
+        {
+            stack.push_back( node );
+            node = node->left_;
+        }
+        else
+        {
+            node = stack.back();
+            stack.pop_back();
+            entries.push_back( node );
+            node = node->right_;
+        }
+    }
+}
@@ -0,0 +1,105 @@
+/*
+
+*************************************************************************
+
+ArmageTron -- Just another Tron Lightcycle Game in 3D.
+Copyright (C) 2005  Manuel Moos (manuel@moosnet.de)
+
+**************************************************************************
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+  
+***************************************************************************
+
+*/
+
+#ifndef ArmageTron_gHighscores_H
+#define ArmageTron_gHighscores_H
+
+#include "tString.h"
+
+#include <vector>
+
+//! entry of a gHighscoreStore
+class gHighscoreEntry
+{
+    friend class gHighscoreStore;
+public:
+    tString const & Name() const { return name_; }
+    double Score() const { return score_; }
+private:
+    gHighscoreEntry( tString const & name, double score );
+
+    tString name_;                  //!< the player's user name
+    double score_;                  //!< the score
+    int order_;                     //!< tie breaker between equal scores; lower goes first
+    bool dirty_;                    //!< changed since the last ClearDirty()
+
+    unsigned int priority_;         //!< heap priority in the treap
+    int size_;                      //!< number of entries in the subtree rooted here
+    gHighscoreEntry * left_;        //!< entries ranked before this one
+    gHighscoreEntry * right_;       //!< entries ranked after this one
+
+    gHighscoreEntry * nextInBucket_;//!< next entry in the same hash bucket
+};
+
+//! highscore table: entries indexed by name and kept ranked by descending score.
+//! All operations are logarithmic or better in the number of entries.
+class gHighscoreStore
+{
+public:
+    gHighscoreStore();
+    ~gHighscoreStore();
+
+    gHighscoreEntry * Find( char const * name ) const;               //!< finds the entry of a name, NULL if there is none
+    gHighscoreEntry * Add( tString const & name, double score );     //!< adds a new entry; the name must not have one yet
+    void SetScore( gHighscoreEntry * entry, double score );          //!< changes the score of an entry and reranks it
+    void Remove( gHighscoreEntry * entry );                          //!< removes and deletes an entry
+
+    int Len() const;                                                 //!< number of entries
+    int Rank( gHighscoreEntry const * entry ) const;                 //!< position of the entry, 0 is the top
+    gHighscoreEntry * AtRank( int rank ) const;                      //!< entry at the given position
+    void GetRanked( std::vector< gHighscoreEntry * > & entries, int max = 0 ) const; //!< all entries (or the top max) in rank order
+
+    std::vector< gHighscoreEntry * > const & Dirty() const { return dirty_; } //!< entries changed since the last ClearDirty()
+    void ClearDirty();                                               //!< forgets about the changes
+private:
+    gHighscoreStore( gHighscoreStore const & );
+    gHighscoreStore & operator = ( gHighscoreStore const & );
+
+    static bool Before( gHighscoreEntry const * a, gHighscoreEntry const * b ); //!< whether a is ranked above b
+
+    gHighscoreEntry * Insert( gHighscoreEntry * root, gHighscoreEntry * entry );  //!< inserts into a treap, returns the new root
+    gHighscoreEntry * Erase( gHighscoreEntry * root, gHighscoreEntry * entry );   //!< removes from a treap, returns the new root
+    gHighscoreEntry * Merge( gHighscoreEntry * left, gHighscoreEntry * right );   //!< joins two treaps, all of left ranked above right
+    static int Size( gHighscoreEntry const * root );                 //!< size of a treap
+    static void Update( gHighscoreEntry * root );                    //!< recalculates the size after the children changed
+    static gHighscoreEntry * RotateLeft( gHighscoreEntry * root );   //!< lifts the right child, returns the new root
+    static gHighscoreEntry * RotateRight( gHighscoreEntry * root );  //!< lifts the left child, returns the new root
+
+    void Rehash( size_t buckets );                                   //!< redistributes the entries over a new number of buckets
+    size_t Bucket( char const * name ) const;                        //!< the bucket a name belongs to
+    void MarkDirty( gHighscoreEntry * entry );                       //!< remembers the entry as changed
+    void Delete( gHighscoreEntry * root );                           //!< deletes a treap
+
+    gHighscoreEntry * root_;                                         //!< root of the treap
+    std::vector< gHighscoreEntry * > buckets_;                       //!< hash buckets
+    int count_;                                                      //!< number of entries
+    int firstOrder_, lastOrder_;                                     //!< smallest and largest tie breaker handed out
+    unsigned int random_;                                            //!< state of the priority generator
+    std::vector< gHighscoreEntry * > dirty_;                         //!< changed entries
+};
+
+#endif
@@ -38,9 +38,13 @@
 #define xmlFree(x) free(x)
 #endif
 
-#if HAVE_LIBXML2_WO_PIBCREATE
-#	include "tDirectories.h"
-#endif
+#include "tDirectories.h"
+
+#include <vector>
+#include <map>
+#include <string>
+#include <sstream>
+#include <fstream>
 
 // lean auto-deleting wrapper class for xmlChar * return values the user has to clean after use
 class gXMLCharReturn
@@ -84,12 +88,202 @@ static void sg_Deprecated()
         con << "\n\n" << tColoredString::ColorString(1,.3,.3) << "WARNING: You are loading a map that is written in a deprecated format. It should work for now, but will stop to do so in one of the next releases. Have the map upgraded to an up-to-date version as soon as possible.\n\n";
 }
 
+// *******************************************************************************
+// *
+// *	gMapInstruction, gCompiledMap
+// *
+// *******************************************************************************
+//!
+//!     Walking the DOM of a map is done once per map file. The walk records the
+//!     steps that build the world in unscaled map coordinates; instantiating the map
+//!     every round then just replays them with the current size multiplier.
+//!
+// *******************************************************************************
+
+//! one step of building the world from a map
+struct gMapInstruction
+{
+    enum Opcode
+    {
+        Setting,        //!< name value: loads a setting
+        SettingsDone,   //!< end of a settings block: applies the settings, fetches the new size multiplier
+        Winding,        //!< number: sets the number of driving directions
+        WindingAxes,    //!< number normalize x0 y0 x1 y1 ...: sets explicit driving directions
+        Spawn,          //!< x y xdir ydir: adds a spawn point
+        Zone,           //!< name=effect, x y radius growth: creates a zone
+        WallBegin,      //!< height: starts a wall
+        WallPoint,      //!< x y: starts the wall at the point or draws a rim segment to it
+        WallSavePos,    //!< remembers the current wall position
+        WallRestorePos, //!< goes back to the remembered wall position
+        WallEnd,        //!< ends a wall
+        Line,           //!< startx starty endx endy: deprecated single rim segment
+        Rectangle,      //!< startx starty endx endy: deprecated rim rectangle
+        Deprecated,     //!< warns about a deprecated map format
+        OpcodeCount
+    };
+
+    int opcode;                 //!< what to do
+    std::vector< float > args;  //!< numeric arguments, see Opcode
+    std::string name, value;    //!< string arguments, see Opcode
+
+    gMapInstruction( int op = Deprecated ): opcode( op ){}
+};
+
+//! a map file reduced to the steps that build the world, with the identity of the file it was compiled from
+class gCompiledMap
+{
+public:
+    gCompiledMap(): size_( 0 ), hash_( 0 ), sum_( 0 ){}
+
+    void Fingerprint( std::string const & content );        //!< remembers the identity of the map file contents
+    bool SameFile( gCompiledMap const & other ) const;     //!< checks whether two compiled maps stem from the same file contents
+
+    void Write( std::ostream & s ) const; //!< writes the compiled map to a binary stream
+    bool Read ( std::istream & s );       //!< reads the compiled map from a binary stream, returns false if it is unusable
+
+    std::string filePath;      //!< the resource path of the map
+    std::string rightFilePath; //!< the resource path the map claims to belong to, empty if it does not claim any
+    std::vector< gMapInstruction > instructions; //!< the world building steps
+private:
+    unsigned int size_, hash_, sum_; //!< length and two independent hashes of the map file
+};
+
+//! version of the binary format of compiled maps; increase on every change of gMapInstruction or gCompiledMap
+static const int sg_compiledMapVersion = 1;
+static const char sg_compiledMapMagic[] = "AAMAPC";
+
+//! FNV-1a hash of a string
+static unsigned int sg_HashFNV( std::string const & s )
+{
+    unsigned int hash = 2166136261U;
+    for ( std::string::const_iterator i = s.begin(); i != s.end(); ++i )
+        hash = ( hash ^ (unsigned char)( *i ) ) * 16777619U;
+    return hash;
+}
+
+void gCompiledMap::Fingerprint( std::string const & content )
+{
+    // FNV-1a and a Bernstein hash, together with the length
+    size_ = content.size();
+    hash_ = sg_HashFNV( content );
+    sum_  = 5381;
+    for ( std::string::const_iterator i = content.begin(); i != content.end(); ++i )
+        sum_ = sum_ * 33 + (unsigned char)( *i );
+}
+
+bool gCompiledMap::SameFile( gCompiledMap const & other ) const
+{
+    return size_ == other.size_ && hash_ == other.hash_ && sum_ == other.sum_ && filePath == other.filePath;
+}
+
+static void sg_WriteInt( std::ostream & s, unsigned int i )
+{
+    s.write( reinterpret_cast< char const * >( &i ), sizeof( i ) );
+}
+
+static void sg_WriteString( std::ostream & s, std::string const & str )
+{
+    sg_WriteInt( s, str.size() );
+    s.write( str.data(), str.size() );
+}
+
+static bool sg_ReadInt( std::istream & s, unsigned int & i )
+{
+    s.read( reinterpret_cast< char * >( &i ), sizeof( i ) );
+    return s.good();
+}
+
+static bool sg_ReadString( std::istream & s, std::string & str )
+{
+    unsigned int len;
+    if ( !sg_ReadInt( s, len ) || len > 0x100000 )
+        return false;
+    std::vector< char > buffer( len + 1 );
+    s.read( &buffer[0], len );
+    str.assign( &buffer[0], len );
+    return s.good();
+}
+
+void gCompiledMap::Write( std::ostream & s ) const
+{
+    s.write( sg_compiledMapMagic, sizeof( sg_compiledMapMagic ) );
+    sg_WriteInt( s, sg_compiledMapVersion );
+    sg_WriteInt( s, size_ );
+    sg_WriteInt( s, hash_ );
+    sg_WriteInt( s, sum_ );
+    sg_WriteString( s, filePath );
+    sg_WriteString( s, rightFilePath );
+
+    sg_WriteInt( s, instructions.size() );
+    for ( std::vector< gMapInstruction >::const_iterator i = instructions.begin(); i != instructions.end(); ++i )
+    {
+        sg_WriteInt( s, i->opcode );
+        sg_WriteInt( s, i->args.size() );
+        if ( !i->args.empty() )
+            s.write( reinterpret_cast< char const * >( &i->args[0] ), sizeof( float ) * i->args.size() );
+        sg_WriteString( s, i->name );
+        sg_WriteString( s, i->value );
+    }
+}
+
+bool gCompiledMap::Read( std::istream & s )
+{
+    char magic[ sizeof( sg_compiledMapMagic ) ];
+    s.read( magic, sizeof( magic ) );
+    if ( !s.good() || memcmp( magic, sg_compiledMapMagic, sizeof( magic ) ) )
+        return false;
+
+    unsigned int version, count;
+    if ( !sg_ReadInt( s, version ) || version != sg_compiledMapVersion ||
+         !sg_ReadInt( s, size_ ) || !sg_ReadInt( s, hash_ ) || !sg_ReadInt( s, sum_ ) ||
+         !sg_ReadString( s, filePath ) || !sg_ReadString( s, rightFilePath ) ||
+         !sg_ReadInt( s, count ) || count > 0x1000000 )
+        return false;
+
+    instructions.clear();
+    instructions.reserve( count );
+    for ( unsigned int i = 0; i < count; ++i )
+    {
+        unsigned int opcode, argCount;
+        if ( !sg_ReadInt( s, opcode ) || opcode >= gMapInstruction::OpcodeCount ||
+             !sg_ReadInt( s, argCount ) || argCount > 0x10000 )
+            return false;
+
+        instructions.push_back( gMapInstruction( opcode ) );
+        gMapInstruction & instruction = instructions.back();
+        instruction.args.resize( argCount );
+        if ( argCount > 0 )
+            s.read( reinterpret_cast< char * >( &instruction.args[0] ), sizeof( float ) * argCount );
+        if ( !sg_ReadString( s, instruction.name ) || !sg_ReadString( s, instruction.value ) )
+            return false;
+    }
+
+    return true;
+}
+
+static bool sg_mapCache = true;
+static tSettingItem< bool > sg_mapCacheConf( "MAP_CACHE", sg_mapCache );
+
+//! compiled maps by resource path
+typedef std::map< std::string, gCompiledMap > gCompiledMapCache;
+static gCompiledMapCache sg_compiledMaps;
+
+//! returns the name of the disk cache file of a map, relative to the var directory
+static tString sg_CompiledMapFile( std::string const & filePath )
+{
+    std::ostringstream name;
+    name << "mapcache/" << std::hex << sg_HashFNV( filePath ) << ".aamapc";
+    return tString( name.str().c_str() );
+}
+
 gParser::gParser(gArena *anArena, eGrid *aGrid)
 {
     theArena = anArena;
 
     theGrid = aGrid;
     doc = NULL;
+    compiled = NULL;
+    compiling = NULL;
     rimTexture = 0;
 }
 
@@ -384,7 +578,7 @@ gParser::parseAxes(eGrid *grid, xmlNodePtr cur, const xmlChar * keyword)
 
     normalize = myxmlGetPropBool(cur, "normalize");
 
-    grid->SetWinding(number);
+    Emit(gMapInstruction::Winding).args.push_back(number);
 
     cur = cur->xmlChildrenNode;
     if (cur != NULL)
@@ -430,7 +624,13 @@ gParser::parseAxes(eGrid *grid, xmlNodePtr cur, const xmlChar * keyword)
             }
             cur = cur->next;
         }
-        grid->SetWinding(number, axisDir, normalize);
+        gMapInstruction & axes = Emit(gMapInstruction::WindingAxes);
+        axes.args.push_back(number);
+        axes.args.push_back(normalize);
+        for(int i=0; i<number; i++){
+            axes.args.push_back(axisDir[i].x);
+            axes.args.push_back(axisDir[i].y);
+        }
         free(axisDir);
     }
 }
@@ -444,7 +644,11 @@ gParser::parseSpawn(eGrid *grid, xmlNodePtr cur, const xmlChar * keyword)
     y = myxmlGetPropFloat(cur, "y");
     myxmlGetDirection(cur, xdir, ydir);
 
-    theArena->NewSpawnPoint(eCoord(x, y), eCoord(xdir, ydir));
+    gMapInstruction & spawn = Emit(gMapInstruction::Spawn);
+    spawn.args.push_back(x);
+    spawn.args.push_back(y);
+    spawn.args.push_back(xdir);
+    spawn.args.push_back(ydir);
 
     endElementAlternative(grid, cur, keyword);
 }
@@ -478,7 +682,7 @@ gParser::parseShapeCircle(eGrid *grid, xmlNodePtr cur, float &x, float &y, float
 void
 gParser::parseZone(eGrid * grid, xmlNodePtr cur, const xmlChar * keyword)
 {
-    float x, y, radius, growth;
+    float x = 0, y = 0, radius = 0, growth = 0;
     bool shapeFound = false;
     xmlNodePtr shape = cur->xmlChildrenNode;
 
@@ -495,28 +699,14 @@ gParser::parseZone(eGrid * grid, xmlNodePtr cur, const xmlChar * keyword)
         shape = shape->next;
     }
 
-    gZone * zone = NULL;
-    if (sn_GetNetState() != nCLIENT )
-    {
-        if (!xmlStrcmp(myxmlGetProp(cur, "effect").GetXML(), (const xmlChar *)"win")) {
-            zone = tNEW( gWinZoneHack) ( grid, eCoord(x*sizeMultiplier,y*sizeMultiplier) );
-        }
-        else if (!xmlStrcmp(myxmlGetProp(cur, "effect").GetXML(), (const xmlChar *)"death")) {
-            zone = tNEW( gDeathZoneHack) ( grid, eCoord(x*sizeMultiplier,y*sizeMultiplier) );
-        }
-        else if (!xmlStrcmp(myxmlGetProp(cur, "effect").GetXML(), (const xmlChar *)"fortress")) {
-            zone = tNEW( gBaseZoneHack) ( grid, eCoord(x*sizeMultiplier,y*sizeMultiplier) );
-        }
-
-        // leaving zone undeleted is no memory leak here, the gid takes control of it
-        if ( zone )
-        {
-            zone->SetRadius( radius*sizeMultiplier );
-            zone->SetExpansionSpeed( growth*sizeMultiplier );
-            zone->SetRotationSpeed( .3f );
-            zone->RequestSync();
-        }
-    }
+    gMapInstruction & zone = Emit(gMapInstruction::Zone);
+    gXMLCharReturn effect = myxmlGetProp(cur, "effect");
+    if (effect.Get())
+        zone.name = effect.Get();
+    zone.args.push_back(x);
+    zone.args.push_back(y);
+    zone.args.push_back(radius);
+    zone.args.push_back(growth);
 }
 
 ePoint * gParser::DrawRim( eGrid * grid, ePoint * start, eCoord const & stop, REAL h )
@@ -537,31 +727,24 @@ ePoint * gParser::DrawRim( eGrid * grid, ePoint * start, eCoord const & stop, RE
 
 void
 gParser::parseWallLine(eGrid *grid, xmlNodePtr cur, const xmlChar * keyword) {
-    REAL ox, oy, x, y;
-    ePoint *R;
-
-    ox = myxmlGetPropFloat(cur, "startx");	oy = myxmlGetPropFloat(cur, "starty");
-    x = myxmlGetPropFloat(cur,   "endx");	 y = myxmlGetPropFloat(cur,   "endy");
-    R = grid->Insert(eCoord(ox, oy) * sizeMultiplier);
-    R = this->DrawRim(grid, R, eCoord(x, y) * sizeMultiplier);
-    sg_Deprecated();
+    gMapInstruction & line = Emit(gMapInstruction::Line);
+    line.args.push_back(myxmlGetPropFloat(cur, "startx"));
+    line.args.push_back(myxmlGetPropFloat(cur, "starty"));
+    line.args.push_back(myxmlGetPropFloat(cur, "endx"));
+    line.args.push_back(myxmlGetPropFloat(cur, "endy"));
+    Emit(gMapInstruction::Deprecated);
 
     endElementAlternative(grid, cur, keyword);
 }
 
 void
 gParser::parseWallRect(eGrid *grid, xmlNodePtr cur, const xmlChar * keyword) {
-    REAL ox, oy, x, y;
-    ePoint *R;
-
-    ox = myxmlGetPropFloat(cur, "startx");	oy = myxmlGetPropFloat(cur, "starty");
-    x = myxmlGetPropFloat(cur,   "endx");	 y = myxmlGetPropFloat(cur,   "endy");
-    R = grid->Insert(eCoord(ox, oy) * sizeMultiplier);
-    R = this->DrawRim( grid, R, eCoord( x, oy) * sizeMultiplier);
-    R = this->DrawRim( grid, R, eCoord( x,  y) * sizeMultiplier);
-    R = this->DrawRim( grid, R, eCoord(ox,  y) * sizeMultiplier);
-    R = this->DrawRim( grid, R, eCoord(ox, oy) * sizeMultiplier);
-    sg_Deprecated();
+    gMapInstruction & rectangle = Emit(gMapInstruction::Rectangle);
+    rectangle.args.push_back(myxmlGetPropFloat(cur, "startx"));
+    rectangle.args.push_back(myxmlGetPropFloat(cur, "starty"));
+    rectangle.args.push_back(myxmlGetPropFloat(cur, "endx"));
+    rectangle.args.push_back(myxmlGetPropFloat(cur, "endy"));
+    Emit(gMapInstruction::Deprecated);
 
     endElementAlternative(grid, cur, keyword);
 }
@@ -569,39 +752,31 @@ gParser::parseWallRect(eGrid *grid, xmlNodePtr cur, const xmlChar * keyword) {
 void
 gParser::parseWall(eGrid *grid, xmlNodePtr cur, const xmlChar * keyword)
 {
-    ePoint *R = NULL, *sR = NULL;
-#ifdef DEBUG
-    REAL ox, oy;
-#endif
-    REAL x, y;
-
     REAL height = myxmlGetPropFloat(cur, "height");
     if ( height <= 0 )
         height = 10000;
 
+    Emit(gMapInstruction::WallBegin).args.push_back(height);
+
     cur = cur->xmlChildrenNode;
 
     while (cur != NULL) {
         if (!xmlStrcmp(cur->name, (const xmlChar *)"text") || !xmlStrcmp(cur->name, (const xmlChar *)"comment")) {}
         else if (isElement(cur->name, (const xmlChar *)"Point", keyword)) {
-            x = myxmlGetPropFloat(cur, "x");
-            y = myxmlGetPropFloat(cur, "y");
-
-            if (R == NULL)
-                R = grid->Insert(eCoord(x, y) * sizeMultiplier);
-            else
-                R = this->DrawRim(grid, R, eCoord(x, y) * sizeMultiplier, height);
+            gMapInstruction & point = Emit(gMapInstruction::WallPoint);
+            point.args.push_back(myxmlGetPropFloat(cur, "x"));
+            point.args.push_back(myxmlGetPropFloat(cur, "y"));
 
             // TODO-Alt:
             // if this function returns a point, use it in the wall. Otherwise, ignore what comes out.
             endElementAlternative(grid, cur, keyword);
         }
         else if (isElement(cur->name, (const xmlChar *)"SavePos", keyword)) {
-            sR = R;
+            Emit(gMapInstruction::WallSavePos);
             endElementAlternative(grid, cur, keyword);
         }
         else if (isElement(cur->name, (const xmlChar *)"RestorePos", keyword)) {
-            R = sR;
+            Emit(gMapInstruction::WallRestorePos);
             endElementAlternative(grid, cur, keyword);
         }
         else if (isElement(cur->name, (const xmlChar *)"Line", keyword)) {
@@ -618,31 +793,25 @@ gParser::parseWall(eGrid *grid, xmlNodePtr cur, const xmlChar * keyword)
             }
         }
         cur = cur->next;
-#ifdef DEBUG
-        ox = x;	oy = y;
-#endif
     }
+
+    Emit(gMapInstruction::WallEnd);
 }
 
 void
 gParser::parseObstacleWall(eGrid *grid, xmlNodePtr cur, const xmlChar * keyword)
 {
-    ePoint *R = NULL;
-    REAL x, y;
-
     REAL height = myxmlGetPropFloat(cur, "height");
+    Emit(gMapInstruction::WallBegin).args.push_back(height);
+
     cur = cur->xmlChildrenNode;
 
     while (cur != NULL) {
         if (!xmlStrcmp(cur->name, (const xmlChar *)"text") || !xmlStrcmp(cur->name, (const xmlChar *)"comment")) {}
         else if (isElement(cur->name, (const xmlChar *)"Point", keyword)) {
-            x = myxmlGetPropFloat(cur, "x");
-            y = myxmlGetPropFloat(cur, "y");
-
-            if (R == NULL)
-                R = grid->Insert(eCoord(x, y) * sizeMultiplier);
-            else
-                R = this->DrawRim(grid, R, eCoord(x, y) * sizeMultiplier, height );
+            gMapInstruction & point = Emit(gMapInstruction::WallPoint);
+            point.args.push_back(myxmlGetPropFloat(cur, "x"));
+            point.args.push_back(myxmlGetPropFloat(cur, "y"));
             endElementAlternative(grid, cur, keyword);
         }
         else if (isElement(cur->name, (const xmlChar *)"Alternative", keyword)) {
@@ -652,7 +821,8 @@ gParser::parseObstacleWall(eGrid *grid, xmlNodePtr cur, const xmlChar * keyword)
         }
         cur = cur->next;
     }
-    sg_Deprecated();
+    Emit(gMapInstruction::WallEnd);
+    Emit(gMapInstruction::Deprecated);
 }
 
 /* processSubAlt should be applied to all and any elements, even those that are known not to have any
@@ -812,12 +982,13 @@ gParser::parseWorld(eGrid *grid, xmlNodePtr cur, const xmlChar * keyword)
 void
 gParser::parseSetting(eGrid *grid, xmlNodePtr cur, const xmlChar * keyword)
 {
-    if (strlen(myxmlGetProp(cur, "name")) && strlen(myxmlGetProp(cur, "value")) && sn_GetNetState() != nCLIENT )
+    gXMLCharReturn name = myxmlGetProp(cur, "name");
+    gXMLCharReturn value = myxmlGetProp(cur, "value");
+    if (name.Get() && value.Get() && strlen(name) && strlen(value))
     {
-        std::stringstream ss;
-        /* Yes it is ackward to generate a string that will be decifered on the other end*/
-        ss << myxmlGetProp(cur, "name")  << " " << myxmlGetProp(cur, "value");
-        tConfItemBase::LoadLine(ss);
+        gMapInstruction & setting = Emit(gMapInstruction::Setting);
+        setting.name = name.Get();
+        setting.value = value.Get();
     }
     /* Verify if any sub elements are included, and if they contain any Alt
        Sub elements of Point arent defined in the current version*/
@@ -841,8 +1012,7 @@ gParser::parseSettings(eGrid *grid, xmlNodePtr cur, const xmlChar * keyword)
         cur = cur->next;
     }
 
-    update_settings();
-    sizeMultiplier = gArena::GetSizeMultiplier();
+    Emit(gMapInstruction::SettingsDone);
 }
 
 void
@@ -866,18 +1036,26 @@ gParser::parseMap(eGrid *grid, xmlNodePtr cur, const xmlChar * keyword)
     }
 }
 
+gMapInstruction &
+gParser::Emit(int opcode)
+{
+    tASSERT( compiling );
+    compiling->instructions.push_back( gMapInstruction( opcode ) );
+    return compiling->instructions.back();
+}
+
 void
-gParser::InstantiateMap(float aSizeMultiplier)
+gParser::Compile(gCompiledMap & target)
 {
-    rimTexture = 0;
-    // BOP
-    sizeMultiplier = aSizeMultiplier;
-    // EOP
+    compiling = &target;
+    target.instructions.clear();
+
     xmlNodePtr cur;
     cur = xmlDocGetRootElement(doc);
 
     if (cur == NULL) {
         con << "ERROR: Map file is blank\n";
+        compiling = NULL;
         return;
     }
 
@@ -907,7 +1085,7 @@ gParser::InstantiateMap(float aSizeMultiplier)
     }
     else if (isElement(cur->name, (const xmlChar *) "World")) {
         // Legacy code to support version 0.1 of the DTDs
-        sg_Deprecated();
+        Emit(gMapInstruction::Deprecated);
 
         cur = cur->xmlChildrenNode;
         while (cur != NULL) {
@@ -927,6 +1105,129 @@ gParser::InstantiateMap(float aSizeMultiplier)
 
     //        fprintf(stderr,"ERROR: Map file is missing root \'Resources\' node");
 
+    compiling = NULL;
+}
+
+void
+gParser::InstantiateMap(float aSizeMultiplier)
+{
+    rimTexture = 0;
+    // BOP
+    sizeMultiplier = aSizeMultiplier;
+    // EOP
+
+    if (!compiled)
+        return;
+
+    // the current wall position, the saved one, and those of the walls the current one is nested in
+    ePoint *R = NULL, *sR = NULL;
+    REAL height = 10000;
+    std::vector< ePoint * > wallStack;
+    std::vector< REAL > heightStack;
+
+    for ( std::vector< gMapInstruction >::const_iterator i = compiled->instructions.begin(); i != compiled->instructions.end(); ++i )
+    {
+        std::vector< float > const & a = i->args;
+        switch ( i->opcode )
+        {
+        case gMapInstruction::Setting:
+            if ( sn_GetNetState() != nCLIENT )
+            {
+                std::stringstream ss;
+                /* Yes it is ackward to generate a string that will be decifered on the other end*/
+                ss << i->name << " " << i->value;
+                tConfItemBase::LoadLine(ss);
+            }
+            break;
+        case gMapInstruction::SettingsDone:
+            update_settings();
+            sizeMultiplier = gArena::GetSizeMultiplier();
+            break;
+        case gMapInstruction::Winding:
+            theGrid->SetWinding( int( a[0] ) );
+            break;
+        case gMapInstruction::WindingAxes:
+        {
+            int number = int( a[0] );
+            std::vector< eCoord > axisDir( number );
+            for ( int j = 0; j < number; ++j )
+                axisDir[j] = eCoord( a[2+2*j], a[3+2*j] );
+            theGrid->SetWinding( number, &axisDir[0], a[1] != 0 );
+            break;
+        }
+        case gMapInstruction::Spawn:
+            theArena->NewSpawnPoint( eCoord( a[0], a[1] ), eCoord( a[2], a[3] ) );
+            break;
+        case gMapInstruction::Zone:
+            if ( sn_GetNetState() != nCLIENT )
+            {
+                eCoord pos = eCoord( a[0], a[1] ) * sizeMultiplier;
+                gZone * zone = NULL;
+                if ( i->name == "win" )
+                    zone = tNEW( gWinZoneHack) ( theGrid, pos );
+                else if ( i->name == "death" )
+                    zone = tNEW( gDeathZoneHack) ( theGrid, pos );
+                else if ( i->name == "fortress" )
+                    zone = tNEW( gBaseZoneHack) ( theGrid, pos );
+
+                // leaving zone undeleted is no memory leak here, the gid takes control of it
+                if ( zone )
+                {
+                    zone->SetRadius( a[2]*sizeMultiplier );
+                    zone->SetExpansionSpeed( a[3]*sizeMultiplier );
+                    zone->SetRotationSpeed( .3f );
+                    zone->RequestSync();
+                }
+            }
+            break;
+        case gMapInstruction::WallBegin:
+            wallStack.push_back( R );
+            wallStack.push_back( sR );
+            heightStack.push_back( height );
+            R = sR = NULL;
+            height = a[0];
+            break;
+        case gMapInstruction::WallPoint:
+            if (R == NULL)
+                R = theGrid->Insert(eCoord(a[0], a[1]) * sizeMultiplier);
+            else
+                R = this->DrawRim(theGrid, R, eCoord(a[0], a[1]) * sizeMultiplier, height);
+            break;
+        case gMapInstruction::WallSavePos:
+            sR = R;
+            break;
+        case gMapInstruction::WallRestorePos:
+            R = sR;
+            break;
+        case gMapInstruction::WallEnd:
+            tASSERT( wallStack.size() >= 2 && !heightStack.empty() );
+            sR = wallStack.back();
+            wallStack.pop_back();
+            R = wallStack.back();
+            wallStack.pop_back();
+            height = heightStack.back();
+            heightStack.pop_back();
+            break;
+        case gMapInstruction::Line:
+        {
+            ePoint * L = theGrid->Insert(eCoord(a[0], a[1]) * sizeMultiplier);
+            this->DrawRim(theGrid, L, eCoord(a[2], a[3]) * sizeMultiplier);
+            break;
+        }
+        case gMapInstruction::Rectangle:
+        {
+            ePoint * L = theGrid->Insert(eCoord(a[0], a[1]) * sizeMultiplier);
+            L = this->DrawRim( theGrid, L, eCoord(a[2], a[1]) * sizeMultiplier);
+            L = this->DrawRim( theGrid, L, eCoord(a[2], a[3]) * sizeMultiplier);
+            L = this->DrawRim( theGrid, L, eCoord(a[0], a[3]) * sizeMultiplier);
+            L = this->DrawRim( theGrid, L, eCoord(a[0], a[1]) * sizeMultiplier);
+            break;
+        }
+        case gMapInstruction::Deprecated:
+            sg_Deprecated();
+            break;
+        }
+    }
 }
 
 int myxmlInputReadFILE (void *context, char *buffer, int len) {
@@ -1012,9 +1313,101 @@ static void sg_ErrorFunc( void * ctx,
 }
 #endif
 
+//! throws if a map is not stored where its header says it belongs
+static void sg_CheckFilePath( tString const & rightFilePathIn, char const * filePath )
+{
+    if ( sn_GetNetState() == nCLIENT || rightFilePathIn.Len() <= 1 )
+        return;
+
+    tString rightFilePath( rightFilePathIn );
+    tString pureFilePath( filePath );
+    int paren = pureFilePath.StrPos( "(" );
+    if ( paren > 0 )
+    {
+        pureFilePath = pureFilePath.SubStr( 0, paren );
+    }
+    int pos;
+    while((pos = rightFilePath.StrPos("//")) != -1) {
+        rightFilePath.RemoveSubStr(pos, 1);
+    }
+    while((pos = pureFilePath.StrPos("//")) != -1) {
+        pureFilePath.RemoveSubStr(pos, 1);
+    }
+    if ( rightFilePath != pureFilePath )
+    {
+        tOutput message( "$resource_file_wrong_place", pureFilePath, rightFilePath );
+        tOutput title( "$resource_file_wrong_place_title" );
+        throw tGenericException( message, title );
+    }
+}
+
+//! makes a compiled map the cached one for its file and returns the cached copy
+static gCompiledMap const * sg_StoreCompiledMap( gCompiledMap const & map, bool writeToDisk )
+{
+    gCompiledMap & cached = sg_compiledMaps[ map.filePath ];
+    cached = map;
+
+    if ( writeToDisk )
+    {
+        std::ofstream out;
+        if ( tDirectories::Var().Open( out, sg_CompiledMapFile( map.filePath ), std::ios::out | std::ios::binary ) )
+        {
+            map.Write( out );
+        }
+    }
+
+    return &cached;
+}
+
 bool
 gParser::LoadAndValidateMapXML(char const * uri, FILE* docfd, char const * filePath)
 {
+    compiled = NULL;
+
+    if (docfd == NULL) {
+        con << "LoadAndValidateMapXML passed a NULL docfd (we should really trap this somewhere else!)\n";
+        return false;
+    }
+
+    /* read the whole file; its fingerprint decides whether the compiled map can be reused */
+    std::string content;
+    {
+        char buffer[4096];
+        size_t len;
+        while ( ( len = fread( buffer, 1, sizeof( buffer ), docfd ) ) > 0 )
+            content.append( buffer, len );
+    }
+
+    gCompiledMap fresh;
+    fresh.filePath = filePath;
+    fresh.Fingerprint( content );
+
+    if ( sg_mapCache )
+    {
+        /* compiled in this session? */
+        gCompiledMapCache::iterator found = sg_compiledMaps.find( fresh.filePath );
+        if ( found != sg_compiledMaps.end() && found->second.SameFile( fresh ) )
+        {
+            sg_CheckFilePath( tString( found->second.rightFilePath.c_str() ), filePath );
+            compiled = &found->second;
+            return true;
+        }
+
+        /* compiled in an earlier session? */
+        tString diskPath = tDirectories::Var().GetReadPath( sg_CompiledMapFile( fresh.filePath ) );
+        if ( diskPath.Len() > 1 )
+        {
+            std::ifstream in( diskPath, std::ios::in | std::ios::binary );
+            gCompiledMap stored;
+            if ( stored.Read( in ) && stored.SameFile( fresh ) )
+            {
+                sg_CheckFilePath( tString( stored.rightFilePath.c_str() ), filePath );
+                compiled = sg_StoreCompiledMap( stored, false );
+                return true;
+            }
+        }
+    }
+
 #ifndef DEDICATED
     /* register error handler */
     xmlGenericErrorFunc errorFunc = &sg_ErrorFunc;
@@ -1026,11 +1419,6 @@ gParser::LoadAndValidateMapXML(char const * uri, FILE* docfd, char const * fileP
 
     bool validated = false;
 
-    if (docfd == NULL) {
-        con << "LoadAndValidateMapXML passed a NULL docfd (we should really trap this somewhere else!)\n";
-        return false;
-    }
-
 #ifndef HAVE_LIBXML2_WO_PIBCREATE
     //xmlSetExternalEntityLoader(myxmlResourceEntityLoader);
     xmlParserInputBufferCreateFilenameDefault(myxmlParserInputBufferCreateFilenameFunc);	//should be moved to some program init area
@@ -1058,8 +1446,7 @@ gParser::LoadAndValidateMapXML(char const * uri, FILE* docfd, char const * fileP
 #endif
 
     /* parse the file, activating the DTD validation option */
-    doc = xmlCtxtReadIO(ctxt, myxmlInputReadFILE, NULL, docfd, uri, NULL, XML_PARSE_DTDVALID);
-    // NOTE: Do *not* pass myxmlInputCloseFILE; we close the file *later*
+    doc = xmlCtxtReadMemory(ctxt, content.data(), content.size(), uri, NULL, XML_PARSE_DTDVALID);
 
     /* check if parsing suceeded */
     if (doc == NULL) {
@@ -1078,41 +1465,16 @@ gParser::LoadAndValidateMapXML(char const * uri, FILE* docfd, char const * fileP
     }
 
     /* check filepath */
-    if ( sn_GetNetState() != nCLIENT )
+    xmlNodePtr root = doc ? xmlDocGetRootElement(doc) : NULL;
+    if (root && isElement(root->name, (const xmlChar *) "Resource"))
     {
-        xmlNodePtr root;
-        root = xmlDocGetRootElement(doc);
-
-        if (root) {
-            if (isElement(root->name, (const xmlChar *) "Resource"))
-            {
-                tString rightFilePath = tString( (char const *)myxmlGetProp(root, "author") ) + "/" +
-                                        tString( (char const *)myxmlGetProp(root, "category") ) + "/" +
-                                        tString( (char const *)myxmlGetProp(root, "name") ) + "-" +
-                                        tString( (char const *)myxmlGetProp(root, "version") ) + "." +
-                                        tString( (char const *)myxmlGetProp(root, "type") ) + ".xml";
-
-                tString pureFilePath( filePath );
-                int paren = pureFilePath.StrPos( "(" );
-                if ( paren > 0 )
-                {
-                    pureFilePath = pureFilePath.SubStr( 0, paren );
-                }
-                int pos;
-                while((pos = rightFilePath.StrPos("//")) != -1) {
-                    rightFilePath.RemoveSubStr(pos, 1);
-                }
-                while((pos = pureFilePath.StrPos("//")) != -1) {
-                    pureFilePath.RemoveSubStr(pos, 1);
-                }
-                if ( rightFilePath != pureFilePath )
-                {
-                    tOutput message( "$resource_file_wrong_place", pureFilePath, rightFilePath );
-                    tOutput title( "$resource_file_wrong_place_title" );
-                    throw tGenericException( message, title );
-                }
-            }
-        }
+        tString rightFilePath = tString( (char const *)myxmlGetProp(root, "author") ) + "/" +
+                                tString( (char const *)myxmlGetProp(root, "category") ) + "/" +
+                                tString( (char const *)myxmlGetProp(root, "name") ) + "-" +
+                                tString( (char const *)myxmlGetProp(root, "version") ) + "." +
+                                tString( (char const *)myxmlGetProp(root, "type") ) + ".xml";
+        fresh.rightFilePath = static_cast< char const * >( rightFilePath );
+        sg_CheckFilePath( rightFilePath, filePath );
     }
 
     /* free up the parser context */
@@ -1123,5 +1485,17 @@ gParser::LoadAndValidateMapXML(char const * uri, FILE* docfd, char const * fileP
     initGenericErrorDefaultFunc( NULL );
 #endif
 
+    /* compile and drop the document, it is not needed any more */
+    if (validated)
+    {
+        Compile(fresh);
+        compiled = sg_StoreCompiledMap( fresh, sg_mapCache );
+    }
+    if (doc)
+    {
+        xmlFreeDoc(doc);
+        doc=NULL;
+    }
+
     return validated;
 }
@@ -13,6 +13,8 @@ class ePoint;
 class gGame;
 class gWallRim;
 class gXMLCharReturn;
+class gCompiledMap;
+struct gMapInstruction;
 
 /*
 Note to the reader: In the full World idea, the parser should, 
@@ -32,6 +34,9 @@ class gParser {
 
     xmlDocPtr doc; /* The map xml document */
 
+    gCompiledMap const * compiled; /* The world building steps of the current map, owned by the map cache */
+    gCompiledMap * compiling;      /* The compiled map receiving the steps while the document is walked */
+
     REAL rimTexture; /* The rim wall texture coordinate */
 
     ePoint * DrawRim( eGrid * grid, ePoint * start, eCoord const & stop, REAL h=10000 ); /* Draws a rim wall segment */
@@ -48,6 +53,9 @@ public:
     void InstantiateMap(float sizeMultiplier);
 
 protected:
+    void Compile(gCompiledMap & target);  /* Walks the xml document and records the world building steps */
+    gMapInstruction & Emit(int opcode);   /* Appends a world building step to the map being compiled */
+
     bool trueOrFalse(char *str);
     gXMLCharReturn myxmlGetProp(xmlNodePtr cur, const char *name);
     int myxmlGetPropInt(xmlNodePtr cur, const char *name);
@@ -55,14 +55,8 @@ bool gParticles::Timestep(REAL currentTime) {
     // Set the timestep interval for the system
     pTimeStep( (float) ticks);
 
-    // Bounce particles off a disc of radius 5.
-    //	pBounce(-0.05, 0.35, 0, PDDisc, 0, 0, 0,  0, 0, 1,  5);
-
-    // Kill particles below Z=-3.
-    //pSink(false, PDPlane, 0, 0, 0, 0,0,1);
-
-    // Move particles to their new positions.
-    pMove();
+    // Run the per frame actions; the library fuses them into one pass.
+    pCallActionList(thisActions);
 
     // Now we check to see if the system is over
     //if( pGetGroupCount() == 0 )
@@ -139,7 +133,29 @@ gParticles::gParticles(const eCoord &pos,const glCoord &vec,REAL time, ParticleS
     // Generate particles along a very small line in the nozzel.
     pSource(psystem.numParticles, PDSphere, focus.x, focus.y, focus.z, 20);
 
-    // Gravity.
+    // Gravity, applied once to the starting velocities.
     pGravity(0.0, 0.0, -0.01);
+
+    // Build the list of actions to run every timestep.
+    thisActions = pGenActionLists(1);
+    pNewActionList(thisActions);
+
+    // Bounce particles off a disc of radius 5.
+    //	pBounce(-0.05, 0.35, 0, PDDisc, 0, 0, 0,  0, 0, 1,  5);
+
+    // Kill particles below Z=-3.
+    //pSink(false, PDPlane, 0, 0, 0, 0,0,1);
+
+    // Move particles to their new positions.
+    pMove();
+
+    pEndActionList();
+#endif
+}
+
+gParticles::~gParticles() {
+#ifdef USE_PARTICLES
+    pDeleteActionLists(thisActions, 1);
+    pDeleteParticleGroups(thisSystem, 1);
 #endif
 }
@@ -78,7 +78,7 @@ typedef struct {
 class gParticles {
 public:
     gParticles(const eCoord &pos,const glCoord &vec,REAL time, ParticleSystem &param);
-    virtual ~gParticles(){}
+    virtual ~gParticles();
 
     virtual bool Timestep(REAL currentTime);
     virtual void GiveBirth(REAL currentTime = 0.0f);   // creates a new particle in the system
@@ -96,6 +96,7 @@ private:
     REAL startTime;
     REAL lastTime;
     int thisSystem;
+    int thisActions;
 };
 
 #endif // ArmageTron_PARTICLES_H
@@ -0,0 +1,119 @@
+/*
+
+*************************************************************************
+
+ArmageTron -- Just another Tron Lightcycle Game in 3D.
+Copyright (C) 2000  Manuel Moos (manuel@moosnet.de)
+
+**************************************************************************
+
+This program is free software; you can redistribute it and/or
+modify it under the terms of the GNU General Public License
+as published by the Free Software Foundation; either version 2
+of the License, or (at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program; if not, write to the Free Software
+Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+
+***************************************************************************
+
+*/
+
+// The replay benchmark: linked into armagetronad_replaybench, it turns the dedicated
+// server into a tool that plays back a recording ( --playback ) as fast as the
+// recorded network input and time allow, stops when the recording ends and reports
+// the time spent and the memory allocations made in the main phases of the server.
+
+#include "config.h"
+
+#include "tSysTime.h"
+#include "tCommandLine.h"
+#include "tString.h"
+
+#include <stdlib.h>
+#include <new>
+#include <fstream>
+#include <iostream>
+
+#ifndef DEDICATED
+#error "The replay benchmark needs a dedicated server build."
+#endif
+
+// file to write the results to; empty for the standard output
+static tString sg_benchmarkResults;
+
+static void sg_ReportBenchmark()
+{
+    if ( sg_benchmarkResults.Len() > 1 )
+    {
+        std::ofstream results( static_cast< char const * >( sg_benchmarkResults ) );
+        tPhaseTimer::Report( results );
+    }
+    else
+    {
+        tPhaseTimer::Report( std::cout );
+    }
+}
+
+class gReplayBenchmarkCommandLineAnalyzer: public tCommandLineAnalyzer
+{
+private:
+    virtual bool DoAnalyze( tCommandLineParser & parser )
+    {
+        return parser.GetOption( sg_benchmarkResults, "--results" );
+    }
+
+    virtual void DoHelp( std::ostream & s )
+    {                                      //
+        s << "--results <filename>         : writes the benchmark results to the file\n";
+    }
+};
+
+static gReplayBenchmarkCommandLineAnalyzer sg_analyzer;
+
+// starts measuring before anything else happens and reports at exit
+class gReplayBenchmarkStarter
+{
+public:
+    gReplayBenchmarkStarter()
+    {
+        tPhaseTimer::Enable();
+        atexit( sg_ReportBenchmark );
+    }
+};
+
+static gReplayBenchmarkStarter sg_starter;
+
+#ifdef DONTUSEMEMMANAGER
+// count all allocations made with new. With the memory manager compiled in,
+// it owns these operators; the allocation columns then stay at zero.
+void * operator new( size_t size )
+{
+    tPhaseTimer::CountAllocation();
+    void * ret = malloc( size > 0 ? size : 1 );
+    if ( !ret )
+        throw std::bad_alloc();
+    return ret;
+}
+
+void * operator new[]( size_t size )
+{
+    return operator new( size );
+}
+
+void operator delete( void * p ) throw()
+{
+    free( p );
+}
+
+void operator delete[]( void * p ) throw()
+{
+    free( p );
+}
+#endif
@@ -36,10 +36,8 @@ void gSensor::PassEdge(const eWall *ww,REAL time,REAL a,int r){
     if (!ww)
         return;
 
-    try{
-        eSensor::PassEdge(ww,time,a,r);
-    }
-    catch( eSensorFinished & e )
+    eSensor::PassEdge(ww,time,a,r);
+    if ( finished_ )
     {
         const gPlayerWall *w=dynamic_cast<const gPlayerWall*>(ww);
         if (w)
@@ -63,8 +61,6 @@ void gSensor::PassEdge(const eWall *ww,REAL time,REAL a,int r){
         }
         else if (dynamic_cast<const gWallRim*>(ww))
             type=gSENSOR_RIM;
-
-        throw;
     }
 }
 
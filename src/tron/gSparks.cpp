@@ -101,6 +101,11 @@ bool gSpark::Timestep(REAL currentTime){
 }
 
 void gSpark::InteractWith(eGameObject *,REAL ,int){}
+
+REAL gSpark::InteractionRange() const
+{
+    return -1;
+}
 void gSpark::PassEdge(const eWall *,REAL ,REAL ,int){}
 
 void gSpark::Kill(){createTime=lastTime-100000;}
@@ -58,6 +58,7 @@ public:
     virtual bool Timestep(REAL currentTime);
 
     virtual void InteractWith(eGameObject *target,REAL time,int recursion=1);
+    virtual REAL InteractionRange() const;
 
     virtual void PassEdge(const eWall *e,REAL time,REAL a,int recursion=1);
 
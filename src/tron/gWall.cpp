@@ -2087,6 +2087,10 @@ bool gNetPlayerWall::ClearToTransmit(int user) const{
            && bool(this->cycle_) && this->cycle_->HasBeenTransmitted(user) && inGrid;
 }
 
+REAL gNetPlayerWall::SyncInterest(int user) const{
+    return se_SyncInterest( user, ( beg + end ) * .5, ( end - beg ).Norm() * .5 );
+}
+
 void gNetPlayerWall::WriteSync(nMessage &m){
     nNetObject::WriteSync(m);
 
@@ -243,6 +243,7 @@ public:
     virtual bool ActionOnQuit();
 
     virtual bool ClearToTransmit(int user) const;
+    virtual REAL SyncInterest(int user) const;
 
     virtual void WriteSync(nMessage &m);
     virtual void ReadSync(nMessage &m);
@@ -379,6 +379,22 @@ void gZone::InteractWith( eGameObject * target, REAL time, int recursion )
     }
 }
 
+// *******************************************************************************
+// *
+// *	InteractionRange
+// *
+// *******************************************************************************
+//!
+//!		@return		the zone radius; only objects inside the zone are affected by InteractWith()
+//!
+// *******************************************************************************
+
+REAL gZone::InteractionRange( void ) const
+{
+    // InteractWith() compares against the squared radius, so the sign does not matter
+    return fabs( Radius() );
+}
+
 // *******************************************************************************
 // *
 // *	OnEnter
@@ -114,6 +114,7 @@ private:
     virtual void ReadSync(nMessage &m);    //!< reads sync data
 
     virtual void InteractWith( eGameObject *target,REAL time,int recursion=1 ); //!< looks for objects inzide the zone and reacts on them
+    virtual REAL InteractionRange() const;      //!< returns the range of interactions: the zone radius
 
     virtual void OnEnter( gCycle *target, REAL time ); //!< reacts on objects inside the zone
 